@@ -0,0 +1,152 @@
+/**
+ * @author Olaf Placha
+ * @brief Measures how the acceptors cope with many clients connecting at the same moment.
+ *
+ * All the connections are initiated at once with non-blocking connect calls. Acceptor threads
+ * greet every accepted client with an encoded Hello, as the server does. Reported are accepted
+ * connections per second and the time from initiating a connection to receiving the whole Hello.
+ *
+ * When the queue of pending connections overflows, the handshake may look complete to the client
+ * while the server drops it. Such a client waits for the Hello forever, so it is counted as failed.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include "../network/connection_acceptor.h"
+#include "../network/message_manager.h"
+
+#define NUM_CONNECTIONS 2000
+// Clients which have not received the Hello in this time are considered failed.
+#define DEADLINE_MS 5000
+
+using clock_type = std::chrono::steady_clock;
+
+static options_server benchmark_options() {
+    options_server op;
+    op.bomb_timer = 5;
+    op.players_count = 16;
+    op.turn_duration = 100;
+    op.explosion_radius = 4;
+    op.initial_blocks = 200;
+    op.game_length = 200;
+    op.server_name = "Benchmark server";
+    op.size_x = 64;
+    op.size_y = 64;
+    return op;
+}
+
+static void greet_clients(const std::shared_ptr<ConnectionAcceptor> &acceptor,
+                          const MessageEncoder::message_t &hello) {
+    while (true) {
+        for (int fd: acceptor->accept_pending_connections(0)) {
+            if (write(fd, hello->data(), hello->size()) != (ssize_t) hello->size()) {
+                std::cerr << "Hello not sent\n";
+            }
+            close(fd);
+        }
+    }
+}
+
+// Connects all the clients at once and returns the times it took each of them to receive the Hello,
+// leaving out the ones that did not receive it before the deadline.
+static std::vector<double> storm(types::port_t port, size_t hello_size) {
+    struct sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_loopback;
+    address.sin6_port = htons(port);
+
+    int epoll_fd = epoll_create1(0);
+    std::vector<clock_type::time_point> started(NUM_CONNECTIONS);
+    std::vector<size_t> received(NUM_CONNECTIONS, 0);
+    std::vector<int> fds(NUM_CONNECTIONS);
+    for (size_t i = 0; i < NUM_CONNECTIONS; i++) {
+        fds[i] = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        started[i] = clock_type::now();
+        if (connect(fds[i], (const struct sockaddr *) &address, sizeof(address)) != 0 && errno != EINPROGRESS) {
+            std::cerr << std::strerror(errno) << '\n';
+            exit(EXIT_FAILURE);
+        }
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[i], &event);
+    }
+
+    std::vector<double> latencies;
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    uint8_t buff[1024];
+    size_t finished = 0;
+    auto deadline = started[0] + std::chrono::milliseconds(DEADLINE_MS);
+    while (finished < NUM_CONNECTIONS && clock_type::now() < deadline) {
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock_type::now());
+        int n = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, (int) timeout.count() + 1);
+        for (int e = 0; e < n; e++) {
+            size_t i = events[e].data.u64;
+            ssize_t bytes = read(fds[i], buff, sizeof(buff));
+            if (bytes > 0) {
+                received[i] += (size_t) bytes;
+            }
+            if (received[i] >= hello_size) {
+                latencies.push_back(std::chrono::duration<double, std::milli>(clock_type::now() - started[i]).count());
+            }
+            if (received[i] >= hello_size || bytes == 0 || (bytes < 0 && errno != EAGAIN)) {
+                close(fds[i]);
+                fds[i] = -1;
+                finished++;
+            }
+        }
+    }
+    for (int fd: fds) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+    close(epoll_fd);
+    return latencies;
+}
+
+static void run(types::threads_count_t acceptors_count, int backlog_size, const MessageEncoder::message_t &hello) {
+    // The first acceptor binds an ephemeral port, the other ones share it.
+    types::port_t port = 0;
+    for (types::threads_count_t i = 0; i < acceptors_count; i++) {
+        auto acceptor = std::make_shared<ConnectionAcceptor>(port, backlog_size, acceptors_count > 1, 0);
+        port = acceptor->get_port();
+        // Acceptors keep waiting for connections until the benchmark ends.
+        std::thread{[acceptor, &hello] { greet_clients(acceptor, hello); }}.detach();
+    }
+
+    std::vector<double> latencies = storm(port, hello->size());
+    std::sort(latencies.begin(), latencies.end());
+
+    double last = latencies.empty() ? DEADLINE_MS : latencies.back();
+    std::cout << acceptors_count << " acceptor(s), backlog " << backlog_size << ": "
+              << (double) latencies.size() / last * 1000 << " connections/s, "
+              << NUM_CONNECTIONS - latencies.size() << " failed, time to Hello p99 ";
+
+    // Failed clients count as the slowest ones.
+    size_t p99_index = NUM_CONNECTIONS * 99 / 100;
+    if (p99_index < latencies.size()) {
+        std::cout << latencies[p99_index] << " ms\n";
+    } else {
+        std::cout << "over " << DEADLINE_MS << " ms\n";
+    }
+}
+
+int main() {
+    MessageEncoder::message_t hello = encode_client_message(Hello(benchmark_options()));
+
+    run(1, TCP_BACKLOG_SIZE, hello);
+    run(1, 4096, hello);
+    run(4, 4096, hello);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * @author Olaf Placha
+ * @brief Measures the memory held by the buffers of many mostly idle connections.
+ *
+ * Every connection is a socket pair whose server end is served as in the reactor mode: the
+ * available bytes are received, a Join is decoded and the idle buffers are released. Buffer memory
+ * is reported while the messages are being handled and after the connections became idle, next to
+ * the memory the handlers would hold with buffers of the maximum size allocated up front.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../network/message_manager.h"
+#include "../network/buffer_pool.h"
+
+#define NUM_CONNECTIONS 4000
+
+static size_t resident_bytes() {
+    FILE *statm = fopen("/proc/self/statm", "r");
+    size_t pages = 0;
+    size_t resident = 0;
+    if (statm != nullptr) {
+        if (fscanf(statm, "%zu %zu", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+    return resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+static void report(const std::string &phase) {
+    BufferPool::stats_t stats = BufferPool::get_stats();
+    std::cout << phase << ": buffer memory in use " << stats.used_bytes / 1024 << " KiB ("
+              << stats.used_bytes / NUM_CONNECTIONS << " bytes per connection), pooled "
+              << stats.pooled_bytes / 1024 << " KiB, resident set " << resident_bytes() / 1024 << " KiB\n";
+}
+
+int main() {
+    MessageEncoder encoder;
+    encoder.send_element<types::message_id_t>(serverClientCodes::join);
+    std::string name = "Benchmark player";
+    Join(name).serialize(encoder);
+    MessageEncoder::message_t join = encoder.get_encoded_message();
+
+    size_t resident_before = resident_bytes();
+    std::vector<int> client_fds;
+    std::vector<TCPHandler::ptr> handlers;
+    std::vector<std::shared_ptr<ServerMessageManager>> managers;
+    for (size_t i = 0; i < NUM_CONNECTIONS; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            std::cerr << std::strerror(errno) << '\n';
+            exit(EXIT_FAILURE);
+        }
+        client_fds.push_back(fds[0]);
+        handlers.push_back(std::make_shared<TCPHandler>(fds[1], TCP_BUFF_SIZE));
+        managers.push_back(std::make_shared<ServerMessageManager>(handlers.back()));
+        if (write(fds[0], join->data(), join->size()) != (ssize_t) join->size()) {
+            std::cerr << "Join not sent\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    size_t decoded = 0;
+    for (size_t i = 0; i < NUM_CONNECTIONS; i++) {
+        handlers[i]->receive_available();
+        while (handlers[i]->try_decode_buffered([&] { managers[i]->read_client_message(); })) {
+            decoded++;
+        }
+    }
+    report("Messages handled");
+
+    for (auto &handler: handlers) {
+        handler->release_idle_buffers();
+    }
+    report("Connections idle");
+
+    std::cout << decoded << " Joins decoded, resident set grew by "
+              << ((long) resident_bytes() - (long) resident_before) / 1024 << " KiB, buffers allocated up front would take "
+              << (size_t) NUM_CONNECTIONS * 2 * TCP_BUFF_SIZE / 1024 << " KiB\n";
+
+    managers.clear();
+    handlers.clear();
+    for (int fd: client_fds) {
+        close(fd);
+    }
+
+    return 0;
+}
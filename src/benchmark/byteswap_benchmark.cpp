@@ -0,0 +1,81 @@
+/**
+ * @author Olaf Placha
+ * @brief Measures the throughput of the batch byteswap kernels for arrays of 16 and 32 bit
+ * numbers, as converted by the codec for the positions of blocks and bombs.
+ *
+ * Arrays of CODEC_BATCH_SIZE bytes are converted by the codec at a time, the large ones measure
+ * the kernels when they are limited by the memory. Element converts every number on its own, as
+ * single fields are converted.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../network/byte_order.h"
+#include "../config/config.h"
+
+#define LARGE_ARRAY_BYTES 4194304
+#define TARGET_BYTES 2000000000
+
+using clock_type = std::chrono::steady_clock;
+
+template<typename T, typename Swap>
+void run(const std::string &name, size_t array_bytes, const Swap &swap) {
+    std::vector<uint8_t> bytes(array_bytes);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = (uint8_t) i;
+    }
+    size_t count = array_bytes / sizeof(T);
+    size_t repetitions = TARGET_BYTES / array_bytes;
+
+    auto start = clock_type::now();
+    for (size_t i = 0; i < repetitions; i++) {
+        swap(bytes.data(), count);
+    }
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    // Keep the conversions from being optimized away.
+    volatile uint8_t sink = bytes[bytes.size() / 2];
+    (void) sink;
+    std::cout << name << " " << sizeof(T) * 8 << " bit, " << array_bytes << " bytes: "
+              << (double) (repetitions * array_bytes) / elapsed / 1e9 << " GB/s" << std::endl;
+}
+
+template<typename T>
+void run_width(size_t array_bytes) {
+    run<T>("Element", array_bytes, [](uint8_t *buffer, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            convert_host_to_network_byte_order<T>(buffer + i * sizeof(T));
+        }
+    });
+
+    const std::pair<const char *, ByteSwapKernel> kernels[] = {
+            {"Scalar", ByteSwapKernel::Scalar},
+            {"SSE", ByteSwapKernel::SSE},
+            {"AVX2", ByteSwapKernel::AVX2},
+    };
+    for (const auto &[name, kernel]: kernels) {
+        if (!is_byte_swap_kernel_supported(kernel)) {
+            std::cout << name << " is not supported by the processor" << std::endl;
+            continue;
+        }
+        run<T>(name, array_bytes, [kernel](uint8_t *buffer, size_t count) {
+            if constexpr (sizeof(T) == 2) {
+                swap_byte_order_16(buffer, count, kernel);
+            } else {
+                swap_byte_order_32(buffer, count, kernel);
+            }
+        });
+    }
+}
+
+int main() {
+    for (size_t array_bytes: {(size_t) CODEC_BATCH_SIZE, (size_t) LARGE_ARRAY_BYTES}) {
+        run_width<uint16_t>(array_bytes);
+        run_width<uint32_t>(array_bytes);
+    }
+    return 0;
+}
@@ -0,0 +1,164 @@
+/**
+ * @author Olaf Placha
+ * @brief Measures the throughput of encoding and decoding every message type sent over TCP.
+ *
+ * Each message is encoded into a MessageEncoder and decoded from a MessageDecoder, as when a turn
+ * is encoded once for all the clients and decoded by the client, so that only the codec is timed.
+ * The messages are of the sizes of a busy game of MAX_PLAYERS players. Messages received by relays
+ * are also viewed in place, see message_views.h, which checks all of the message as decoding does
+ * but copies nothing.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <chrono>
+#include <string>
+#include "../network/messages.h"
+#include "../network/message_views.h"
+
+#define MAX_PLAYERS 25
+#define TURN_EVENTS 200
+#define TARGET_BYTES 50000000
+
+using clock_type = std::chrono::steady_clock;
+
+static Player sample_player(size_t id) {
+    Player player;
+    player.name = "Player " + std::to_string(id);
+    player.address = "[2001:db8::" + std::to_string(id) + "]:54321";
+    return player;
+}
+
+static Position sample_position(size_t i) {
+    Position position;
+    position.x = (types::size_xy_t) (i % 31);
+    position.y = (types::size_xy_t) (i % 17);
+    return position;
+}
+
+static Turn sample_turn() {
+    Turn turn;
+    turn.turn = 100;
+    for (size_t i = 0; i < TURN_EVENTS; i++) {
+        switch (i % 4) {
+            case 0: {
+                PlayerMoved event;
+                event.id = (types::player_id_t) (i % MAX_PLAYERS);
+                event.position = sample_position(i);
+                turn.events.emplace_back(event);
+                break;
+            }
+            case 1: {
+                BombPlaced event;
+                event.id = (types::bomb_id_t) i;
+                event.position = sample_position(i);
+                turn.events.emplace_back(event);
+                break;
+            }
+            case 2: {
+                BombExploded event;
+                event.id = (types::bomb_id_t) i;
+                event.robots_destroyed = {0, 1};
+                for (size_t j = 0; j < 8; j++) {
+                    event.blocks_destroyed.push_back(sample_position(i + j));
+                }
+                turn.events.emplace_back(event);
+                break;
+            }
+            default: {
+                BlockPlaced event;
+                event.position = sample_position(i);
+                turn.events.emplace_back(event);
+                break;
+            }
+        }
+    }
+    return turn;
+}
+
+// Encodes and decodes the message until TARGET_BYTES are encoded, reporting both throughputs,
+// and views it if View is not void.
+template<typename View = void, typename Message>
+static void run(const std::string &name, const Message &message) {
+    MessageEncoder encoder;
+    message.serialize(encoder);
+    MessageEncoder::message_t encoded = encoder.get_encoded_message();
+    size_t repetitions = TARGET_BYTES / encoded->size() + 1;
+
+    size_t encoded_bytes = 0;
+    auto start = clock_type::now();
+    for (size_t i = 0; i < repetitions; i++) {
+        message.serialize(encoder);
+        encoded_bytes += encoder.get_encoded_message()->size();
+    }
+    double encode_time = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    size_t decoded = 0;
+    start = clock_type::now();
+    for (size_t i = 0; i < repetitions; i++) {
+        MessageDecoder decoder(*encoded);
+        Message copy(decoder);
+        decoded += decoder.get_remaining_bytes_count() == 0;
+    }
+    double decode_time = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    double view_time = 0;
+    if constexpr (!std::is_void_v<View>) {
+        start = clock_type::now();
+        for (size_t i = 0; i < repetitions; i++) {
+            MessageDecoder decoder(*encoded);
+            View view;
+            decoded += view_message(decoder, view) == StreamStatus::Ok && decoder.get_remaining_bytes_count() == 0;
+        }
+        view_time = std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+    size_t expected = std::is_void_v<View> ? repetitions : 2 * repetitions;
+
+    if (encoded_bytes != repetitions * encoded->size() || decoded != expected) {
+        std::cerr << name << " was not encoded and decoded back!\n";
+        exit(EXIT_FAILURE);
+    }
+    double megabytes = (double) encoded_bytes / 1e6;
+    std::cout << name << " (" << encoded->size() << " bytes): encode " << encode_time * 1e9 / (double) repetitions
+              << " ns, " << megabytes / encode_time << " MB/s, decode " << decode_time * 1e9 / (double) repetitions
+              << " ns, " << megabytes / decode_time << " MB/s";
+    if constexpr (!std::is_void_v<View>) {
+        std::cout << ", view " << view_time * 1e9 / (double) repetitions << " ns, " << megabytes / view_time
+                  << " MB/s";
+    }
+    std::cout << std::endl;
+}
+
+int main() {
+    std::string name = "Benchmark player";
+    run<JoinView>("Join", Join(name));
+    run("Move", Move(Direction::Left));
+
+    Hello hello;
+    hello.server_name = "Benchmark server";
+    hello.players_count = MAX_PLAYERS;
+    hello.size_x = 31;
+    hello.size_y = 17;
+    hello.game_length = 1000;
+    hello.explosion_radius = 4;
+    hello.bomb_timer = 10;
+    run<HelloView>("Hello", hello);
+
+    AcceptedPlayer accepted_player;
+    accepted_player.id = 7;
+    accepted_player.player = sample_player(7);
+    run<AcceptedPlayerView>("AcceptedPlayer", accepted_player);
+
+    GameStarted game_started;
+    GameEnded game_ended;
+    for (size_t id = 0; id < MAX_PLAYERS; id++) {
+        game_started.players[(types::player_id_t) id] = sample_player(id);
+        game_ended.scores[(types::player_id_t) id] = (types::score_t) id;
+    }
+    run<GameStartedView>("GameStarted", game_started);
+    run<TurnView>("Turn", sample_turn());
+    run<GameEndedView>("GameEnded", game_ended);
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/**
+ * @author Olaf Placha
+ * @brief Measures how fast the server notices many clients leaving at once, e.g. at the end of
+ * a tournament, with the exception API of the codec and with the exception-free one.
+ *
+ * Every connection is a socket pair whose client end sends a Join and is closed before the
+ * measurement starts, so that all the disconnections are pending at once. The server ends are
+ * served as in the reactor mode: the available bytes are received, the messages decoded and the
+ * disconnection detected. With exceptions that takes two of them per connection, one when the
+ * buffered bytes run out and one when the peer is found disconnected. Each thread serves its
+ * share of the connections, as the event loops do, since unwinding may contend between threads.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../network/message_manager.h"
+#include "../network/tool_connections.h"
+
+#define NUM_CONNECTIONS 10000
+#define REPETITIONS 3
+
+using clock_type = std::chrono::steady_clock;
+
+struct connection {
+    TCPHandler::ptr handler;
+    ServerMessageManager::ptr manager;
+};
+
+// Connects the clients, each of which sends the message and disconnects.
+static std::vector<connection> connect_clients(const MessageEncoder::message_t &join) {
+    std::vector<connection> connections(NUM_CONNECTIONS);
+    for (auto &c: connections) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            std::cerr << std::strerror(errno) << '\n';
+            exit(EXIT_FAILURE);
+        }
+        if (write(fds[0], join->data(), join->size()) != (ssize_t) join->size()) {
+            std::cerr << "Join not sent\n";
+            exit(EXIT_FAILURE);
+        }
+        close(fds[0]);
+        c.handler = std::make_shared<TCPHandler>(fds[1], TCP_BUFF_SIZE);
+        c.manager = std::make_shared<ServerMessageManager>(c.handler);
+    }
+    return connections;
+}
+
+// Serves a connection with the exception API, returning the number of messages received.
+static size_t serve_with_exceptions(connection &c) {
+    size_t messages = 0;
+    bool drained = false;
+    while (!drained) {
+        bool disconnected = false;
+        try {
+            drained = c.handler->receive_available();
+        }
+        catch (const TCPError &e) {
+            disconnected = true;
+            drained = true;
+        }
+        // Bytes received before the disconnection are still decoded.
+        while (c.handler->try_decode_buffered([&] { c.manager->read_client_message(); })) {
+            messages++;
+        }
+        if (disconnected) {
+            break;
+        }
+    }
+    return messages;
+}
+
+// Serves a connection with the exception-free API, returning the number of messages received.
+static size_t serve_with_status_codes(connection &c) {
+    size_t messages = 0;
+    bool drained = false;
+    while (!drained) {
+        StreamResult<bool> received = c.handler->try_receive_available();
+        drained = !received || *received;
+        StreamResult<ClientMessage> msg = c.manager->try_decode_buffered_client_message();
+        for (; msg; msg = c.manager->try_decode_buffered_client_message()) {
+            messages++;
+        }
+        if (!received) {
+            // The client disconnected.
+            break;
+        }
+    }
+    return messages;
+}
+
+template<typename Serve>
+static void run(const std::string &name, size_t threads_count, const MessageEncoder::message_t &join,
+                const Serve &serve) {
+    double best = 0;
+    for (int repetition = 0; repetition < REPETITIONS; repetition++) {
+        std::vector<connection> connections = connect_clients(join);
+        std::vector<size_t> messages(threads_count, 0);
+
+        auto start = clock_type::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threads_count; t++) {
+            threads.emplace_back([&, t] {
+                for (size_t i = t; i < connections.size(); i += threads_count) {
+                    messages[t] += serve(connections[i]);
+                }
+            });
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        double elapsed = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+
+        size_t received = 0;
+        for (size_t m: messages) {
+            received += m;
+        }
+        if (received != NUM_CONNECTIONS) {
+            std::cerr << "Received " << received << " messages instead of " << NUM_CONNECTIONS << "!\n";
+            exit(EXIT_FAILURE);
+        }
+        if (repetition == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    std::cout << name << ", " << threads_count << " thread(s): " << NUM_CONNECTIONS << " disconnections in "
+              << best << " ms, " << best * 1000000 / NUM_CONNECTIONS << " ns per client\n";
+}
+
+int main() {
+    // Every connection is held by the server end only, the limit is raised for the 10000 of them.
+    raise_open_files_limit();
+
+    MessageEncoder encoder;
+    encoder.send_element<types::message_id_t>(serverClientCodes::join);
+    std::string name = "Benchmark player";
+    Join(name).serialize(encoder);
+    MessageEncoder::message_t join = encoder.get_encoded_message();
+
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads_count: {(size_t) 1, cores}) {
+        run("Exceptions", threads_count, join, serve_with_exceptions);
+        run("Status codes", threads_count, join, serve_with_status_codes);
+        if (cores == 1) {
+            break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * @author Olaf Placha
+ * @brief Measures the cost of looking up the structures of the current game for every message
+ * received from the clients, as the threads serving them contend for the shared state.
+ *
+ * Locked is the lookup the server made before: the shared lock is taken to copy the pointers to
+ * the structures and again to check whether the game started. Cached copies the pointers only
+ * when the version of the game changes, otherwise it reads two atomics. A new game is published
+ * every GAME_INTERVAL lookups of a thread, as a game ends, so that both paths copy the pointers
+ * now and then. Every lookup is followed by a move stored in the slot of the thread.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <shared_mutex>
+#include "../concurrency/accepted_player_container.h"
+#include "../concurrency/move_container.h"
+
+#define LOOKUPS 2000000
+#define GAME_INTERVAL 100000
+#define MAX_THREADS 8
+
+typedef std::unique_lock<std::shared_mutex> WriteLock;
+typedef std::shared_lock<std::shared_mutex> ReadLock;
+
+using clock_type = std::chrono::steady_clock;
+
+struct shared_state {
+    std::shared_mutex mutex;
+    std::atomic<bool> game_started;
+    std::atomic<size_t> game_version;
+    AcceptedPlayerContainer::ptr accepted_players;
+    MoveContainer::ptr move_container;
+} shared;
+
+void reset_shared() {
+    WriteLock lock_guard(shared.mutex);
+    shared.game_started = true;
+    shared.accepted_players = std::make_shared<AcceptedPlayerContainer>(MAX_THREADS);
+    shared.move_container = std::make_shared<MoveContainer>(MAX_THREADS);
+    shared.game_version++;
+}
+
+struct game_structures {
+    size_t game_version = 0;
+    AcceptedPlayerContainer::ptr accepted_players;
+    MoveContainer::ptr move_container;
+};
+
+// Lookup as made by the server before the structures were cached.
+MoveContainer::ptr lookup_locked(game_structures &) {
+    AcceptedPlayerContainer::ptr accepted_players;
+    MoveContainer::ptr move_container;
+    {
+        ReadLock lock_guard(shared.mutex);
+        accepted_players = shared.accepted_players;
+        move_container = shared.move_container;
+    }
+    ReadLock lock_guard(shared.mutex);
+    return shared.game_started ? move_container : nullptr;
+}
+
+MoveContainer::ptr lookup_cached(game_structures &game) {
+    if (game.game_version != shared.game_version) {
+        ReadLock lock_guard(shared.mutex);
+        game.accepted_players = shared.accepted_players;
+        game.move_container = shared.move_container;
+        game.game_version = shared.game_version;
+    }
+    return shared.game_started ? game.move_container : nullptr;
+}
+
+template<typename Lookup>
+void run(const std::string &name, size_t threads_count, const Lookup &lookup) {
+    reset_shared();
+    ClientMessage move = Move(Direction::Up);
+
+    auto start = clock_type::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threads_count; t++) {
+        threads.emplace_back([&, t] {
+            game_structures game;
+            for (size_t i = 1; i <= LOOKUPS; i++) {
+                MoveContainer::ptr move_container = lookup(game);
+                move_container->update_slot((types::player_id_t) t, move);
+                if (t == 0 && i % GAME_INTERVAL == 0) {
+                    reset_shared();
+                }
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+
+    std::cout << name << ", " << threads_count << " thread(s): " << elapsed / (double) (LOOKUPS * threads_count)
+              << " ns per message" << std::endl;
+}
+
+int main() {
+    for (size_t threads_count = 1; threads_count <= MAX_THREADS; threads_count *= 2) {
+        run("Locked", threads_count, lookup_locked);
+        run("Cached", threads_count, lookup_cached);
+    }
+    return 0;
+}
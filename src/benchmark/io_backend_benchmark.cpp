@@ -0,0 +1,144 @@
+/**
+ * @author Olaf Placha
+ * @brief Compares the socket and io_uring backends of the network handlers on a game-like workload.
+ *
+ * Every millisecond the server sends an encoded Turn to each of many loopback TCP clients, which
+ * decode it and answer with a Move. Round-trip latency of every exchange and CPU time of the
+ * whole process are reported for each backend.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include "../network/message_manager.h"
+
+#define NUM_CLIENTS 32
+#define NUM_TURNS 500
+#define NUM_PLAYERS 16
+
+using clock_type = std::chrono::steady_clock;
+
+static Turn make_turn(types::turn_t turn_id) {
+    Turn turn;
+    turn.turn = turn_id;
+    for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+        PlayerMoved moved{};
+        moved.id = id;
+        moved.position.x = (types::size_xy_t) (turn_id + id);
+        moved.position.y = (types::size_xy_t) (turn_id * id);
+        turn.events.emplace_back(moved);
+    }
+    return turn;
+}
+
+static double cpu_seconds() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (double) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void run(IoBackend requested, const std::vector<MessageEncoder::message_t> &turns) {
+    IoBackend backend = NetworkHandler::select_io_backend(requested);
+    if (backend != requested) {
+        return;
+    }
+
+    // Listen on an ephemeral loopback port.
+    int listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+    struct sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_loopback;
+    socklen_t address_len = sizeof(address);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listen_fd, NUM_CLIENTS) != 0 ||
+        getsockname(listen_fd, (struct sockaddr *) &address, &address_len) != 0) {
+        std::cerr << std::strerror(errno) << '\n';
+        exit(EXIT_FAILURE);
+    }
+
+    // Clients answer every turn with a move.
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < NUM_CLIENTS; i++) {
+        clients.emplace_back([address] {
+            int fd = socket(AF_INET6, SOCK_STREAM, 0);
+            if (connect(fd, (const struct sockaddr *) &address, sizeof(address)) != 0) {
+                std::cerr << std::strerror(errno) << '\n';
+                exit(EXIT_FAILURE);
+            }
+            int flag = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+            TCPHandler handler(fd, TCP_BUFF_SIZE);
+            for (size_t t = 0; t < NUM_TURNS; t++) {
+                handler.read_element<types::message_id_t>();
+                Turn turn(handler);
+                handler.send_element<types::message_id_t>(serverClientCodes::move);
+                Move(Direction::Up).serialize(handler);
+                handler.flush_outcoming_message();
+            }
+        });
+    }
+
+    // Server side of every connection runs in its own thread, as in the threaded server.
+    std::vector<std::vector<double>> latencies(NUM_CLIENTS);
+    std::vector<std::thread> sessions;
+    double cpu_start = cpu_seconds();
+    auto start = clock_type::now();
+    for (size_t i = 0; i < NUM_CLIENTS; i++) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        int flag = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        sessions.emplace_back([fd, start, &turns, &latency = latencies[i]] {
+            TCPHandler handler(fd, TCP_BUFF_SIZE);
+            for (size_t t = 0; t < NUM_TURNS; t++) {
+                std::this_thread::sleep_until(start + std::chrono::milliseconds(t + 1));
+                auto sent = clock_type::now();
+                handler.send_encoded_message(*turns[t]);
+                handler.read_element<types::message_id_t>();
+                Move move(handler);
+                latency.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - sent).count());
+            }
+        });
+    }
+
+    for (auto &session: sessions) {
+        session.join();
+    }
+    double cpu = cpu_seconds() - cpu_start;
+    for (auto &client: clients) {
+        client.join();
+    }
+    close(listen_fd);
+
+    std::vector<double> all;
+    for (auto &latency: latencies) {
+        all.insert(all.end(), latency.begin(), latency.end());
+    }
+    std::sort(all.begin(), all.end());
+    const std::string &name = backend == IoBackend::IoUring ? options::IO_BACKEND_IO_URING : options::IO_BACKEND_SOCKET;
+    std::cout << name << ": "
+              << NUM_CLIENTS << " clients, " << NUM_TURNS << " turns, round trip p50 "
+              << all[all.size() / 2] << " us, p99 " << all[all.size() * 99 / 100] << " us, CPU time "
+              << cpu << " s\n";
+}
+
+int main() {
+    std::vector<MessageEncoder::message_t> turns;
+    for (types::turn_t t = 0; t < NUM_TURNS; t++) {
+        turns.push_back(encode_client_message(make_turn(t)));
+    }
+
+    run(IoBackend::Socket, turns);
+    run(IoBackend::IoUring, turns);
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * @author Olaf Placha
+ * @brief Measures how fast the client side decoders consume a stream of server messages.
+ *
+ * The stream (one GameStarted followed by many Turns) is encoded once, then written repeatedly
+ * into one end of a socket pair while the other end is decoded with TCPHandler.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../network/network_handler.h"
+#include "../network/messages.h"
+
+#define NUM_PLAYERS 16
+#define NUM_TURNS 2000
+#define NUM_REPETITIONS 100
+
+static std::vector<uint8_t> drain_socket(int fd) {
+    std::vector<uint8_t> bytes;
+    uint8_t buff[4096];
+    ssize_t n;
+    while ((n = read(fd, buff, sizeof(buff))) > 0) {
+        bytes.insert(bytes.end(), buff, buff + n);
+    }
+    return bytes;
+}
+
+static Turn make_turn(types::turn_t turn_id) {
+    Turn turn;
+    turn.turn = turn_id;
+    for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+        PlayerMoved moved{};
+        moved.id = id;
+        moved.position.x = (types::size_xy_t) (turn_id + id);
+        moved.position.y = (types::size_xy_t) (turn_id * id);
+        turn.events.emplace_back(moved);
+    }
+    BombExploded exploded;
+    exploded.id = turn_id;
+    exploded.robots_destroyed = {1, 2, 3};
+    for (types::size_xy_t i = 0; i < 8; i++) {
+        Position p{};
+        p.x = i;
+        p.y = turn_id;
+        exploded.blocks_destroyed.push_back(p);
+    }
+    turn.events.emplace_back(exploded);
+    return turn;
+}
+
+// Encodes the benchmarked message stream and returns its wire representation.
+static std::vector<uint8_t> encode_stream() {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        throw std::runtime_error(std::strerror(errno));
+    }
+
+    std::vector<uint8_t> bytes;
+    std::thread drain{[&] { bytes = drain_socket(sv[1]); }};
+    {
+        TCPHandler handler(sv[0], TCP_BUFF_SIZE);
+
+        GameStarted started;
+        for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+            Player player;
+            player.name = "player-number-" + std::to_string(id);
+            player.address = "[::ffff:127.0.0.1]:" + std::to_string(40000 + id);
+            started.players.insert({id, player});
+        }
+        handler.send_element<types::message_id_t>(clientServerCodes::gameStarted);
+        started.serialize(handler);
+        handler.flush_outcoming_message();
+
+        for (types::turn_t i = 0; i < NUM_TURNS; i++) {
+            handler.send_element<types::message_id_t>(clientServerCodes::turn);
+            make_turn(i).serialize(handler);
+            handler.flush_outcoming_message();
+        }
+    }
+    drain.join();
+    close(sv[1]);
+    return bytes;
+}
+
+int main() {
+    std::vector<uint8_t> stream = encode_stream();
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        throw std::runtime_error(std::strerror(errno));
+    }
+
+    std::thread writer{[&] {
+        for (size_t r = 0; r < NUM_REPETITIONS; r++) {
+            size_t offset = 0;
+            while (offset < stream.size()) {
+                ssize_t n = write(sv[1], stream.data() + offset, stream.size() - offset);
+                if (n <= 0) {
+                    return;
+                }
+                offset += (size_t) n;
+            }
+        }
+    }};
+
+    size_t events = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+        TCPHandler handler(sv[0], TCP_BUFF_SIZE);
+        for (size_t r = 0; r < NUM_REPETITIONS; r++) {
+            handler.read_element<types::message_id_t>();
+            GameStarted started(handler);
+            for (size_t i = 0; i < NUM_TURNS; i++) {
+                handler.read_element<types::message_id_t>();
+                Turn turn(handler);
+                events += turn.events.size();
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    writer.join();
+    close(sv[1]);
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double total_bytes = (double) stream.size() * NUM_REPETITIONS;
+    std::cout << "Decoded " << total_bytes / 1e6 << " MB (" << events << " events) in " << seconds << " s: "
+              << total_bytes / seconds / 1e6 << " MB/s\n";
+
+    return 0;
+}
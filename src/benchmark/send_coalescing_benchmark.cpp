@@ -0,0 +1,183 @@
+/**
+ * @author Olaf Placha
+ * @brief Counts send syscalls and TCP segments needed to stream a 64-player game to every player.
+ *
+ * The game is generated by GameServer with random moves and sent to each player over its own
+ * loopback TCP connection (with Nagle's algorithm turned off, as in the server).
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <random>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#include <unistd.h>
+#include "../network/message_manager.h"
+#include "../game_logic/game.h"
+
+#define NUM_PLAYERS 64
+#define GAME_LENGTH 200
+
+std::atomic<size_t> send_syscalls = 0;
+std::atomic<size_t> sendmsg_syscalls = 0;
+
+// Interpose the libc wrappers in order to count the syscalls made by the network module.
+extern "C" ssize_t send(int fd, const void *buf, size_t n, int flags) {
+    send_syscalls++;
+    return syscall(SYS_sendto, fd, buf, n, flags, nullptr, 0);
+}
+
+extern "C" ssize_t sendmsg(int fd, const struct msghdr *msg, int flags) {
+    sendmsg_syscalls++;
+    return syscall(SYS_sendmsg, fd, msg, flags);
+}
+
+static options_server benchmark_options() {
+    options_server op;
+    op.bomb_timer = 5;
+    op.players_count = NUM_PLAYERS;
+    op.turn_duration = 0;
+    op.explosion_radius = 4;
+    op.initial_blocks = 200;
+    op.game_length = GAME_LENGTH;
+    op.server_name = "Benchmark server";
+    op.port = 0;
+    op.seed = 42;
+    op.size_x = 64;
+    op.size_y = 64;
+    return op;
+}
+
+static std::vector<Turn> generate_game(const options_server &op) {
+    std::minstd_rand random(op.seed);
+    std::vector<Turn> turns;
+    GameServer game(op);
+    MoveContainer moves(op.players_count);
+
+    turns.push_back(game.game_init());
+    for (types::game_length_t i = 0; i < op.game_length; i++) {
+        for (types::player_id_t id = 0; id < op.players_count; id++) {
+            switch (random() % 4) {
+                case 0:
+                    moves.update_slot(id, PlaceBomb());
+                    break;
+                case 1:
+                    moves.update_slot(id, PlaceBlock());
+                    break;
+                default:
+                    moves.update_slot(id, Move(static_cast<Direction>(random() % 4)));
+            }
+        }
+        turns.push_back(game.apply_moves(moves));
+    }
+    return turns;
+}
+
+int main() {
+    options_server op = benchmark_options();
+    std::vector<Turn> turns = generate_game(op);
+
+    // Listen on an ephemeral loopback port.
+    int listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+    struct sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_loopback;
+    socklen_t address_len = sizeof(address);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listen_fd, NUM_PLAYERS) != 0 ||
+        getsockname(listen_fd, (struct sockaddr *) &address, &address_len) != 0) {
+        std::cerr << std::strerror(errno) << '\n';
+        return EXIT_FAILURE;
+    }
+
+    // Players only drain their sockets.
+    std::vector<std::thread> players;
+    for (size_t i = 0; i < NUM_PLAYERS; i++) {
+        players.emplace_back([address] {
+            int fd = socket(AF_INET6, SOCK_STREAM, 0);
+            if (connect(fd, (const struct sockaddr *) &address, sizeof(address)) != 0) {
+                std::cerr << std::strerror(errno) << '\n';
+                exit(EXIT_FAILURE);
+            }
+            char buff[65536];
+            while (read(fd, buff, sizeof(buff)) > 0) {}
+            close(fd);
+        });
+    }
+
+    std::vector<int> fds;
+    std::vector<ServerMessageManager::ptr> managers;
+    for (size_t i = 0; i < NUM_PLAYERS; i++) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        int flag = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        TCPHandler::ptr handler = std::make_shared<TCPHandler>(fd, TCP_BUFF_SIZE);
+        fds.push_back(fd);
+        managers.push_back(std::make_shared<ServerMessageManager>(handler));
+    }
+
+    // Players' names and addresses as the server would see them.
+    GameStarted game_started;
+    for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+        Player player;
+        player.name = "Player " + std::to_string(id);
+        player.address = "[::1]:" + std::to_string(50000 + id);
+        game_started.players.insert({id, player});
+    }
+    GameEnded game_ended;
+    for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+        game_ended.scores.insert({id, id});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto &manager: managers) {
+        manager->send_client_message(Hello(op));
+        for (auto const &[id, player]: game_started.players) {
+            AcceptedPlayer accepted;
+            accepted.id = id;
+            accepted.player = player;
+            manager->send_client_message(accepted);
+        }
+        manager->send_client_message(game_started);
+    }
+    for (const Turn &turn: turns) {
+        for (auto &manager: managers) {
+            manager->send_client_message(turn);
+        }
+    }
+    for (auto &manager: managers) {
+        manager->send_client_message(game_ended);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Count data segments sent on every connection.
+    size_t segments = 0;
+    size_t bytes = 0;
+    for (int fd: fds) {
+        struct tcp_info info{};
+        socklen_t info_len = sizeof(info);
+        if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &info_len) == 0) {
+            segments += info.tcpi_data_segs_out;
+            bytes += info.tcpi_bytes_acked;
+        }
+    }
+
+    managers.clear();
+    for (auto &player: players) {
+        player.join();
+    }
+    close(listen_fd);
+
+    std::cout << NUM_PLAYERS << " players, " << turns.size() << " turns, " << bytes << " bytes sent in "
+              << std::chrono::duration<double>(end - start).count() << " s\n"
+              << "send syscalls: " << send_syscalls + sendmsg_syscalls << '\n'
+              << "TCP data segments: " << segments << '\n';
+
+    return 0;
+}
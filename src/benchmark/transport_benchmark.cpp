@@ -0,0 +1,139 @@
+/**
+ * @author Olaf Placha
+ * @brief Measures the message managers and the codec over Unix socket pairs and over in-process
+ * memory pipes, which leave out the kernel.
+ *
+ * Connections: every simulated client connects, sends a Join, which ServerMessageManager decodes,
+ * and reads the Hello and AcceptedPlayer sent back, all in one thread, so that the timing does not
+ * depend on scheduling. Turns: a game of NUM_TURNS turns is streamed over one connection by
+ * ServerMessageManager and decoded by the client in another thread.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <sys/socket.h>
+#include "../network/message_manager.h"
+
+#define NUM_CONNECTIONS 20000
+#define NUM_TURNS 20000
+#define NUM_PLAYERS 16
+
+using clock_type = std::chrono::steady_clock;
+
+// Creates both ends of a connection, the client's one first.
+using connect_t = std::function<std::pair<TCPHandler::ptr, TCPHandler::ptr>()>;
+
+static options_server benchmark_options() {
+    options_server op;
+    op.bomb_timer = 5;
+    op.players_count = NUM_PLAYERS;
+    op.explosion_radius = 4;
+    op.game_length = NUM_TURNS;
+    op.server_name = "Benchmark server";
+    op.size_x = 64;
+    op.size_y = 64;
+    return op;
+}
+
+static Turn make_turn(types::turn_t turn_id) {
+    Turn turn;
+    turn.turn = turn_id;
+    for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+        PlayerMoved moved{};
+        moved.id = id;
+        moved.position.x = (types::size_xy_t) (turn_id + id);
+        moved.position.y = (types::size_xy_t) (turn_id * id);
+        turn.events.emplace_back(moved);
+    }
+    return turn;
+}
+
+static std::pair<TCPHandler::ptr, TCPHandler::ptr> connect_socket_pair() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        std::cerr << std::strerror(errno) << '\n';
+        exit(EXIT_FAILURE);
+    }
+    return {std::make_shared<TCPHandler>(fds[0], TCP_BUFF_SIZE), std::make_shared<TCPHandler>(fds[1], TCP_BUFF_SIZE)};
+}
+
+static std::pair<TCPHandler::ptr, TCPHandler::ptr> connect_memory_pipe() {
+    auto [client_end, server_end] = MemoryPipe::create_connection();
+    return {std::make_shared<TCPHandler>(client_end, TCP_BUFF_SIZE),
+            std::make_shared<TCPHandler>(server_end, TCP_BUFF_SIZE)};
+}
+
+static void run_connections(const std::string &name, const connect_t &connect) {
+    MessageEncoder::message_t hello = encode_client_message(Hello(benchmark_options()));
+    std::string player_name = "Benchmark player";
+
+    auto start = clock_type::now();
+    for (size_t i = 0; i < NUM_CONNECTIONS; i++) {
+        auto [client, server] = connect();
+        ServerMessageManager manager(server);
+
+        client->send_element<types::message_id_t>(serverClientCodes::join);
+        Join(player_name).serialize(*client);
+        client->flush_outcoming_message();
+
+        ClientMessage message = manager.read_client_message();
+        AcceptedPlayer accepted;
+        accepted.id = (types::player_id_t) i;
+        accepted.player.name = std::get<Join>(message).name;
+        accepted.player.address = manager.get_client_name();
+        manager.send_client_message(hello);
+        manager.send_client_message(accepted);
+
+        client->read_element<types::message_id_t>();
+        Hello received_hello(*client);
+        client->read_element<types::message_id_t>();
+        AcceptedPlayer received_accepted(*client);
+    }
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    std::cout << name << ": " << NUM_CONNECTIONS << " connections in " << seconds << " s, "
+              << (double) NUM_CONNECTIONS / seconds << " connections/s\n";
+}
+
+static void run_turns(const std::string &name, const connect_t &connect,
+                      const std::vector<MessageEncoder::message_t> &turns) {
+    auto [client, server] = connect();
+    ServerMessageManager manager(server);
+    size_t bytes = 0;
+    for (const auto &turn: turns) {
+        bytes += turn->size();
+    }
+
+    auto start = clock_type::now();
+    std::thread reader([&client] {
+        for (size_t t = 0; t < NUM_TURNS; t++) {
+            client->read_element<types::message_id_t>();
+            Turn turn(*client);
+        }
+    });
+    for (const auto &turn: turns) {
+        manager.send_client_message(turn);
+    }
+    reader.join();
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    std::cout << name << ": " << NUM_TURNS << " turns in " << seconds << " s, " << (double) NUM_TURNS / seconds
+              << " turns/s, " << (double) bytes / seconds / 1e6 << " MB/s\n";
+}
+
+int main() {
+    std::vector<MessageEncoder::message_t> turns;
+    for (types::turn_t t = 0; t < NUM_TURNS; t++) {
+        turns.push_back(encode_client_message(make_turn(t)));
+    }
+
+    run_connections("Unix socket pair", connect_socket_pair);
+    run_connections("Memory pipe", connect_memory_pipe);
+    run_turns("Unix socket pair", connect_socket_pair, turns);
+    run_turns("Memory pipe", connect_memory_pipe, turns);
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/**
+ * @author Olaf Placha
+ * @brief Compares turn delivery to clients running on the same host over a Unix domain socket
+ * and over loopback TCP.
+ *
+ * Both servers are set up with ConnectionAcceptor and the clients connect with TCPHandler, as
+ * robots-server and robots-client do. Every millisecond the server sends an encoded Turn to each
+ * client, which decodes it and answers with a Move. Reported is the round-trip latency of every
+ * exchange and the CPU time of the whole process.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "../network/connection_acceptor.h"
+#include "../network/message_manager.h"
+
+#define NUM_CLIENTS 32
+#define NUM_TURNS 500
+#define NUM_PLAYERS 16
+
+using clock_type = std::chrono::steady_clock;
+
+static Turn make_turn(types::turn_t turn_id) {
+    Turn turn;
+    turn.turn = turn_id;
+    for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+        PlayerMoved moved{};
+        moved.id = id;
+        moved.position.x = (types::size_xy_t) (turn_id + id);
+        moved.position.y = (types::size_xy_t) (turn_id * id);
+        turn.events.emplace_back(moved);
+    }
+    return turn;
+}
+
+static double cpu_seconds() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (double) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void run(const std::string &name, const ConnectionAcceptor &acceptor,
+                const std::function<std::unique_ptr<TCPHandler>()> &connect,
+                const std::vector<MessageEncoder::message_t> &turns) {
+    // Clients answer every turn with a move.
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < NUM_CLIENTS; i++) {
+        clients.emplace_back([&connect] {
+            std::unique_ptr<TCPHandler> handler = connect();
+            for (size_t t = 0; t < NUM_TURNS; t++) {
+                handler->read_element<types::message_id_t>();
+                Turn turn(*handler);
+                handler->send_element<types::message_id_t>(serverClientCodes::move);
+                Move(Direction::Up).serialize(*handler);
+                handler->flush_outcoming_message();
+            }
+        });
+    }
+
+    // Server side of every connection runs in its own thread, as in the threaded server.
+    std::vector<std::vector<double>> latencies(NUM_CLIENTS);
+    std::vector<std::thread> sessions;
+    double cpu_start = cpu_seconds();
+    auto start = clock_type::now();
+    for (size_t i = 0; i < NUM_CLIENTS; i++) {
+        int fd = acceptor.accept_another_connection();
+        sessions.emplace_back([fd, start, &turns, &latency = latencies[i]] {
+            TCPHandler handler(fd, TCP_BUFF_SIZE);
+            for (size_t t = 0; t < NUM_TURNS; t++) {
+                std::this_thread::sleep_until(start + std::chrono::milliseconds(t + 1));
+                auto sent = clock_type::now();
+                handler.send_encoded_message(*turns[t]);
+                handler.read_element<types::message_id_t>();
+                Move move(handler);
+                latency.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - sent).count());
+            }
+        });
+    }
+
+    for (auto &session: sessions) {
+        session.join();
+    }
+    double cpu = cpu_seconds() - cpu_start;
+    for (auto &client: clients) {
+        client.join();
+    }
+
+    std::vector<double> all;
+    for (auto &latency: latencies) {
+        all.insert(all.end(), latency.begin(), latency.end());
+    }
+    std::sort(all.begin(), all.end());
+    std::cout << name << ": " << NUM_CLIENTS << " clients, " << NUM_TURNS << " turns, round trip p50 "
+              << all[all.size() / 2] << " us, p99 " << all[all.size() * 99 / 100] << " us, CPU time "
+              << cpu << " s\n";
+}
+
+int main() {
+    std::vector<MessageEncoder::message_t> turns;
+    for (types::turn_t t = 0; t < NUM_TURNS; t++) {
+        turns.push_back(encode_client_message(make_turn(t)));
+    }
+
+    {
+        ConnectionAcceptor acceptor(0, NUM_CLIENTS);
+        std::string address = "::1";
+        types::port_t port = acceptor.get_port();
+        run("Loopback TCP", acceptor, [&address, port] {
+            return std::make_unique<TCPHandler>(address, port, TCP_BUFF_SIZE);
+        }, turns);
+    }
+
+    {
+        std::string socket_path = "/tmp/robots-benchmark-" + std::to_string(getpid()) + ".sock";
+        ConnectionAcceptor acceptor(socket_path, NUM_CLIENTS);
+        run("Unix domain socket", acceptor, [&socket_path] {
+            return std::make_unique<TCPHandler>(socket_path, TCP_BUFF_SIZE);
+        }, turns);
+    }
+
+    return 0;
+}
@@ -9,6 +9,7 @@
 #include "game_logic/lobby.h"
 #include "game_logic/game.h"
 #include "network/message_manager.h"
+#include "network/socket_tuning.h"
 
 enum State {
     LOBBY, GAME
@@ -21,20 +22,22 @@ void guiClientServerStream(ClientMessageManager &manager, std::string &player_na
         Join join(player_name);
 
         while (true) {
-            InputMessage message = manager.read_gui_message();
-            if (std::holds_alternative<InvalidMessage>(message)) {
-                // Ignore.
-                continue;
-            }
-            if (state == LOBBY && !join_sent) {
-                // Send a request to join the game.
-                manager.send_server_message(join);
-                join_sent = true;
-            } else {
-                // Send next instruction input to the server.
-                std::visit([&](auto &&arg) {
-                    manager.send_server_message(arg);
-                }, message);
+            // Handle all the inputs that are already queued.
+            for (InputMessage &message: manager.read_gui_messages()) {
+                if (std::holds_alternative<InvalidMessage>(message)) {
+                    // Ignore.
+                    continue;
+                }
+                if (state == LOBBY && !join_sent) {
+                    // Send a request to join the game.
+                    manager.send_server_message(join);
+                    join_sent = true;
+                } else {
+                    // Send next instruction input to the server.
+                    std::visit([&](auto &&arg) {
+                        manager.send_server_message(arg);
+                    }, message);
+                }
             }
         }
     }
@@ -68,8 +71,12 @@ void serverClientGuiStream(ClientMessageManager &manager) {
                     // Another player joined!
                     AcceptedPlayer player = std::get<AcceptedPlayer>(message);
                     lobby.accept(player);
-                    // Send it tu gui.
-                    manager.send_gui_message(lobby.get_lobby_state());
+                    // Send it tu gui, together with the following states if more messages are waiting.
+                    if (manager.has_buffered_server_messages()) {
+                        manager.queue_gui_message(lobby.get_lobby_state());
+                    } else {
+                        manager.send_gui_message(lobby.get_lobby_state());
+                    }
                 } else {
                     throw std::runtime_error("Forbidden message received while in the lobby!");
                 }
@@ -88,8 +95,13 @@ void serverClientGuiStream(ClientMessageManager &manager) {
                 } else if (std::holds_alternative<Turn>(message)) {
                     Turn turn = std::get<Turn>(message);
                     game.apply_turn(turn);
-                    // Get the same state and send it to gui.
-                    manager.send_gui_message(game.get_game_state());
+                    // Get the same state and send it to gui, together with the following states
+                    // if more messages are waiting.
+                    if (manager.has_buffered_server_messages()) {
+                        manager.queue_gui_message(game.get_game_state());
+                    } else {
+                        manager.send_gui_message(game.get_game_state());
+                    }
                 }
             }
         }
@@ -103,11 +115,30 @@ void serverClientGuiStream(ClientMessageManager &manager) {
 int main(int argc, char *argv[]) {
     // Parse program arguments.
     options_client op = parse_client(argc, argv);
+    NetworkHandler::select_io_backend(op.io_backend);
+    SocketTuning::select_profile(op.socket_profile);
+    std::cerr << SocketTuning::describe_profile() << '\n';
 
     // Set up message manager.
-    TCPHandler tcp_handler(op.server_address, op.server_port, TCP_BUFF_SIZE);
-    UDPHandler udp_handler(op.port, op.gui_address, op.gui_port, UDP_BUFF_SIZE);
-    ClientMessageManager manager(tcp_handler, udp_handler);
+    TCPHandler tcp_handler = op.socket_path.empty() ? TCPHandler(op.server_address, op.server_port, TCP_BUFF_SIZE)
+                                                    : TCPHandler(op.socket_path, TCP_BUFF_SIZE);
+    std::unique_ptr<UDPHandler> udp_handler;
+    std::unique_ptr<SharedMemoryGuiHandler> shm_handler;
+    if (op.gui_shm_name.empty()) {
+        udp_handler = std::make_unique<UDPHandler>(op.port, op.gui_endpoints, UDP_BUFF_SIZE);
+    } else {
+        shm_handler = std::make_unique<SharedMemoryGuiHandler>(op.gui_shm_name);
+    }
+    ClientMessageManager manager = udp_handler ? ClientMessageManager(tcp_handler, *udp_handler)
+                                               : ClientMessageManager(tcp_handler, *shm_handler);
+
+    // Ask the server for turns over UDP, it sends them to the address the client is connected from.
+    std::unique_ptr<TurnChannelClient> turn_channel;
+    if (op.turn_port != 0) {
+        turn_channel = std::make_unique<TurnChannelClient>(op.turn_port);
+        manager.set_turn_channel(*turn_channel);
+        manager.send_server_message(SubscribeTurns(op.turn_port));
+    }
 
     // Set initial state.
     state = LOBBY;
@@ -14,6 +14,15 @@ GameStarted AcceptedPlayerContainer::return_when_target_players_joined() {
     return message;
 }
 
+MessageEncoder::message_t AcceptedPlayerContainer::return_encoded_when_target_players_joined() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    // Wait until full set of players join.
+    condition_variable.wait(lock_guard, [&] { return target_players_count == accepted_players.size(); });
+
+    return game_started;
+}
+
 types::player_id_t AcceptedPlayerContainer::add_new_player(const Player &player) {
     std::unique_lock<std::mutex> lock_guard(mutex);
 
@@ -22,7 +31,18 @@ types::player_id_t AcceptedPlayerContainer::add_new_player(const Player &player)
     }
 
     // Add a new player to the map.
-    accepted_players.insert({accepted_players.size(), player});
+    AcceptedPlayer message;
+    message.id = (types::player_id_t) accepted_players.size();
+    message.player = player;
+    accepted_players.insert({message.id, player});
+    encoded_players.push_back(encode_client_message(message));
+
+    if (target_players_count == accepted_players.size()) {
+        // The set of players is complete, encode the message about the start of the game.
+        GameStarted message;
+        message.players = accepted_players;
+        game_started = encode_client_message(message);
+    }
 
     // Notify waiting threads about the new player.
     condition_variable.notify_all();
@@ -46,4 +66,31 @@ AcceptedPlayer AcceptedPlayerContainer::get_accepted_player(types::player_id_t i
     player.player = accepted_players.at(id);
 
     return player;
-}
\ No newline at end of file
+}
+
+GameStarted AcceptedPlayerContainer::get_accepted_players() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    GameStarted message;
+    message.players = accepted_players;
+    return message;
+}
+
+MessageEncoder::message_t AcceptedPlayerContainer::try_get_encoded_accepted_player(types::player_id_t id) {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    if (id >= target_players_count) {
+        throw std::runtime_error("Trying to get player thet will never exist!");
+    }
+
+    if (encoded_players.size() <= id) {
+        return nullptr;
+    }
+    return encoded_players.at(id);
+}
+
+MessageEncoder::message_t AcceptedPlayerContainer::try_get_encoded_game_started() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    return game_started;
+}
@@ -33,6 +33,14 @@ public:
      */
     GameStarted return_when_target_players_joined();
 
+    /**
+     * @brief Returns when enough players join, so that the game can be started. The message is
+     * encoded only once, when the last player joins.
+     * 
+     * @return MessageEncoder::message_t - Encoded message containing all accepted players.
+     */
+    MessageEncoder::message_t return_encoded_when_target_players_joined();
+
     /**
      * @brief Adds a new player to the container.
      *
@@ -48,6 +56,31 @@ public:
      */
     AcceptedPlayer get_accepted_player(types::player_id_t);
 
+    /**
+     * @brief Returns the players accepted so far without waiting for the others, e.g. to hand
+     * them over to the next server, which adds them again in the order of their ids.
+     * 
+     * @return GameStarted - Message containing the accepted players.
+     */
+    GameStarted get_accepted_players();
+
+    /* Below there are non-blocking getters used by event loops. They return nullptr if the
+     * message is not available yet. */
+
+    /**
+     * @brief Returns the encoded message about a player under the provided index.
+     * 
+     * @return MessageEncoder::message_t - Encoded AcceptedPlayer message or nullptr.
+     */
+    MessageEncoder::message_t try_get_encoded_accepted_player(types::player_id_t);
+
+    /**
+     * @brief Returns the encoded message about the start of the game.
+     * 
+     * @return MessageEncoder::message_t - Encoded GameStarted message or nullptr.
+     */
+    MessageEncoder::message_t try_get_encoded_game_started();
+
     /* Delete copy constructor and copy assignment. */
     AcceptedPlayerContainer(AcceptedPlayerContainer const &) = delete;
 
@@ -58,6 +91,8 @@ private:
     std::condition_variable condition_variable;
     std::map<types::player_id_t, Player> accepted_players;
     types::players_count_t target_players_count;
+    std::vector<MessageEncoder::message_t> encoded_players;
+    MessageEncoder::message_t game_started;
 };
 
 #endif // ACCEPTED_PLAYER_CONTAINER_H
\ No newline at end of file
@@ -20,6 +20,12 @@ MoveContainer::container_t MoveContainer::atomic_snapshot_and_clear() {
     return copy;
 }
 
+MoveContainer::container_t MoveContainer::atomic_snapshot() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    return slots;
+}
+
 void MoveContainer::update_slot(types::player_id_t slot_id, const ClientMessage &move) {
     std::unique_lock<std::mutex> lock_guard(mutex);
 
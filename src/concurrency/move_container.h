@@ -31,6 +31,14 @@ public:
      */
     container_t atomic_snapshot_and_clear();
 
+    /**
+     * @brief Takes a snapshot of the container without resetting it, e.g. to pass the moves
+     * requested before a handoff to the next server.
+     *
+     * @return container_t - Snapshot of the container.
+     */
+    container_t atomic_snapshot();
+
     /**
      * @brief Puts the move requested by the player in the container.
      * 
@@ -1,15 +1,215 @@
+#include <set>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include "turn_container.h"
 
+void ClientBoard::apply(const Turn &turn, PriorState *prior_state) {
+    if (prior_state) {
+        prior_state->bombs_count = bombs.size();
+        auto record_block = [&](const Position &position) {
+            prior_state->blocks.emplace_back(position, blocks.contains(position));
+        };
+        auto record_bomb = [&](types::bomb_id_t id) {
+            auto it = bombs.find(id);
+            prior_state->bombs.emplace_back(id, it == bombs.end() ? std::nullopt : std::optional<Bomb>(it->second));
+        };
+        for (const Event &event: turn.events) {
+            if (auto *bomb_placed = std::get_if<BombPlaced>(&event)) {
+                record_bomb(bomb_placed->id);
+            } else if (auto *bomb_exploded = std::get_if<BombExploded>(&event)) {
+                record_bomb(bomb_exploded->id);
+                for (const Position &position: bomb_exploded->blocks_destroyed) {
+                    record_block(position);
+                }
+            } else if (auto *block_placed = std::get_if<BlockPlaced>(&event)) {
+                record_block(block_placed->position);
+            }
+        }
+    }
+
+    for (auto &[id, bomb]: bombs) {
+        bomb.timer = (types::bomb_timer_t) (bomb.timer + 1);
+    }
+
+    // Blocks are destroyed after all the events of the turn, robots score once per turn.
+    std::set<types::player_id_t> robots_destroyed;
+    std::vector<Position> blocks_destroyed;
+    for (const Event &event: turn.events) {
+        if (auto *bomb_placed = std::get_if<BombPlaced>(&event)) {
+            bombs.insert({bomb_placed->id, Bomb{bomb_placed->position, 0}});
+        } else if (auto *bomb_exploded = std::get_if<BombExploded>(&event)) {
+            bombs.erase(bomb_exploded->id);
+            robots_destroyed.insert(bomb_exploded->robots_destroyed.begin(), bomb_exploded->robots_destroyed.end());
+            blocks_destroyed.insert(blocks_destroyed.end(), bomb_exploded->blocks_destroyed.begin(),
+                                    bomb_exploded->blocks_destroyed.end());
+        } else if (auto *player_moved = std::get_if<PlayerMoved>(&event)) {
+            positions[player_moved->id] = player_moved->position;
+        } else if (auto *block_placed = std::get_if<BlockPlaced>(&event)) {
+            blocks.insert(block_placed->position);
+        }
+    }
+    for (const Position &position: blocks_destroyed) {
+        blocks.erase(position);
+    }
+    for (types::player_id_t id: robots_destroyed) {
+        scores[id]++;
+    }
+}
+
+namespace {
+    /**
+     * @brief Creates the turns which bring a client from board `from` to board `to`, reached by
+     * the game turns_count turns later. The last of them is numbered last_turn. The boards hold
+     * only the cells, bombs and robots those turns refer to, with the scores gained in them.
+     *
+     * Robots are moved and blocks are placed and destroyed in the turns at once. Robots score
+     * and bombs tick once per turn, so there are as many turns as the largest score gained and the
+     * oldest bomb placed need, or all the turns_count if a bomb the client knows is still ticking.
+     * Such bombs not on the boards are told by other_bombs. Robots score in the explosions of
+     * unknown_bomb, which no client knows.
+     */
+    std::vector<Turn> catch_up_turns(const ClientBoard &from, const ClientBoard &to, size_t turns_count,
+                                     types::turn_t last_turn, bool other_bombs, types::bomb_id_t unknown_bomb) {
+        size_t count = other_bombs ? turns_count : 1;
+        std::vector<types::bomb_id_t> exploded;
+        std::unordered_set<types::bomb_id_t> ticking;
+        for (const auto &[id, bomb]: from.bombs) {
+            auto it = to.bombs.find(id);
+            if (it != to.bombs.end() && it->second.position == bomb.position &&
+                it->second.timer == (types::bomb_timer_t) (bomb.timer + turns_count)) {
+                ticking.insert(id);
+                count = turns_count;
+            } else {
+                exploded.push_back(id);
+            }
+        }
+        for (const auto &[id, bomb]: to.bombs) {
+            if (!ticking.contains(id)) {
+                count = std::max<size_t>(count, bomb.timer + 1u);
+            }
+        }
+        std::map<types::player_id_t, types::score_t> gained;
+        for (const auto &[id, score]: to.scores) {
+            auto it = from.scores.find(id);
+            gained[id] = score - (it == from.scores.end() ? 0 : it->second);
+            count = std::max<size_t>(count, gained[id]);
+        }
+        count = std::min(count, turns_count);
+
+        std::vector<Turn> turns(count);
+        for (size_t i = 0; i < count; i++) {
+            turns[i].turn = (types::turn_t) (last_turn - (count - 1 - i));
+            // Explosions of a bomb the client does not know only carry the destroyed robots and blocks.
+            BombExploded explosion;
+            explosion.id = unknown_bomb;
+            for (const auto &[id, score]: gained) {
+                if (score > i) {
+                    explosion.robots_destroyed.push_back(id);
+                }
+            }
+            if (i == 0) {
+                for (const Position &block: from.blocks) {
+                    if (!to.blocks.contains(block)) {
+                        explosion.blocks_destroyed.push_back(block);
+                    }
+                }
+                for (types::bomb_id_t id: exploded) {
+                    BombExploded bomb_exploded;
+                    bomb_exploded.id = id;
+                    turns[i].events.emplace_back(std::move(bomb_exploded));
+                }
+            }
+            if (!explosion.robots_destroyed.empty() || !explosion.blocks_destroyed.empty()) {
+                turns[i].events.emplace_back(std::move(explosion));
+            }
+        }
+
+        for (const Position &block: to.blocks) {
+            if (!from.blocks.contains(block)) {
+                BlockPlaced block_placed;
+                block_placed.position = block;
+                turns.front().events.emplace_back(block_placed);
+            }
+        }
+        // A bomb is placed in the turn after which it has ticked as many times as in the game.
+        for (const auto &[id, bomb]: to.bombs) {
+            if (!ticking.contains(id)) {
+                size_t ticks = std::min<size_t>(bomb.timer, count - 1);
+                BombPlaced bomb_placed;
+                bomb_placed.id = id;
+                bomb_placed.position = bomb.position;
+                turns[count - 1 - ticks].events.emplace_back(bomb_placed);
+            }
+        }
+        for (const auto &[id, position]: to.positions) {
+            auto it = from.positions.find(id);
+            if (it == from.positions.end() || !(it->second == position)) {
+                PlayerMoved player_moved;
+                player_moved.id = id;
+                player_moved.position = position;
+                turns.back().events.emplace_back(player_moved);
+            }
+        }
+        return turns;
+    }
+
+    Turn decode_turn(const MessageEncoder::message_t &message) {
+        MessageDecoder decoder(*message);
+        decoder.read_element<types::message_id_t>();
+        return Turn(decoder);
+    }
+}
+
+void TurnContainer::push_turn(MessageEncoder::message_t message, Turn turn) {
+    // The last turn is sent as it is in snapshots, so the board is one turn behind.
+    if (!turns.empty()) {
+        board.apply(last_turn, &prior_states.emplace_back());
+    }
+    for (const Event &event: turn.events) {
+        if (auto *bomb_placed = std::get_if<BombPlaced>(&event)) {
+            unused_bomb_id = std::max(unused_bomb_id, (types::bomb_id_t) (bomb_placed->id + 1));
+        } else if (auto *bomb_exploded = std::get_if<BombExploded>(&event)) {
+            unused_bomb_id = std::max(unused_bomb_id, (types::bomb_id_t) (bomb_exploded->id + 1));
+        }
+    }
+    last_turn = std::move(turn);
+
+    turn_ends.push_back((turn_ends.empty() ? 0 : turn_ends.back()) + message->size());
+    turns.push_back(std::move(message));
+}
+
 void TurnContainer::append_new_turn(const Turn &turn) {
+    // Encode the turn before taking the lock.
+    MessageEncoder::message_t message = encode_client_message(turn);
+
     std::unique_lock<std::mutex> lock_guard(mutex);
 
-    turns.push_back(turn);
+    push_turn(std::move(message), turn);
 
     // Notify waiting threads about the new turn.
     condition_variable.notify_all();
 }
 
-Turn TurnContainer::get_turn(types::turn_t turn_id) {
+void TurnContainer::append_encoded_turn(MessageEncoder::message_t message) {
+    Turn turn = decode_turn(message);
+
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    push_turn(std::move(message), std::move(turn));
+
+    // Notify waiting threads about the new turn.
+    condition_variable.notify_all();
+}
+
+std::vector<MessageEncoder::message_t> TurnContainer::get_turns() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    return turns;
+}
+
+MessageEncoder::message_t TurnContainer::get_turn(types::turn_t turn_id) {
     std::unique_lock<std::mutex> lock_guard(mutex);
 
     // Wait until the turn is available.
@@ -19,21 +219,117 @@ Turn TurnContainer::get_turn(types::turn_t turn_id) {
     return turns.at(turn_id);
 }
 
-Game::score_map_t TurnContainer::return_when_game_finished() {
+MessageEncoder::message_t TurnContainer::return_when_game_finished() {
     std::unique_lock<std::mutex> lock_guard(mutex);
 
     // Wait until the game is finished.
     condition_variable.wait(lock_guard, [&] { return finished; });
 
-    return score_map;
+    return game_ended;
 }
 
-void TurnContainer::mark_the_game_as_finished(const Game::score_map_t &score_map_) {
+MessageEncoder::message_t TurnContainer::try_get_turn(size_t turn_id) {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    if (turns.size() <= turn_id) {
+        return nullptr;
+    }
+    return turns.at(turn_id);
+}
+
+MessageEncoder::message_t TurnContainer::try_get_game_ended() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    return game_ended;
+}
+
+size_t TurnContainer::get_turns_count() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    return turns.size();
+}
+
+size_t TurnContainer::get_bytes_since(size_t turn_id) {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+
+    if (turns.size() <= turn_id) {
+        return 0;
+    }
+    return turn_ends.back() - (turn_id == 0 ? 0 : turn_ends[turn_id - 1]);
+}
+
+std::pair<MessageEncoder::message_t, size_t> TurnContainer::encode_snapshot(size_t turn_id) {
+    std::vector<MessageEncoder::message_t> missed_turns;
+    std::vector<ClientBoard::PriorState> missed_prior_states;
+    MessageEncoder::message_t last;
+    size_t known_bombs;
+    types::bomb_id_t unknown_bomb;
+    {
+        std::unique_lock<std::mutex> lock_guard(mutex);
+        if (turns.size() <= turn_id) {
+            return {nullptr, 0};
+        }
+        last = turns.back();
+        if (turns.size() - turn_id == 1) {
+            return {last, 1};
+        }
+        missed_turns.assign(turns.begin() + (ptrdiff_t) turn_id, turns.end() - 1);
+        missed_prior_states.assign(prior_states.begin() + (ptrdiff_t) turn_id, prior_states.end());
+        known_bombs = prior_states[turn_id].bombs_count;
+        unknown_bomb = unused_bomb_id;
+    }
+    size_t replaced = missed_turns.size() + 1;
+
+    // Restore what the missed turns refer to as the client has it, from the first turn referring
+    // to it. Bombs have ticked in the turns before that one.
+    ClientBoard received;
+    std::unordered_set<Position, Position::HashFunction> restored_blocks;
+    std::unordered_set<types::bomb_id_t> restored_bombs;
+    for (size_t i = 0; i < missed_prior_states.size(); i++) {
+        for (const auto &[position, present]: missed_prior_states[i].blocks) {
+            if (restored_blocks.insert(position).second && present) {
+                received.blocks.insert(position);
+            }
+        }
+        for (const auto &[id, bomb]: missed_prior_states[i].bombs) {
+            if (restored_bombs.insert(id).second && bomb) {
+                received.bombs.insert({id, Bomb{bomb->position, (types::bomb_timer_t) (bomb->timer - i)}});
+            }
+        }
+    }
+
+    // Replay the missed turns without holding the lock, up to the one before the last.
+    ClientBoard board_before_last = received;
+    for (const MessageEncoder::message_t &turn: missed_turns) {
+        board_before_last.apply(decode_turn(turn));
+    }
+
+    // The explosions of the last turn are shown by the client, so it is sent as it is.
+    MessageDecoder decoder(*last);
+    decoder.read_element<types::message_id_t>();
+    auto last_turn_id = decoder.read_element<types::turn_t>();
+
+    std::vector<uint8_t> snapshot;
+    for (const Turn &turn: catch_up_turns(received, board_before_last, missed_turns.size(),
+                                          (types::turn_t) (last_turn_id - 1), known_bombs > received.bombs.size(),
+                                          unknown_bomb)) {
+        MessageEncoder::message_t encoded = encode_client_message(turn);
+        snapshot.insert(snapshot.end(), encoded->begin(), encoded->end());
+    }
+    snapshot.insert(snapshot.end(), last->begin(), last->end());
+    return {std::make_shared<const std::vector<uint8_t>>(std::move(snapshot)), replaced};
+}
+
+void TurnContainer::mark_the_game_as_finished(const Game::score_map_t &score_map) {
+    GameEnded message;
+    message.scores = score_map;
+    MessageEncoder::message_t encoded_message = encode_client_message(message);
+
     std::unique_lock<std::mutex> lock_guard(mutex);
 
     finished = true;
-    score_map = score_map_;
+    game_ended = std::move(encoded_message);
 
     // Notify waiting threads about the end of the game.
     condition_variable.notify_all();
-}
\ No newline at end of file
+}
@@ -9,12 +9,41 @@
 #define TURN_CONTAINER_H
 
 #include <vector>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <condition_variable>
 #include <mutex>
 #include "../config/config.h"
 #include "../network/messages.h"
 #include "../game_logic/game.h"
 
+/**
+ * @brief Board as seen by a client, which applies the events of the turns as GameClient::apply_turn.
+ * Bombs hold the number of turns since they were placed instead of their timers.
+ */
+struct ClientBoard {
+    /* State of the cells and bombs a turn refers to, as it was before the turn. */
+    struct PriorState {
+        std::vector<std::pair<Position, bool>> blocks;
+        std::vector<std::pair<types::bomb_id_t, std::optional<Bomb>>> bombs;
+        size_t bombs_count = 0;
+    };
+
+    std::map<types::player_id_t, Position> positions;
+    std::unordered_set<Position, Position::HashFunction> blocks;
+    std::unordered_map<types::bomb_id_t, Bomb> bombs;
+    std::map<types::player_id_t, types::score_t> scores;
+
+    /**
+     * @brief Applies the events of the turn.
+     *
+     * @param prior_state If not nullptr, receives the state before the turn of what it refers to.
+     */
+    void apply(const Turn &, PriorState *prior_state = nullptr);
+};
+
 class TurnContainer {
 public:
     using ptr = std::shared_ptr<TurnContainer>;
@@ -22,26 +51,79 @@ public:
     TurnContainer() = default;
 
     /**
-     * @brief Appends a new turn to the container.
+     * @brief Encodes a new turn and appends it to the container. The turn is encoded only once,
+     * no matter how many clients it is sent to.
      * 
      */
     void append_new_turn(const Turn &);
 
+    /**
+     * @brief Appends a turn encoded by encode_client_message, e.g. by the previous server.
+     *
+     */
+    void append_encoded_turn(MessageEncoder::message_t);
+
+    /**
+     * @brief Returns all the turns of the game appended so far.
+     *
+     * @return std::vector<MessageEncoder::message_t> - Encoded Turn messages.
+     */
+    std::vector<MessageEncoder::message_t> get_turns();
+
     /**
      * @brief Returns the turn under specified index as soon as it is ready.
      * 
-     * @return Turn - Message containing all players' moves.
+     * @return MessageEncoder::message_t - Encoded message containing all players' moves.
      */
-    Turn get_turn(types::turn_t);
+    MessageEncoder::message_t get_turn(types::turn_t);
 
     /**
      * @brief Returns as soon as the current game is over.
      * 
-     * @return Game::score_map_t - Map with players' scores.
+     * @return MessageEncoder::message_t - Encoded message with players' scores.
+     */
+    MessageEncoder::message_t return_when_game_finished();
+
+    /* Below there are non-blocking getters used by event loops. They return nullptr if the
+     * message is not available yet. */
+
+    /**
+     * @brief Returns the turn under specified index if it is ready.
+     * 
+     * @return MessageEncoder::message_t - Encoded Turn message or nullptr.
+     */
+    MessageEncoder::message_t try_get_turn(size_t);
+
+    /**
+     * @brief Returns the message about the end of the game if the game is over.
+     * 
+     * @return MessageEncoder::message_t - Encoded GameEnded message or nullptr.
+     */
+    MessageEncoder::message_t try_get_game_ended();
+
+    /**
+     * @return size_t Number of turns appended so far.
+     */
+    size_t get_turns_count();
+
+    /**
+     * @return size_t Total size of the encoded turns from the one under specified index to the
+     * last one appended, i.e. what a client which is sent that turn next is behind by.
      */
-    Game::score_map_t return_when_game_finished();
+    size_t get_bytes_since(size_t);
 
-    /* */
+    /**
+     * @brief Encodes a snapshot of the board which brings a client that was sent the turns before
+     * the one under specified index up to date at once. Catch-up turns leave the client with the
+     * positions, blocks, bombs with their timers and scores it would have before the last turn
+     * appended, which follows unchanged (see Turn for the events they are made of). Only the cells
+     * and bombs the missed turns refer to are restored and replayed, so the snapshot costs time
+     * proportional to the turns it replaces rather than to the length of the game.
+     *
+     * @return std::pair<MessageEncoder::message_t, size_t> - Encoded Turn messages, or nullptr if
+     * there are no such turns, and the number of turns they replace.
+     */
+    std::pair<MessageEncoder::message_t, size_t> encode_snapshot(size_t);
 
     /**
      * @brief Marks the game as finished. Lets the other threads know that the game is finished 
@@ -57,8 +139,19 @@ public:
 private:
     std::mutex mutex;
     std::condition_variable condition_variable;
-    std::vector<Turn> turns;
-    Game::score_map_t score_map;
+    std::vector<MessageEncoder::message_t> turns;
+    // Total size of the turns up to and including the one under the same index.
+    std::vector<size_t> turn_ends;
+    MessageEncoder::message_t game_ended;
+    // Board after all the turns but the last one, which is applied when the next one is appended.
+    ClientBoard board;
+    // State of what each turn applied to the board refers to before it.
+    std::vector<ClientBoard::PriorState> prior_states;
+    Turn last_turn;
+    // Larger than the ids of all the bombs in the turns so far, so that no client knows a bomb with it.
+    types::bomb_id_t unused_bomb_id = 0;
+
+    void push_turn(MessageEncoder::message_t, Turn);
 
     bool finished = false;
 };
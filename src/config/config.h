@@ -12,15 +12,95 @@
 #include <inttypes.h>
 #include <string>
 #include <vector>
+#include <utility>
 
 const int TCP_BUFF_SIZE = 65536;
+// TCP buffers start small and grow up to TCP_BUFF_SIZE when needed.
+const int TCP_INITIAL_BUFF_SIZE = 1024;
 const int UDP_BUFF_SIZE = 65536;
 const int TCP_BACKLOG_SIZE = 32;
+// Maximum number of UDP packets received or sent with a single syscall.
+const int UDP_BATCH_SIZE = 16;
+// Maximum number of queued messages sent with a single syscall.
+const int SEND_QUEUE_IOV_COUNT = 64;
+// Messages for a client are produced as long as fewer bytes are waiting to be sent to it.
+const int SEND_QUEUE_LOW_WATERMARK = 65536;
+// Maximum number of events returned by a single epoll_wait call.
+const int EPOLL_MAX_EVENTS = 256;
+// Sizes of the buffers kept by the buffer pool, powers of two.
+const int BUFFER_POOL_MIN_SIZE = 1024;
+const int BUFFER_POOL_MAX_SIZE = 65536;
+// Maximum number of bytes of released buffers of one size kept by the pool.
+const int BUFFER_POOL_CLASS_CAPACITY = 1 << 20;
+// Maximum size of a frame of the shared memory gui channel.
+const int SHM_FRAME_SIZE = 1 << 20;
+// Number of inputs of the gui the shared memory channel can hold, a power of two.
+const int SHM_INPUT_RING_SIZE = 256;
+// Maximum size of an input of the gui passed through the shared memory channel.
+const int SHM_INPUT_SIZE = 7;
+// Set in the index of the middle frame of the shared memory channel if it has not been taken yet.
+const uint32_t SHM_FRAME_FRESH = 4;
+// Written to the shared memory channel once it is initialized.
+const uint32_t SHM_CHANNEL_MAGIC = 0x524f424f;
+// Number of bytes an in-process memory pipe holds before writers wait.
+const int MEMORY_PIPE_SIZE = 65536;
+// Maximum size of a datagram of the UDP turn channel, turns which do not fit are sent over TCP.
+const int TURN_DATAGRAM_SIZE = 65507;
+// Number of earlier unacknowledged turns sent again together with every new turn over UDP.
+const int TURN_REDUNDANCY = 3;
+// Milliseconds after which unacknowledged turns are sent again if no new turn was sent.
+const int TURN_RESEND_TIMEOUT = 20;
+// Maximum number of file descriptors passed in one message during a handoff (SCM_MAX_FD is 253).
+const int HANDOFF_MAX_FDS = 250;
+// Written at the start of a traffic capture file.
+const uint32_t TRAFFIC_CAPTURE_MAGIC = 0x52425443;
+// Number of bytes of captured messages buffered before they are written to the file.
+const int CAPTURE_BUFFER_SIZE = 65536;
+// Milliseconds after which captured messages are written even if the buffer is not full.
+const int CAPTURE_FLUSH_INTERVAL = 1000;
+// Milliseconds the replay tool keeps receiving after the last message from the server.
+const int REPLAY_DRAIN_TIMEOUT = 2000;
+// Number of connections the load generator waits to be greeted with Hello at a time. Kept below
+// TCP_BACKLOG_SIZE, as connecting blocks for a second when the accept queue of the server overflows.
+const int LOAD_CONNECT_BATCH = 16;
+// Moves a client may send at once above the rate limit, if one is set.
+const int INPUT_BURST = 100;
+// Milliseconds over which the messages dropped from a client are counted against the flood limit.
+const int FLOOD_WINDOW = 1000;
+// Bytes of fixed-width elements of a vector the codec converts on the stack at a time.
+const int CODEC_BATCH_SIZE = 512;
+// Milliseconds between the reads of zero-copy completions of the closed connections.
+const int ZEROCOPY_REAP_INTERVAL = 100;
+// Size of the submission queue of each io_uring instance.
+const int IO_URING_ENTRIES = 8;
+
+/* Implementations of the blocking socket operations performed by the network handlers. */
+enum class IoBackend {
+    Socket, IoUring
+};
+
+/* Sets of socket options applied to every TCP and UDP socket (see SocketTuning). */
+enum class SocketProfile {
+    Default, Latency, Throughput, Dense
+};
+
+/* What happens to a client which falls behind by more than the limits. */
+enum class SlowClientPolicy {
+    Coalesce, Drop, Disconnect
+};
+
+/* Actions sent by the virtual players of the load generator. Mixed assigns the other models to the
+ * players in turn. */
+enum class BehaviorModel {
+    Idle, Walker, Bomber, Builder, Mixed
+};
 
 namespace types {
     const int MAX_TYPE_SIZE = 8;
 
     using port_t = uint16_t;
+    // Host and port.
+    using endpoint_t = std::pair<std::string, port_t>;
 
     using message_id_t = uint8_t;
     using bomb_timer_t = uint16_t;
@@ -41,58 +121,194 @@ namespace types {
     using vec_len_t = uint32_t;
 
     using coord_t = int64_t;
+
+    using threads_count_t = uint16_t;
+    using backlog_size_t = uint16_t;
+    using defer_accept_t = uint16_t;
+    using zerocopy_threshold_t = uint32_t;
+    using connections_count_t = uint32_t;
+    using replay_speed_t = uint16_t;
+    using action_rate_t = uint16_t;
+    using lag_turns_t = uint16_t;
+    using backlog_bytes_t = uint32_t;
+    using load_duration_t = uint16_t;
+    using input_rate_t = uint16_t;
+    using flood_limit_t = uint32_t;
 }
 
 namespace usage {
-    const std::string CLIENT_USAGE = "-d <GUI_ADDRESS> -n <PLAYER_NAME> -p <PORT> -s <SERVER_ADDRESS>\n";
+    const std::string CLIENT_USAGE = std::string("(-d <GUI_ADDRESS>... -p <PORT> | -m <GUI_SHM_NAME>) [-i <IO_BACKEND>] ") +
+                                     "-n <PLAYER_NAME> (-s <SERVER_ADDRESS> | -u <SOCKET_PATH>) [-g <TURN_PORT>] [-t <SOCKET_PROFILE>]\n";
     const std::string CLIENT_HELP = CLIENT_USAGE + "\nOptions:\n" +
                                     "\t-d\tAddress of GUI: <(host name):(port) or (IPv4):(port) or (IPv6):(port)>.\n" +
+                                    "\t\tMay be given many times to send the game state to many GUIs.\n" +
+                                    "\t-g\tPort on which turns are received over UDP from a server started with -g.\n" +
+                                    "\t\tTurns are received over TCP if not given.\n" +
+                                    "\t-i\tImplementation of socket operations: socket (default) or io_uring.\n" +
+                                    "\t-m\tName of a shared memory object (e.g. /robots-gui) through which a GUI\n" +
+                                    "\t\trunning on the same host is communicated with instead of UDP.\n" +
                                     "\t-n\tPlayer's name.\n" +
                                     "\t-p\tPort on which client listens for move instruction packets.\n" +
                                     "\t-d\tAddress of server: <(host name):(port) or (IPv4):(port) or (IPv6):(port)>.\n" +
+                                    "\t-t\tSocket tuning profile: default, latency, throughput or dense.\n" +
+                                    "\t-u\tPath of the Unix domain socket of a server running on the same host,\n" +
+                                    "\t\tused instead of the server address.\n" +
                                     "\t-h\tShows usage information.\n";
 
-    const std::string SERVER_USAGE = std::string("-b <BOMB_TIMER> -c <PLAYERS_COUNT> -d <TURN_DURATION> ") +
-                                     "-e <EXPLOSION_RADIUS> -k <INITIAL_BLOCKS> -l <GAME_LENGTH> -n <SERVER_NAME> " +
-                                     "-p <PORT> [-s <SEED>] -x <SIZE_X> -y <SIZE_Y>\n";
+    const std::string SERVER_USAGE = std::string("[-a <ACCEPTOR_THREADS>] -b <BOMB_TIMER> -c <PLAYERS_COUNT> ") +
+                                     "-d <TURN_DURATION> " +
+                                     "-e <EXPLOSION_RADIUS> [-f <CAPTURE_FILE>] [-g <TURN_PORT>] [-i <IO_BACKEND>] [-j <MAX_LAG_TURNS>] -k <INITIAL_BLOCKS> " +
+                                     "-l <GAME_LENGTH> [-m <MAX_BACKLOG_BYTES>] -n <SERVER_NAME> " +
+                                     "[-o <HANDOFF_PATH>] -p <PORT> [-q <BACKLOG_SIZE>] [-r <REACTOR_THREADS>] [-s <SEED>] " +
+                                     "[-t <SOCKET_PROFILE>] [-u <SOCKET_PATH>] [-v <SLOW_CLIENT_POLICY>] [-w <DEFER_ACCEPT>] -x <SIZE_X> -y <SIZE_Y> [-z <ZEROCOPY_THRESHOLD>] " +
+                                     "[--flood-limit <FLOOD_LIMIT>] [--input-burst <INPUT_BURST>] [--input-rate <INPUT_RATE>]\n";
     const std::string SERVER_HELP = SERVER_USAGE + "\nOptions:\n" +
+                                                   "\t-a\tNumber of threads accepting connections, each with its own listening\n" +
+                                                   "\t\tsocket bound with SO_REUSEPORT (default 1).\n" +
                                                    "\t-b\tBomb timer.\n" +
                                                    "\t-c\tNumber of players required for the game.\n" +
                                                    "\t-d\tNumber of milliseconds per turn.\n" +
                                                    "\t-e\tExplosion radius.\n" +
+                                                   "\t-f\tFile to which the messages received from the clients are written, so that\n" +
+                                                   "\t\trobots-replay can send them again.\n" +
+                                                   "\t-g\tUDP port from which turns are sent to clients which ask for it, so that\n" +
+                                                   "\t\ta lost packet does not hold back the following turns. 0 (default) disables it.\n" +
+                                                   "\t-i\tImplementation of socket operations: socket (default) or io_uring.\n" +
+                                                   "\t-j\tTurns a client may fall behind by before -v applies to it.\n" +
+                                                   "\t\t0 (default) disables the limit.\n" +
                                                    "\t-k\tNumber of initial blocks.\n" +
                                                    "\t-l\tGame length in turns.\n" +
+                                                   "\t-m\tBytes of messages not sent to a client yet, above which -v applies to it.\n" +
+                                                   "\t\t0 (default) disables the limit.\n" +
                                                    "\t-n\tServer name.\n" +
+                                                   "\t-o\tPath of a Unix domain socket on which the server hands its clients and\n" +
+                                                   "\t\tgame over to a server started later with the same options. A server started\n" +
+                                                   "\t\twhen another one listens on the path takes over from it. Requires -r.\n" +
                                                    "\t-p\tPort of the server.\n" +
+                                                   "\t-q\tLength of the queue of pending connections of each listening socket.\n" +
+                                                   "\t-r\tNumber of epoll event loop threads serving the clients. If 0 (default),\n" +
+                                                   "\t\tevery client is served by two dedicated threads.\n" +
                                                    "\t-s\tRandom seed.\n" +
+                                                   "\t-t\tSocket tuning profile: default, latency (TCP_QUICKACK, SO_BUSY_POLL,\n" +
+                                                   "\t\tTCP_NOTSENT_LOWAT, DSCP EF, SO_PRIORITY), throughput (large buffers)\n" +
+                                                   "\t\tor dense (small buffers for many connections).\n" +
+                                                   "\t-u\tPath of a Unix domain socket on which clients running on the same host\n" +
+                                                   "\t\tare accepted too.\n" +
+                                                   "\t-v\tWhat happens to a client exceeding -j or -m: coalesce (default) replaces the\n" +
+                                                   "\t\tturns it missed with a snapshot of the board, drop skips spectators to the\n" +
+                                                   "\t\tlatest turn without the ones they missed and sends players the snapshot,\n" +
+                                                   "\t\tdisconnect closes the connection.\n" +
+                                                   "\t\tA client whose messages queued by the server alone exceed -m is disconnected.\n" +
+                                                   "\t-w\tSeconds for which a connection is not accepted until the client sends\n" +
+                                                   "\t\tdata (TCP_DEFER_ACCEPT). 0 (default) disables it.\n" +
                                                    "\t-x\tSize x in number of blocks.\n" +
-                                                   "\t-y\tSize y in number of blocks.\n";
+                                                   "\t-y\tSize y in number of blocks.\n" +
+                                                   "\t-z\tMessages of at least this many bytes are sent with MSG_ZEROCOPY.\n" +
+                                                   "\t\t0 (default) disables zero-copy sending.\n" +
+                                                   "\t--flood-limit\tMoves dropped from a client within a second, above which it\n" +
+                                                   "\t\tis disconnected. 0 (default) never disconnects flooding clients.\n" +
+                                                   "\t--input-burst\tMoves a client may send at once above --input-rate\n" +
+                                                   "\t\t(default 100).\n" +
+                                                   "\t--input-rate\tMoves (Move, PlaceBomb and PlaceBlock) per second accepted\n" +
+                                                   "\t\tfrom a client, the rest are dropped. 0 (default) disables the limit.\n" +
+                                                   "\t\tMoves repeating the last one of the turn are dropped regardless.\n";
+
+    const std::string REPLAY_USAGE = std::string("-f <CAPTURE_FILE> [-m <SERVER_PID>] [-n <CONNECTIONS>] ") +
+                                     "-s <SERVER_ADDRESS> [-x <SPEED>]\n";
+    const std::string REPLAY_HELP = REPLAY_USAGE + "\nOptions:\n" +
+                                    "\t-f\tFile written by a server started with -f.\n" +
+                                    "\t-m\tPID of the server, whose CPU time is reported.\n" +
+                                    "\t-n\tNumber of connections, each sending the messages of a captured one in\n" +
+                                    "\t\tturn. By default every captured connection is replayed once.\n" +
+                                    "\t-s\tAddress of server: <(host name):(port) or (IPv4):(port) or (IPv6):(port)>.\n" +
+                                    "\t-x\tHow many times faster than captured the messages are sent (default 1).\n" +
+                                    "\t\t0 sends them as fast as possible.\n" +
+                                    "\t-h\tShows usage information.\n";
+
+    const std::string LOAD_USAGE = std::string("[-b <BEHAVIOR>] [-l <DURATION>] -n <PLAYERS> [-r <ACTION_RATE>] ") +
+                                   "-s <SERVER_ADDRESS> [-t <SOCKET_PROFILE>]\n";
+    const std::string LOAD_HELP = LOAD_USAGE + "\nOptions:\n" +
+                                  "\t-b\tActions sent by the players: idle (Join only), walker (Move), bomber\n" +
+                                  "\t\t(Move and PlaceBomb), builder (Move and PlaceBlock) or mixed (default),\n" +
+                                  "\t\twhich assigns the other models to the players in turn.\n" +
+                                  "\t-l\tSeconds for which the load is generated (default 10).\n" +
+                                  "\t-n\tNumber of virtual players, each with its own connection.\n" +
+                                  "\t-r\tActions sent by every player per second during a game (default 10).\n" +
+                                  "\t-s\tAddress of server: <(host name):(port) or (IPv4):(port) or (IPv6):(port)>.\n" +
+                                  "\t-t\tSocket tuning profile: default, latency, throughput or dense.\n" +
+                                  "\t-h\tShows usage information.\n";
 }
 
 namespace options {
     // Common.
     const char HELP = 'h';
     const char PORT = 'p';
+    const char IO_BACKEND = 'i';
     const char ADDRESS_DELIMITER = ':';
+    const std::string IO_BACKEND_SOCKET = "socket";
+    const std::string IO_BACKEND_IO_URING = "io_uring";
+    const char SOCKET_PROFILE = 't';
+    const std::string SOCKET_PROFILE_DEFAULT = "default";
+    const std::string SOCKET_PROFILE_LATENCY = "latency";
+    const std::string SOCKET_PROFILE_THROUGHPUT = "throughput";
+    const std::string SOCKET_PROFILE_DENSE = "dense";
+    const char SOCKET_PATH = 'u';
+    const char TURN_PORT = 'g';
 
     // Client-specific.
-    const char CLIENT_OPTSTRING[] = "d:hn:p:s:";
+    const char CLIENT_OPTSTRING[] = "d:g:hi:m:n:p:s:t:u:";
     const char GUI_ADDRESS = 'd';
+    const char GUI_SHM_NAME = 'm';
     const char PLAYER_NAME = 'n';
     const char SERVER_ADDRESS = 's';
 
     // Server-specific.
-    const char SERVER_OPTSTRING[] = "b:c:d:e:hk:l:n:p:s:x:y:";
+    const char SERVER_OPTSTRING[] = "a:b:c:d:e:f:g:hi:j:k:l:m:n:o:p:q:r:s:t:u:v:w:x:y:z:";
+    const char ACCEPTOR_THREADS = 'a';
     const char BOMB_TIMER = 'b';
     const char PLAYER_COUNT = 'c';
     const char TURN_DURATION = 'd';
     const char EXPLOSION_RADIUS = 'e';
+    const char CAPTURE_FILE = 'f';
+    const char MAX_LAG_TURNS = 'j';
     const char INITIAL_BLOCKS = 'k';
     const char GAME_LENGTH = 'l';
+    const char MAX_BACKLOG_BYTES = 'm';
     const char SERVER_NAME = 'n';
+    const char HANDOFF_PATH = 'o';
+    const char BACKLOG_SIZE = 'q';
+    const char REACTOR_THREADS = 'r';
     const char SEED = 's';
+    const char SLOW_CLIENT_POLICY = 'v';
+    const std::string POLICY_COALESCE = "coalesce";
+    const std::string POLICY_DROP = "drop";
+    const std::string POLICY_DISCONNECT = "disconnect";
+    const char DEFER_ACCEPT = 'w';
     const char SIZE_X = 'x';
     const char SIZE_Y = 'y';
+    const char ZEROCOPY_THRESHOLD = 'z';
+    // Long options, as every lowercase letter is taken. Their codes are above those of the letters.
+    const int FLOOD_LIMIT = 256;
+    const int INPUT_BURST = 257;
+    const int INPUT_RATE = 258;
+
+    // Replay-specific.
+    const char REPLAY_OPTSTRING[] = "f:hm:n:s:x:";
+    const char SERVER_PID = 'm';
+    const char CONNECTIONS = 'n';
+    const char REPLAY_SPEED = 'x';
+
+    // Load generator-specific.
+    const char LOAD_OPTSTRING[] = "b:hl:n:r:s:t:";
+    const char BEHAVIOR = 'b';
+    const char LOAD_DURATION = 'l';
+    const char PLAYERS = 'n';
+    const char ACTION_RATE = 'r';
+    const std::string BEHAVIOR_IDLE = "idle";
+    const std::string BEHAVIOR_WALKER = "walker";
+    const std::string BEHAVIOR_BOMBER = "bomber";
+    const std::string BEHAVIOR_BUILDER = "builder";
+    const std::string BEHAVIOR_MIXED = "mixed";
 }
 
 #endif // CONFIG_H
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <string>
 #include <limits>
 #include <chrono>
+#include <getopt.h>
 #include "parser.h"
 #include "config.h"
 
@@ -12,20 +13,59 @@ struct required_client {
     bool port = true;
     bool server_address = true;
     bool server_port = true;
+    bool io_backend = false;
+    bool socket_profile = false;
+    bool socket_path = false;
+    bool gui_shm_name = false;
+    bool turn_port = false;
 };
 
 struct required_server {
+    bool acceptor_threads = false;
     bool bomb_timer = true;
     bool players_count = true;
     bool turn_duration = true;
     bool explosion_radius = true;
+    bool turn_port = false;
     bool initial_blocks = true;
     bool game_length = true;
     bool server_name = true;
     bool port = true;
+    bool backlog_size = false;
+    bool reactor_threads = false;
+    bool io_backend = false;
     bool seed = false;
+    bool socket_profile = false;
+    bool socket_path = false;
+    bool defer_accept = false;
     bool size_x = true;
     bool size_y = true;
+    bool zerocopy_threshold = false;
+    bool handoff_path = false;
+    bool capture_path = false;
+    bool max_lag_turns = false;
+    bool max_backlog_bytes = false;
+    bool slow_client_policy = false;
+    bool input_rate = false;
+    bool input_burst = false;
+    bool flood_limit = false;
+};
+
+struct required_replay {
+    bool capture_path = true;
+    bool server_pid = false;
+    bool connections = false;
+    bool server_address = true;
+    bool speed = false;
+};
+
+struct required_load {
+    bool behavior = false;
+    bool duration = false;
+    bool players = true;
+    bool action_rate = false;
+    bool server_address = true;
+    bool socket_profile = false;
 };
 
 static bool required_specified_client(const required_client &required) {
@@ -34,23 +74,66 @@ static bool required_specified_client(const required_client &required) {
                   !required.player_name &&
                   !required.port &&
                   !required.server_address &&
-                  !required.server_port;
+                  !required.server_port &&
+                  !required.io_backend &&
+                  !required.socket_profile &&
+                  !required.socket_path &&
+                  !required.gui_shm_name &&
+                  !required.turn_port;
 
     return result;
 }
 
 static bool required_specified_server(const required_server &required) {
-    bool result = !required.bomb_timer &&
+    bool result = !required.acceptor_threads &&
+                  !required.bomb_timer &&
                   !required.players_count &&
                   !required.turn_duration &&
                   !required.explosion_radius &&
+                  !required.turn_port &&
                   !required.initial_blocks &&
                   !required.game_length &&
                   !required.server_name &&
                   !required.port &&
+                  !required.backlog_size &&
+                  !required.reactor_threads &&
+                  !required.io_backend &&
                   !required.seed &&
+                  !required.socket_profile &&
+                  !required.socket_path &&
+                  !required.defer_accept &&
                   !required.size_x &&
-                  !required.size_y;
+                  !required.size_y &&
+                  !required.zerocopy_threshold &&
+                  !required.handoff_path &&
+                  !required.capture_path &&
+                  !required.max_lag_turns &&
+                  !required.max_backlog_bytes &&
+                  !required.slow_client_policy &&
+                  !required.input_rate &&
+                  !required.input_burst &&
+                  !required.flood_limit;
+
+    return result;
+}
+
+static bool required_specified_replay(const required_replay &required) {
+    bool result = !required.capture_path &&
+                  !required.server_pid &&
+                  !required.connections &&
+                  !required.server_address &&
+                  !required.speed;
+
+    return result;
+}
+
+static bool required_specified_load(const required_load &required) {
+    bool result = !required.behavior &&
+                  !required.duration &&
+                  !required.players &&
+                  !required.action_rate &&
+                  !required.server_address &&
+                  !required.socket_profile;
 
     return result;
 }
@@ -107,10 +190,75 @@ static void parse_address(std::string &addr, types::port_t &port, std::string s,
     port = parse_numerical<types::port_t>(s.substr(pos + 1).c_str(), message + " port");
 }
 
+static IoBackend parse_io_backend(const std::string &s) {
+    if (s == options::IO_BACKEND_SOCKET) {
+        return IoBackend::Socket;
+    } else if (s == options::IO_BACKEND_IO_URING) {
+        return IoBackend::IoUring;
+    }
+    std::cerr << "I/O backend should be either " << options::IO_BACKEND_SOCKET << " or "
+              << options::IO_BACKEND_IO_URING << "!\n";
+    exit(EXIT_FAILURE);
+}
+
+static SocketProfile parse_socket_profile(const std::string &s) {
+    if (s == options::SOCKET_PROFILE_DEFAULT) {
+        return SocketProfile::Default;
+    } else if (s == options::SOCKET_PROFILE_LATENCY) {
+        return SocketProfile::Latency;
+    } else if (s == options::SOCKET_PROFILE_THROUGHPUT) {
+        return SocketProfile::Throughput;
+    } else if (s == options::SOCKET_PROFILE_DENSE) {
+        return SocketProfile::Dense;
+    }
+    std::cerr << "Socket profile should be one of " << options::SOCKET_PROFILE_DEFAULT << ", "
+              << options::SOCKET_PROFILE_LATENCY << ", " << options::SOCKET_PROFILE_THROUGHPUT << " or "
+              << options::SOCKET_PROFILE_DENSE << "!\n";
+    exit(EXIT_FAILURE);
+}
+
+static SlowClientPolicy parse_slow_client_policy(const std::string &s) {
+    if (s == options::POLICY_COALESCE) {
+        return SlowClientPolicy::Coalesce;
+    } else if (s == options::POLICY_DROP) {
+        return SlowClientPolicy::Drop;
+    } else if (s == options::POLICY_DISCONNECT) {
+        return SlowClientPolicy::Disconnect;
+    }
+    std::cerr << "Slow client policy should be one of " << options::POLICY_COALESCE << ", "
+              << options::POLICY_DROP << " or " << options::POLICY_DISCONNECT << "!\n";
+    exit(EXIT_FAILURE);
+}
+
+static BehaviorModel parse_behavior(const std::string &s) {
+    if (s == options::BEHAVIOR_IDLE) {
+        return BehaviorModel::Idle;
+    } else if (s == options::BEHAVIOR_WALKER) {
+        return BehaviorModel::Walker;
+    } else if (s == options::BEHAVIOR_BOMBER) {
+        return BehaviorModel::Bomber;
+    } else if (s == options::BEHAVIOR_BUILDER) {
+        return BehaviorModel::Builder;
+    } else if (s == options::BEHAVIOR_MIXED) {
+        return BehaviorModel::Mixed;
+    }
+    std::cerr << "Behavior should be one of " << options::BEHAVIOR_IDLE << ", " << options::BEHAVIOR_WALKER << ", "
+              << options::BEHAVIOR_BOMBER << ", " << options::BEHAVIOR_BUILDER << " or "
+              << options::BEHAVIOR_MIXED << "!\n";
+    exit(EXIT_FAILURE);
+}
+
 options_client parse_client(int argc, char *argv[]) {
     options_client options;
     required_client required;
 
+    // Use socket system calls by default.
+    options.io_backend = IoBackend::Socket;
+    options.socket_profile = SocketProfile::Default;
+
+    // Receive turns over TCP by default.
+    options.turn_port = 0;
+
     // Validates if any unknown parameter was specified.
     int counter = 1;
 
@@ -119,10 +267,15 @@ options_client parse_client(int argc, char *argv[]) {
         counter += 2;
         switch (opt) {
             case options::GUI_ADDRESS:
-                parse_address(options.gui_address, options.gui_port, optarg, "GUI");
+                options.gui_endpoints.emplace_back();
+                parse_address(options.gui_endpoints.back().first, options.gui_endpoints.back().second, optarg, "GUI");
                 required.gui_address = false;
                 required.gui_port = false;
                 break;
+            case options::IO_BACKEND:
+                options.io_backend = parse_io_backend(optarg);
+                required.io_backend = false;
+                break;
             case options::PLAYER_NAME:
                 options.player_name = optarg;
                 required.player_name = false;
@@ -136,6 +289,27 @@ options_client parse_client(int argc, char *argv[]) {
                 required.server_address = false;
                 required.server_port = false;
                 break;
+            case options::SOCKET_PROFILE:
+                options.socket_profile = parse_socket_profile(optarg);
+                required.socket_profile = false;
+                break;
+            case options::SOCKET_PATH:
+                // The server is connected to through the socket instead of its address.
+                options.socket_path = optarg;
+                required.server_address = false;
+                required.server_port = false;
+                break;
+            case options::GUI_SHM_NAME:
+                // The gui is communicated with through shared memory instead of UDP.
+                options.gui_shm_name = optarg;
+                required.gui_address = false;
+                required.gui_port = false;
+                required.port = false;
+                break;
+            case options::TURN_PORT:
+                options.turn_port = parse_numerical<types::port_t>(optarg, "Turn port");
+                required.turn_port = false;
+                break;
             case options::HELP:
                 exit_help(argv[0], usage::CLIENT_HELP);
                 break;
@@ -152,10 +326,46 @@ options_client parse_client(int argc, char *argv[]) {
     return options;
 }
 
+// Options of the server without a letter, each taking an argument.
+static const struct option server_long_options[] = {
+    {"flood-limit", required_argument, nullptr, options::FLOOD_LIMIT},
+    {"input-burst", required_argument, nullptr, options::INPUT_BURST},
+    {"input-rate", required_argument, nullptr, options::INPUT_RATE},
+    {nullptr, 0, nullptr, 0}
+};
+
 options_server parse_server(int argc, char *argv[]) {
     options_server options;
     required_server required;
 
+    // Accept connections with a single thread by default.
+    options.acceptor_threads = 1;
+    options.backlog_size = TCP_BACKLOG_SIZE;
+    options.defer_accept = 0;
+
+    // Copy sent bytes by default.
+    options.zerocopy_threshold = 0;
+
+    // Serve each client with dedicated threads by default.
+    options.reactor_threads = 0;
+
+    // Send turns only over TCP by default.
+    options.turn_port = 0;
+
+    // Send all the turns to slow clients by default, the policy applies only with -j or -m.
+    options.max_lag_turns = 0;
+    options.max_backlog_bytes = 0;
+    options.slow_client_policy = SlowClientPolicy::Coalesce;
+
+    // Accept all the moves of the clients by default.
+    options.input_rate = 0;
+    options.input_burst = INPUT_BURST;
+    options.flood_limit = 0;
+
+    // Use socket system calls by default.
+    options.io_backend = IoBackend::Socket;
+    options.socket_profile = SocketProfile::Default;
+
     // Get default seed value.
     options.seed = (types::seed_t) std::chrono::system_clock::now().time_since_epoch().count();
 
@@ -163,9 +373,13 @@ options_server parse_server(int argc, char *argv[]) {
     int counter = 1;
 
     int opt;
-    while ((opt = getopt(argc, argv, options::SERVER_OPTSTRING)) != -1) {
+    while ((opt = getopt_long(argc, argv, options::SERVER_OPTSTRING, server_long_options, nullptr)) != -1) {
         counter += 2;
         switch (opt) {
+            case options::ACCEPTOR_THREADS:
+                options.acceptor_threads = parse_numerical<types::threads_count_t>(optarg, "Acceptor threads");
+                required.acceptor_threads = false;
+                break;
             case options::BOMB_TIMER:
                 options.bomb_timer = parse_numerical<types::bomb_timer_t>(optarg, "Bomb timer");
                 required.bomb_timer = false;
@@ -182,6 +396,14 @@ options_server parse_server(int argc, char *argv[]) {
                 options.explosion_radius = parse_numerical<types::explosion_radius_t>(optarg, "Explosion radius");
                 required.explosion_radius = false;
                 break;
+            case options::TURN_PORT:
+                options.turn_port = parse_numerical<types::port_t>(optarg, "Turn port");
+                required.turn_port = false;
+                break;
+            case options::IO_BACKEND:
+                options.io_backend = parse_io_backend(optarg);
+                required.io_backend = false;
+                break;
             case options::INITIAL_BLOCKS:
                 options.initial_blocks = parse_numerical<types::initial_blocks_t>(optarg, "Initial blocks");
                 required.initial_blocks = false;
@@ -198,10 +420,30 @@ options_server parse_server(int argc, char *argv[]) {
                 options.port = parse_numerical<types::port_t>(optarg, "Port");
                 required.port = false;
                 break;
+            case options::BACKLOG_SIZE:
+                options.backlog_size = parse_numerical<types::backlog_size_t>(optarg, "Backlog size");
+                required.backlog_size = false;
+                break;
+            case options::REACTOR_THREADS:
+                options.reactor_threads = parse_numerical<types::threads_count_t>(optarg, "Reactor threads");
+                required.reactor_threads = false;
+                break;
             case options::SEED:
                 options.seed = parse_numerical<types::seed_t>(optarg, "Seed");
                 required.seed = false;
                 break;
+            case options::SOCKET_PROFILE:
+                options.socket_profile = parse_socket_profile(optarg);
+                required.socket_profile = false;
+                break;
+            case options::SOCKET_PATH:
+                options.socket_path = optarg;
+                required.socket_path = false;
+                break;
+            case options::DEFER_ACCEPT:
+                options.defer_accept = parse_numerical<types::defer_accept_t>(optarg, "Defer accept");
+                required.defer_accept = false;
+                break;
             case options::SIZE_X:
                 options.size_x = parse_numerical<types::size_xy_t>(optarg, "Size x");
                 required.size_x = false;
@@ -210,6 +452,43 @@ options_server parse_server(int argc, char *argv[]) {
                 options.size_y = parse_numerical<types::size_xy_t>(optarg, "Size y");
                 required.size_y = false;
                 break;
+            case options::ZEROCOPY_THRESHOLD:
+                options.zerocopy_threshold = parse_numerical<types::zerocopy_threshold_t>(optarg,
+                                                                                          "Zero-copy threshold");
+                required.zerocopy_threshold = false;
+                break;
+            case options::MAX_LAG_TURNS:
+                options.max_lag_turns = parse_numerical<types::lag_turns_t>(optarg, "Maximum lag");
+                required.max_lag_turns = false;
+                break;
+            case options::MAX_BACKLOG_BYTES:
+                options.max_backlog_bytes = parse_numerical<types::backlog_bytes_t>(optarg, "Maximum backlog");
+                required.max_backlog_bytes = false;
+                break;
+            case options::SLOW_CLIENT_POLICY:
+                options.slow_client_policy = parse_slow_client_policy(optarg);
+                required.slow_client_policy = false;
+                break;
+            case options::INPUT_RATE:
+                options.input_rate = parse_numerical<types::input_rate_t>(optarg, "Input rate");
+                required.input_rate = false;
+                break;
+            case options::INPUT_BURST:
+                options.input_burst = parse_numerical<types::input_rate_t>(optarg, "Input burst");
+                required.input_burst = false;
+                break;
+            case options::FLOOD_LIMIT:
+                options.flood_limit = parse_numerical<types::flood_limit_t>(optarg, "Flood limit");
+                required.flood_limit = false;
+                break;
+            case options::HANDOFF_PATH:
+                options.handoff_path = optarg;
+                required.handoff_path = false;
+                break;
+            case options::CAPTURE_FILE:
+                options.capture_path = optarg;
+                required.capture_path = false;
+                break;
             case options::HELP:
                 exit_help(argv[0], usage::SERVER_HELP);
                 break;
@@ -223,5 +502,125 @@ options_server parse_server(int argc, char *argv[]) {
         exit_wrong_param(argv[0], usage::SERVER_USAGE);
     }
 
+    if (options.acceptor_threads == 0) {
+        std::cerr << "Acceptor threads should be positive!\n";
+        exit(EXIT_FAILURE);
+    }
+
+    // Only connections served by event loops can be taken out of them and handed over.
+    if (!options.handoff_path.empty() && options.reactor_threads == 0) {
+        std::cerr << "Handoff requires reactor threads!\n";
+        exit(EXIT_FAILURE);
+    }
+
+    return options;
+}
+
+options_replay parse_replay(int argc, char *argv[]) {
+    options_replay options;
+    required_replay required;
+
+    // Replay every captured connection once, as fast as it was captured.
+    options.connections = 0;
+    options.speed = 1;
+    options.server_pid = 0;
+
+    // Validates if any unknown parameter was specified.
+    int counter = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, options::REPLAY_OPTSTRING)) != -1) {
+        counter += 2;
+        switch (opt) {
+            case options::CAPTURE_FILE:
+                options.capture_path = optarg;
+                required.capture_path = false;
+                break;
+            case options::SERVER_PID:
+                options.server_pid = parse_numerical<pid_t>(optarg, "Server PID");
+                required.server_pid = false;
+                break;
+            case options::CONNECTIONS:
+                options.connections = parse_numerical<types::connections_count_t>(optarg, "Connections");
+                required.connections = false;
+                break;
+            case options::SERVER_ADDRESS:
+                parse_address(options.server_address, options.server_port, optarg, "Server");
+                required.server_address = false;
+                break;
+            case options::REPLAY_SPEED:
+                options.speed = parse_numerical<types::replay_speed_t>(optarg, "Speed");
+                required.speed = false;
+                break;
+            case options::HELP:
+                exit_help(argv[0], usage::REPLAY_HELP);
+                break;
+            default:
+                exit_wrong_param(argv[0], usage::REPLAY_USAGE);
+        }
+    }
+
+    // Check if all required parameters have been specified.
+    if (argc != counter || !required_specified_replay(required)) {
+        exit_wrong_param(argv[0], usage::REPLAY_USAGE);
+    }
+
+    return options;
+}
+
+options_load parse_load(int argc, char *argv[]) {
+    options_load options;
+    required_load required;
+
+    // Mix all the behaviors, with every player acting 10 times a second for 10 seconds.
+    options.behavior = BehaviorModel::Mixed;
+    options.duration = 10;
+    options.action_rate = 10;
+    options.socket_profile = SocketProfile::Default;
+
+    // Validates if any unknown parameter was specified.
+    int counter = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, options::LOAD_OPTSTRING)) != -1) {
+        counter += 2;
+        switch (opt) {
+            case options::BEHAVIOR:
+                options.behavior = parse_behavior(optarg);
+                required.behavior = false;
+                break;
+            case options::LOAD_DURATION:
+                options.duration = parse_numerical<types::load_duration_t>(optarg, "Duration");
+                required.duration = false;
+                break;
+            case options::PLAYERS:
+                options.players = parse_numerical<types::connections_count_t>(optarg, "Players");
+                required.players = false;
+                break;
+            case options::ACTION_RATE:
+                options.action_rate = parse_numerical<types::action_rate_t>(optarg, "Action rate");
+                required.action_rate = false;
+                break;
+            case options::SERVER_ADDRESS:
+                parse_address(options.server_address, options.server_port, optarg, "Server");
+                required.server_address = false;
+                break;
+            case options::SOCKET_PROFILE:
+                options.socket_profile = parse_socket_profile(optarg);
+                required.socket_profile = false;
+                break;
+            case options::HELP:
+                exit_help(argv[0], usage::LOAD_HELP);
+                break;
+            default:
+                exit_wrong_param(argv[0], usage::LOAD_USAGE);
+        }
+    }
+
+    // Check if all required parameters have been specified.
+    if (argc != counter || !required_specified_load(required)) {
+        exit_wrong_param(argv[0], usage::LOAD_USAGE);
+    }
+
     return options;
 }
@@ -13,30 +13,89 @@
 #include "config.h"
 
 struct options_client {
-    std::string gui_address;
-    types::port_t gui_port;
+    std::vector<types::endpoint_t> gui_endpoints;
     std::string player_name;
     types::port_t port;
     std::string server_address;
     types::port_t server_port;
+    // Empty if the server is connected to over TCP.
+    std::string socket_path;
+    IoBackend io_backend;
+    SocketProfile socket_profile;
+    // Empty if the gui is communicated with over UDP.
+    std::string gui_shm_name;
+    // 0 if turns are received over TCP.
+    types::port_t turn_port;
 };
 
 struct options_server {
+    types::threads_count_t acceptor_threads;
     types::bomb_timer_t bomb_timer;
     types::players_count_t players_count;
     types::turn_duration_t turn_duration;
     types::explosion_radius_t explosion_radius;
+    // 0 if turns are sent only over TCP.
+    types::port_t turn_port;
     types::initial_blocks_t initial_blocks;
     types::game_length_t game_length;
     std::string server_name;
     types::port_t port;
+    types::backlog_size_t backlog_size;
+    types::threads_count_t reactor_threads;
+    IoBackend io_backend;
     types::seed_t seed;
+    SocketProfile socket_profile;
+    // Empty if there is no Unix domain socket listener.
+    std::string socket_path;
+    types::defer_accept_t defer_accept;
     types::size_xy_t size_x;
     types::size_xy_t size_y;
+    types::zerocopy_threshold_t zerocopy_threshold;
+    // Empty if the server is not handed over.
+    std::string handoff_path;
+    // Empty if the messages from the clients are not captured.
+    std::string capture_path;
+    // 0 if the limit is disabled.
+    types::lag_turns_t max_lag_turns;
+    // 0 if the limit is disabled.
+    types::backlog_bytes_t max_backlog_bytes;
+    SlowClientPolicy slow_client_policy;
+    // 0 if the limit is disabled.
+    types::input_rate_t input_rate;
+    types::input_rate_t input_burst;
+    // 0 if flooding clients are not disconnected.
+    types::flood_limit_t flood_limit;
+};
+
+struct options_replay {
+    std::string capture_path;
+    // 0 if the CPU time of the server is not reported.
+    pid_t server_pid;
+    // 0 if every captured connection is replayed once.
+    types::connections_count_t connections;
+    std::string server_address;
+    types::port_t server_port;
+    // 0 if the messages are sent as fast as possible.
+    types::replay_speed_t speed;
+};
+
+struct options_load {
+    BehaviorModel behavior;
+    types::load_duration_t duration;
+    types::connections_count_t players;
+    // Actions per second of every player.
+    types::action_rate_t action_rate;
+    std::string server_address;
+    types::port_t server_port;
+    SocketProfile socket_profile;
 };
 
 options_client parse_client(int argc, char *argv[]);
 
 options_server parse_server(int argc, char *argv[]);
 
+options_replay parse_replay(int argc, char *argv[]);
+
+options_load parse_load(int argc, char *argv[]);
+
 #endif // PARSER_H
\ No newline at end of file
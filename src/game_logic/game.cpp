@@ -1,5 +1,5 @@
-#include <chrono>
-#include <thread>
+#include <sstream>
+#include <algorithm>
 #include "game.h"
 
 void Game::explode_one_direction(const Position &pos, types::coord_t dx, types::coord_t dy) {
@@ -175,7 +175,6 @@ GameServer::GameServer(const options_server &op) : random(op.seed) {
     bomb_timer = op.bomb_timer;
     explosion_radius = op.explosion_radius;
 
-    turn_duration = op.turn_duration;
     initial_blocks = op.initial_blocks;
     bomb_counter = 0;
     turn = 0;
@@ -271,6 +270,11 @@ void GameServer::handle_exploding_bomb(types::bomb_id_t bomb_id, Turn &turn_mess
         }
     }
 
+    // Turns must not depend on the order of the hash table, which differs in a restored game.
+    std::sort(bomb_blocks_destroyed.begin(), bomb_blocks_destroyed.end(), [](const Position &a, const Position &b) {
+        return std::tie(a.x, a.y) < std::tie(b.x, b.y);
+    });
+
     // Add the explosion event.
     event.blocks_destroyed = bomb_blocks_destroyed;
     event.robots_destroyed = bomb_robots_destroyed;
@@ -360,6 +364,10 @@ void GameServer::apply_player_move(types::player_id_t id, Turn &turn_message, co
     }
 }
 
+void GameServer::apply_player_move(types::player_id_t, Turn &, const SubscribeTurns &) {
+    // Ignore.
+}
+
 void GameServer::update_blocks() {
     for (const Position &pos: turn_blocks_destroyed) {
         blocks.erase(pos);
@@ -368,7 +376,6 @@ void GameServer::update_blocks() {
 
 Turn GameServer::apply_moves(MoveContainer &move_container) {
     Turn turn_message;
-    std::this_thread::sleep_for(std::chrono::milliseconds(turn_duration));
 
     // Get the last move from every player.
     MoveContainer::container_t moves = move_container.atomic_snapshot_and_clear();
@@ -380,16 +387,22 @@ Turn GameServer::apply_moves(MoveContainer &move_container) {
     // Check what bombs explode.
     decrease_bomb_timers();
 
-    for (auto it = bombs.cbegin(), next_it = it; it != bombs.cend(); it = next_it) {
-        ++next_it;
-        if (it->second.timer == 0) {
-            // The bomb explodes.
-            handle_exploding_bomb(it->first, turn_message);
-
-            // Erase the bomb after explosion.
-            bombs.erase(it);
+    // Bombs explode in the order of their ids, for the same reason their blocks are sorted.
+    std::vector<types::bomb_id_t> exploding_bombs;
+    for (const auto &[id, bomb]: bombs) {
+        if (bomb.timer == 0) {
+            exploding_bombs.push_back(id);
         }
     }
+    std::sort(exploding_bombs.begin(), exploding_bombs.end());
+
+    for (types::bomb_id_t id: exploding_bombs) {
+        // The bomb explodes.
+        handle_exploding_bomb(id, turn_message);
+
+        // Erase the bomb after explosion.
+        bombs.erase(id);
+    }
 
     for (types::player_id_t i = 0; i < scores.size(); i++) {
         // Check if the player way destroyed.
@@ -426,4 +439,73 @@ Turn GameServer::apply_moves(MoveContainer &move_container) {
 
 Game::score_map_t GameServer::get_score_map() const {
     return scores;
+}
+
+types::turn_t GameServer::get_turn() const {
+    return turn;
+}
+
+void GameServer::serialize(MessageEncoder &encoder) const {
+    encoder.send_element<types::turn_t>(turn);
+    encoder.send_element<types::bomb_id_t>(bomb_counter);
+
+    // The state of the generator is its last value, written out as a number.
+    std::ostringstream random_state;
+    random_state << random;
+    encoder.send_element<uint32_t>((uint32_t) std::stoul(random_state.str()));
+
+    encoder.send_element<uint32_t>((uint32_t) player_positions.size());
+    for (const auto &[id, position]: player_positions) {
+        encoder.send_element<types::player_id_t>(id);
+        position.serialize(encoder);
+    }
+
+    encoder.send_element<uint32_t>((uint32_t) blocks.size());
+    for (const Position &position: blocks) {
+        position.serialize(encoder);
+    }
+
+    encoder.send_element<uint32_t>((uint32_t) bombs.size());
+    for (const auto &[id, bomb]: bombs) {
+        encoder.send_element<types::bomb_id_t>(id);
+        bomb.position.serialize(encoder);
+        encoder.send_element<types::bomb_timer_t>(bomb.timer);
+    }
+
+    encoder.send_element<uint32_t>((uint32_t) scores.size());
+    for (const auto &[id, score]: scores) {
+        encoder.send_element<types::player_id_t>(id);
+        encoder.send_element<types::score_t>(score);
+    }
+}
+
+GameServer::GameServer(const options_server &op, MessageDecoder &decoder) : GameServer(op) {
+    turn = decoder.read_element<types::turn_t>();
+    bomb_counter = decoder.read_element<types::bomb_id_t>();
+
+    std::istringstream random_state(std::to_string(decoder.read_element<uint32_t>()));
+    random_state >> random;
+
+    for (auto count = decoder.read_element<uint32_t>(); count > 0; count--) {
+        auto id = decoder.read_element<types::player_id_t>();
+        player_positions.insert({id, Position(decoder)});
+    }
+
+    for (auto count = decoder.read_element<uint32_t>(); count > 0; count--) {
+        blocks.insert(Position(decoder));
+    }
+
+    for (auto count = decoder.read_element<uint32_t>(); count > 0; count--) {
+        auto id = decoder.read_element<types::bomb_id_t>();
+        Bomb bomb{};
+        bomb.position = Position(decoder);
+        bomb.timer = decoder.read_element<types::bomb_timer_t>();
+        bombs.insert({id, bomb});
+    }
+
+    scores.clear();
+    for (auto count = decoder.read_element<uint32_t>(); count > 0; count--) {
+        auto id = decoder.read_element<types::player_id_t>();
+        scores.insert({id, decoder.read_element<types::score_t>()});
+    }
 }
\ No newline at end of file
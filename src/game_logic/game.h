@@ -76,12 +76,21 @@ public:
     /*  Create the game based on the provided options. */
     explicit GameServer(const options_server &);
 
+    /* Restore the game serialized by another server, e.g. during a handoff. */
+    GameServer(const options_server &, MessageDecoder &);
+
     Turn game_init();
 
+    /* Carry out the next turn, without waiting for its duration. */
     Turn apply_moves(MoveContainer &);
 
     score_map_t get_score_map() const;
 
+    types::turn_t get_turn() const;
+
+    /* Serialize the state of the game together with the state of its random number generator. */
+    void serialize(MessageEncoder &) const;
+
 private:
     bool is_position_legal(const Position &, types::coord_t, types::coord_t);
 
@@ -95,10 +104,11 @@ private:
 
     void apply_player_move(types::player_id_t, Turn &, const Move &);
 
+    void apply_player_move(types::player_id_t, Turn &, const SubscribeTurns &);
+
     void update_blocks();
 
     std::minstd_rand random;
-    types::turn_duration_t turn_duration;
     types::initial_blocks_t initial_blocks;
     types::bomb_id_t bomb_counter;
 };
@@ -0,0 +1,283 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <queue>
+#include <random>
+
+#include "config/config.h"
+#include "config/parser.h"
+#include "network/message_manager.h"
+#include "network/socket_tuning.h"
+#include "network/tool_connections.h"
+
+#define SEED 42
+
+using clock_type = std::chrono::steady_clock;
+
+// Messages sent by the virtual players, encoded once for all of them.
+struct encoded_actions {
+    MessageEncoder::message_t moves[4];
+    MessageEncoder::message_t place_bomb;
+    MessageEncoder::message_t place_block;
+};
+
+// Connection of a player, closed until it is opened and after it fails.
+struct virtual_player : ToolConnection {
+    BehaviorModel behavior;
+    MessageEncoder::message_t join;
+    bool greeted = false;
+    // True between GameStarted and GameEnded, actions are sent only then.
+    bool in_game = false;
+    // Times at which the actions sent since the last received turn were sent.
+    std::deque<clock_type::time_point> pending_actions;
+    // Milliseconds from sending an action until the next turn was received.
+    std::vector<double> latencies;
+};
+
+struct load_stats {
+    uint64_t sent_actions = 0;
+    uint64_t received_messages = 0;
+    uint64_t received_turns = 0;
+    uint64_t decode_errors = 0;
+    uint64_t failed_connections = 0;
+    // Connections opened which have not received Hello yet.
+    size_t connecting = 0;
+};
+
+// Action timer of a player, the earliest one on top of the queue.
+using action_timer = std::pair<clock_type::time_point, size_t>;
+
+static encoded_actions encode_actions() {
+    encoded_actions actions;
+    for (int direction = 0; direction < 4; direction++) {
+        actions.moves[direction] = ClientMessageManager::encode_server_message(Move((Direction) direction));
+    }
+    actions.place_bomb = ClientMessageManager::encode_server_message(PlaceBomb());
+    actions.place_block = ClientMessageManager::encode_server_message(PlaceBlock());
+    return actions;
+}
+
+static BehaviorModel assign_behavior(BehaviorModel behavior, size_t player_id) {
+    if (behavior != BehaviorModel::Mixed) {
+        return behavior;
+    }
+    const BehaviorModel mixed[] = {BehaviorModel::Walker, BehaviorModel::Bomber, BehaviorModel::Builder,
+                                   BehaviorModel::Idle};
+    return mixed[player_id % std::size(mixed)];
+}
+
+// Picks the next action of a player. Bombers and builders move three times out of four.
+static MessageEncoder::message_t next_action(BehaviorModel behavior, const encoded_actions &actions,
+                                             std::mt19937 &generator) {
+    std::uniform_int_distribution<int> distribution(0, 3);
+    int roll = distribution(generator);
+    if (behavior == BehaviorModel::Bomber && roll == 0) {
+        return actions.place_bomb;
+    } else if (behavior == BehaviorModel::Builder && roll == 0) {
+        return actions.place_block;
+    }
+    return actions.moves[distribution(generator)];
+}
+
+static void close_connection(int epoll_fd, virtual_player &player, load_stats &stats) {
+    player.close(epoll_fd);
+    if (!player.greeted) {
+        stats.connecting--;
+    }
+    player.in_game = false;
+    player.pending_actions.clear();
+    stats.failed_connections++;
+}
+
+static void send_messages(int epoll_fd, size_t id, virtual_player &player, load_stats &stats) {
+    try {
+        player.send_queued_messages(epoll_fd, id);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Player " << id << ": " << e.what() << '\n';
+        close_connection(epoll_fd, player, stats);
+    }
+}
+
+static void handle_server_message(virtual_player &player, const ServerMessageView &message, clock_type::time_point now,
+                                  load_stats &stats) {
+    stats.received_messages++;
+    if (std::holds_alternative<HelloView>(message)) {
+        player.greeted = true;
+        stats.connecting--;
+        player.handler->queue_encoded_message(player.join);
+    } else if (std::holds_alternative<GameStartedView>(message)) {
+        player.in_game = true;
+    } else if (std::holds_alternative<TurnView>(message)) {
+        stats.received_turns++;
+        for (auto sent: player.pending_actions) {
+            player.latencies.push_back(std::chrono::duration<double, std::milli>(now - sent).count());
+        }
+        player.pending_actions.clear();
+    } else if (std::holds_alternative<GameEndedView>(message)) {
+        // Join the next game.
+        player.in_game = false;
+        player.pending_actions.clear();
+        player.handler->queue_encoded_message(player.join);
+    }
+}
+
+static void receive_messages(int epoll_fd, size_t id, virtual_player &player, load_stats &stats) {
+    try {
+        // The messages are only inspected, they are viewed in the receive buffer.
+        player.receive_server_messages(
+                [&](const ServerMessageView &message, std::span<const uint8_t>, clock_type::time_point now) {
+                    handle_server_message(player, message, now, stats);
+                });
+    }
+    catch (const DecodeError &e) {
+        std::cerr << "Player " << id << ": " << e.what() << '\n';
+        stats.decode_errors++;
+        close_connection(epoll_fd, player, stats);
+        return;
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Player " << id << ": " << e.what() << '\n';
+        close_connection(epoll_fd, player, stats);
+        return;
+    }
+    // Send the Join messages queued in response.
+    send_messages(epoll_fd, id, player, stats);
+}
+
+static void open_connection(int epoll_fd, size_t id, virtual_player &player, options_load &options,
+                            load_stats &stats) {
+    try {
+        player.open(epoll_fd, id, options.server_address, options.server_port);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Player " << id << ": " << e.what() << '\n';
+        stats.failed_connections++;
+        return;
+    }
+    stats.connecting++;
+}
+
+int main(int argc, char *argv[]) {
+    options_load options = parse_load(argc, argv);
+    SocketTuning::select_profile(options.socket_profile);
+    raise_open_files_limit();
+
+    encoded_actions actions = encode_actions();
+    std::vector<virtual_player> players(options.players);
+    for (size_t id = 0; id < players.size(); id++) {
+        std::string name = "Bot " + std::to_string(id);
+        players[id].behavior = assign_behavior(options.behavior, id);
+        players[id].join = ClientMessageManager::encode_server_message(Join(name));
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        std::cerr << std::strerror(errno) << '\n';
+        exit(EXIT_FAILURE);
+    }
+
+    std::mt19937 generator(SEED);
+    auto start = clock_type::now();
+    auto deadline = start + std::chrono::seconds(options.duration);
+
+    // The first actions of the players are spread over the interval between actions.
+    std::priority_queue<action_timer, std::vector<action_timer>, std::greater<>> timers;
+    std::chrono::microseconds interval(options.action_rate > 0 ? 1000000 / options.action_rate : 0);
+    if (options.action_rate > 0) {
+        std::uniform_int_distribution<int64_t> offset(0, interval.count());
+        for (size_t id = 0; id < players.size(); id++) {
+            if (players[id].behavior != BehaviorModel::Idle) {
+                timers.emplace(start + std::chrono::microseconds(offset(generator)), id);
+            }
+        }
+    }
+
+    load_stats stats;
+    size_t next_connection = 0;
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+
+    while (true) {
+        auto now = clock_type::now();
+        if (now >= deadline) {
+            break;
+        }
+
+        // Connect the players in batches, so that the server can keep up with accepting them.
+        while (stats.connecting < LOAD_CONNECT_BATCH && next_connection < players.size()) {
+            open_connection(epoll_fd, next_connection, players[next_connection], options, stats);
+            next_connection++;
+        }
+
+        // Send the actions that are due. Players which are not in a game skip their turn.
+        while (!timers.empty() && timers.top().first <= now) {
+            auto [due, id] = timers.top();
+            timers.pop();
+            timers.emplace(due + interval, id);
+
+            virtual_player &player = players[id];
+            if (!player.handler || !player.in_game) {
+                continue;
+            }
+            player.handler->queue_encoded_message(next_action(player.behavior, actions, generator));
+            player.pending_actions.push_back(now);
+            stats.sent_actions++;
+            send_messages(epoll_fd, id, player, stats);
+        }
+
+        auto wake_up = deadline;
+        if (!timers.empty()) {
+            wake_up = std::min(wake_up, timers.top().first);
+        }
+        auto timeout = std::chrono::ceil<std::chrono::milliseconds>(wake_up - now).count();
+
+        int n = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, (int) std::max<int64_t>(timeout, 0));
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << std::strerror(errno) << '\n';
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < n; i++) {
+            auto id = (size_t) events[i].data.u64;
+            virtual_player &player = players[id];
+            if (player.handler && (events[i].events & EPOLLOUT)) {
+                send_messages(epoll_fd, id, player, stats);
+            }
+            if (player.handler && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                receive_messages(epoll_fd, id, player, stats);
+            }
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+    close(epoll_fd);
+
+    std::vector<double> latencies;
+    // The 99th percentile of every player, showing whether some players are served worse than others.
+    std::vector<double> player_latencies;
+    for (auto &player: players) {
+        latencies.insert(latencies.end(), player.latencies.begin(), player.latencies.end());
+        if (!player.latencies.empty()) {
+            player_latencies.push_back(percentile(player.latencies, 99));
+        }
+    }
+
+    std::cout << options.players << " players, " << stats.failed_connections << " connections failed." << std::endl;
+    std::cout << "Sent " << (double) stats.sent_actions / elapsed << " actions/s, received "
+              << (double) stats.received_messages / elapsed << " messages/s (" << (double) stats.received_turns / elapsed
+              << " turns/s)." << std::endl;
+    std::cout << "Decode errors: " << stats.decode_errors << " ("
+              << (stats.received_messages > 0 ? 100 * (double) stats.decode_errors / (double) stats.received_messages : 0)
+              << "% of received messages)." << std::endl;
+    report_percentiles("Action to turn latency", latencies);
+    report_percentiles("Action to turn latency p99 of players", player_latencies);
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <cstdlib>
+#include <bit>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+#include "buffer_pool.h"
+#include "../config/config.h"
+
+namespace {
+    // Released buffers of one size.
+    struct size_class {
+        std::mutex mutex;
+        std::vector<uint8_t *> buffers;
+    };
+
+    const size_t CLASSES_COUNT = (size_t) std::bit_width((size_t) BUFFER_POOL_MAX_SIZE / BUFFER_POOL_MIN_SIZE);
+
+    size_class classes[CLASSES_COUNT];
+    std::atomic<size_t> used_bytes{0};
+    std::atomic<size_t> pooled_bytes{0};
+
+    size_t class_index(size_t n) {
+        return (size_t) std::bit_width((n - 1) / BUFFER_POOL_MIN_SIZE);
+    }
+}
+
+uint8_t *BufferPool::acquire(size_t &n) {
+    if (n <= BUFFER_POOL_MAX_SIZE) {
+        size_t index = class_index(std::max<size_t>(n, 1));
+        n = (size_t) BUFFER_POOL_MIN_SIZE << index;
+
+        size_class &pooled = classes[index];
+        std::unique_lock<std::mutex> lock_guard(pooled.mutex);
+        if (!pooled.buffers.empty()) {
+            uint8_t *buff = pooled.buffers.back();
+            pooled.buffers.pop_back();
+            pooled_bytes -= n;
+            used_bytes += n;
+            return buff;
+        }
+    }
+
+    auto *buff = (uint8_t *) malloc(n);
+    if (buff == nullptr) {
+        throw std::runtime_error("Error occurred when allocating space for a buffer!");
+    }
+    used_bytes += n;
+    return buff;
+}
+
+void BufferPool::release(uint8_t *buff, size_t n) {
+    used_bytes -= n;
+    if (n <= BUFFER_POOL_MAX_SIZE) {
+        size_class &pooled = classes[class_index(n)];
+        std::unique_lock<std::mutex> lock_guard(pooled.mutex);
+        if ((pooled.buffers.size() + 1) * n <= BUFFER_POOL_CLASS_CAPACITY) {
+            pooled.buffers.push_back(buff);
+            pooled_bytes += n;
+            return;
+        }
+    }
+    free(buff);
+}
+
+BufferPool::stats_t BufferPool::get_stats() {
+    return {used_bytes, pooled_bytes};
+}
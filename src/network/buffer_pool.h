@@ -0,0 +1,47 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides a pool of network buffers shared by all the handlers.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cinttypes>
+#include <cstddef>
+
+/**
+ * @brief Thread-safe pool of buffers whose sizes are powers of two, from BUFFER_POOL_MIN_SIZE to
+ * BUFFER_POOL_MAX_SIZE. Released buffers are kept for reuse, up to BUFFER_POOL_CLASS_CAPACITY bytes
+ * of each size, the rest is given back to the allocator. Larger buffers are not pooled.
+ */
+class BufferPool {
+public:
+    struct stats_t {
+        // Bytes of the buffers held by their users.
+        size_t used_bytes;
+        // Bytes of the released buffers kept for reuse.
+        size_t pooled_bytes;
+    };
+
+    /**
+     * @brief Takes a buffer of at least n bytes from the pool.
+     *
+     * @param n Requested size, rounded up to the size of the returned buffer.
+     * @return uint8_t* Pointer to the buffer.
+     * @throws std::runtime_error - Thrown when memory cannot be allocated.
+     */
+    static uint8_t *acquire(size_t &n);
+
+    /**
+     * @brief Gives the buffer back to the pool.
+     *
+     * @param n Size of the buffer returned by acquire.
+     */
+    static void release(uint8_t *buff, size_t n);
+
+    static stats_t get_stats();
+};
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,119 @@
+#include "byte_order.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BYTE_ORDER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    template<typename T>
+    void swap_scalar(uint8_t *buffer, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            T element;
+            std::memcpy(&element, buffer + i * sizeof(T), sizeof(T));
+            element = swap_byte_order(element);
+            std::memcpy(buffer + i * sizeof(T), &element, sizeof(T));
+        }
+    }
+
+#ifdef BYTE_ORDER_X86
+    // Shuffle reversing the bytes of every number of the given width in a 16 byte lane.
+    __attribute__((target("ssse3")))
+    __m128i lane_shuffle(size_t width) {
+        return width == 2 ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+                          : _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    }
+
+    template<typename T>
+    __attribute__((target("ssse3")))
+    void swap_sse(uint8_t *buffer, size_t count) {
+        const __m128i shuffle = lane_shuffle(sizeof(T));
+        size_t bytes = count * sizeof(T);
+        size_t i = 0;
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i lane = _mm_loadu_si128((const __m128i *) (buffer + i));
+            _mm_storeu_si128((__m128i *) (buffer + i), _mm_shuffle_epi8(lane, shuffle));
+        }
+        swap_scalar<T>(buffer + i, (bytes - i) / sizeof(T));
+    }
+
+    template<typename T>
+    __attribute__((target("avx2")))
+    void swap_avx2(uint8_t *buffer, size_t count) {
+        // The shuffle works within each 16 byte half of the register.
+        const __m256i shuffle = _mm256_broadcastsi128_si256(lane_shuffle(sizeof(T)));
+        size_t bytes = count * sizeof(T);
+        size_t i = 0;
+        for (; i + 32 <= bytes; i += 32) {
+            __m256i lanes = _mm256_loadu_si256((const __m256i *) (buffer + i));
+            _mm256_storeu_si256((__m256i *) (buffer + i), _mm256_shuffle_epi8(lanes, shuffle));
+        }
+        // The rest is converted by the SSE kernel, which stalls if the upper halves are in use.
+        _mm256_zeroupper();
+        swap_sse<T>(buffer + i, (bytes - i) / sizeof(T));
+    }
+#endif
+
+    ByteSwapKernel detect_best_kernel() {
+#ifdef BYTE_ORDER_X86
+        // Runs before main, when the features may not have been detected yet.
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return ByteSwapKernel::AVX2;
+        }
+        if (__builtin_cpu_supports("ssse3")) {
+            return ByteSwapKernel::SSE;
+        }
+#endif
+        return ByteSwapKernel::Scalar;
+    }
+
+    const ByteSwapKernel best_kernel = detect_best_kernel();
+
+    ByteSwapKernel resolve_kernel(ByteSwapKernel kernel) {
+        if (kernel == ByteSwapKernel::Best) {
+            return best_kernel;
+        }
+        return is_byte_swap_kernel_supported(kernel) ? kernel : ByteSwapKernel::Scalar;
+    }
+
+    template<typename T>
+    void swap_batch(uint8_t *buffer, size_t count, ByteSwapKernel kernel) {
+        switch (resolve_kernel(kernel)) {
+#ifdef BYTE_ORDER_X86
+            case ByteSwapKernel::AVX2:
+                swap_avx2<T>(buffer, count);
+                return;
+            case ByteSwapKernel::SSE:
+                swap_sse<T>(buffer, count);
+                return;
+#endif
+            default:
+                swap_scalar<T>(buffer, count);
+        }
+    }
+}
+
+bool is_byte_swap_kernel_supported(ByteSwapKernel kernel) {
+    switch (kernel) {
+#ifdef BYTE_ORDER_X86
+        case ByteSwapKernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case ByteSwapKernel::SSE:
+            return __builtin_cpu_supports("ssse3");
+#endif
+        case ByteSwapKernel::Best:
+        case ByteSwapKernel::Scalar:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void swap_byte_order_16(uint8_t *buffer, size_t count, ByteSwapKernel kernel) {
+    swap_batch<uint16_t>(buffer, count, kernel);
+}
+
+void swap_byte_order_32(uint8_t *buffer, size_t count, ByteSwapKernel kernel) {
+    swap_batch<uint32_t>(buffer, count, kernel);
+}
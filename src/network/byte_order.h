@@ -0,0 +1,116 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides the conversion of numbers between host and network byte order.
+ *
+ * Single numbers are converted by functions selected at compile time by the size of the type, an
+ * unsupported size does not compile. Arrays of 16 and 32 bit numbers are converted in place by
+ * batch kernels using SSSE3 or AVX2 when the processor supports them.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H
+
+#include <bit>
+#include <cstring>
+#include <cstddef>
+#include <cinttypes>
+#include <type_traits>
+
+/**
+ * @brief Reverses the bytes of the number.
+ */
+template<typename T>
+constexpr T swap_byte_order(T value) {
+    static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "Only integers can be converted!");
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                  "Invalid data type size for endianness conversion!");
+    if constexpr (sizeof(T) == 1) {
+        return value;
+    } else if constexpr (sizeof(T) == 2) {
+        return (T) __builtin_bswap16((uint16_t) value);
+    } else if constexpr (sizeof(T) == 4) {
+        return (T) __builtin_bswap32((uint32_t) value);
+    } else {
+        return (T) __builtin_bswap64((uint64_t) value);
+    }
+}
+
+template<typename T>
+constexpr T host_to_network(T value) {
+    if constexpr (std::endian::native == std::endian::big) {
+        return value;
+    } else {
+        return swap_byte_order(value);
+    }
+}
+
+template<typename T>
+constexpr T network_to_host(T value) {
+    return host_to_network(value);
+}
+
+/**
+ * @brief Converts the element of type T stored at buffer, which may be unaligned, from network to
+ * host byte order.
+ */
+template<typename T>
+void convert_network_to_host_byte_order(uint8_t *buffer) {
+    T element;
+    std::memcpy(&element, buffer, sizeof(T));
+    element = network_to_host(element);
+    std::memcpy(buffer, &element, sizeof(T));
+}
+
+/**
+ * @brief Converts the element of type T stored at buffer, which may be unaligned, from host to
+ * network byte order.
+ */
+template<typename T>
+void convert_host_to_network_byte_order(uint8_t *buffer) {
+    T element;
+    std::memcpy(&element, buffer, sizeof(T));
+    element = host_to_network(element);
+    std::memcpy(buffer, &element, sizeof(T));
+}
+
+/* Implementations of the batch byteswap, Best is the fastest one the processor supports. */
+enum class ByteSwapKernel {
+    Best,
+    Scalar,
+    SSE,
+    AVX2,
+};
+
+/**
+ * @brief Checks whether the processor supports the kernel.
+ */
+bool is_byte_swap_kernel_supported(ByteSwapKernel kernel);
+
+/**
+ * @brief Reverses the bytes of count 16 bit numbers stored at buffer, which may be unaligned.
+ * An unsupported kernel falls back to the scalar one.
+ */
+void swap_byte_order_16(uint8_t *buffer, size_t count, ByteSwapKernel kernel = ByteSwapKernel::Best);
+
+/**
+ * @brief Reverses the bytes of count 32 bit numbers stored at buffer, which may be unaligned.
+ * An unsupported kernel falls back to the scalar one.
+ */
+void swap_byte_order_32(uint8_t *buffer, size_t count, ByteSwapKernel kernel = ByteSwapKernel::Best);
+
+/**
+ * @brief Converts count numbers of type T stored at buffer between host and network byte order.
+ */
+template<typename T>
+void convert_byte_order_batch(uint8_t *buffer, size_t count) {
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4, "No batch kernel for the size!");
+    if constexpr (std::endian::native == std::endian::little && sizeof(T) == 2) {
+        swap_byte_order_16(buffer, count);
+    } else if constexpr (std::endian::native == std::endian::little && sizeof(T) == 4) {
+        swap_byte_order_32(buffer, count);
+    }
+}
+
+#endif // BYTE_ORDER_H
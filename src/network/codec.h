@@ -0,0 +1,440 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides the encoding and decoding of the messages, generated at compile time
+ * from the fields each message declares once.
+ *
+ * A message declares its fields with a static schema() function returning a tuple of pointers to
+ * its members, in the order in which they are sent. Events also declare the code sent before them
+ * as code. Fields are numbers, enums (sent as their underlying type), strings (u8 length and the
+ * bytes, truncated to 255 bytes), vectors (u32 length and the elements), maps (u32 length and the
+ * pairs), variants of events and other messages. Everything is sent in network byte order.
+ *
+ * Strings are copied with a single write. Vectors of fixed-width elements, numbers and messages
+ * made of numbers only such as Position, are converted to network byte order in batches of
+ * CODEC_BATCH_SIZE bytes on the stack, each batch written and read with a single bulk copy. When
+ * all the numbers of an element are 16 or 32 bit wide, the batch is converted by the SIMD kernels.
+ *
+ * Writers and readers wrap the streams, so that the same code is generated for every one of them:
+ * OutputStream (send_element), PacketStream (append_to_outcoming_packet), InputStream
+ * (read_element, throwing when the bytes end) and MessageDecoder without exceptions.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <map>
+#include <span>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include "network_handler.h"
+#include "byte_order.h"
+#include "../config/config.h"
+
+namespace codec {
+    template<typename T>
+    concept Message = requires { T::schema(); };
+
+    template<typename T>
+    concept Event = Message<T> && requires { T::code; };
+
+    /* Writes to an OutputStream. */
+    template<typename OutputStream>
+    struct StreamWriter {
+        OutputStream &stream;
+
+        template<typename T>
+        void write(T element) {
+            stream.template send_element<T>(element);
+        }
+
+        void write_bytes(std::span<const uint8_t> bytes) {
+            stream.send_bytes(bytes);
+        }
+    };
+
+    /* Writes to a gui packet, see UDPHandler and SharedMemoryGuiHandler. */
+    template<typename PacketStream>
+    struct PacketWriter {
+        PacketStream &stream;
+
+        template<typename T>
+        void write(T element) {
+            stream.template append_to_outcoming_packet<T>(element);
+        }
+
+        void write_bytes(std::span<const uint8_t> bytes) {
+            stream.append_bytes_to_outcoming_packet(bytes);
+        }
+    };
+
+    /* Reads from an InputStream, which throws when the bytes end, so reads always succeed. */
+    template<typename InputStream>
+    struct StreamReader {
+        InputStream &stream;
+
+        template<typename T>
+        bool read(T &element) {
+            element = stream.template read_element<T>();
+            return true;
+        }
+
+        bool read_bytes(std::span<uint8_t> out) {
+            stream.read_bytes(out);
+            return true;
+        }
+    };
+
+    /* Reads from a MessageDecoder without exceptions, a read fails when the bytes end. */
+    struct TryReader {
+        MessageDecoder &decoder;
+
+        template<typename T>
+        bool read(T &element) {
+            return decoder.try_read_element(element);
+        }
+
+        bool read_bytes(std::span<uint8_t> out) {
+            return decoder.try_read_bytes(out);
+        }
+    };
+
+    template<typename Writer, typename T>
+    void encode(Writer &writer, const T &value);
+
+    template<typename Reader, typename T>
+    bool decode(Reader &reader, T &value);
+
+    template<typename T>
+    struct is_vector : std::false_type {};
+
+    template<typename T>
+    struct is_vector<std::vector<T>> : std::true_type {};
+
+    template<typename T>
+    struct is_map : std::false_type {};
+
+    template<typename K, typename V>
+    struct is_map<std::map<K, V>> : std::true_type {};
+
+    template<typename T>
+    struct is_variant : std::false_type {};
+
+    template<typename... Ts>
+    struct is_variant<std::variant<Ts...>> : std::true_type {};
+
+    template<typename Member>
+    struct member_type;
+
+    template<typename Class, typename M>
+    struct member_type<M Class::*> {
+        using type = M;
+    };
+
+    template<typename T>
+    constexpr size_t wire_size();
+
+    // Size of the message on the wire if all its fields are of fixed width, 0 otherwise.
+    template<Message T>
+    constexpr size_t schema_wire_size() {
+        return std::apply([](auto... fields) {
+            size_t sizes[] = {wire_size<typename member_type<decltype(fields)>::type>()...};
+            size_t total = 0;
+            for (size_t size: sizes) {
+                if (size == 0) {
+                    return (size_t) 0;
+                }
+                total += size;
+            }
+            return total;
+        }, T::schema());
+    }
+
+    // Size of the value on the wire if it is the same for every value of the type, 0 otherwise.
+    template<typename T>
+    constexpr size_t wire_size() {
+        if constexpr (std::is_enum_v<T>) {
+            return sizeof(std::underlying_type_t<T>);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return sizeof(T);
+        } else if constexpr (Message<T> && !Event<T>) {
+            return schema_wire_size<T>();
+        } else {
+            return 0;
+        }
+    }
+
+    template<typename T>
+    inline constexpr size_t wire_size_v = wire_size<T>();
+
+    template<typename T>
+    constexpr size_t uniform_width();
+
+    template<Message T>
+    constexpr size_t schema_uniform_width() {
+        return std::apply([](auto... fields) {
+            size_t widths[] = {uniform_width<typename member_type<decltype(fields)>::type>()...};
+            for (size_t width: widths) {
+                if (width != widths[0]) {
+                    return (size_t) 0;
+                }
+            }
+            return widths[0];
+        }, T::schema());
+    }
+
+    // Width of the numbers of the fixed-width value if all of them are of the same width, 0 otherwise.
+    template<typename T>
+    constexpr size_t uniform_width() {
+        if constexpr (std::is_enum_v<T>) {
+            return sizeof(std::underlying_type_t<T>);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return sizeof(T);
+        } else if constexpr (Message<T> && !Event<T>) {
+            return schema_wire_size<T>() > 0 ? schema_uniform_width<T>() : 0;
+        } else {
+            return 0;
+        }
+    }
+
+    template<typename T>
+    inline constexpr size_t uniform_width_v = uniform_width<T>();
+
+    // Whether the numbers of the elements are converted by the batch kernels instead of one by one.
+    template<typename Element>
+    inline constexpr bool kernel_converted = uniform_width_v<Element> == 2 || uniform_width_v<Element> == 4;
+
+    template<typename Element>
+    void convert_batch(uint8_t *batch, size_t bytes) {
+        using Number = std::conditional_t<uniform_width_v<Element> == 2, uint16_t, uint32_t>;
+        convert_byte_order_batch<Number>(batch, bytes / sizeof(Number));
+    }
+
+    // Writes the fixed-width value at out and advances out, in network byte order if Convert.
+    template<bool Convert, typename T>
+    void pack(uint8_t *&out, const T &value) {
+        if constexpr (std::is_enum_v<T>) {
+            pack<Convert>(out, static_cast<std::underlying_type_t<T>>(value));
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            T converted = Convert ? host_to_network(value) : value;
+            std::memcpy(out, &converted, sizeof(T));
+            out += sizeof(T);
+        } else {
+            std::apply([&](auto... fields) { (pack<Convert>(out, value.*fields), ...); }, T::schema());
+        }
+    }
+
+    // Reads the fixed-width value from in and advances in, from network byte order if Convert.
+    template<bool Convert, typename T>
+    void unpack(const uint8_t *&in, T &value) {
+        if constexpr (std::is_enum_v<T>) {
+            std::underlying_type_t<T> underlying;
+            unpack<Convert>(in, underlying);
+            value = static_cast<T>(underlying);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            std::memcpy(&value, in, sizeof(T));
+            if constexpr (Convert) {
+                value = network_to_host(value);
+            }
+            in += sizeof(T);
+        } else {
+            std::apply([&](auto... fields) { (unpack<Convert>(in, value.*fields), ...); }, T::schema());
+        }
+    }
+
+    // Number of fixed-width elements converted at a time.
+    template<typename Element>
+    inline constexpr size_t batch_length = std::max<size_t>(CODEC_BATCH_SIZE / wire_size_v<Element>, 1);
+
+    template<typename Writer, typename Element>
+    void encode_batched(Writer &writer, const std::vector<Element> &elements) {
+        uint8_t batch[batch_length<Element> * wire_size_v<Element>];
+        for (size_t first = 0; first < elements.size(); first += batch_length<Element>) {
+            size_t last = std::min(elements.size(), first + batch_length<Element>);
+            uint8_t *out = batch;
+            for (size_t i = first; i < last; i++) {
+                pack<!kernel_converted<Element>>(out, elements[i]);
+            }
+            if constexpr (kernel_converted<Element>) {
+                convert_batch<Element>(batch, (size_t) (out - batch));
+            }
+            writer.write_bytes({batch, (size_t) (out - batch)});
+        }
+    }
+
+    template<typename Reader, typename Element>
+    bool decode_batched(Reader &reader, std::vector<Element> &elements, size_t len) {
+        uint8_t batch[batch_length<Element> * wire_size_v<Element>];
+        elements.clear();
+        while (elements.size() < len) {
+            size_t count = std::min(len - elements.size(), batch_length<Element>);
+            if (!reader.read_bytes({batch, count * wire_size_v<Element>})) {
+                return false;
+            }
+            if constexpr (kernel_converted<Element>) {
+                convert_batch<Element>(batch, count * wire_size_v<Element>);
+            }
+            const uint8_t *in = batch;
+            for (size_t i = 0; i < count; i++) {
+                unpack<!kernel_converted<Element>>(in, elements.emplace_back());
+            }
+        }
+        return true;
+    }
+
+    template<typename Length, typename Container>
+    Length checked_length(const Container &container) {
+        // Check if the size of the container is supported.
+        if (container.size() > std::numeric_limits<Length>::max()) {
+            throw std::runtime_error("Trying to send a container of unsupported size!");
+        }
+        return (Length) container.size();
+    }
+
+    template<typename Writer, Message T>
+    void encode_fields(Writer &writer, const T &message) {
+        std::apply([&](auto... fields) { (encode(writer, message.*fields), ...); }, T::schema());
+    }
+
+    template<typename Reader, Message T>
+    bool decode_fields(Reader &reader, T &message) {
+        return std::apply([&](auto... fields) { return (decode(reader, message.*fields) && ...); }, T::schema());
+    }
+
+    // Decodes the alternative of the variant whose code is the one read, I is the first one to check.
+    template<typename Reader, typename Variant, size_t I = 0>
+    bool decode_alternative(Reader &reader, Variant &variant, types::message_id_t code) {
+        if constexpr (I == std::variant_size_v<Variant>) {
+            throw std::runtime_error("Unknown message received from the server!");
+        } else {
+            using Alternative = std::variant_alternative_t<I, Variant>;
+            if (code != Alternative::code) {
+                return decode_alternative<Reader, Variant, I + 1>(reader, variant, code);
+            }
+            return decode_fields(reader, variant.template emplace<Alternative>());
+        }
+    }
+
+    /**
+     * @brief Writes the value, its code first if it is an event.
+     *
+     * @throws std::runtime_error - Thrown when a vector or a map is too large to be sent, or when
+     * the stream fails.
+     */
+    template<typename Writer, typename T>
+    void encode(Writer &writer, const T &value) {
+        if constexpr (std::is_enum_v<T>) {
+            writer.template write<std::underlying_type_t<T>>(static_cast<std::underlying_type_t<T>>(value));
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            writer.template write<T>(value);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            // Truncate string if too long.
+            auto n = (types::str_len_t) std::min<size_t>(value.size(), std::numeric_limits<types::str_len_t>::max());
+            writer.template write<types::str_len_t>(n);
+            writer.write_bytes({(const uint8_t *) value.data(), n});
+        } else if constexpr (is_vector<T>::value) {
+            writer.template write<types::vec_len_t>(checked_length<types::vec_len_t>(value));
+            if constexpr (wire_size_v<typename T::value_type> > 0) {
+                encode_batched(writer, value);
+            } else {
+                for (const auto &element: value) {
+                    encode(writer, element);
+                }
+            }
+        } else if constexpr (is_map<T>::value) {
+            writer.template write<types::map_len_t>(checked_length<types::map_len_t>(value));
+            for (const auto &[key, element]: value) {
+                encode(writer, key);
+                encode(writer, element);
+            }
+        } else if constexpr (is_variant<T>::value) {
+            std::visit([&](const auto &alternative) { encode(writer, alternative); }, value);
+        } else {
+            static_assert(Message<T>, "The type has no schema!");
+            if constexpr (Event<T>) {
+                writer.template write<types::message_id_t>(T::code);
+            }
+            encode_fields(writer, value);
+        }
+    }
+
+    /**
+     * @brief Reads the value, replacing the old one. Variants are read starting with the code.
+     *
+     * @return bool False if the bytes ended before the value did, only if the reader does not throw.
+     * @throws std::runtime_error - Thrown when the code of a variant is unknown, and by the reader.
+     */
+    template<typename Reader, typename T>
+    bool decode(Reader &reader, T &value) {
+        if constexpr (std::is_enum_v<T>) {
+            std::underlying_type_t<T> underlying;
+            if (!reader.read(underlying)) {
+                return false;
+            }
+            value = static_cast<T>(underlying);
+            return true;
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            return reader.read(value);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            // Read all bytes of the string at once.
+            types::str_len_t len;
+            if (!reader.read(len)) {
+                return false;
+            }
+            value.resize(len);
+            return reader.read_bytes({(uint8_t *) value.data(), value.size()});
+        } else if constexpr (is_vector<T>::value) {
+            types::vec_len_t len;
+            if (!reader.read(len)) {
+                return false;
+            }
+            // The length comes from the peer, the memory grows only with the elements read.
+            if constexpr (wire_size_v<typename T::value_type> > 0) {
+                return decode_batched(reader, value, len);
+            }
+            value.clear();
+            for (size_t i = 0; i < len; i++) {
+                if (!decode(reader, value.emplace_back())) {
+                    return false;
+                }
+            }
+            return true;
+        } else if constexpr (is_map<T>::value) {
+            types::map_len_t len;
+            if (!reader.read(len)) {
+                return false;
+            }
+            // A key sent again does not replace the first value.
+            value.clear();
+            for (size_t i = 0; i < len; i++) {
+                typename T::key_type key;
+                typename T::mapped_type element;
+                if (!decode(reader, key) || !decode(reader, element)) {
+                    return false;
+                }
+                value.emplace(key, std::move(element));
+            }
+            return true;
+        } else if constexpr (is_variant<T>::value) {
+            types::message_id_t code;
+            if (!reader.read(code)) {
+                return false;
+            }
+            return decode_alternative(reader, value, code);
+        } else {
+            static_assert(Message<T>, "The type has no schema!");
+            return decode_fields(reader, value);
+        }
+    }
+}
+
+#endif // CODEC_H
@@ -1,4 +1,8 @@
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <poll.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
 #include <stdexcept>
@@ -7,8 +11,21 @@
 #include <unistd.h>
 #include <iostream>
 #include "connection_acceptor.h"
+#include "socket_tuning.h"
 
-ConnectionAcceptor::ConnectionAcceptor(types::port_t port, int backlog_size) {
+static int create_stop_fd() {
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+    return fd;
+}
+
+ConnectionAcceptor::ConnectionAcceptor(types::port_t port, int backlog_size) :
+        ConnectionAcceptor(port, backlog_size, false, 0) {}
+
+ConnectionAcceptor::ConnectionAcceptor(types::port_t port, int backlog_size, bool reuse_port,
+                                       types::defer_accept_t defer_accept) : stop_fd(create_stop_fd()) {
     int err;
     struct sockaddr_in6 serveraddr;
 
@@ -18,45 +35,207 @@ ConnectionAcceptor::ConnectionAcceptor(types::port_t port, int backlog_size) {
     serveraddr.sin6_port = htons(port);
     serveraddr.sin6_addr = in6addr_any;
 
-    // Create a new TCP socket.
-    socket_fd = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+    // Create a new TCP socket. It is non-blocking, so that pending connections can be drained.
+    socket_fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
     if (socket_fd == -1) {
         throw TCPAcceptError(std::strerror(errno));
     }
 
+    // Let other acceptors listen on the same port.
+    int flag = 1;
+    if (reuse_port && setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof(flag)) != 0) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+
+    // Wake up the acceptor only when the first data from the client arrives.
+    int defer_seconds = defer_accept;
+    if (defer_accept > 0 &&
+        setsockopt(socket_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_seconds, sizeof(defer_seconds)) != 0) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+
+    // Accepted sockets inherit the buffer sizes of the profile.
+    if (!SocketTuning::tune_listening_socket(socket_fd)) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+
     // Bind the socket to the specified port.
     err = bind(socket_fd, (struct sockaddr *) &serveraddr, sizeof(serveraddr));
     if (err != 0) {
-        throw TCPAcceptError(gai_strerror(err));
+        throw TCPAcceptError(std::strerror(errno));
     }
 
     // Start listening for new connection requests.
     err = listen(socket_fd, backlog_size);
     if (err != 0) {
-        throw TCPAcceptError(gai_strerror(err));
+        throw TCPAcceptError(std::strerror(errno));
+    }
+}
+
+ConnectionAcceptor::ConnectionAcceptor(const std::string &socket_path_, int backlog_size) :
+        stop_fd(create_stop_fd()), socket_path(socket_path_) {
+    struct sockaddr_un serveraddr{};
+    serveraddr.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(serveraddr.sun_path)) {
+        throw TCPAcceptError("Socket path is empty or too long!");
+    }
+    std::memcpy(serveraddr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket_fd == -1) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+
+    // Remove the socket file left by a previous server, but no other file the path may name.
+    struct stat file{};
+    if (lstat(socket_path.c_str(), &file) == 0) {
+        if (!S_ISSOCK(file.st_mode)) {
+            throw TCPAcceptError("Socket path names a file which is not a socket!");
+        }
+        if (unlink(socket_path.c_str()) != 0 && errno != ENOENT) {
+            throw TCPAcceptError(std::strerror(errno));
+        }
+    } else if (errno != ENOENT) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+
+    if (bind(socket_fd, (struct sockaddr *) &serveraddr, sizeof(serveraddr)) != 0) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+    if (lstat(socket_path.c_str(), &file) != 0) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+    socket_file_dev = file.st_dev;
+    socket_file_ino = file.st_ino;
+
+    if (listen(socket_fd, backlog_size) != 0) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+}
+
+ConnectionAcceptor::ConnectionAcceptor(int socket_fd_, const std::string &socket_path_) :
+        socket_fd(socket_fd_), stop_fd(create_stop_fd()), socket_path(socket_path_) {
+    // The socket file was created by the previous server, it belongs to this one now.
+    struct stat file{};
+    if (!socket_path.empty() && lstat(socket_path.c_str(), &file) == 0 && S_ISSOCK(file.st_mode)) {
+        socket_file_dev = file.st_dev;
+        socket_file_ino = file.st_ino;
     }
 }
 
+// Blocks until there is a pending connection request. Returns false if the acceptor is stopped.
+static bool wait_for_connection(int socket_fd, int stop_fd) {
+    struct pollfd fds[] = {{socket_fd, POLLIN, 0},
+                           {stop_fd, POLLIN, 0}};
+    while (poll(fds, 2, -1) == -1) {
+        if (errno != EINTR) {
+            throw TCPAcceptError(std::strerror(errno));
+        }
+    }
+    return fds[1].revents == 0;
+}
+
+// Applies the socket profile to a TCP socket, which disables Nagle's algorithm. Closes the socket on failure.
+static bool tune_accepted_socket(int socket_fd, bool unix_domain) {
+    if (!unix_domain && !SocketTuning::tune_tcp_socket(socket_fd)) {
+        int setsockopt_errno = errno;
+        close(socket_fd);
+        errno = setsockopt_errno;
+        return false;
+    }
+    return true;
+}
+
 int ConnectionAcceptor::accept_another_connection() const {
-    int new_connection_fd = accept(socket_fd, nullptr, nullptr);
-    if (new_connection_fd == -1) {
+    while (true) {
+        if (!wait_for_connection(socket_fd, stop_fd)) {
+            throw TCPAcceptError("Acceptor stopped!");
+        }
+        int new_connection_fd = accept4(socket_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (new_connection_fd == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) {
+                // The connection request is gone, wait for another one.
+                continue;
+            }
+            throw TCPAcceptError(std::strerror(errno));
+        }
+
+        if (!tune_accepted_socket(new_connection_fd, !socket_path.empty())) {
+            throw TCPAcceptError(std::strerror(errno));
+        }
+        return new_connection_fd;
+    }
+}
+
+std::vector<int> ConnectionAcceptor::accept_pending_connections(int flags) const {
+    std::vector<int> new_connection_fds;
+
+    while (new_connection_fds.empty()) {
+        if (!wait_for_connection(socket_fd, stop_fd)) {
+            break;
+        }
+
+        // Accept until there are no more pending connection requests.
+        while (true) {
+            int new_connection_fd = accept4(socket_fd, nullptr, nullptr, flags | SOCK_CLOEXEC);
+            if (new_connection_fd == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK || !new_connection_fds.empty()) {
+                    // Errors are reported once the accepted connections are handed over.
+                    break;
+                }
+                throw TCPAcceptError(std::strerror(errno));
+            }
+
+            if (!tune_accepted_socket(new_connection_fd, !socket_path.empty())) {
+                std::cerr << std::strerror(errno) << '\n';
+                continue;
+            }
+            new_connection_fds.push_back(new_connection_fd);
+        }
+    }
+
+    return new_connection_fds;
+}
+
+void ConnectionAcceptor::stop() {
+    uint64_t value = 1;
+    if (write(stop_fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
         throw TCPAcceptError(std::strerror(errno));
     }
+}
 
-    // Disable Nagle's algorithm.
-    int err;
-    int flag = 1;
-    err = setsockopt(new_connection_fd, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof(int));
-    if (err != 0) {
-        throw std::runtime_error(std::strerror(errno));
+void ConnectionAcceptor::resume() {
+    uint64_t value;
+    if (read(stop_fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+        throw TCPAcceptError(std::strerror(errno));
     }
+}
+
+int ConnectionAcceptor::get_socket_fd() const {
+    return socket_fd;
+}
 
-    return new_connection_fd;
+types::port_t ConnectionAcceptor::get_port() const {
+    struct sockaddr_in6 address{};
+    socklen_t address_len = sizeof(address);
+    if (getsockname(socket_fd, (struct sockaddr *) &address, &address_len) != 0) {
+        throw TCPAcceptError(std::strerror(errno));
+    }
+    return ntohs(address.sin6_port);
 }
 
 ConnectionAcceptor::~ConnectionAcceptor() {
-    if (close(socket_fd) == -1) {
+    if (close(socket_fd) == -1 || close(stop_fd) == -1) {
         std::cerr << std::strerror(errno) << std::endl;
         exit(EXIT_FAILURE);
     }
+    // Remove the socket file only if it is still the one of this socket, and not e.g. the file of
+    // another server bound to the path since.
+    struct stat file{};
+    if (socket_file_ino != 0 && lstat(socket_path.c_str(), &file) == 0 && S_ISSOCK(file.st_mode) &&
+        file.st_dev == socket_file_dev && file.st_ino == socket_file_ino) {
+        unlink(socket_path.c_str());
+    }
 }
\ No newline at end of file
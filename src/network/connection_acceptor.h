@@ -10,6 +10,9 @@
 #define CONNECTION_ACCEPTOR_H
 
 #include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/types.h>
 #include "../config/config.h"
 
 class TCPAcceptError : public std::runtime_error {
@@ -22,13 +25,70 @@ public:
     ConnectionAcceptor(types::port_t port, int backlog_size);
 
     /**
-     * @brief Accepts another TCP connection. Turns off Nagle's congestion algorithm.
+     * @brief Creates a listening socket which may share the port with other acceptors, so that the
+     * kernel spreads incoming connections among them.
+     *
+     * @param reuse_port Whether to bind the socket with SO_REUSEPORT.
+     * @param defer_accept Seconds for which a connection is not accepted until the client sends data.
+     * 0 disables TCP_DEFER_ACCEPT.
+     * @throw TCPAcceptError - Thrown when any network related system call fails.
+     */
+    ConnectionAcceptor(types::port_t port, int backlog_size, bool reuse_port, types::defer_accept_t defer_accept);
+
+    /**
+     * @brief Creates a listening Unix domain stream socket bound to the path, for clients running on
+     * the same host. A stale socket file left at the path is replaced and the file is removed when
+     * the acceptor is destroyed. The socket profile is not applied, its options concern IP traffic.
+     *
+     * @param socket_path Path of the socket file.
+     * @throw TCPAcceptError - Thrown when any network related system call fails, or when the path
+     * names a file which is not a socket.
+     */
+    ConnectionAcceptor(const std::string &socket_path, int backlog_size);
+
+    /**
+     * @brief Takes over a listening socket handed over by another server.
+     *
+     * @param socket_path Path of the socket file if it is a Unix domain socket, empty otherwise.
+     * @throw TCPAcceptError - Thrown when any network related system call fails.
+     */
+    ConnectionAcceptor(int socket_fd, const std::string &socket_path);
+
+    /**
+     * @brief Accepts another TCP connection. Applies the socket profile, which turns off Nagle's
+     * congestion algorithm.
      * 
      * @throw TCPAcceptError - Thrown when any network related system call fails.
      * @return int - File descriptor of the socket of the newly established TCP connection.
      */
     [[nodiscard]] int accept_another_connection() const;
 
+    /**
+     * @brief Waits for connection requests and accepts all the pending ones. Applies the socket
+     * profile, which turns off Nagle's congestion algorithm.
+     *
+     * @param flags Flags of the accepted sockets, e.g. SOCK_NONBLOCK.
+     * @throw TCPAcceptError - Thrown when no connection could be accepted.
+     * @return std::vector<int> - File descriptors of the sockets of the newly established TCP connections,
+     * empty if the acceptor was stopped.
+     */
+    [[nodiscard]] std::vector<int> accept_pending_connections(int flags) const;
+
+    /**
+     * @brief Makes accept_pending_connections return without accepting connections until resume
+     * is called. Thread-safe.
+     */
+    void stop();
+
+    void resume();
+
+    [[nodiscard]] int get_socket_fd() const;
+
+    /**
+     * @return types::port_t - Port the socket is bound to.
+     */
+    [[nodiscard]] types::port_t get_port() const;
+
     ~ConnectionAcceptor();
 
     /* Delete copy constructor and copy assignment. */
@@ -38,6 +98,13 @@ public:
 
 private:
     int socket_fd;
+    // Event file descriptor, readable while the acceptor is stopped.
+    int stop_fd;
+    // Path of the socket file, empty if the socket is a TCP one.
+    std::string socket_path;
+    // Identity of the socket file, removed by the destructor. Zero if there is none.
+    dev_t socket_file_dev = 0;
+    ino_t socket_file_ino = 0;
 };
 
 #endif // CONNECTION_ACCEPTOR_H
\ No newline at end of file
@@ -0,0 +1,162 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "handoff.h"
+
+namespace {
+    // Both servers run on the same host, so the header is sent in host byte order.
+    struct header_t {
+        uint64_t state_size;
+        uint32_t fds_count;
+    };
+
+    // Byte carrying a batch of file descriptors, or the confirmation.
+    const uint8_t MARKER = 1;
+}
+
+HandoffChannel::HandoffChannel(const std::string &socket_path) {
+    struct sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+        throw HandoffError("Invalid handoff socket path!");
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+
+    socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket_fd == -1) {
+        throw HandoffError(std::strerror(errno));
+    }
+    if (connect(socket_fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        close(socket_fd);
+        throw HandoffError(std::strerror(errno));
+    }
+}
+
+HandoffChannel::HandoffChannel(int socket_fd_) : socket_fd(socket_fd_) {}
+
+HandoffChannel::~HandoffChannel() {
+    close(socket_fd);
+}
+
+void HandoffChannel::send_all(std::span<const uint8_t> bytes) {
+    while (!bytes.empty()) {
+        ssize_t sent = send(socket_fd, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw HandoffError(std::strerror(errno));
+        }
+        bytes = bytes.subspan((size_t) sent);
+    }
+}
+
+void HandoffChannel::receive_all(std::span<uint8_t> bytes) {
+    while (!bytes.empty()) {
+        ssize_t received = recv(socket_fd, bytes.data(), bytes.size(), 0);
+        if (received == -1 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            throw HandoffError(received == 0 ? "Handoff channel closed!" : std::strerror(errno));
+        }
+        bytes = bytes.subspan((size_t) received);
+    }
+}
+
+void HandoffChannel::send_state(std::span<const uint8_t> state, const std::vector<int> &fds) {
+    header_t header{state.size(), (uint32_t) fds.size()};
+    send_all({(const uint8_t *) &header, sizeof(header)});
+
+    for (size_t first = 0; first < fds.size(); first += HANDOFF_MAX_FDS) {
+        size_t count = std::min<size_t>(fds.size() - first, HANDOFF_MAX_FDS);
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)]{};
+        uint8_t marker = MARKER;
+        struct iovec iov{&marker, sizeof(marker)};
+
+        struct msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        std::memcpy(CMSG_DATA(cmsg), fds.data() + first, sizeof(int) * count);
+
+        ssize_t sent;
+        while ((sent = sendmsg(socket_fd, &message, MSG_NOSIGNAL)) == -1 && errno == EINTR) {}
+        if (sent != 1) {
+            throw HandoffError(std::strerror(errno));
+        }
+    }
+
+    send_all(state);
+}
+
+std::pair<std::vector<uint8_t>, std::vector<int>> HandoffChannel::receive_state() {
+    header_t header{};
+    receive_all({(uint8_t *) &header, sizeof(header)});
+
+    std::vector<int> fds;
+    try {
+        while (fds.size() < header.fds_count) {
+            alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)]{};
+            uint8_t marker;
+            struct iovec iov{&marker, sizeof(marker)};
+
+            struct msghdr message{};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            ssize_t received;
+            while ((received = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR) {}
+            if (received != 1) {
+                throw HandoffError(received == 0 ? "Handoff channel closed!" : std::strerror(errno));
+            }
+
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    size_t offset = fds.size();
+                    fds.resize(offset + count);
+                    std::memcpy(fds.data() + offset, CMSG_DATA(cmsg), sizeof(int) * count);
+                }
+            }
+            if (message.msg_flags & MSG_CTRUNC) {
+                throw HandoffError("File descriptors lost during the handoff!");
+            }
+        }
+        if (fds.size() != header.fds_count) {
+            throw HandoffError("Unexpected file descriptors received during the handoff!");
+        }
+
+        std::vector<uint8_t> state(header.state_size);
+        receive_all(state);
+        return {std::move(state), std::move(fds)};
+    }
+    catch (const HandoffError &e) {
+        for (int fd: fds) {
+            close(fd);
+        }
+        throw;
+    }
+}
+
+void HandoffChannel::confirm() {
+    uint8_t marker = MARKER;
+    send_all({&marker, sizeof(marker)});
+}
+
+bool HandoffChannel::wait_for_confirmation() {
+    uint8_t marker;
+    ssize_t received;
+    while ((received = recv(socket_fd, &marker, sizeof(marker), 0)) == -1 && errno == EINTR) {}
+    return received == 1 && marker == MARKER;
+}
@@ -0,0 +1,91 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides the channel through which a running server hands its listening
+ * sockets, connections and game over to a newly started one, so that it can be upgraded without
+ * disconnecting the clients.
+ *
+ * The new server connects to the Unix domain socket on which the running server listens. The
+ * running server sends a header with the size of the state and the number of file descriptors,
+ * the descriptors in batches of at most HANDOFF_MAX_FDS (SCM_RIGHTS), each attached to a single
+ * byte, and finally the state. The new server confirms with a single byte once it has restored
+ * the state, after which the running server exits. Closing the channel without confirmation lets
+ * the running server resume.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <span>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cinttypes>
+#include "../config/config.h"
+
+class HandoffError : public std::runtime_error {
+public:
+    explicit HandoffError(const char *w) : std::runtime_error(w) {}
+};
+
+class HandoffChannel {
+public:
+    /**
+     * @brief Connects to the running server.
+     *
+     * @param socket_path Path of the Unix domain socket on which the running server listens.
+     * @throws HandoffError - Thrown when there is no server listening on the path.
+     */
+    explicit HandoffChannel(const std::string &socket_path);
+
+    /**
+     * @brief Takes over the connection accepted from the new server.
+     */
+    explicit HandoffChannel(int socket_fd);
+
+    ~HandoffChannel();
+
+    /**
+     * @brief Sends the serialized state together with the file descriptors, which stay open.
+     *
+     * @throws HandoffError.
+     */
+    void send_state(std::span<const uint8_t> state, const std::vector<int> &fds);
+
+    /**
+     * @brief Receives the state sent with send_state. The received file descriptors have
+     * FD_CLOEXEC set.
+     *
+     * @throws HandoffError.
+     */
+    std::pair<std::vector<uint8_t>, std::vector<int>> receive_state();
+
+    /**
+     * @brief Lets the running server know that the state was restored.
+     *
+     * @throws HandoffError.
+     */
+    void confirm();
+
+    /**
+     * @brief Waits until the new server confirms or closes the channel.
+     *
+     * @return bool True if the new server confirmed.
+     */
+    bool wait_for_confirmation();
+
+    // Delete copy constructor and copy assignment.
+    HandoffChannel(HandoffChannel const &) = delete;
+
+    void operator=(HandoffChannel const &) = delete;
+
+private:
+    int socket_fd;
+
+    void send_all(std::span<const uint8_t> bytes);
+
+    void receive_all(std::span<uint8_t> bytes);
+};
+
+#endif // HANDOFF_H
@@ -0,0 +1,280 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include "io_uring.h"
+#include "../config/config.h"
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+template<typename T>
+static T *ring_field(void *ring, uint32_t offset) {
+    return (T *) ((uint8_t *) ring + offset);
+}
+
+IoUring::IoUring(unsigned entries) : fixed_buff(nullptr), fixed_buff_size(0) {
+    struct io_uring_params params{};
+    ring_fd = io_uring_setup(entries, &params);
+    if (ring_fd < 0) {
+        throw IoUringError(std::strerror(errno));
+    }
+    sq_entries = params.sq_entries;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        // Both rings are mapped with a single call.
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                   IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        close(ring_fd);
+        throw IoUringError(std::strerror(errno));
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            munmap(sq_ring, sq_ring_size);
+            close(ring_fd);
+            throw IoUringError(std::strerror(errno));
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = (struct io_uring_sqe *) mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                        ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        munmap(sq_ring, sq_ring_size);
+        close(ring_fd);
+        throw IoUringError(std::strerror(errno));
+    }
+
+    sq_tail = ring_field<unsigned>(sq_ring, params.sq_off.tail);
+    sq_mask = ring_field<unsigned>(sq_ring, params.sq_off.ring_mask);
+    sq_array = ring_field<unsigned>(sq_ring, params.sq_off.array);
+    cq_head = ring_field<unsigned>(cq_ring, params.cq_off.head);
+    cq_tail = ring_field<unsigned>(cq_ring, params.cq_off.tail);
+    cq_mask = ring_field<unsigned>(cq_ring, params.cq_off.ring_mask);
+    cqes = ring_field<struct io_uring_cqe>(cq_ring, params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    munmap(sqes, sqes_size);
+    if (cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    munmap(sq_ring, sq_ring_size);
+    close(ring_fd);
+}
+
+bool IoUring::register_buffer(uint8_t *buff, size_t n) {
+    unregister_buffer();
+
+    struct iovec iov{};
+    iov.iov_base = buff;
+    iov.iov_len = n;
+    if (io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) != 0) {
+        return false;
+    }
+    fixed_buff = buff;
+    fixed_buff_size = n;
+    return true;
+}
+
+void IoUring::unregister_buffer() {
+    if (fixed_buff != nullptr) {
+        io_uring_register(ring_fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        fixed_buff = nullptr;
+        fixed_buff_size = 0;
+    }
+}
+
+struct io_uring_sqe *IoUring::next_sqe(unsigned index) {
+    // Only this thread produces entries, so the tail can be read without synchronization.
+    unsigned tail = *sq_tail + index;
+    unsigned slot = tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqes[slot];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = index;
+    sq_array[slot] = slot;
+    return sqe;
+}
+
+void IoUring::submit_and_wait(unsigned n, int *results) {
+    // Publish the prepared entries to the kernel.
+    __atomic_store_n(sq_tail, *sq_tail + n, __ATOMIC_RELEASE);
+
+    unsigned to_submit = n;
+    unsigned completed = 0;
+    while (completed < n) {
+        int err = io_uring_enter(ring_fd, to_submit, n - completed, IORING_ENTER_GETEVENTS);
+        if (err < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw IoUringError(std::strerror(errno));
+        }
+        to_submit -= std::min(to_submit, (unsigned) err);
+
+        // Reap available completions.
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+            results[cqe->user_data] = cqe->res;
+            head++;
+            completed++;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+// Converts the result of a completed request to the convention of the socket system calls.
+static ssize_t request_result(int res) {
+    if (res < 0) {
+        errno = -res;
+        return -1;
+    }
+    return res;
+}
+
+ssize_t IoUring::read_fixed(int fd, uint8_t *buff, size_t n) {
+    if (buff < fixed_buff || buff + n > fixed_buff + fixed_buff_size) {
+        // The buffer is not registered.
+        return recv(fd, buff, n, 0);
+    }
+
+    struct io_uring_sqe *sqe = next_sqe(0);
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) buff;
+    sqe->len = (uint32_t) n;
+    sqe->buf_index = 0;
+
+    int res;
+    submit_and_wait(1, &res);
+    return request_result(res);
+}
+
+ssize_t IoUring::recv(int fd, void *buff, size_t n, int flags) {
+    struct io_uring_sqe *sqe = next_sqe(0);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) buff;
+    sqe->len = (uint32_t) n;
+    sqe->msg_flags = (uint32_t) flags;
+
+    int res;
+    submit_and_wait(1, &res);
+    return request_result(res);
+}
+
+ssize_t IoUring::send_chunks(int fd, std::span<const std::span<const uint8_t>> chunks, int flags) {
+    ssize_t total = 0;
+    int results[IO_URING_ENTRIES];
+
+    while (!chunks.empty()) {
+        unsigned n = (unsigned) std::min<size_t>(chunks.size(), std::min<unsigned>(sq_entries, IO_URING_ENTRIES));
+        for (unsigned i = 0; i < n; i++) {
+            struct io_uring_sqe *sqe = next_sqe(i);
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t) chunks[i].data();
+            sqe->len = (uint32_t) chunks[i].size();
+            // Let the kernel retry short sends, so that the chunks are sent completely and in order.
+            int chunk_flags = flags | MSG_WAITALL;
+            if (i + 1 < chunks.size()) {
+                chunk_flags |= MSG_MORE;
+            }
+            sqe->msg_flags = (uint32_t) chunk_flags;
+            if (i + 1 < n) {
+                sqe->flags = IOSQE_IO_LINK;
+            }
+        }
+        submit_and_wait(n, results);
+
+        unsigned completed = n;
+        for (unsigned i = 0; i < completed; i++) {
+            if (results[i] < 0) {
+                return request_result(results[i]);
+            }
+            total += results[i];
+            if ((size_t) results[i] == chunks[i].size()) {
+                continue;
+            }
+
+            // A short send fails the link, so the later chunks were cancelled. If any of them was
+            // sent anyway, there is a gap in the stream.
+            for (unsigned j = i + 1; j < n; j++) {
+                if (results[j] != -ECANCELED) {
+                    errno = EIO;
+                    return -1;
+                }
+            }
+            if (results[i] == 0) {
+                // The socket does not take any more bytes.
+                errno = EPIPE;
+                return -1;
+            }
+            // Send the rest of the chunk before the later ones.
+            std::span<const uint8_t> rest = chunks[i].subspan((size_t) results[i]);
+            ssize_t rest_sent = send_chunks(fd, {&rest, 1}, i + 1 < chunks.size() ? flags | MSG_MORE : flags);
+            if (rest_sent < 0) {
+                return rest_sent;
+            }
+            total += rest_sent;
+            completed = i + 1;
+        }
+        chunks = chunks.subspan(completed);
+    }
+    return total;
+}
+
+int IoUring::send_messages(int fd, std::span<struct mmsghdr> msgs, int flags) {
+    int results[IO_URING_ENTRIES];
+    unsigned n = (unsigned) std::min<size_t>(msgs.size(), std::min<unsigned>(sq_entries, IO_URING_ENTRIES));
+    for (unsigned i = 0; i < n; i++) {
+        struct io_uring_sqe *sqe = next_sqe(i);
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t) &msgs[i].msg_hdr;
+        sqe->len = 1;
+        sqe->msg_flags = (uint32_t) flags;
+        if (i + 1 < n) {
+            // Keep the datagrams to a destination in order.
+            sqe->flags = IOSQE_IO_LINK;
+        }
+    }
+    submit_and_wait(n, results);
+
+    for (unsigned i = 0; i < n; i++) {
+        if (results[i] < 0) {
+            return i == 0 ? (int) request_result(results[i]) : (int) i;
+        }
+        msgs[i].msg_len = (unsigned) results[i];
+    }
+    return (int) n;
+}
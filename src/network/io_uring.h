@@ -0,0 +1,125 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides a minimal wrapper of Linux io_uring, set up with raw system calls.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <cinttypes>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+class IoUringError : public std::runtime_error {
+public:
+    explicit IoUringError(const char *w) : std::runtime_error(w) {}
+};
+
+/**
+ * @brief Submission and completion queues of a single io_uring instance. Operations are blocking:
+ * requests belonging to one operation are submitted and waited for with a single io_uring_enter call.
+ * An instance must not be used by many threads at the same time.
+ *
+ * All operations return the number of transferred bytes or -1 with errno set, just like the
+ * corresponding socket system calls.
+ */
+class IoUring {
+public:
+    /**
+     * @brief Sets up a new io_uring instance.
+     *
+     * @param entries Size of the submission queue.
+     * @throws IoUringError - Thrown when io_uring is not supported or not permitted.
+     */
+    explicit IoUring(unsigned entries);
+
+    ~IoUring();
+
+    /**
+     * @brief Registers the buffer as the fixed buffer of the instance, so that the kernel does not
+     * have to map its pages on every operation. Replaces the previously registered buffer.
+     *
+     * @return bool True if the buffer was registered.
+     */
+    bool register_buffer(uint8_t *buff, size_t n);
+
+    /**
+     * @brief Unregisters the fixed buffer, so that its memory can be reused.
+     */
+    void unregister_buffer();
+
+    /**
+     * @brief Receives bytes into the registered buffer. Falls back to an ordinary receive if the
+     * given memory is not inside the registered buffer.
+     */
+    ssize_t read_fixed(int fd, uint8_t *buff, size_t n);
+
+    ssize_t recv(int fd, void *buff, size_t n, int flags);
+
+    /**
+     * @brief Sends all the chunks, in order, with requests linked together and submitted at once.
+     * Stream sockets send every chunk completely, retrying short sends inside the kernel. A short
+     * send which gets through anyway cancels the rest of the link, which is sent again after the
+     * remaining bytes of its chunk.
+     *
+     * @return ssize_t Number of bytes sent, or -1 with errno set. EIO means that a chunk after a short
+     * send was sent anyway, leaving a gap in the stream.
+     */
+    ssize_t send_chunks(int fd, std::span<const std::span<const uint8_t>> chunks, int flags);
+
+    /**
+     * @brief Sends the datagrams in order like sendmmsg, with requests linked together and
+     * submitted at once. A failed send cancels the later ones, at most the size of the submission
+     * queue is sent per call.
+     *
+     * @return int Number of sent datagrams, or -1 with errno set if none was sent.
+     */
+    int send_messages(int fd, std::span<struct mmsghdr> msgs, int flags);
+
+    /* Delete copy constructor and copy assignment. */
+    IoUring(IoUring const &) = delete;
+
+    void operator=(IoUring const &) = delete;
+
+private:
+    int ring_fd;
+    unsigned sq_entries;
+
+    // Memory shared with the kernel.
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    // Pointers into the shared rings.
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    uint8_t *fixed_buff;
+    size_t fixed_buff_size;
+
+    // Returns a cleared submission queue entry, the caller fills it in.
+    struct io_uring_sqe *next_sqe(unsigned index);
+
+    /**
+     * @brief Submits n prepared entries and waits for all of their completions.
+     *
+     * @param results Array of n results, filled in submission order.
+     */
+    void submit_and_wait(unsigned n, int *results);
+};
+
+#endif // IO_URING_H
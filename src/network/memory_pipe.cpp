@@ -0,0 +1,76 @@
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include "memory_pipe.h"
+
+MemoryPipe::MemoryPipe(size_t capacity) : ring(capacity), head(0), size(0), closed(false) {}
+
+std::pair<MemoryPipe::endpoint_t, MemoryPipe::endpoint_t> MemoryPipe::create_connection(size_t capacity) {
+    ptr to_server = std::make_shared<MemoryPipe>(capacity);
+    ptr to_client = std::make_shared<MemoryPipe>(capacity);
+    return {{to_client, to_server}, {to_server, to_client}};
+}
+
+ssize_t MemoryPipe::read(uint8_t *buff, size_t n, bool wait) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wait) {
+        readable.wait(lock, [this] { return size > 0 || closed; });
+    }
+    if (size == 0) {
+        if (closed) {
+            return 0;
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+
+    // The bytes may wrap around the end of the ring.
+    n = std::min(n, size);
+    size_t first = std::min(n, ring.size() - head);
+    std::memcpy(buff, ring.data() + head, first);
+    std::memcpy(buff + first, ring.data(), n - first);
+    head = (head + n) % ring.size();
+    size -= n;
+    writable.notify_all();
+    return (ssize_t) n;
+}
+
+ssize_t MemoryPipe::write(std::span<const std::span<const uint8_t>> chunks, bool wait) {
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto &chunk: chunks) {
+        size_t offset = 0;
+        while (offset < chunk.size()) {
+            if (wait) {
+                writable.wait(lock, [this] { return size < ring.size() || closed; });
+            }
+            if (closed) {
+                errno = EPIPE;
+                return -1;
+            }
+            if (size == ring.size()) {
+                if (total > 0) {
+                    return (ssize_t) total;
+                }
+                errno = EAGAIN;
+                return -1;
+            }
+
+            size_t tail = (head + size) % ring.size();
+            size_t n = std::min({chunk.size() - offset, ring.size() - size, ring.size() - tail});
+            std::memcpy(ring.data() + tail, chunk.data() + offset, n);
+            size += n;
+            offset += n;
+            total += n;
+            readable.notify_all();
+        }
+    }
+    return (ssize_t) total;
+}
+
+void MemoryPipe::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    readable.notify_all();
+    writable.notify_all();
+}
@@ -0,0 +1,91 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides in-process byte streams used instead of sockets, so that the
+ * message managers and the codec can be run and measured without the network stack.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef MEMORY_PIPE_H
+#define MEMORY_PIPE_H
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <span>
+#include <vector>
+#include <utility>
+#include <cinttypes>
+#include <sys/types.h>
+#include "../config/config.h"
+
+/**
+ * @brief Bounded byte stream in one direction, with the semantics of a stream socket: reads
+ * return as many bytes as are available, waiting for some if there are none, and writes wait for
+ * free space. Both may be made non-blocking, in which case they fail with EAGAIN.
+ */
+class MemoryPipe {
+public:
+    using ptr = std::shared_ptr<MemoryPipe>;
+
+    /**
+     * @brief Both directions of a connection, as seen by one of its ends.
+     */
+    struct endpoint_t {
+        // Bytes sent by the peer.
+        ptr in;
+        // Bytes sent to the peer.
+        ptr out;
+    };
+
+    explicit MemoryPipe(size_t capacity);
+
+    /**
+     * @brief Creates a connection made of two pipes.
+     *
+     * @return std::pair<endpoint_t, endpoint_t> Its ends, e.g. of the client and of the server.
+     */
+    static std::pair<endpoint_t, endpoint_t> create_connection(size_t capacity = MEMORY_PIPE_SIZE);
+
+    /**
+     * @brief Reads at most n bytes.
+     *
+     * @param wait Whether to wait for bytes if there are none.
+     * @return ssize_t Number of read bytes, 0 if the pipe is closed and empty, or -1 with errno
+     * set to EAGAIN.
+     */
+    ssize_t read(uint8_t *buff, size_t n, bool wait);
+
+    /**
+     * @brief Writes the chunks in order.
+     *
+     * @param wait Whether to wait for free space until all the bytes are written. Otherwise only
+     * the bytes which fit are written.
+     * @return ssize_t Number of written bytes or -1 with errno set to EAGAIN, or to EPIPE if the
+     * pipe is closed.
+     */
+    ssize_t write(std::span<const std::span<const uint8_t>> chunks, bool wait);
+
+    /**
+     * @brief Closes the pipe. The reader gets the remaining bytes and then the end of the stream,
+     * writes fail. Waiting readers and writers are woken up.
+     */
+    void close();
+
+    // Delete copy constructor and copy assignment.
+    MemoryPipe(MemoryPipe const &) = delete;
+
+    void operator=(MemoryPipe const &) = delete;
+
+private:
+    std::mutex mutex;
+    std::condition_variable readable;
+    std::condition_variable writable;
+    // Bytes are stored in ring[head, head + size), modulo the capacity.
+    std::vector<uint8_t> ring;
+    size_t head;
+    size_t size;
+    bool closed;
+};
+
+#endif // MEMORY_PIPE_H
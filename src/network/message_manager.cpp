@@ -1,41 +1,163 @@
+#include <poll.h>
+#include <atomic>
+#include <cerrno>
 #include "message_manager.h"
 
 ClientMessageManager::ClientMessageManager(TCPHandler &tcp_handler_, UDPHandler &udp_handler_) :
-        tcp_handler(tcp_handler_), udp_handler(udp_handler_) {}
+        tcp_handler(tcp_handler_), gui_handler(&udp_handler_), turn_channel(nullptr), game_length(0), game_started(false) {}
+
+ClientMessageManager::ClientMessageManager(TCPHandler &tcp_handler_, SharedMemoryGuiHandler &shm_handler_) :
+        tcp_handler(tcp_handler_), gui_handler(&shm_handler_), turn_channel(nullptr), game_length(0), game_started(false) {}
+
+void ClientMessageManager::set_turn_channel(TurnChannelClient &turn_channel_) {
+    turn_channel = &turn_channel_;
+}
 
 ServerMessage ClientMessageManager::read_server_message() {
-    auto message_id = tcp_handler.read_element<types::message_id_t>();
+    if (turn_channel == nullptr) {
+        return read_tcp_server_message();
+    }
+
+    while (true) {
+        // Datagrams may overtake GameStarted.
+        if (game_started && turn_channel->has_next_turn()) {
+            return turn_channel->take_next_turn();
+        }
+        if (game_ended && turn_channel->get_next_turn() > game_length) {
+            ServerMessage message = std::move(*game_ended);
+            game_ended.reset();
+            game_started = false;
+            turn_channel->end_game();
+            return message;
+        }
+
+        // Messages after GameEnded wait until the rest of the turns is received over UDP.
+        bool tcp_ready = wait_for_server_messages(!game_ended);
+        turn_channel->receive_datagrams();
+        if (!tcp_ready) {
+            continue;
+        }
+
+        ServerMessage message = read_tcp_server_message();
+        if (std::holds_alternative<Hello>(message)) {
+            game_length = std::get<Hello>(message).game_length;
+            return message;
+        } else if (std::holds_alternative<GameStarted>(message)) {
+            game_started = true;
+            return message;
+        } else if (std::holds_alternative<Turn>(message)) {
+            // Turns which do not fit into a datagram, or sent before the subscription.
+            turn_channel->accept_turn(std::move(std::get<Turn>(message)));
+        } else if (std::holds_alternative<GameEnded>(message)) {
+            game_ended = std::move(message);
+        } else {
+            return message;
+        }
+    }
+}
+
+bool ClientMessageManager::wait_for_server_messages(bool include_tcp) {
+    if (include_tcp && tcp_handler.get_buffered_bytes_count() > 0) {
+        return true;
+    }
+    // Negative descriptors are ignored by poll.
+    struct pollfd fds[] = {{include_tcp ? tcp_handler.get_socket_fd() : -1, POLLIN, 0},
+                           {turn_channel->get_socket_fd(), POLLIN, 0}};
+    if (poll(fds, 2, -1) == -1) {
+        if (errno == EINTR) {
+            return false;
+        }
+        throw std::runtime_error(std::strerror(errno));
+    }
+    return fds[0].revents != 0;
+}
+
+ServerMessage ClientMessageManager::read_tcp_server_message() {
+    return decode_server_message(tcp_handler);
+}
+
+template<InputStream Stream>
+ServerMessage ClientMessageManager::decode_server_message(Stream &handler) {
+    auto message_id = handler.template read_element<types::message_id_t>();
 
     switch (message_id) {
         case clientServerCodes::hello:
-            return Hello(tcp_handler);
+            return Hello(handler);
 
         case clientServerCodes::acceptedPlayer:
-            return AcceptedPlayer(tcp_handler);
+            return AcceptedPlayer(handler);
 
         case clientServerCodes::gameStarted:
-            return GameStarted(tcp_handler);
+            return GameStarted(handler);
 
         case clientServerCodes::turn:
-            return Turn(tcp_handler);
+            return Turn(handler);
 
         case clientServerCodes::gameEnded:
-            return GameEnded(tcp_handler);
+            return GameEnded(handler);
 
         default:
             throw std::runtime_error("Unknown message received from the server!");
     }
 }
 
+template ServerMessage ClientMessageManager::decode_server_message<TCPHandler>(TCPHandler &);
+
+template ServerMessage ClientMessageManager::decode_server_message<MessageDecoder>(MessageDecoder &);
+
+// Views the body of a message, returning the status if it cannot be viewed.
+template<typename View, typename MessageView>
+static StreamResult<MessageView> try_view_body(MessageDecoder &decoder) {
+    View view;
+    StreamStatus status = view_message(decoder, view);
+    if (status != StreamStatus::Ok) {
+        return status;
+    }
+    return MessageView(view);
+}
+
+StreamResult<ServerMessageView> ClientMessageManager::try_view_server_message(MessageDecoder &decoder) {
+    types::message_id_t message_id;
+    if (!decoder.try_read_element(message_id)) {
+        return StreamStatus::Incomplete;
+    }
+
+    switch (message_id) {
+        case clientServerCodes::hello:
+            return try_view_body<HelloView, ServerMessageView>(decoder);
+
+        case clientServerCodes::acceptedPlayer:
+            return try_view_body<AcceptedPlayerView, ServerMessageView>(decoder);
+
+        case clientServerCodes::gameStarted:
+            return try_view_body<GameStartedView, ServerMessageView>(decoder);
+
+        case clientServerCodes::turn:
+            return try_view_body<TurnView, ServerMessageView>(decoder);
+
+        case clientServerCodes::gameEnded:
+            return try_view_body<GameEndedView, ServerMessageView>(decoder);
+
+        default:
+            // Unknown message received from the server.
+            return StreamStatus::Invalid;
+    }
+}
+
 InputMessage ClientMessageManager::read_gui_message() {
-    // Read another incoming UDP packet.
-    size_t packet_size = udp_handler.read_incoming_packet();
+    return std::visit([](auto *handler) { return read_gui_message(*handler); }, gui_handler);
+}
+
+template<typename PacketStream>
+InputMessage ClientMessageManager::read_gui_message(PacketStream &handler) {
+    // Read another incoming packet.
+    size_t packet_size = handler.read_incoming_packet();
     if (packet_size == 0) {
-        // Treat empty UDP packet as an invalid message.
+        // Treat empty packet as an invalid message.
         return InvalidMessage();
     }
 
-    auto message_id = udp_handler.read_next_packet_element<types::message_id_t>();
+    auto message_id = handler.template read_next_packet_element<types::message_id_t>();
 
     switch (message_id) {
         case clientGuiCodes::placeBomb:
@@ -46,7 +168,7 @@ InputMessage ClientMessageManager::read_gui_message() {
             break;
         case clientGuiCodes::move:
             if (packet_size == 1 + sizeof(Move)) {
-                auto d_val = udp_handler.read_next_packet_element<u_int8_t>();
+                auto d_val = handler.template read_next_packet_element<u_int8_t>();
                 if (d_val < 4) {
                     auto direction = static_cast<Direction>(d_val);
                     return Move(direction);
@@ -56,92 +178,274 @@ InputMessage ClientMessageManager::read_gui_message() {
     return InvalidMessage();
 }
 
+std::vector<InputMessage> ClientMessageManager::read_gui_messages() {
+    std::vector<InputMessage> messages;
+    do {
+        messages.push_back(read_gui_message());
+    } while (std::visit([](auto *handler) { return handler->has_received_packets(); }, gui_handler));
+    return messages;
+}
+
+bool ClientMessageManager::has_buffered_server_messages() const {
+    if (turn_channel != nullptr && ((game_started && turn_channel->has_next_turn()) ||
+                                    (game_ended && turn_channel->get_next_turn() > game_length))) {
+        return true;
+    }
+    return tcp_handler.get_buffered_bytes_count() > 0;
+}
+
 void ClientMessageManager::send_server_message(const Join &message) {
     tcp_handler.send_element<types::message_id_t>(serverClientCodes::join);
     message.serialize(tcp_handler);
+    tcp_handler.flush_outcoming_message();
 }
 
 void ClientMessageManager::send_server_message(const PlaceBomb &) {
     tcp_handler.send_element<types::message_id_t>(serverClientCodes::placeBomb);
+    tcp_handler.flush_outcoming_message();
 }
 
 void ClientMessageManager::send_server_message(const PlaceBlock &) {
     tcp_handler.send_element<types::message_id_t>(serverClientCodes::placeBlock);
+    tcp_handler.flush_outcoming_message();
 }
 
 void ClientMessageManager::send_server_message(const Move &message) {
     tcp_handler.send_element<types::message_id_t>(serverClientCodes::move);
     message.serialize(tcp_handler);
+    tcp_handler.flush_outcoming_message();
+}
+
+void ClientMessageManager::send_server_message(const SubscribeTurns &message) {
+    tcp_handler.send_element<types::message_id_t>(serverClientCodes::subscribeTurns);
+    message.serialize(tcp_handler);
+    tcp_handler.flush_outcoming_message();
 }
 
 // Ignore.
 void ClientMessageManager::send_server_message(const InvalidMessage &) {};
 
-// Over UDP.
+// Codes of the messages sent to the server are the indices of their alternatives.
+static_assert(std::is_same_v<std::variant_alternative_t<serverClientCodes::move, ClientMessage>, Move>);
+
+MessageEncoder::message_t ClientMessageManager::encode_server_message(const ClientMessage &message) {
+    MessageEncoder encoder;
+    encoder.send_element<types::message_id_t>((types::message_id_t) message.index());
+    std::visit([&encoder](const auto &alternative) {
+        if constexpr (requires { alternative.serialize(encoder); }) {
+            alternative.serialize(encoder);
+        }
+    }, message);
+    return encoder.get_encoded_message();
+}
+
+// Over UDP or shared memory.
 void ClientMessageManager::send_gui_message(LobbyMessage &&message) {
-    udp_handler.append_to_outcoming_packet<types::message_id_t>(guiClientCodes::lobby);
-    message.serialize(udp_handler);
+    std::visit([&message](auto *handler) {
+        handler->template append_to_outcoming_packet<types::message_id_t>(guiClientCodes::lobby);
+        message.serialize_packet(*handler);
 
-    // Send the packet.
-    udp_handler.flush_outcoming_packet();
+        // Send the packet.
+        handler->flush_outcoming_packet();
+    }, gui_handler);
+}
+
+void ClientMessageManager::queue_gui_message(LobbyMessage &&message) {
+    std::visit([&message](auto *handler) {
+        handler->template append_to_outcoming_packet<types::message_id_t>(guiClientCodes::lobby);
+        message.serialize_packet(*handler);
+        handler->queue_outcoming_packet();
+    }, gui_handler);
+}
+
+void ClientMessageManager::queue_gui_message(GameMessage &&message) {
+    std::visit([&message](auto *handler) {
+        handler->template append_to_outcoming_packet<types::message_id_t>(guiClientCodes::game);
+        message.serialize_packet(*handler);
+        handler->queue_outcoming_packet();
+    }, gui_handler);
 }
 
 void ClientMessageManager::send_gui_message(GameMessage &&message) {
-    udp_handler.append_to_outcoming_packet<types::message_id_t>(guiClientCodes::game);
-    message.serialize(udp_handler);
+    std::visit([&message](auto *handler) {
+        handler->template append_to_outcoming_packet<types::message_id_t>(guiClientCodes::game);
+        message.serialize_packet(*handler);
+
+        // Send the packet.
+        handler->flush_outcoming_packet();
+    }, gui_handler);
+}
 
-    // Send the packet.
-    udp_handler.flush_outcoming_packet();
+TrafficCapture::ptr ServerMessageManager::traffic_capture;
+
+ServerMessageManager::ServerMessageManager(TCPHandler::ptr &tcp_handler_) : tcp_handler(tcp_handler_) {
+    static std::atomic<uint32_t> connections_count = 0;
+    connection_id = connections_count++;
 }
 
-ServerMessageManager::ServerMessageManager(TCPHandler::ptr &tcp_handler_) : tcp_handler(tcp_handler_) {}
+void ServerMessageManager::set_traffic_capture(TrafficCapture::ptr capture) {
+    traffic_capture = std::move(capture);
+}
 
 ClientMessage ServerMessageManager::read_client_message() {
-    auto message_id = tcp_handler->read_element<types::message_id_t>();
+    StreamResult<ClientMessage> message = try_read_client_message();
+    return std::move(message.value());
+}
+
+StreamResult<ClientMessage> ServerMessageManager::try_read_client_message() {
+    // Messages of the clients are short, each one is decoded once all of its bytes are received.
+    size_t needed = 1;
+    while (true) {
+        StreamStatus status = tcp_handler->try_wait_for_bytes(needed);
+        if (status != StreamStatus::Ok) {
+            return {status, errno};
+        }
+        StreamResult<ClientMessage> message = try_decode_buffered_client_message();
+        if (message.status() != StreamStatus::Incomplete) {
+            return message;
+        }
+        needed = tcp_handler->get_buffered_bytes_count() + 1;
+    }
+}
+
+StreamResult<ClientMessage> ServerMessageManager::try_decode_buffered_client_message() {
+    std::span<const uint8_t> bytes = tcp_handler->get_buffered_bytes();
+    MessageDecoder decoder(bytes);
+    StreamResult<ClientMessage> message = try_decode_client_message(decoder);
+    if (message) {
+        size_t size = bytes.size() - decoder.get_remaining_bytes_count();
+        if (traffic_capture) {
+            // The capture holds the message as sent by the client.
+            traffic_capture->record(connection_id, bytes.first(size));
+        }
+        tcp_handler->consume_buffered_bytes(size);
+    }
+    return message;
+}
+
+ClientMessage ServerMessageManager::decode_client_message(MessageDecoder &decoder) {
+    StreamResult<ClientMessage> message = try_decode_client_message(decoder);
+    return std::move(message.value());
+}
+
+// Decodes the body of a message into a new ClientMessage, returning Incomplete if it is cut short.
+template<typename Message>
+static StreamResult<ClientMessage> try_decode_body(MessageDecoder &decoder) {
+    Message message;
+    if (!Message::try_decode(decoder, message)) {
+        return StreamStatus::Incomplete;
+    }
+    return ClientMessage(std::move(message));
+}
+
+StreamResult<ClientMessage> ServerMessageManager::try_decode_client_message(MessageDecoder &decoder) {
+    types::message_id_t message_id;
+    if (!decoder.try_read_element(message_id)) {
+        return StreamStatus::Incomplete;
+    }
+
+    switch (message_id) {
+        case serverClientCodes::join:
+            return try_decode_body<Join>(decoder);
+
+        case serverClientCodes::placeBomb:
+            return ClientMessage(PlaceBomb());
+
+        case serverClientCodes::placeBlock:
+            return ClientMessage(PlaceBlock());
+
+        case serverClientCodes::move:
+            return try_decode_body<Move>(decoder);
+
+        case serverClientCodes::subscribeTurns:
+            return try_decode_body<SubscribeTurns>(decoder);
+
+        default:
+            // Unknown message received from the client.
+            return StreamStatus::Invalid;
+    }
+}
+
+// Decodes the body of a message without strings into a new ClientMessageView.
+template<typename Message>
+static StreamResult<ClientMessageView> try_decode_view_body(MessageDecoder &decoder) {
+    Message message;
+    if (!Message::try_decode(decoder, message)) {
+        return StreamStatus::Incomplete;
+    }
+    return ClientMessageView(message);
+}
+
+StreamResult<ClientMessageView> ServerMessageManager::try_view_client_message(MessageDecoder &decoder) {
+    types::message_id_t message_id;
+    if (!decoder.try_read_element(message_id)) {
+        return StreamStatus::Incomplete;
+    }
 
     switch (message_id) {
         case serverClientCodes::join:
-            return Join(*tcp_handler);
+            return try_view_body<JoinView, ClientMessageView>(decoder);
 
         case serverClientCodes::placeBomb:
-            return PlaceBomb();
+            return ClientMessageView(PlaceBomb());
 
         case serverClientCodes::placeBlock:
-            return PlaceBlock();
+            return ClientMessageView(PlaceBlock());
 
         case serverClientCodes::move:
-            return Move(*tcp_handler);
+            return try_decode_view_body<Move>(decoder);
+
+        case serverClientCodes::subscribeTurns:
+            return try_decode_view_body<SubscribeTurns>(decoder);
 
         default:
-            throw std::runtime_error("Unknown message received from the client!");
+            // Unknown message received from the client.
+            return StreamStatus::Invalid;
     }
 }
 
 void ServerMessageManager::send_client_message(const Hello &message) {
     tcp_handler->send_element<types::message_id_t>(clientServerCodes::hello);
     message.serialize(*tcp_handler);
+    tcp_handler->flush_outcoming_message();
 }
 
 void ServerMessageManager::send_client_message(const AcceptedPlayer &message) {
     tcp_handler->send_element<types::message_id_t>(clientServerCodes::acceptedPlayer);
     message.serialize(*tcp_handler);
+    tcp_handler->flush_outcoming_message();
 }
 
 void ServerMessageManager::send_client_message(const GameStarted &message) {
     tcp_handler->send_element<types::message_id_t>(clientServerCodes::gameStarted);
     message.serialize(*tcp_handler);
+    tcp_handler->flush_outcoming_message();
 }
 
 void ServerMessageManager::send_client_message(const Turn &message) {
     tcp_handler->send_element<types::message_id_t>(clientServerCodes::turn);
     message.serialize(*tcp_handler);
+    tcp_handler->flush_outcoming_message();
 }
 
 void ServerMessageManager::send_client_message(const GameEnded &message) {
     tcp_handler->send_element<types::message_id_t>(clientServerCodes::gameEnded);
     message.serialize(*tcp_handler);
+    tcp_handler->flush_outcoming_message();
+}
+
+void ServerMessageManager::send_client_message(const MessageEncoder::message_t &message) {
+    tcp_handler->send_encoded_message(message);
 }
 
 std::string ServerMessageManager::get_client_name() const {
     return tcp_handler->get_peer_name();
+}
+
+bool ServerMessageManager::get_client_address(struct sockaddr_in6 &address) const {
+    return tcp_handler->get_peer_address(address);
+}
+
+void ServerMessageManager::disconnect_client() {
+    tcp_handler->disconnect();
 }
\ No newline at end of file
@@ -8,8 +8,14 @@
 #ifndef MESSAGE_MANAGER_H
 #define MESSAGE_MANAGER_H
 
+#include <variant>
+#include <optional>
 #include "network_handler.h"
+#include "shared_memory_handler.h"
+#include "turn_channel.h"
+#include "traffic_capture.h"
 #include "messages.h"
+#include "message_views.h"
 
 /**
  * @brief This class handles all communication between the client and the server as well as between
@@ -19,6 +25,17 @@ class ClientMessageManager {
 public:
     ClientMessageManager(TCPHandler &, UDPHandler &);
 
+    /**
+     * @brief Communicates with a gui running on the same host through shared memory instead of UDP.
+     */
+    ClientMessageManager(TCPHandler &, SharedMemoryGuiHandler &);
+
+    /**
+     * @brief Receives turns over UDP too. Turns are then read from both the channel and the TCP
+     * stream, in order and without duplicates.
+     */
+    void set_turn_channel(TurnChannelClient &);
+
     /**
      * @brief Reads another message from the server.
      *
@@ -26,6 +43,12 @@ public:
      */
     ServerMessage read_server_message();
 
+    /**
+     * @return bool True if bytes of another message from the server, or the next turn received
+     * over UDP, are already buffered.
+     */
+    [[nodiscard]] bool has_buffered_server_messages() const;
+
     /**
      * @brief Reads another message from the gui.
      * 
@@ -33,6 +56,13 @@ public:
      */
     InputMessage read_gui_message();
 
+    /**
+     * @brief Reads all the messages from the gui that are already queued, waiting for at least one.
+     *
+     * @return std::vector<InputMessage> - Messages from the gui, in order of arrival.
+     */
+    std::vector<InputMessage> read_gui_messages();
+
     /* Below there are overloaded methods used for sending various message types. */
     void send_server_message(const Join &);
 
@@ -42,12 +72,45 @@ public:
 
     void send_server_message(const Move &);
 
+    void send_server_message(const SubscribeTurns &);
+
     void send_server_message(const InvalidMessage &);
 
+    /**
+     * @brief Encodes a message sent to the server together with its code, as the methods above
+     * send it.
+     */
+    static MessageEncoder::message_t encode_server_message(const ClientMessage &);
+
+    /**
+     * @brief Decodes a message from the server together with its code.
+     *
+     * @param Stream TCPHandler or MessageDecoder, e.g. reading many connections in one event loop.
+     */
+    template<InputStream Stream>
+    static ServerMessage decode_server_message(Stream &);
+
+    /**
+     * @brief Views a message from the server together with its code, without copying it out of
+     * the bytes of the decoder and without exceptions, e.g. for relays which only inspect or
+     * forward the messages.
+     *
+     * @return StreamResult<ServerMessageView> - View of the message, Incomplete if the bytes end
+     * before the message does, or Invalid if a code is unknown.
+     */
+    static StreamResult<ServerMessageView> try_view_server_message(MessageDecoder &);
+
     void send_gui_message(LobbyMessage &&);
 
     void send_gui_message(GameMessage &&);
 
+    /**
+     * @brief Queues a message for the gui, so that it is sent together with the following ones.
+     */
+    void queue_gui_message(LobbyMessage &&);
+
+    void queue_gui_message(GameMessage &&);
+
     /* Delete copy constructor and copy assignment. */
     ClientMessageManager(ClientMessageManager const &) = delete;
 
@@ -55,7 +118,24 @@ public:
 
 private:
     TCPHandler &tcp_handler;
-    UDPHandler &udp_handler;
+    std::variant<UDPHandler *, SharedMemoryGuiHandler *> gui_handler;
+    // nullptr if turns are received over TCP only.
+    TurnChannelClient *turn_channel;
+    // GameEnded, held back until all the turns of the game are read.
+    std::optional<ServerMessage> game_ended;
+    // Taken from Hello.
+    types::game_length_t game_length;
+    // True between GameStarted and GameEnded.
+    bool game_started;
+
+    ServerMessage read_tcp_server_message();
+
+    // Waits until there are datagrams with turns, or bytes from the server if include_tcp, to be
+    // received. Returns true if there are bytes from the server.
+    bool wait_for_server_messages(bool include_tcp);
+
+    template<typename PacketStream>
+    static InputMessage read_gui_message(PacketStream &);
 };
 
 /**
@@ -71,9 +151,53 @@ public:
      * @brief Reads another message from the client.
      * 
      * @return ClientMessage - Message from the client.
+     * @throws TCPError, DecodeError.
      */
     ClientMessage read_client_message();
 
+    /**
+     * @brief Reads another message from the client like read_client_message, blocking until it
+     * is received, without exceptions.
+     *
+     * @return StreamResult<ClientMessage> - Message from the client, or Disconnected, Invalid,
+     * Failed, or Incomplete if called from try_decode_buffered.
+     */
+    StreamResult<ClientMessage> try_read_client_message();
+
+    /**
+     * @brief Decodes another message from the bytes already received from the client, without
+     * reading on the socket and without exceptions.
+     *
+     * @return StreamResult<ClientMessage> - Message from the client, Incomplete if the bytes do
+     * not hold all of it, or Invalid.
+     */
+    StreamResult<ClientMessage> try_decode_buffered_client_message();
+
+    /**
+     * @brief Decodes a message from the client together with its code, e.g. reading the moves
+     * carried over in a handoff.
+     *
+     * @throws DecodeError.
+     */
+    static ClientMessage decode_client_message(MessageDecoder &);
+
+    /**
+     * @brief Decodes a message from the client together with its code, without exceptions.
+     *
+     * @return StreamResult<ClientMessage> - Message from the client, Incomplete if the bytes end
+     * before the message does, or Invalid if its code is unknown.
+     */
+    static StreamResult<ClientMessage> try_decode_client_message(MessageDecoder &);
+
+    /**
+     * @brief Views a message from the client together with its code like
+     * try_decode_client_message, without copying the name of Join out of the bytes.
+     *
+     * @return StreamResult<ClientMessageView> - View of the message, Incomplete if the bytes end
+     * before the message does, or Invalid if its code is unknown.
+     */
+    static StreamResult<ClientMessageView> try_view_client_message(MessageDecoder &);
+
     /* Below there are overloaded methods used for sending various message types. */
     void send_client_message(const Hello &);
 
@@ -85,8 +209,31 @@ public:
 
     void send_client_message(const GameEnded &);
 
+    /**
+     * @brief Sends a message previously encoded with encode_client_message.
+     */
+    void send_client_message(const MessageEncoder::message_t &);
+
     [[nodiscard]] std::string get_client_name() const;
 
+    /**
+     * @return bool False if the client is not connected over IPv6 (IPv4 addresses are mapped).
+     */
+    bool get_client_address(struct sockaddr_in6 &) const;
+
+    /**
+     * @brief Ends the connection with the client, its pending reads and sends fail.
+     */
+    void disconnect_client();
+
+    /**
+     * @brief Records the messages read by all the managers created afterwards, each manager being
+     * a separate connection. Not thread-safe, meant to be called before any connection is accepted.
+     *
+     * @param capture nullptr stops capturing.
+     */
+    static void set_traffic_capture(TrafficCapture::ptr capture);
+
     /* Delete copy constructor and copy assignment. */
     ServerMessageManager(ServerMessageManager const &) = delete;
 
@@ -94,6 +241,9 @@ public:
 
 private:
     TCPHandler::ptr tcp_handler;
+    uint32_t connection_id;
+
+    static TrafficCapture::ptr traffic_capture;
 };
 
 #endif // MESSAGE_MANAGER_H
\ No newline at end of file
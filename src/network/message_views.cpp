@@ -0,0 +1,11 @@
+#include "message_views.h"
+
+StreamStatus views::view_element(MessageDecoder &decoder, std::string_view &string) {
+    types::str_len_t len;
+    std::span<const uint8_t> bytes;
+    if (!decoder.try_read_element(len) || !decoder.try_view_bytes(len, bytes)) {
+        return StreamStatus::Incomplete;
+    }
+    string = {(const char *) bytes.data(), bytes.size()};
+    return StreamStatus::Ok;
+}
@@ -0,0 +1,321 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides views of the messages received over TCP, decoded lazily in the
+ * bytes they were received in instead of being copied into the owning messages.
+ *
+ * Strings are viewed as std::string_view, vectors and maps as ranges decoding their elements as
+ * they are iterated, so that viewing a message allocates nothing. Making a view walks the message
+ * once to check that all of it was received. A view is valid as long as the bytes are, e.g. until
+ * the next read on the TCPHandler whose buffered bytes it views. The owning messages are
+ * constructed from their views when they have to be kept.
+ *
+ * Views declare their fields with schema() as the messages do, fixed-width elements such as
+ * Position and the events without vectors are decoded by the codec.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef MESSAGE_VIEWS_H
+#define MESSAGE_VIEWS_H
+
+#include <span>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <iterator>
+#include <string_view>
+#include "messages.h"
+#include "codec.h"
+
+template<typename Element>
+class ViewRange;
+
+namespace views {
+    template<typename T>
+    concept FixedWidth = codec::wire_size_v<T> > 0;
+
+    template<typename T>
+    concept Viewed = codec::Message<T> && !FixedWidth<T>;
+
+    StreamStatus view_element(MessageDecoder &, std::string_view &);
+
+    template<FixedWidth T>
+    StreamStatus view_element(MessageDecoder &, T &);
+
+    template<Viewed T>
+    StreamStatus view_element(MessageDecoder &, T &);
+
+    template<typename K, typename V>
+    StreamStatus view_element(MessageDecoder &, std::pair<K, V> &);
+
+    template<typename Element>
+    StreamStatus view_element(MessageDecoder &, ViewRange<Element> &);
+
+    template<typename... Ts>
+    StreamStatus view_element(MessageDecoder &, std::variant<Ts...> &);
+}
+
+/**
+ * @brief Elements of a vector or a map, decoded one at a time as the range is iterated. The
+ * elements were checked when the range was made.
+ */
+template<typename Element>
+class ViewRange {
+public:
+    class iterator {
+    public:
+        using value_type = Element;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() : decoder(std::span<const uint8_t>()), left(0) {}
+
+        iterator(std::span<const uint8_t> bytes, size_t count) : decoder(bytes), left(count + 1) {
+            ++*this;
+        }
+
+        const Element &operator*() const {
+            return element;
+        }
+
+        const Element *operator->() const {
+            return &element;
+        }
+
+        iterator &operator++() {
+            if (--left > 0) {
+                views::view_element(decoder, element);
+            }
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        bool operator==(std::default_sentinel_t) const {
+            return left == 0;
+        }
+
+    private:
+        MessageDecoder decoder;
+        // Elements left to be decoded, plus the current one.
+        size_t left;
+        Element element{};
+    };
+
+    ViewRange() : count(0) {}
+
+    ViewRange(std::span<const uint8_t> bytes_, size_t count_) : bytes(bytes_), count(count_) {}
+
+    [[nodiscard]] iterator begin() const {
+        return iterator(bytes, count);
+    }
+
+    [[nodiscard]] std::default_sentinel_t end() const {
+        return {};
+    }
+
+    [[nodiscard]] size_t size() const {
+        return count;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return count == 0;
+    }
+
+private:
+    std::span<const uint8_t> bytes;
+    size_t count;
+};
+
+struct PlayerView {
+    std::string_view name;
+    std::string_view address;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&PlayerView::name, &PlayerView::address);
+    }
+};
+
+struct BombExplodedView {
+    static constexpr types::message_id_t code = eventCodes::bombExploded;
+
+    types::bomb_id_t id;
+    ViewRange<types::player_id_t> robots_destroyed;
+    ViewRange<Position> blocks_destroyed;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&BombExplodedView::id, &BombExplodedView::robots_destroyed,
+                               &BombExplodedView::blocks_destroyed);
+    }
+};
+
+using EventView = std::variant<BombPlaced, BombExplodedView, PlayerMoved, BlockPlaced>;
+
+/* Views of the messages. bytes are the bytes of the message without its code. */
+
+struct JoinView {
+    std::string_view name;
+    std::span<const uint8_t> bytes;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&JoinView::name);
+    }
+};
+
+struct HelloView {
+    std::string_view server_name;
+    types::players_count_t players_count;
+    types::size_xy_t size_x;
+    types::size_xy_t size_y;
+    types::game_length_t game_length;
+    types::explosion_radius_t explosion_radius;
+    types::bomb_timer_t bomb_timer;
+    std::span<const uint8_t> bytes;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&HelloView::server_name, &HelloView::players_count, &HelloView::size_x,
+                               &HelloView::size_y, &HelloView::game_length, &HelloView::explosion_radius,
+                               &HelloView::bomb_timer);
+    }
+};
+
+struct AcceptedPlayerView {
+    types::player_id_t id;
+    PlayerView player;
+    std::span<const uint8_t> bytes;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&AcceptedPlayerView::id, &AcceptedPlayerView::player);
+    }
+};
+
+struct GameStartedView {
+    ViewRange<std::pair<types::player_id_t, PlayerView>> players;
+    std::span<const uint8_t> bytes;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&GameStartedView::players);
+    }
+};
+
+struct TurnView {
+    types::turn_t turn;
+    ViewRange<EventView> events;
+    std::span<const uint8_t> bytes;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&TurnView::turn, &TurnView::events);
+    }
+};
+
+struct GameEndedView {
+    ViewRange<std::pair<types::player_id_t, types::score_t>> scores;
+    std::span<const uint8_t> bytes;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&GameEndedView::scores);
+    }
+};
+
+/* Views of the messages sent from client to server. */
+using ClientMessageView = std::variant<JoinView, PlaceBomb, PlaceBlock, Move, SubscribeTurns>;
+/* Views of the messages sent from server to client. */
+using ServerMessageView = std::variant<HelloView, AcceptedPlayerView, GameStartedView, TurnView, GameEndedView>;
+
+namespace views {
+    template<FixedWidth T>
+    StreamStatus view_element(MessageDecoder &decoder, T &element) {
+        codec::TryReader reader{decoder};
+        return codec::decode(reader, element) ? StreamStatus::Ok : StreamStatus::Incomplete;
+    }
+
+    template<Viewed T>
+    StreamStatus view_element(MessageDecoder &decoder, T &view) {
+        StreamStatus status = StreamStatus::Ok;
+        // Stops at the first field which cannot be viewed.
+        std::apply([&](auto... fields) {
+            (void) (((status = view_element(decoder, view.*fields)) == StreamStatus::Ok) && ...);
+        }, T::schema());
+        return status;
+    }
+
+    template<typename K, typename V>
+    StreamStatus view_element(MessageDecoder &decoder, std::pair<K, V> &pair) {
+        StreamStatus status = view_element(decoder, pair.first);
+        return status == StreamStatus::Ok ? view_element(decoder, pair.second) : status;
+    }
+
+    template<typename Element>
+    StreamStatus view_element(MessageDecoder &decoder, ViewRange<Element> &range) {
+        static_assert(std::is_same_v<types::vec_len_t, types::map_len_t>);
+        types::vec_len_t count;
+        if (!decoder.try_read_element(count)) {
+            return StreamStatus::Incomplete;
+        }
+
+        if constexpr (FixedWidth<Element>) {
+            // Fixed-width elements are only counted.
+            std::span<const uint8_t> bytes;
+            if (!decoder.try_view_bytes(count * codec::wire_size_v<Element>, bytes)) {
+                return StreamStatus::Incomplete;
+            }
+            range = ViewRange<Element>(bytes, count);
+            return StreamStatus::Ok;
+        }
+
+        // Check the elements, so that they are decoded without checks when iterated.
+        std::span<const uint8_t> bytes = decoder.get_remaining_bytes();
+        Element element{};
+        for (size_t i = 0; i < count; i++) {
+            StreamStatus status = view_element(decoder, element);
+            if (status != StreamStatus::Ok) {
+                return status;
+            }
+        }
+        range = ViewRange<Element>(bytes.first(bytes.size() - decoder.get_remaining_bytes_count()), count);
+        return StreamStatus::Ok;
+    }
+
+    // Views the alternative of the variant whose code is the one read, I is the first one to check.
+    template<typename Variant, size_t I = 0>
+    StreamStatus view_alternative(MessageDecoder &decoder, Variant &variant, types::message_id_t code) {
+        if constexpr (I == std::variant_size_v<Variant>) {
+            return StreamStatus::Invalid;
+        } else {
+            using Alternative = std::variant_alternative_t<I, Variant>;
+            if (code != Alternative::code) {
+                return view_alternative<Variant, I + 1>(decoder, variant, code);
+            }
+            return view_element(decoder, variant.template emplace<Alternative>());
+        }
+    }
+
+    template<typename... Ts>
+    StreamStatus view_element(MessageDecoder &decoder, std::variant<Ts...> &variant) {
+        types::message_id_t code;
+        if (!decoder.try_read_element(code)) {
+            return StreamStatus::Incomplete;
+        }
+        return view_alternative(decoder, variant, code);
+    }
+}
+
+/**
+ * @brief Views the body of a message at the start of the remaining bytes of the decoder, which
+ * is advanced past it.
+ *
+ * @return StreamStatus Ok, Incomplete if the bytes end before the message does, or Invalid if the
+ * code of an event is unknown.
+ */
+template<typename View>
+StreamStatus view_message(MessageDecoder &decoder, View &view) {
+    std::span<const uint8_t> bytes = decoder.get_remaining_bytes();
+    StreamStatus status = views::view_element(decoder, view);
+    if (status == StreamStatus::Ok) {
+        view.bytes = bytes.first(bytes.size() - decoder.get_remaining_bytes_count());
+    }
+    return status;
+}
+
+#endif // MESSAGE_VIEWS_H
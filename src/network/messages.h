@@ -9,14 +9,79 @@
 #define MESSAGES_H
 
 #include <string>
+#include <tuple>
 #include <variant>
 #include <vector>
 #include <map>
 #include <set>
 #include <unordered_set>
 #include "network_handler.h"
+#include "codec.h"
 #include "../config/parser.h"
 
+/*
+ * Every message declares its fields once in schema(), from which the codec (see
+ * codec.h) generates the encoding and decoding for every stream. Events also declare
+ * the code sent before them.
+ *
+ * Messages sent over TCP are serialized with OutputStream being either TCPHandler,
+ * which sends them over the connection, or MessageEncoder, which encodes them once for
+ * many connections. They are decoded from an InputStream: TCPHandler or MessageDecoder,
+ * which reads them from memory.
+ */
+template<typename T>
+concept InputStream = requires(T &stream, std::span<uint8_t> out) {
+    stream.template read_element<types::message_id_t>();
+    stream.read_bytes(out);
+};
+
+/* Codes of messages sent from client to server. */
+namespace serverClientCodes {
+    const types::message_id_t join = 0;
+    const types::message_id_t placeBomb = 1;
+    const types::message_id_t placeBlock = 2;
+    const types::message_id_t move = 3;
+    const types::message_id_t subscribeTurns = 4;
+}
+
+/* Codes of messages sent from client to gui. */
+namespace guiClientCodes {
+    const types::message_id_t lobby = 0;
+    const types::message_id_t game = 1;
+}
+
+/* Codes of messages sent from gui to client. */
+namespace clientGuiCodes {
+    const types::message_id_t placeBomb = 0;
+    const types::message_id_t placeBlock = 1;
+    const types::message_id_t move = 2;
+}
+
+/* Codes of messages sent from server to client. */
+namespace clientServerCodes {
+    const types::message_id_t hello = 0;
+    const types::message_id_t acceptedPlayer = 1;
+    const types::message_id_t gameStarted = 2;
+    const types::message_id_t turn = 3;
+    const types::message_id_t gameEnded = 4;
+}
+
+/* Codes of specific events. */
+namespace eventCodes {
+    const types::message_id_t bombPlaced = 0;
+    const types::message_id_t bombExploded = 1;
+    const types::message_id_t playerMoved = 2;
+    const types::message_id_t blockPlaced = 3;
+}
+
+/* Views of the messages in the bytes they were received in, see message_views.h. */
+struct JoinView;
+struct HelloView;
+struct AcceptedPlayerView;
+struct GameStartedView;
+struct TurnView;
+struct GameEndedView;
+
 enum class Direction : std::underlying_type_t<std::byte> {
     Up, Right, Down, Left
 };
@@ -28,9 +93,25 @@ struct Join {
 
     explicit Join(std::string &);
 
-    explicit Join(TCPHandler &);
+    template<InputStream Stream>
+    explicit Join(Stream &);
 
-    void serialize(TCPHandler &) const;
+    // Copies the message out of the bytes of the view.
+    explicit Join(const JoinView &);
+
+    /**
+     * @brief Decodes the message without exceptions, for the hot paths of the server.
+     *
+     * @return bool False if the bytes end before the message does.
+     */
+    static bool try_decode(MessageDecoder &, Join &);
+
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&Join::name);
+    }
 };
 
 struct PlaceBomb {
@@ -46,9 +127,22 @@ struct Move {
 
     explicit Move(Direction direction_);
 
-    explicit Move(TCPHandler &);
+    template<InputStream Stream>
+    explicit Move(Stream &);
+
+    /**
+     * @brief Decodes the message without exceptions, for the hot paths of the server.
+     *
+     * @return bool False if the bytes end before the message does.
+     */
+    static bool try_decode(MessageDecoder &, Move &);
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&Move::direction);
+    }
 };
 
 struct InvalidMessage {
@@ -67,9 +161,20 @@ struct Hello {
 
     explicit Hello(const options_server &);
 
-    explicit Hello(TCPHandler &handler);
+    template<InputStream Stream>
+    explicit Hello(Stream &);
+
+    // Copies the message out of the bytes of the view.
+    explicit Hello(const HelloView &);
+
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
 
-    void serialize(TCPHandler &) const;
+    static constexpr auto schema() {
+        return std::make_tuple(&Hello::server_name, &Hello::players_count,
+                               &Hello::size_x, &Hello::size_y, &Hello::game_length,
+                               &Hello::explosion_radius, &Hello::bomb_timer);
+    }
 };
 
 struct Player {
@@ -78,11 +183,19 @@ struct Player {
 
     Player() = default;
 
-    explicit Player(TCPHandler &);
+    template<InputStream Stream>
+    explicit Player(Stream &);
 
-    void serialize(UDPHandler &) const;
+    // Serializes into a gui packet, see UDPHandler and SharedMemoryGuiHandler.
+    template<typename PacketStream>
+    void serialize_packet(PacketStream &) const;
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&Player::name, &Player::address);
+    }
 };
 
 struct AcceptedPlayer {
@@ -91,9 +204,18 @@ struct AcceptedPlayer {
 
     AcceptedPlayer() = default;
 
-    explicit AcceptedPlayer(TCPHandler &);
+    template<InputStream Stream>
+    explicit AcceptedPlayer(Stream &);
+
+    // Copies the message out of the bytes of the view.
+    explicit AcceptedPlayer(const AcceptedPlayerView &);
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&AcceptedPlayer::id, &AcceptedPlayer::player);
+    }
 };
 
 struct GameStarted {
@@ -101,9 +223,47 @@ struct GameStarted {
 
     GameStarted() = default;
 
-    explicit GameStarted(TCPHandler &);
+    template<InputStream Stream>
+    explicit GameStarted(Stream &);
+
+    // Copies the message out of the bytes of the view.
+    explicit GameStarted(const GameStartedView &);
+
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&GameStarted::players);
+    }
+};
+
+/**
+ * @brief Asks the server to send turns as datagrams to the given UDP port of the
+ * client, whose address is the one of the TCP connection (see TurnChannelServer).
+ */
+struct SubscribeTurns {
+    types::port_t port;
+
+    SubscribeTurns() = default;
+
+    explicit SubscribeTurns(types::port_t port_);
+
+    template<InputStream Stream>
+    explicit SubscribeTurns(Stream &);
+
+    /**
+     * @brief Decodes the message without exceptions, for the hot paths of the server.
+     *
+     * @return bool False if the bytes end before the message does.
+     */
+    static bool try_decode(MessageDecoder &, SubscribeTurns &);
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&SubscribeTurns::port);
+    }
 };
 
 struct Position {
@@ -112,13 +272,16 @@ struct Position {
 
     Position() = default;
 
-    explicit Position(TCPHandler &);
+    template<InputStream Stream>
+    explicit Position(Stream &);
 
     bool operator==(const Position &) const;
 
-    void serialize(UDPHandler &) const;
+    template<typename PacketStream>
+    void serialize_packet(PacketStream &) const;
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
 
     struct HashFunction {
         size_t operator()(const Position &p) const {
@@ -127,6 +290,10 @@ struct Position {
             return xHash ^ yHash;
         }
     };
+
+    static constexpr auto schema() {
+        return std::make_tuple(&Position::x, &Position::y);
+    }
 };
 
 struct BombPlaced {
@@ -135,9 +302,16 @@ struct BombPlaced {
 
     BombPlaced() = default;
 
-    explicit BombPlaced(TCPHandler &handler);
+    template<InputStream Stream>
+    explicit BombPlaced(Stream &);
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+    static constexpr types::message_id_t code = eventCodes::bombPlaced;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&BombPlaced::id, &BombPlaced::position);
+    }
 };
 
 struct BombExploded {
@@ -147,9 +321,17 @@ struct BombExploded {
 
     BombExploded() = default;
 
-    explicit BombExploded(TCPHandler &handler);
+    template<InputStream Stream>
+    explicit BombExploded(Stream &);
+
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+    static constexpr types::message_id_t code = eventCodes::bombExploded;
 
-    void serialize(TCPHandler &) const;
+    static constexpr auto schema() {
+        return std::make_tuple(&BombExploded::id, &BombExploded::robots_destroyed,
+                               &BombExploded::blocks_destroyed);
+    }
 };
 
 struct PlayerMoved {
@@ -158,9 +340,16 @@ struct PlayerMoved {
 
     PlayerMoved() = default;
 
-    explicit PlayerMoved(TCPHandler &handler);
+    template<InputStream Stream>
+    explicit PlayerMoved(Stream &);
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+    static constexpr types::message_id_t code = eventCodes::playerMoved;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&PlayerMoved::id, &PlayerMoved::position);
+    }
 };
 
 struct BlockPlaced {
@@ -168,22 +357,51 @@ struct BlockPlaced {
 
     BlockPlaced() = default;
 
-    explicit BlockPlaced(TCPHandler &handler);
+    template<InputStream Stream>
+    explicit BlockPlaced(Stream &);
+
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+    static constexpr types::message_id_t code = eventCodes::blockPlaced;
 
-    void serialize(TCPHandler &) const;
+    static constexpr auto schema() {
+        return std::make_tuple(&BlockPlaced::position);
+    }
 };
 
 using Event = std::variant<BombPlaced, BombExploded, PlayerMoved, BlockPlaced>;
 
+/**
+ * @brief Events of a turn of the game. A server applying a slow-client policy (see
+ * TurnContainer::encode_snapshot) may instead send a client fewer catch-up turns,
+ * numbered as the last turns they replace, which leave the client with the board it
+ * would have from the turns it missed:
+ * - robots score and blocks are destroyed in BombExploded events with an id no bomb
+ *   ever had,
+ * - bombs are placed in the turn after which they have ticked as many times as in the
+ *   game, not in the one they were placed in,
+ * - blocks are placed and robots are moved at once, to their latest positions.
+ * Clients ignore explosions of bombs they do not know, apart from the destroyed robots
+ * and blocks.
+ */
 struct Turn {
     types::turn_t turn;
     std::vector<Event> events;
 
     Turn() = default;
 
-    explicit Turn(TCPHandler &handler);
+    template<InputStream Stream>
+    explicit Turn(Stream &);
+
+    // Copies the message out of the bytes of the view.
+    explicit Turn(const TurnView &);
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&Turn::turn, &Turn::events);
+    }
 };
 
 struct GameEnded {
@@ -191,16 +409,30 @@ struct GameEnded {
 
     GameEnded() = default;
 
-    explicit GameEnded(TCPHandler &handler);
+    template<InputStream Stream>
+    explicit GameEnded(Stream &);
+
+    // Copies the message out of the bytes of the view.
+    explicit GameEnded(const GameEndedView &);
 
-    void serialize(TCPHandler &) const;
+    template<typename OutputStream>
+    void serialize(OutputStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&GameEnded::scores);
+    }
 };
 
 struct Bomb {
     Position position;
     types::bomb_timer_t timer;
 
-    void serialize(UDPHandler &) const;
+    template<typename PacketStream>
+    void serialize_packet(PacketStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&Bomb::position, &Bomb::timer);
+    }
 };
 
 struct LobbyMessage {
@@ -213,7 +445,16 @@ struct LobbyMessage {
     types::bomb_timer_t bomb_timer;
     std::map<types::player_id_t, Player> players;
 
-    void serialize(UDPHandler &) const;
+    template<typename PacketStream>
+    void serialize_packet(PacketStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&LobbyMessage::server_name, &LobbyMessage::players_count,
+                               &LobbyMessage::size_x, &LobbyMessage::size_y,
+                               &LobbyMessage::game_length,
+                               &LobbyMessage::explosion_radius,
+                               &LobbyMessage::bomb_timer, &LobbyMessage::players);
+    }
 };
 
 struct GameMessage {
@@ -229,49 +470,86 @@ struct GameMessage {
     std::vector<Position> explosions;
     std::map<types::player_id_t, types::score_t> scores;
 
-    void serialize(UDPHandler &) const;
+    template<typename PacketStream>
+    void serialize_packet(PacketStream &) const;
+
+    static constexpr auto schema() {
+        return std::make_tuple(&GameMessage::server_name, &GameMessage::size_x,
+                               &GameMessage::size_y, &GameMessage::game_length,
+                               &GameMessage::turn, &GameMessage::players,
+                               &GameMessage::player_positions, &GameMessage::blocks,
+                               &GameMessage::bombs, &GameMessage::explosions,
+                               &GameMessage::scores);
+    }
 };
 
-/* Codes of messages sent from client to server. */
-namespace serverClientCodes {
-    const types::message_id_t join = 0;
-    const types::message_id_t placeBomb = 1;
-    const types::message_id_t placeBlock = 2;
-    const types::message_id_t move = 3;
-}
+/*
+ * Encoding and decoding of the messages declaring their schema, for every supported
+ * stream. They are defined here rather than instantiated for each stream in
+ * messages.cpp, so that the codec is inlined into its callers, e.g. the loops encoding
+ * the events of a turn.
+ */
+#define DEFINE_CODEC(Message) \
+    template<InputStream Stream> \
+    Message::Message(Stream &handler) { \
+        codec::StreamReader<Stream> reader{handler}; \
+        codec::decode_fields(reader, *this); \
+    } \
+    template<typename OutputStream> \
+    void Message::serialize(OutputStream &handler) const { \
+        codec::StreamWriter<OutputStream> writer{handler}; \
+        codec::encode(writer, *this); \
+    }
+
+#define DEFINE_PACKET_CODEC(Message) \
+    template<typename PacketStream> \
+    void Message::serialize_packet(PacketStream &handler) const { \
+        codec::PacketWriter<PacketStream> writer{handler}; \
+        codec::encode(writer, *this); \
+    }
+
+DEFINE_CODEC(Join)
+DEFINE_CODEC(Move)
+DEFINE_CODEC(SubscribeTurns)
+DEFINE_CODEC(Hello)
+DEFINE_CODEC(Player)
+DEFINE_CODEC(AcceptedPlayer)
+DEFINE_CODEC(GameStarted)
+DEFINE_CODEC(Position)
+// Events are decoded after their code is read, as part of a turn.
+DEFINE_CODEC(BombPlaced)
+DEFINE_CODEC(BombExploded)
+DEFINE_CODEC(PlayerMoved)
+DEFINE_CODEC(BlockPlaced)
+DEFINE_CODEC(Turn)
+DEFINE_CODEC(GameEnded)
+
+DEFINE_PACKET_CODEC(Player)
+DEFINE_PACKET_CODEC(Position)
+DEFINE_PACKET_CODEC(Bomb)
+DEFINE_PACKET_CODEC(LobbyMessage)
+DEFINE_PACKET_CODEC(GameMessage)
+
+#undef DEFINE_CODEC
+#undef DEFINE_PACKET_CODEC
+
+/*
+ * Below there are overloaded functions encoding the messages sent from server to client
+ * together with their codes, once for all the clients. ServerMessageManager sends them
+ * as they are.
+ */
+MessageEncoder::message_t encode_client_message(const Hello &);
 
-/* Codes of messages sent from client to gui. */
-namespace guiClientCodes {
-    const types::message_id_t lobby = 0;
-    const types::message_id_t game = 1;
-}
+MessageEncoder::message_t encode_client_message(const AcceptedPlayer &);
 
-/* Codes of messages sent from gui to client. */
-namespace clientGuiCodes {
-    const types::message_id_t placeBomb = 0;
-    const types::message_id_t placeBlock = 1;
-    const types::message_id_t move = 2;
-}
+MessageEncoder::message_t encode_client_message(const GameStarted &);
 
-/* Codes of messages sent from server to client. */
-namespace clientServerCodes {
-    const types::message_id_t hello = 0;
-    const types::message_id_t acceptedPlayer = 1;
-    const types::message_id_t gameStarted = 2;
-    const types::message_id_t turn = 3;
-    const types::message_id_t gameEnded = 4;
-}
+MessageEncoder::message_t encode_client_message(const Turn &);
 
-/* Codes of specific events. */
-namespace eventCodes {
-    const types::message_id_t bombPlaced = 0;
-    const types::message_id_t bombExploded = 1;
-    const types::message_id_t playerMoved = 2;
-    const types::message_id_t blockPlaced = 3;
-}
+MessageEncoder::message_t encode_client_message(const GameEnded &);
 
 /* Messages sent from client to server. */
-using ClientMessage = std::variant<Join, PlaceBomb, PlaceBlock, Move>;
+using ClientMessage = std::variant<Join, PlaceBomb, PlaceBlock, Move, SubscribeTurns>;
 /* Messages sent from server to client. */
 using ServerMessage = std::variant<Hello, AcceptedPlayer, GameStarted, Turn, GameEnded>;
 /* Messages sent from client to GUI. */
@@ -1,99 +1,157 @@
 #include <cstdlib>
+#include <algorithm>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <netinet/tcp.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <iostream>
 #include <cerrno>
 #include <cstring>
+#include <thread>
 #include <unistd.h>
 #include "network_handler.h"
+#include "buffer_pool.h"
+#include "socket_tuning.h"
 
-/**
- * @brief Converts first n bytes of the buffer from network to host byte order.
- *
- * @param buffer Pointer to buffer with data.
- * @param n Number of bytes to convert.
- */
-void convert_network_to_host_byte_order(uint8_t *buffer, size_t n) {
-    switch (n) {
-        case 1:
-            // Nothing to be done.
-            return;
-        case 2: {
-            uint16_t before = *(uint16_t *) buffer;
-            uint16_t after = ntohs(before);
-            *(uint16_t *) buffer = after;
-            return;
-        }
-        case 4: {
-            uint32_t before = *(uint32_t *) buffer;
-            uint32_t after = ntohl(before);
-            *(uint32_t *) buffer = after;
-            return;
-        }
-        case 8: {
-            uint64_t before = *(uint64_t *) buffer;
-            uint64_t after = be64toh(before);
-            *(uint64_t *) buffer = after;
-            return;
+void NetworkHandler::resize_buffer(uint8_t *&buff, size_t &size, size_t n, size_t keep_from, size_t keep_to) {
+    uint8_t *new_buff = BufferPool::acquire(n);
+    if (keep_to > keep_from) {
+        std::memcpy(new_buff, buff + keep_from, keep_to - keep_from);
+    }
+    if (buff != nullptr) {
+        BufferPool::release(buff, size);
+    }
+    buff = new_buff;
+    size = n;
+}
+
+void NetworkHandler::unregister_recv_buff() {
+    if (recv_buff_registered) {
+        // The kernel must not keep the pages of a buffer given back to the pool.
+        recv_ring->unregister_buffer();
+        recv_buff_registered = false;
+    }
+}
+
+void NetworkHandler::resize_recv_buff(size_t n, size_t keep_from, size_t keep_to) {
+    unregister_recv_buff();
+    resize_buffer(recv_buff, recv_buff_size, std::min(n, recv_buff_max_size), keep_from, keep_to);
+}
+
+void NetworkHandler::resize_send_buff(size_t n, size_t keep) {
+    resize_buffer(send_buff, send_buff_size, std::min(n, send_buff_max_size), 0, keep);
+}
+
+void NetworkHandler::release_recv_buff() {
+    if (recv_buff != nullptr) {
+        unregister_recv_buff();
+        BufferPool::release(recv_buff, recv_buff_size);
+        recv_buff = nullptr;
+        recv_buff_size = 0;
+    }
+}
+
+void NetworkHandler::release_send_buff() {
+    if (send_buff != nullptr) {
+        BufferPool::release(send_buff, send_buff_size);
+        send_buff = nullptr;
+        send_buff_size = 0;
+    }
+}
+
+size_t NetworkHandler::get_buffer_memory() const {
+    return recv_buff_size + send_buff_size;
+}
+
+// Backend used by newly created handlers.
+static IoBackend io_backend = IoBackend::Socket;
+
+IoBackend NetworkHandler::select_io_backend(IoBackend backend) {
+    if (backend == IoBackend::IoUring) {
+        try {
+            // Check if io_uring is supported and permitted.
+            IoUring probe(1);
         }
-        default:
-            throw std::invalid_argument("Invalid data type size for endianness convertion!");
-    }
-}
-
-/**
- * @brief Converts first n bytes of the buffer from host to network byte order.
- *
- * @param buffer Pointer to buffer with data.
- * @param n Number of bytes to convert.
- */
-void convert_host_to_network_byte_order(uint8_t *buffer, size_t n) {
-    switch (n) {
-        case 1:
-            // Nothing to be done.
-            return;
-        case 2: {
-            uint16_t before = *(uint16_t *) buffer;
-            uint16_t after = htons(before);
-            *(uint16_t *) buffer = after;
-            return;
+        catch (const IoUringError &e) {
+            std::cerr << "io_uring is not available (" << e.what() << "), using sockets instead.\n";
+            backend = IoBackend::Socket;
         }
-        case 4: {
-            uint32_t before = *(uint32_t *) buffer;
-            uint32_t after = htonl(before);
-            *(uint32_t *) buffer = after;
-            return;
+    }
+    io_backend = backend;
+    return io_backend;
+}
+
+NetworkHandler::NetworkHandler(size_t recv_buff_max_size_, size_t send_buff_max_size_) :
+        recv_buff(nullptr), recv_buff_size(0), recv_buff_max_size(recv_buff_max_size_), send_buff(nullptr),
+        send_buff_size(0), send_buff_max_size(send_buff_max_size_), recv_buff_registered(false) {
+    if (io_backend == IoBackend::IoUring) {
+        try {
+            // Receiving and sending may happen in different threads, so each has its own instance.
+            recv_ring = std::make_unique<IoUring>(IO_URING_ENTRIES);
+            send_ring = std::make_unique<IoUring>(IO_URING_ENTRIES);
         }
-        case 8: {
-            uint64_t before = *(uint64_t *) buffer;
-            uint64_t after = htobe64(before);
-            *(uint64_t *) buffer = after;
-            return;
+        catch (const IoUringError &e) {
+            // Fall back to socket system calls.
+            recv_ring.reset();
+            send_ring.reset();
         }
-        default:
-            throw std::invalid_argument("Invalid data type size for endianness conversion!");
     }
 }
 
-uint8_t *NetworkHandler::allocate_buffer_space(size_t n) {
-    auto *buff_ptr = (uint8_t *) malloc(n);
-    if (buff_ptr == nullptr) {
-        throw std::runtime_error("Error occurred when allocating space for a buffer!");
+NetworkHandler::~NetworkHandler() {
+    // Unregister the buffers before releasing them.
+    recv_ring.reset();
+    send_ring.reset();
+    recv_buff_registered = false;
+    release_recv_buff();
+    release_send_buff();
+}
+
+ssize_t NetworkHandler::receive(int fd, uint8_t *buff, size_t n) {
+    if (recv_ring) {
+        if (!recv_buff_registered) {
+            // The buffer changed since the last receive.
+            recv_buff_registered = recv_ring->register_buffer(recv_buff, recv_buff_size);
+        }
+        return recv_ring->read_fixed(fd, buff, n);
     }
-    return buff_ptr;
+    return recv(fd, buff, n, 0);
 }
 
-NetworkHandler::NetworkHandler(size_t recv_buff_size_, size_t send_buff_size_) :
-        recv_buff_size(recv_buff_size_), send_buff_size(send_buff_size_) {
-    recv_buff = allocate_buffer_space(recv_buff_size_);
-    send_buff = allocate_buffer_space(send_buff_size_);
+ssize_t NetworkHandler::transmit(int fd, std::span<const std::span<const uint8_t>> chunks, int flags) {
+    if (send_ring) {
+        return send_ring->send_chunks(fd, chunks, flags);
+    }
+
+    ssize_t total = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        int chunk_flags = i + 1 < chunks.size() ? flags | MSG_MORE : flags;
+        const uint8_t *buff = chunks[i].data();
+        size_t n = chunks[i].size();
+
+        // Send until there are no bytes of the chunk to be sent.
+        while (n > 0) {
+            ssize_t bytes_sent = send(fd, buff, n, chunk_flags);
+            if (bytes_sent == -1) {
+                return -1;
+            }
+            n -= (size_t) bytes_sent;
+            buff += bytes_sent;
+            total += bytes_sent;
+        }
+    }
+    return total;
 }
 
-NetworkHandler::~NetworkHandler() {
-    free(recv_buff);
-    free(send_buff);
+int NetworkHandler::transmit_datagrams(int fd, std::span<struct mmsghdr> msgs) {
+    if (send_ring) {
+        return send_ring->send_messages(fd, msgs, 0);
+    }
+    return sendmmsg(fd, msgs.data(), (unsigned) msgs.size(), 0);
 }
 
 int TCPHandler::set_up_tcp_connection(std::string &address, types::port_t port) {
@@ -117,71 +175,676 @@ int TCPHandler::set_up_tcp_connection(std::string &address, types::port_t port)
         throw std::runtime_error(std::strerror(errno));
     }
 
+    // Apply the socket profile, which disables Nagle's algorithm. Buffer sizes must be set
+    // before connecting to take effect on the window scale.
+    if (!SocketTuning::tune_tcp_socket(fd)) {
+        throw std::runtime_error(std::strerror(errno));
+    }
+
     // Connect to the server.
     err = connect(fd, res->ai_addr, res->ai_addrlen);
     if (err != 0) {
         throw std::runtime_error(std::strerror(errno));
     }
 
-    // Disable Nagle's algorithm.
-    int flag = 1;
-    err = setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char *) &flag, sizeof(int));
-    if (err != 0) {
+    freeaddrinfo(res);
+    return fd;
+}
+
+int TCPHandler::set_up_unix_connection(const std::string &socket_path) {
+    struct sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long!");
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
         throw std::runtime_error(std::strerror(errno));
     }
 
-    freeaddrinfo(res);
+    if (connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        throw std::runtime_error(std::strerror(errno));
+    }
     return fd;
 }
 
+TCPHandler::send_stats_t TCPHandler::send_stats;
+
+std::atomic<size_t> TCPHandler::instances_count{0};
+
 TCPHandler::TCPHandler(int socket_fd_, size_t buff_size_) :
-        NetworkHandler(buff_size_, buff_size_), socket_fd(socket_fd_), recv_deque() {}
+        NetworkHandler(buff_size_, buff_size_), socket_fd(socket_fd_), recv_head(0), recv_tail(0),
+        send_len(0), buffered_reads_only(false), send_queue_offset(0), send_queue_bytes(0),
+        zerocopy_threshold(0) {
+    instances_count++;
+}
 
 TCPHandler::TCPHandler(std::string &address, types::port_t port, size_t buff_size_) :
-        NetworkHandler(buff_size_, buff_size_), recv_deque() {
+        NetworkHandler(buff_size_, buff_size_), recv_head(0), recv_tail(0), send_len(0),
+        buffered_reads_only(false), send_queue_offset(0), send_queue_bytes(0),
+        zerocopy_threshold(0) {
     socket_fd = set_up_tcp_connection(address, port);
+    instances_count++;
+}
+
+TCPHandler::TCPHandler(const std::string &socket_path, size_t buff_size_) :
+        NetworkHandler(buff_size_, buff_size_), recv_head(0), recv_tail(0), send_len(0),
+        buffered_reads_only(false), send_queue_offset(0), send_queue_bytes(0),
+        zerocopy_threshold(0) {
+    socket_fd = set_up_unix_connection(socket_path);
+    instances_count++;
+}
+
+TCPHandler::TCPHandler(MemoryPipe::endpoint_t endpoint, size_t buff_size_) :
+        NetworkHandler(buff_size_, buff_size_), socket_fd(-1), pipe(std::move(endpoint)), recv_head(0),
+        recv_tail(0), send_len(0), buffered_reads_only(false), send_queue_offset(0), send_queue_bytes(0),
+        zerocopy_threshold(0) {
+    instances_count++;
 }
 
 TCPHandler::~TCPHandler() {
+    instances_count--;
+    if (pipe.out) {
+        // The peer reads the remaining bytes and then the end of the stream, its sends fail.
+        pipe.out->close();
+        pipe.in->close();
+        return;
+    }
     if (shutdown(socket_fd, SHUT_WR) == -1) {
         // Ignore errors.
     }
+    try {
+        reap_zerocopy_completions();
+    } catch (TCPError &) {
+        // The socket is broken, the kernel does not read the sent memory anymore.
+        zerocopy_sends = ZerocopySends();
+    }
+    if (!zerocopy_sends.empty()) {
+        // The completions arrive on this socket, so it is closed once they have all arrived.
+        ZerocopyReaper::adopt(socket_fd, std::move(zerocopy_sends));
+        return;
+    }
     if (close(socket_fd) == -1) {
         std::cerr << std::strerror(errno) << std::endl;
         exit(EXIT_FAILURE);
     }
 }
 
-void TCPHandler::return_when_n_bytes_in_deque(size_t n) {
-    // If there are enough bytes in the recv_deque, then do not read on the socket.
-    while (recv_deque.size() < n) {
-        ssize_t received_bytes = recv(socket_fd, recv_buff, recv_buff_size, 0);
+const char *describe_stream_status(StreamStatus status, int error) {
+    switch (status) {
+        case StreamStatus::Ok:
+            return "Success!";
+        case StreamStatus::Incomplete:
+            return "Not enough buffered bytes!";
+        case StreamStatus::Disconnected:
+            return "Peer disconnected!";
+        case StreamStatus::Invalid:
+            return "Invalid message received!";
+        case StreamStatus::Failed:
+            return std::strerror(error);
+    }
+    return "Unknown status!";
+}
+
+void throw_stream_status(StreamStatus status, int error) {
+    switch (status) {
+        case StreamStatus::Incomplete:
+            throw TCPIncompleteError(describe_stream_status(status, error));
+        case StreamStatus::Invalid:
+            throw DecodeError(describe_stream_status(status, error));
+        default:
+            throw TCPError(describe_stream_status(status, error));
+    }
+}
+
+void TCPHandler::return_when_n_bytes_in_buffer(size_t n) {
+    StreamStatus status = try_wait_for_bytes(n);
+    if (status != StreamStatus::Ok) {
+        throw_stream_status(status, errno);
+    }
+}
+
+StreamStatus TCPHandler::try_wait_for_bytes(size_t n) {
+    // If there are enough bytes in the recv_buff, then do not read on the socket.
+    if (recv_tail - recv_head >= n) {
+        return StreamStatus::Ok;
+    }
+    if (buffered_reads_only) {
+        return StreamStatus::Incomplete;
+    }
+    if (n > recv_buff_max_size) {
+        return StreamStatus::Invalid;
+    }
+
+    if (recv_buff_size < n) {
+        // The buffer cannot hold the requested bytes, take a larger one.
+        grow_recv_buff(n);
+    } else if (recv_buff_size - recv_head < n) {
+        // Not enough space after the unconsumed bytes, move them to the beginning of the buffer.
+        std::memmove(recv_buff, recv_buff + recv_head, recv_tail - recv_head);
+        recv_tail -= recv_head;
+        recv_head = 0;
+    }
+
+    while (recv_tail - recv_head < n) {
+        // Receive directly into the free space of the buffer.
+        size_t free_space = recv_buff_size - recv_tail;
+        ssize_t received_bytes = receive_stream(recv_buff + recv_tail, free_space, true);
         if (received_bytes == 0) {
-            throw TCPError("Peer disconnected!");
+            return StreamStatus::Disconnected;
         } else if (received_bytes < 0) {
             // Some error occurred.
-            throw TCPError(std::strerror(errno));
+            return StreamStatus::Failed;
         }
-        // Copy all read bytes to recv_deque.
-        for (ssize_t i = 0; i < received_bytes; i++) {
-            recv_deque.push_back(recv_buff[i]);
+        recv_tail += (size_t) received_bytes;
+
+        if ((size_t) received_bytes == free_space && recv_buff_size < recv_buff_max_size) {
+            // The peer sends faster than the buffer can take, fewer syscalls are needed with a larger one.
+            grow_recv_buff(recv_buff_size * 2);
         }
     }
+    return StreamStatus::Ok;
+}
+
+void TCPHandler::grow_recv_buff(size_t n) {
+    size_t buffered = recv_tail - recv_head;
+    resize_recv_buff(std::max<size_t>(n, TCP_INITIAL_BUFF_SIZE), recv_head, recv_tail);
+    recv_head = 0;
+    recv_tail = buffered;
+}
+
+bool TCPHandler::grow_send_buff(size_t n) {
+    if (send_buff_size >= send_buff_max_size) {
+        return false;
+    }
+    resize_send_buff(std::max<size_t>({send_len + n, send_buff_size * 2, TCP_INITIAL_BUFF_SIZE}), send_len);
+    return send_buff_size - send_len >= n;
+}
+
+void TCPHandler::release_idle_buffers() {
+    if (recv_head == recv_tail) {
+        release_recv_buff();
+        recv_head = 0;
+        recv_tail = 0;
+    }
+    if (send_len == 0) {
+        release_send_buff();
+    }
+}
+
+void TCPHandler::read_bytes(std::span<uint8_t> out) {
+    size_t done = 0;
+    while (done < out.size()) {
+        // Read in chunks not greater than the receive buffer.
+        size_t chunk = std::min(out.size() - done, recv_buff_max_size);
+        return_when_n_bytes_in_buffer(chunk);
+        std::memcpy(out.data() + done, recv_buff + recv_head, chunk);
+        recv_head += chunk;
+        done += chunk;
+    }
 }
 
-void TCPHandler::send_n_bytes(size_t n, uint8_t *buff) const {
-    // Send until there are no bytes to be sent.
-    while (n > 0) {
-        ssize_t bytes_sent = send(socket_fd, buff, n, MSG_NOSIGNAL);
+std::span<const uint8_t> TCPHandler::peek(size_t n) {
+    if (n > recv_buff_max_size) {
+        throw TCPError("Attempt to peek more bytes than the receive buffer can hold!");
+    }
+    return_when_n_bytes_in_buffer(n);
+    return {recv_buff + recv_head, n};
+}
+
+void TCPHandler::send_bytes(std::span<const uint8_t> element_bytes) {
+    while (!element_bytes.empty()) {
+        if (send_buff_size - send_len < element_bytes.size() && !grow_send_buff(element_bytes.size())
+            && send_len == send_buff_size) {
+            // The send buffer is full. Send what is buffered, the rest of the message follows.
+            send_n_bytes(send_len, send_buff, MSG_MORE);
+            send_len = 0;
+        }
+
+        // Copy as much as fits into the send buffer.
+        size_t chunk = std::min(element_bytes.size(), send_buff_size - send_len);
+        std::memcpy(send_buff + send_len, element_bytes.data(), chunk);
+        send_len += chunk;
+        element_bytes = element_bytes.subspan(chunk);
+    }
+}
+
+void TCPHandler::flush_outcoming_message() {
+    send_n_bytes(send_len, send_buff, 0);
+    send_len = 0;
+}
+
+void TCPHandler::send_encoded_message(std::span<const uint8_t> message) {
+    // Send the buffered bytes first, they are followed by the message.
+    std::span<const uint8_t> chunks[] = {{send_buff, send_len}, message};
+    std::span<const std::span<const uint8_t>> to_send(chunks);
+    if (send_len == 0) {
+        to_send = to_send.subspan(1);
+    }
+    send_len = 0;
+
+    ssize_t bytes_sent = transmit_stream(to_send, MSG_NOSIGNAL);
+    if (bytes_sent == -1) {
+        // Some error occured.
+        throw TCPError(std::strerror(errno));
+    }
+    send_stats.copied_bytes += (uint64_t) bytes_sent;
+}
+
+void TCPHandler::send_encoded_message(const MessageEncoder::message_t &message) {
+    if (zerocopy_threshold == 0 || message->size() < zerocopy_threshold) {
+        send_encoded_message(*message);
+        return;
+    }
+
+    if (send_len > 0) {
+        // Send the buffered bytes first, more bytes follow.
+        send_n_bytes(send_len, send_buff, MSG_MORE);
+        send_len = 0;
+    }
+
+    // Send until there are no bytes of the message to be sent.
+    size_t offset = 0;
+    while (offset < message->size()) {
+        struct iovec iov{};
+        iov.iov_base = (void *) (message->data() + offset);
+        iov.iov_len = message->size() - offset;
+        struct msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        ssize_t bytes_sent = send_zerocopy(&msg, 0, message);
         if (bytes_sent == -1) {
-            // Some error occured.
+            if (errno == EINTR) {
+                continue;
+            }
             throw TCPError(std::strerror(errno));
         }
-        n -= bytes_sent;
-        buff += bytes_sent;
+        offset += (size_t) bytes_sent;
+    }
+
+    reap_zerocopy_completions();
+}
+
+bool TCPHandler::enable_zerocopy(size_t threshold) {
+    int flag = 1;
+    if (pipe.out || setsockopt(socket_fd, SOL_SOCKET, SO_ZEROCOPY, &flag, sizeof(flag)) != 0) {
+        return false;
+    }
+    zerocopy_threshold = threshold;
+    return true;
+}
+
+ssize_t TCPHandler::send_zerocopy(struct msghdr *msg, int flags, const MessageEncoder::message_t &message) {
+    ssize_t bytes_sent = sendmsg(socket_fd, msg, MSG_NOSIGNAL | MSG_ZEROCOPY | flags);
+    if (bytes_sent == -1 && errno == ENOBUFS) {
+        // No memory left for the notification, copy the bytes instead.
+        bytes_sent = sendmsg(socket_fd, msg, MSG_NOSIGNAL | flags);
+        if (bytes_sent > 0) {
+            send_stats.copied_bytes += (uint64_t) bytes_sent;
+        }
+        return bytes_sent;
+    }
+
+    if (bytes_sent > 0) {
+        zerocopy_sends.push((size_t) bytes_sent, message);
+    }
+    return bytes_sent;
+}
+
+void TCPHandler::reap_zerocopy_completions() {
+    zerocopy_sends.reap(socket_fd);
+}
+
+void ZerocopySends::push(size_t bytes, const MessageEncoder::message_t &message) {
+    // Every successful call gets the next identifier, reported back on completion.
+    sends.push_back({bytes, message, false, false});
+}
+
+void ZerocopySends::reap(int socket_fd) {
+    while (!sends.empty()) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + CMSG_SPACE(sizeof(struct sockaddr_in6))];
+        struct msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(socket_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            throw TCPError(std::strerror(errno));
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+                !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+                continue;
+            }
+            struct sock_extended_err err;
+            std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+            if (err.ee_errno == 0 && err.ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+                // Sends with identifiers in [ee_info, ee_data] have completed.
+                complete(err.ee_info, err.ee_data, err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+            }
+        }
+    }
+}
+
+void ZerocopySends::complete(uint32_t first, uint32_t last, bool copied) {
+    // Identifiers are 32-bit counters, which may wrap around.
+    for (uint32_t id = first;; id++) {
+        size_t index = id - first_id;
+        if (index < sends.size()) {
+            sends[index].completed = true;
+            sends[index].copied = copied;
+        }
+        if (id == last) {
+            break;
+        }
+    }
+
+    // Release the messages in order, once all the earlier sends have completed.
+    while (!sends.empty() && sends.front().completed) {
+        zerocopy_send &front = sends.front();
+        if (front.copied) {
+            TCPHandler::send_stats.zerocopy_copied_bytes += front.bytes;
+        } else {
+            TCPHandler::send_stats.zerocopy_bytes += front.bytes;
+        }
+        sends.pop_front();
+        first_id++;
+    }
+}
+
+void ZerocopyReaper::adopt(int socket_fd, ZerocopySends sends) {
+    // Never destroyed, so that the thread can run until the process exits.
+    static ZerocopyReaper *reaper = new ZerocopyReaper();
+    std::lock_guard<std::mutex> lock(reaper->mutex);
+    reaper->sockets.emplace_back(socket_fd, std::move(sends));
+    reaper->sockets_cv.notify_one();
+}
+
+ZerocopyReaper::ZerocopyReaper() {
+    std::thread([this] { run(); }).detach();
+}
+
+void ZerocopyReaper::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        sockets_cv.wait(lock, [this] { return !sockets.empty(); });
+        for (auto it = sockets.begin(); it != sockets.end();) {
+            try {
+                it->second.reap(it->first);
+            } catch (TCPError &) {
+                // The socket is broken, the kernel does not read the sent memory anymore.
+                it->second = ZerocopySends();
+            }
+            if (!it->second.empty()) {
+                ++it;
+                continue;
+            }
+            if (close(it->first) == -1) {
+                // Ignore errors.
+            }
+            it = sockets.erase(it);
+        }
+        // Completions arrive once the peer acknowledges the bytes, or the connection times out.
+        sockets_cv.wait_for(lock, std::chrono::milliseconds(ZEROCOPY_REAP_INTERVAL));
+    }
+}
+
+bool TCPHandler::receive_available() {
+    StreamResult<bool> drained = try_receive_available();
+    return drained.value();
+}
+
+StreamResult<bool> TCPHandler::try_receive_available() {
+    if (recv_buff == nullptr) {
+        // The buffer was released while the connection was idle.
+        grow_recv_buff(TCP_INITIAL_BUFF_SIZE);
+    } else if (recv_head > 0) {
+        // Move the unconsumed bytes to the beginning of the buffer to make space for new ones.
+        std::memmove(recv_buff, recv_buff + recv_head, recv_tail - recv_head);
+        recv_tail -= recv_head;
+        recv_head = 0;
+    }
+
+    while (true) {
+        if (recv_tail == recv_buff_size) {
+            if (recv_buff_size >= recv_buff_max_size) {
+                return false;
+            }
+            grow_recv_buff(recv_buff_size * 2);
+        }
+
+        ssize_t received_bytes = receive_stream(recv_buff + recv_tail, recv_buff_size - recv_tail, false);
+        if (received_bytes == 0) {
+            return StreamStatus::Disconnected;
+        } else if (received_bytes < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // All available bytes were received.
+                return true;
+            } else if (errno != EINTR) {
+                return {StreamStatus::Failed, errno};
+            }
+        } else {
+            recv_tail += (size_t) received_bytes;
+        }
     }
 }
 
+void TCPHandler::queue_encoded_message(const MessageEncoder::message_t &message) {
+    send_queue_bytes += message->size();
+    send_queue.push_back(message);
+}
+
+bool TCPHandler::send_queued_messages() {
+    StreamResult<bool> emptied = try_send_queued_messages();
+    return emptied.value();
+}
+
+StreamResult<bool> TCPHandler::try_send_queued_messages() {
+    reap_zerocopy_completions();
+
+    while (!send_queue.empty()) {
+        // Gather queued messages, skipping the already sent part of the first one. A large
+        // message is sent with zero-copy on its own.
+        bool zerocopy = zerocopy_threshold > 0 && send_queue.front()->size() >= zerocopy_threshold;
+        struct iovec iov[SEND_QUEUE_IOV_COUNT];
+        size_t iov_count = 0;
+        for (auto it = send_queue.begin(); it != send_queue.end() && iov_count < SEND_QUEUE_IOV_COUNT; ++it) {
+            if (iov_count > 0 && zerocopy_threshold > 0 && (zerocopy || (*it)->size() >= zerocopy_threshold)) {
+                break;
+            }
+            size_t offset = iov_count == 0 ? send_queue_offset : 0;
+            iov[iov_count].iov_base = (void *) ((*it)->data() + offset);
+            iov[iov_count].iov_len = (*it)->size() - offset;
+            iov_count++;
+        }
+
+        struct msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_count;
+        ssize_t bytes_sent;
+        if (zerocopy) {
+            bytes_sent = send_zerocopy(&msg, MSG_DONTWAIT, send_queue.front());
+        } else if (pipe.out) {
+            std::span<const uint8_t> chunks[SEND_QUEUE_IOV_COUNT];
+            for (size_t i = 0; i < iov_count; i++) {
+                chunks[i] = {(const uint8_t *) iov[i].iov_base, iov[i].iov_len};
+            }
+            bytes_sent = pipe.out->write({chunks, iov_count}, false);
+            if (bytes_sent > 0) {
+                send_stats.copied_bytes += (uint64_t) bytes_sent;
+            }
+        } else {
+            bytes_sent = sendmsg(socket_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (bytes_sent > 0) {
+                send_stats.copied_bytes += (uint64_t) bytes_sent;
+            }
+        }
+        if (bytes_sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return false;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            return {StreamStatus::Failed, errno};
+        }
+
+        // Drop the messages that were sent completely.
+        auto n = (size_t) bytes_sent;
+        send_queue_bytes -= n;
+        while (n > 0) {
+            size_t left = send_queue.front()->size() - send_queue_offset;
+            if (n < left) {
+                send_queue_offset += n;
+                break;
+            }
+            n -= left;
+            send_queue.pop_front();
+            send_queue_offset = 0;
+        }
+    }
+    return true;
+}
+
+size_t TCPHandler::get_queued_bytes_count() const {
+    return send_queue_bytes;
+}
+
+size_t TCPHandler::get_buffered_bytes_count() const {
+    return recv_tail - recv_head;
+}
+
+std::span<const uint8_t> TCPHandler::get_buffered_bytes() const {
+    if (recv_buff == nullptr) {
+        return {};
+    }
+    return {recv_buff + recv_head, recv_tail - recv_head};
+}
+
+void TCPHandler::consume_buffered_bytes(size_t n) {
+    recv_head += n;
+}
+
+std::vector<uint8_t> TCPHandler::get_unread_bytes() const {
+    if (recv_buff == nullptr) {
+        return {};
+    }
+    return {recv_buff + recv_head, recv_buff + recv_tail};
+}
+
+std::vector<uint8_t> TCPHandler::get_unsent_bytes() const {
+    std::vector<uint8_t> bytes;
+    bytes.reserve(send_queue_bytes);
+    for (auto it = send_queue.begin(); it != send_queue.end(); ++it) {
+        size_t offset = it == send_queue.begin() ? send_queue_offset : 0;
+        bytes.insert(bytes.end(), (*it)->begin() + (ptrdiff_t) offset, (*it)->end());
+    }
+    return bytes;
+}
+
+void TCPHandler::restore_unread_bytes(std::span<const uint8_t> bytes) {
+    if (bytes.size() > recv_buff_max_size) {
+        throw TCPError("Restored bytes do not fit into the receive buffer!");
+    }
+    if (bytes.empty()) {
+        return;
+    }
+    grow_recv_buff(bytes.size());
+    std::memcpy(recv_buff, bytes.data(), bytes.size());
+    recv_head = 0;
+    recv_tail = bytes.size();
+}
+
+void TCPHandler::send_n_bytes(size_t n, const uint8_t *buff, int flags) {
+    std::span<const uint8_t> chunk[] = {{buff, n}};
+    if (transmit_stream(chunk, MSG_NOSIGNAL | flags) == -1) {
+        // Some error occured.
+        throw TCPError(std::strerror(errno));
+    }
+    send_stats.copied_bytes += n;
+}
+
+ssize_t TCPHandler::receive_stream(uint8_t *buff, size_t n, bool wait) {
+    if (pipe.in) {
+        return pipe.in->read(buff, n, wait);
+    }
+
+    if (wait) {
+        ssize_t received_bytes = receive(socket_fd, buff, n);
+        if (received_bytes > 0) {
+            SocketTuning::rearm_quick_ack(socket_fd);
+        }
+        return received_bytes;
+    }
+
+    ssize_t received_bytes = recv(socket_fd, buff, n, MSG_DONTWAIT);
+    if (received_bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // All available bytes were received. The caller checks errno afterwards.
+        int saved_errno = errno;
+        SocketTuning::rearm_quick_ack(socket_fd);
+        errno = saved_errno;
+    }
+    return received_bytes;
+}
+
+ssize_t TCPHandler::transmit_stream(std::span<const std::span<const uint8_t>> chunks, int flags) {
+    if (pipe.out) {
+        return pipe.out->write(chunks, true);
+    }
+    return transmit(socket_fd, chunks, flags);
+}
+
+MessageEncoder::message_t MessageEncoder::get_encoded_message() {
+    auto message = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+    bytes.clear();
+    return message;
+}
+
+void MessageEncoder::send_bytes(std::span<const uint8_t> element_bytes) {
+    bytes.insert(bytes.end(), element_bytes.begin(), element_bytes.end());
+}
+
+MessageDecoder::MessageDecoder(std::span<const uint8_t> bytes_) : bytes(bytes_), offset(0) {}
+
+void MessageDecoder::read_bytes(std::span<uint8_t> out) {
+    if (!try_read_bytes(out)) {
+        throw DecodeError("Attempt to read data out of the message's bound!");
+    }
+}
+
+bool MessageDecoder::try_read_bytes(std::span<uint8_t> out) {
+    if (bytes.size() - offset < out.size()) {
+        return false;
+    }
+    std::memcpy(out.data(), bytes.data() + offset, out.size());
+    offset += out.size();
+    return true;
+}
+
+bool MessageDecoder::try_view_bytes(size_t n, std::span<const uint8_t> &view) {
+    if (bytes.size() - offset < n) {
+        return false;
+    }
+    view = bytes.subspan(offset, n);
+    offset += n;
+    return true;
+}
+
+std::span<const uint8_t> MessageDecoder::get_remaining_bytes() const {
+    return bytes.subspan(offset);
+}
+
+size_t MessageDecoder::get_remaining_bytes_count() const {
+    return bytes.size() - offset;
+}
+
 int UDPHandler::set_up_udp_listening(types::port_t port) {
     int fd = socket(AF_INET6, SOCK_DGRAM, 0);
     if (fd < 0) {
@@ -193,6 +856,10 @@ int UDPHandler::set_up_udp_listening(types::port_t port) {
     address.sin6_addr = in6addr_any;
     address.sin6_port = htons(port);
 
+    if (!SocketTuning::tune_udp_socket(fd)) {
+        throw std::runtime_error(std::strerror(errno));
+    }
+
     // Bind port to the socket.
     if (bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
         throw std::runtime_error(std::strerror(errno));
@@ -200,7 +867,7 @@ int UDPHandler::set_up_udp_listening(types::port_t port) {
     return fd;
 }
 
-int UDPHandler::set_up_udp_sending(const std::string &address, types::port_t port) {
+UDPHandler::destination_t UDPHandler::resolve_udp_destination(const std::string &address, types::port_t port) {
     int err;
     struct addrinfo hints, *res;
 
@@ -215,55 +882,188 @@ int UDPHandler::set_up_udp_sending(const std::string &address, types::port_t por
         throw std::runtime_error(gai_strerror(err));
     }
 
-    // Create a UDP socket.
-    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (fd == -1) {
-        throw std::runtime_error(std::strerror(errno));
-    }
+    destination_t destination{};
+    std::memcpy(&destination.address, res->ai_addr, res->ai_addrlen);
+    destination.address_len = res->ai_addrlen;
+    destination.socket_fd = -1;
+    freeaddrinfo(res);
+    return destination;
+}
 
-    // Bind the packets receiver.
-    err = connect(fd, res->ai_addr, res->ai_addrlen);
-    if (err != 0) {
+int UDPHandler::set_up_udp_sending(int family) {
+    // Destinations are provided with every packet.
+    int fd = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd == -1 || !SocketTuning::tune_udp_socket(fd)) {
         throw std::runtime_error(std::strerror(errno));
     }
-
-    freeaddrinfo(res);
     return fd;
 }
 
 UDPHandler::UDPHandler(types::port_t recv_port, const std::string &send_address, types::port_t send_port,
-                       size_t buff_size_) : NetworkHandler(buff_size_, buff_size_), packet_size(0) {
+                       size_t buff_size_) :
+        UDPHandler(recv_port, std::vector<types::endpoint_t>{{send_address, send_port}}, buff_size_) {}
+
+UDPHandler::UDPHandler(types::port_t recv_port, const std::vector<types::endpoint_t> &send_endpoints,
+                       size_t buff_size_) :
+        NetworkHandler(buff_size_, buff_size_), send_socket_fd_v4(-1), send_socket_fd_v6(-1), packet_size(0),
+        received_packets(0), next_packet(0) {
+    for (auto const &[address, port]: send_endpoints) {
+        destinations.push_back(resolve_udp_destination(address, port));
+    }
+    // Packets to the hosts of one family are sent with a single syscall on its socket.
+    std::stable_sort(destinations.begin(), destinations.end(), [](const destination_t &a, const destination_t &b) {
+        return a.address.ss_family < b.address.ss_family;
+    });
+
     recv_socket_fd = set_up_udp_listening(recv_port);
-    send_socket_fd = set_up_udp_sending(send_address, send_port);
+
+    // IPv6 may be unavailable, so IPv4 hosts get a socket of their own.
+    for (destination_t &destination: destinations) {
+        int &socket_fd = destination.address.ss_family == AF_INET ? send_socket_fd_v4 : send_socket_fd_v6;
+        if (socket_fd == -1) {
+            socket_fd = set_up_udp_sending(destination.address.ss_family);
+        }
+        destination.socket_fd = socket_fd;
+    }
+
+    // Packets are received in batches and sent in batches, so the buffers are taken whole.
+    resize_recv_buff(buff_size_, 0, 0);
+    resize_send_buff(buff_size_, 0);
+
+    recv_packet = recv_buff;
     recv_pointer = recv_buff;
     send_pointer = send_buff;
+
+    // Every received packet has its own slot of the receive buffer.
+    size_t slot_size = recv_buff_size / UDP_BATCH_SIZE;
+    for (size_t i = 0; i < UDP_BATCH_SIZE; i++) {
+        recv_iovs[i].iov_base = recv_buff + i * slot_size;
+        recv_iovs[i].iov_len = slot_size;
+    }
 }
 
-size_t UDPHandler::read_incoming_packet() {
-    // Reset the recv_pointer.
-    recv_pointer = recv_buff;
+void UDPHandler::receive_packets() {
+    for (size_t i = 0; i < UDP_BATCH_SIZE; i++) {
+        memset(&recv_msgs[i], 0, sizeof(recv_msgs[i]));
+        recv_msgs[i].msg_hdr.msg_iov = &recv_iovs[i];
+        recv_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
 
-    // Read another UDP packet.
-    ssize_t bytes_read = recv(recv_socket_fd, recv_buff, recv_buff_size, 0);
-    if (bytes_read < 0) {
+    // Wait for one packet, then take the ones that are already queued. MSG_TRUNC reports the
+    // original size of the packets not fitting into their slots.
+    int n = recvmmsg(recv_socket_fd, recv_msgs, UDP_BATCH_SIZE, MSG_WAITFORONE | MSG_TRUNC, nullptr);
+    if (n < 0) {
         // Some error occured.
         throw UDPError(std::strerror(errno));
     }
 
-    packet_size = bytes_read;
-    return packet_size;
+    received_packets = (size_t) n;
+    next_packet = 0;
+}
+
+size_t UDPHandler::read_incoming_packet() {
+    if (next_packet == received_packets) {
+        receive_packets();
+    }
+
+    // Reset the recv_pointer to the beginning of the next packet.
+    struct iovec &slot = recv_iovs[next_packet];
+    size_t original_size = recv_msgs[next_packet].msg_len;
+    next_packet++;
+    recv_packet = (uint8_t *) slot.iov_base;
+    recv_pointer = recv_packet;
+
+    // Only the received part of a truncated packet can be read.
+    packet_size = std::min(original_size, slot.iov_len);
+    return original_size;
+}
+
+bool UDPHandler::has_received_packets() const {
+    return next_packet < received_packets;
+}
+
+void UDPHandler::append_bytes_to_outcoming_packet(std::span<const uint8_t> element_bytes) {
+    // Check if the bytes will fit into the send buffer.
+    if ((size_t) (send_buff + send_buff_size - send_pointer) < element_bytes.size()) {
+        reserve_outcoming_bytes(element_bytes.size());
+    }
+
+    std::memcpy(send_pointer, element_bytes.data(), element_bytes.size());
+    send_pointer += element_bytes.size();
+}
+
+void UDPHandler::reserve_outcoming_bytes(size_t n) {
+    if (!queued_packets.empty()) {
+        // The queued packets take the room, send them before the packet being built.
+        send_queued_packets();
+    }
+    if ((size_t) (send_buff + send_buff_size - send_pointer) < n) {
+        throw UDPError("Data does not fit into the send buffer!");
+    }
+}
+
+void UDPHandler::queue_outcoming_packet() {
+    queued_packets.push_back((size_t) (send_pointer - send_buff));
+
+    // Leave space for the following packets.
+    if (queued_packets.size() == UDP_BATCH_SIZE || queued_packets.back() > send_buff_size / 2) {
+        send_queued_packets();
+    }
 }
 
 void UDPHandler::flush_outcoming_packet() {
-    size_t bytes_to_send = send_pointer - send_buff;
-    ssize_t bytes_sent = send(send_socket_fd, send_buff, bytes_to_send, 0);
-    if (bytes_sent < 0) {
-        // Some error occured.
-        throw UDPError(std::strerror(errno));
+    queued_packets.push_back((size_t) (send_pointer - send_buff));
+    send_queued_packets();
+}
+
+void UDPHandler::send_queued_packets() {
+    // Describe every packet once, each of them is sent to every destination.
+    send_iovs.resize(queued_packets.size());
+    size_t begin = 0;
+    for (size_t i = 0; i < queued_packets.size(); i++) {
+        send_iovs[i].iov_base = send_buff + begin;
+        send_iovs[i].iov_len = queued_packets[i] - begin;
+        begin = queued_packets[i];
     }
 
-    // Free the buffer for next UDP packet.
-    send_pointer = send_buff;
+    // Packets go to a destination in the order of queueing.
+    size_t packets_count = queued_packets.size();
+    send_msgs.resize(packets_count * destinations.size());
+    for (size_t d = 0; d < destinations.size(); d++) {
+        for (size_t i = 0; i < packets_count; i++) {
+            struct mmsghdr &msg = send_msgs[d * packets_count + i];
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_hdr.msg_name = &destinations[d].address;
+            msg.msg_hdr.msg_namelen = destinations[d].address_len;
+            msg.msg_hdr.msg_iov = &send_iovs[i];
+            msg.msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    // Send to the hosts sharing a socket at once, until all the packets are sent.
+    size_t first = 0;
+    while (first < destinations.size()) {
+        size_t last = first + 1;
+        while (last < destinations.size() && destinations[last].socket_fd == destinations[first].socket_fd) {
+            last++;
+        }
+        std::span<struct mmsghdr> msgs(send_msgs.data() + first * packets_count, (last - first) * packets_count);
+        while (!msgs.empty()) {
+            int n = transmit_datagrams(destinations[first].socket_fd, msgs);
+            if (n < 0) {
+                // Some error occured.
+                throw UDPError(std::strerror(errno));
+            }
+            msgs = msgs.subspan((size_t) n);
+        }
+        first = last;
+    }
+
+    // Free the buffer for next UDP packets, keeping the one being built.
+    size_t building = (size_t) (send_pointer - send_buff) - queued_packets.back();
+    std::memmove(send_buff, send_buff + queued_packets.back(), building);
+    queued_packets.clear();
+    send_pointer = send_buff + building;
 }
 
 UDPHandler::~UDPHandler() {
@@ -271,25 +1071,70 @@ UDPHandler::~UDPHandler() {
         std::cerr << std::strerror(errno) << std::endl;
         exit(EXIT_FAILURE);
     }
-    if (close(send_socket_fd) == -1) {
-        std::cerr << std::strerror(errno) << std::endl;
-        exit(EXIT_FAILURE);
+    for (int socket_fd: {send_socket_fd_v4, send_socket_fd_v6}) {
+        if (socket_fd != -1 && close(socket_fd) == -1) {
+            std::cerr << std::strerror(errno) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+bool TCPHandler::get_peer_address(struct sockaddr_in6 &address) const {
+    if (pipe.in) {
+        return false;
+    }
+    struct sockaddr_storage storage{};
+    socklen_t address_len = sizeof(storage);
+    if (getpeername(socket_fd, (struct sockaddr *) &storage, &address_len) == -1 || storage.ss_family != AF_INET6) {
+        return false;
     }
+    std::memcpy(&address, &storage, sizeof(address));
+    return true;
+}
+
+void TCPHandler::disconnect() {
+    if (pipe.out) {
+        pipe.out->close();
+        pipe.in->close();
+        return;
+    }
+    if (shutdown(socket_fd, SHUT_RDWR) == -1) {
+        // Ignore errors, the peer may have disconnected already.
+    }
+}
+
+int TCPHandler::get_socket_fd() const {
+    return socket_fd;
 }
 
 std::string TCPHandler::get_peer_name() const {
+    if (pipe.in) {
+        return "memory";
+    }
+
     int err;
     char str[INET6_ADDRSTRLEN];
-    struct sockaddr_in6 address;
-    socklen_t addres_len = sizeof(address);
+    struct sockaddr_storage storage{};
+    socklen_t addres_len = sizeof(storage);
 
-    err = getpeername(socket_fd, (struct sockaddr *) &address, &addres_len);
+    err = getpeername(socket_fd, (struct sockaddr *) &storage, &addres_len);
     if (err == -1) {
         throw std::runtime_error(std::strerror(errno));
     }
 
-    if (inet_ntop(AF_INET6, &address.sin6_addr, str, sizeof(str))) {
-        return "[" + std::string(str) + "]:" + std::to_string(ntohs(address.sin6_port));
+    if (storage.ss_family == AF_UNIX) {
+        // Clients connect with unnamed sockets, so name them after the socket of the server.
+        struct sockaddr_un local{};
+        socklen_t local_len = sizeof(local);
+        if (getsockname(socket_fd, (struct sockaddr *) &local, &local_len) == -1) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        return "unix:" + std::string(local.sun_path);
+    }
+
+    auto *address = (struct sockaddr_in6 *) &storage;
+    if (inet_ntop(AF_INET6, &address->sin6_addr, str, sizeof(str))) {
+        return "[" + std::string(str) + "]:" + std::to_string(ntohs(address->sin6_port));
     } else {
         throw std::runtime_error(std::strerror(errno));
     }
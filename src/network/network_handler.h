@@ -9,48 +9,364 @@
 #ifndef NETWORK_HANDLER_H
 #define NETWORK_HANDLER_H
 
-#include <deque>
 #include <string>
+#include <span>
 #include <cinttypes>
 #include <iostream>
 #include <stdexcept>
 #include <cstring>
 #include <memory>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <variant>
+#include <sys/socket.h>
+#include <netinet/in.h>
 #include "../config/config.h"
-
-void convert_network_to_host_byte_order(uint8_t *buffer, size_t n);
-
-void convert_host_to_network_byte_order(uint8_t *buffer, size_t n);
+#include "io_uring.h"
+#include "memory_pipe.h"
+#include "byte_order.h"
 
 class TCPError : public std::runtime_error {
 public:
     explicit TCPError(const char *w) : std::runtime_error(w) {}
 };
 
+// Thrown when a message is decoded from the buffered bytes only and they do not hold all of it.
+class TCPIncompleteError : public TCPError {
+public:
+    explicit TCPIncompleteError(const char *w) : TCPError(w) {}
+};
+
 class UDPError : public std::runtime_error {
 public:
     explicit UDPError(const char *w) : std::runtime_error(w) {}
 };
 
+class DecodeError : public std::runtime_error {
+public:
+    explicit DecodeError(const char *w) : std::runtime_error(w) {}
+};
+
+/* Outcome of the operations reporting failures without exceptions. They are used on the hot paths
+ * of the server, where a wave of disconnections would otherwise unwind a stack per client. */
+enum class StreamStatus {
+    Ok,
+    // The bytes hold only a part of the message.
+    Incomplete,
+    // The peer closed the connection.
+    Disconnected,
+    // The bytes are not a valid message.
+    Invalid,
+    // A system call failed.
+    Failed
+};
+
+/**
+ * @brief Describes a failure, as the exception thrown in its place would.
+ *
+ * @param error errno of a failed system call.
+ */
+const char *describe_stream_status(StreamStatus status, int error);
+
+/**
+ * @brief Throws the exception reporting a failure in the exception API: TCPIncompleteError,
+ * TCPError or DecodeError.
+ */
+[[noreturn]] void throw_stream_status(StreamStatus status, int error);
+
+/**
+ * @brief Value of a successful operation or the status of a failed one, in the manner of
+ * std::expected. A failed system call keeps its errno.
+ */
+template<typename T>
+class StreamResult {
+public:
+    StreamResult(T value_) : result(std::move(value_)), error(0) {}
+
+    StreamResult(StreamStatus status_, int error_ = 0) : result(status_), error(error_) {}
+
+    [[nodiscard]] bool has_value() const {
+        return std::holds_alternative<T>(result);
+    }
+
+    explicit operator bool() const {
+        return has_value();
+    }
+
+    T &operator*() {
+        return std::get<T>(result);
+    }
+
+    T *operator->() {
+        return &std::get<T>(result);
+    }
+
+    /**
+     * @throws TCPIncompleteError, TCPError, DecodeError - Thrown if the operation failed.
+     */
+    T &value() {
+        if (!has_value()) {
+            throw_stream_status(status(), error);
+        }
+        return std::get<T>(result);
+    }
+
+    [[nodiscard]] StreamStatus status() const {
+        return has_value() ? StreamStatus::Ok : std::get<StreamStatus>(result);
+    }
+
+    [[nodiscard]] const char *what() const {
+        return describe_stream_status(status(), error);
+    }
+
+private:
+    std::variant<T, StreamStatus> result;
+    int error;
+};
+
 class NetworkHandler {
 public:
-    NetworkHandler(size_t recv_buff_size_, size_t send_buff_size_);
+    /**
+     * @brief Construct a new NetworkHandler object. Buffers are taken from the buffer pool when
+     * they are needed.
+     *
+     * @param recv_buff_max_size_ Maximum size of the receive buffer.
+     * @param send_buff_max_size_ Maximum size of the send buffer.
+     */
+    NetworkHandler(size_t recv_buff_max_size_, size_t send_buff_max_size_);
 
     ~NetworkHandler();
 
+    /**
+     * @return size_t Number of bytes of the buffers currently held by the handler.
+     */
+    [[nodiscard]] size_t get_buffer_memory() const;
+
+    /**
+     * @brief Selects the implementation of blocking socket operations used by handlers created
+     * afterwards. Falls back to socket system calls if io_uring is not available.
+     *
+     * @return IoBackend The backend actually selected.
+     */
+    static IoBackend select_io_backend(IoBackend backend);
+
 protected:
+    // Buffers are nullptr and their sizes are 0 when they are not held.
     uint8_t *recv_buff;
     size_t recv_buff_size;
+    size_t recv_buff_max_size;
     uint8_t *send_buff;
     size_t send_buff_size;
+    size_t send_buff_max_size;
+
+    // Instances used for blocking receiving and sending, nullptr if socket system calls are used.
+    std::unique_ptr<IoUring> recv_ring;
+    std::unique_ptr<IoUring> send_ring;
+
+    /**
+     * @brief Receives bytes from the socket into the receive buffer, blocking until some arrive.
+     *
+     * @param buff Pointer inside recv_buff.
+     * @return ssize_t Number of received bytes or -1 with errno set.
+     */
+    ssize_t receive(int fd, uint8_t *buff, size_t n);
+
+    /**
+     * @brief Sends all the chunks in order, blocking until they are handed over to the kernel.
+     * Every chunk but the last one is sent with MSG_MORE.
+     *
+     * @return ssize_t Number of sent bytes or -1 with errno set.
+     */
+    ssize_t transmit(int fd, std::span<const std::span<const uint8_t>> chunks, int flags);
+
+    /**
+     * @brief Sends the datagrams in order, like sendmmsg.
+     *
+     * @return int Number of sent datagrams, or -1 with errno set if none was sent.
+     */
+    int transmit_datagrams(int fd, std::span<struct mmsghdr> msgs);
+
+    /**
+     * @brief Replaces the receive buffer with a pooled one of at least min(n, recv_buff_max_size) bytes.
+     * Bytes recv_buff[keep_from, keep_to) are moved to the beginning of the new buffer.
+     */
+    void resize_recv_buff(size_t n, size_t keep_from, size_t keep_to);
+
+    /**
+     * @brief Replaces the send buffer with a pooled one of at least min(n, send_buff_max_size) bytes.
+     * The first keep bytes are copied to the new buffer.
+     */
+    void resize_send_buff(size_t n, size_t keep);
+
+    // Give the buffers back to the pool.
+    void release_recv_buff();
+
+    void release_send_buff();
+
+private:
+    // Whether recv_buff is registered as the fixed buffer of recv_ring.
+    bool recv_buff_registered;
+
+    void unregister_recv_buff();
+
+    static void resize_buffer(uint8_t *&buff, size_t &size, size_t n, size_t keep_from, size_t keep_to);
+};
+
+/**
+ * @brief Class accumulating the wire representation of a message in memory. It provides the same
+ * interface for appending elements as TCPHandler, so that a message can be serialized once and
+ * the resulting bytes can be sent over many TCP connections.
+ *
+ */
+class MessageEncoder {
+public:
+    // Immutable wire representation of a message, shared by all senders.
+    using message_t = std::shared_ptr<const std::vector<uint8_t>>;
+
+    MessageEncoder() = default;
+
+    // Append element to the encoded message.
+    template<typename T>
+    void send_element(T element);
+
+    // Append bytes to the encoded message without endianness conversion.
+    void send_bytes(std::span<const uint8_t> element_bytes);
+
+    /**
+     * @brief Returns the encoded message. The encoder is left empty.
+     *
+     * @return message_t Wire representation of the message.
+     */
+    message_t get_encoded_message();
+
+    // Delete copy constructor and copy assignment.
+    MessageEncoder(MessageEncoder const &) = delete;
+
+    void operator=(MessageEncoder const &) = delete;
+
+private:
+    std::vector<uint8_t> bytes;
+};
+
+/**
+ * @brief Class reading the wire representation of messages from memory, e.g. from a datagram.
+ * It provides the same interface for reading elements as TCPHandler.
+ */
+class MessageDecoder {
+public:
+    /**
+     * @param bytes_ Encoded messages, which must outlive the decoder.
+     */
+    explicit MessageDecoder(std::span<const uint8_t> bytes_);
+
+    /**
+     * @brief Reads the next element, converting its endianness if needed.
+     *
+     * @throws DecodeError - Thrown when there are not enough bytes left.
+     */
+    template<typename T>
+    T read_element();
+
+    /**
+     * @brief Reads the next out.size() bytes without endianness conversion.
+     *
+     * @throws DecodeError - Thrown when there are not enough bytes left.
+     */
+    void read_bytes(std::span<uint8_t> out);
+
+    /**
+     * @brief Reads the next element like read_element, without exceptions.
+     *
+     * @return bool False if there are not enough bytes left, nothing is read then.
+     */
+    template<typename T>
+    bool try_read_element(T &element);
+
+    /**
+     * @brief Reads the next bytes like read_bytes, without exceptions.
+     *
+     * @return bool False if there are not enough bytes left, nothing is read then.
+     */
+    bool try_read_bytes(std::span<uint8_t> out);
 
     /**
-     * @brief Allocates space for a buffer.
+     * @brief Returns a view of the next n bytes and skips them, without copying them.
      *
-     * @param n Size of the buffer.
-     * @return uint8_t* Pointer to the buffer.
+     * @return bool False if there are not enough bytes left, nothing is read then.
      */
-    static uint8_t *allocate_buffer_space(size_t n);
+    bool try_view_bytes(size_t n, std::span<const uint8_t> &view);
+
+    [[nodiscard]] std::span<const uint8_t> get_remaining_bytes() const;
+
+    [[nodiscard]] size_t get_remaining_bytes_count() const;
+
+private:
+    std::span<const uint8_t> bytes;
+    size_t offset;
+};
+
+/**
+ * @brief Sends made with MSG_ZEROCOPY on one socket, in the order of their identifiers. The kernel
+ * reads the sent memory until it reports the completion of the send on the error queue of the
+ * socket, so the messages are kept alive until then.
+ */
+class ZerocopySends {
+public:
+    ZerocopySends() : first_id(0) {}
+
+    // Records the next successful zero-copy send call, which sent bytes of the message.
+    void push(size_t bytes, const MessageEncoder::message_t &message);
+
+    /**
+     * @brief Reads completions from the error queue of the socket without blocking and releases
+     * the messages whose sends have completed.
+     *
+     * @throws TCPError.
+     */
+    void reap(int socket_fd);
+
+    [[nodiscard]] bool empty() const {
+        return sends.empty();
+    }
+
+private:
+    // A send call made with MSG_ZEROCOPY, waiting for its completion.
+    struct zerocopy_send {
+        size_t bytes;
+        // Keeps the sent memory alive.
+        MessageEncoder::message_t message;
+        bool completed;
+        bool copied;
+    };
+
+    // The first send has identifier first_id.
+    std::deque<zerocopy_send> sends;
+    uint32_t first_id;
+
+    void complete(uint32_t first, uint32_t last, bool copied);
+};
+
+/**
+ * @brief Owns the sockets of the destroyed TCPHandlers whose zero-copy sends have not completed.
+ * A background thread reads their completions and closes each socket once all of its messages
+ * are released.
+ */
+class ZerocopyReaper {
+public:
+    // Takes over the socket, which must not be closed by the caller.
+    static void adopt(int socket_fd, ZerocopySends sends);
+
+private:
+    std::mutex mutex;
+    std::condition_variable sockets_cv;
+    std::vector<std::pair<int, ZerocopySends>> sockets;
+
+    ZerocopyReaper();
+
+    [[noreturn]] void run();
 };
 
 /**
@@ -58,16 +374,37 @@ protected:
  * instantiated providing previously created socket or by providing name and port of the
  * server, with which connection will be established during object construction.
  *
+ * The stream may also be an in-process MemoryPipe connection, so that the message managers can be
+ * run without sockets. Zero-copy sending and socket tuning do not apply to it.
+ *
  */
 class TCPHandler : public NetworkHandler {
 public:
     using ptr = std::shared_ptr<TCPHandler>;
 
+    /**
+     * @brief Numbers of bytes sent by all the handlers.
+     */
+    struct send_stats_t {
+        // Sent with MSG_ZEROCOPY, straight from the user memory.
+        std::atomic<uint64_t> zerocopy_bytes{0};
+        // Sent with MSG_ZEROCOPY, but copied by the kernel anyway (e.g. over loopback).
+        std::atomic<uint64_t> zerocopy_copied_bytes{0};
+        // Sent with an ordinary copying send.
+        std::atomic<uint64_t> copied_bytes{0};
+    };
+
+    static send_stats_t send_stats;
+
+    // Number of existing handlers.
+    static std::atomic<size_t> instances_count;
+
     /**
      * @brief Construct a new TCPHandler object using previously created socket.
      *
      * @param socket_fd_ Connected TCP socket file descriptor.
-     * @param buff_size_ Size of the receive/send buffers.
+     * @param buff_size_ Maximum size of the receive/send buffers. They start small and grow
+     * when a message does not fit.
      */
     TCPHandler(int socket_fd_, size_t buff_size_);
 
@@ -76,12 +413,52 @@ public:
      *
      * @param address Address of the server.
      * @param port Port of the server.
-     * @param buff_size_ Size of the receive/send buffers.
+     * @param buff_size_ Maximum size of the receive/send buffers.
      */
     TCPHandler(std::string &address, types::port_t port, size_t buff_size_);
 
+    /**
+     * @brief Construct a new TCPHandler object connected to the Unix domain stream socket of a server
+     * running on the same host. The protocol is the same as over TCP.
+     *
+     * @param socket_path Path of the socket file of the server.
+     * @param buff_size_ Maximum size of the receive/send buffers.
+     */
+    TCPHandler(const std::string &socket_path, size_t buff_size_);
+
+    /**
+     * @brief Construct a new TCPHandler object using one end of an in-process connection.
+     *
+     * @param endpoint End created with MemoryPipe::create_connection.
+     * @param buff_size_ Maximum size of the receive/send buffers.
+     */
+    TCPHandler(MemoryPipe::endpoint_t endpoint, size_t buff_size_);
+
     [[nodiscard]] std::string get_peer_name() const;
 
+    /**
+     * @brief Returns the address of the peer connected over TCP, e.g. to send datagrams to it.
+     *
+     * @return bool False if the peer is connected over a Unix domain socket or a memory pipe.
+     */
+    bool get_peer_address(struct sockaddr_in6 &address) const;
+
+    /**
+     * @return int File descriptor of the socket, e.g. to wait for it with poll, -1 for a memory pipe.
+     */
+    [[nodiscard]] int get_socket_fd() const;
+
+    /**
+     * @brief Ends the connection in both directions, e.g. to drop a client which cannot keep up.
+     * Reads and sends of both ends fail afterwards, the descriptor is closed by the destructor.
+     * Thread-safe with respect to operations of other threads on the handler.
+     */
+    void disconnect();
+
+    /**
+     * @brief Closes the connection. If zero-copy sends have not completed yet, the socket is
+     * handed over to the ZerocopyReaper, which closes it once their messages are released.
+     */
     ~TCPHandler();
 
     /**
@@ -97,18 +474,206 @@ public:
     template<typename T>
     T read_element();
 
-    // Send element over TCP connection.
+    /**
+     * @brief Read subsequent out.size() bytes from the TCP stream into the provided buffer.
+     * No endianness conversion is performed.
+     *
+     * @param out Buffer to be filled with the bytes from the stream.
+     * @throws TCPError.
+     */
+    void read_bytes(std::span<uint8_t> out);
+
+    /**
+     * @brief Returns a view of the next n bytes of the TCP stream without consuming them.
+     * The view is valid until the next read on the handler.
+     *
+     * @param n Number of bytes to be peeked, not greater than the size of the receive buffer.
+     * @return std::span<const uint8_t> View of the next n bytes.
+     * @throws TCPError.
+     */
+    std::span<const uint8_t> peek(size_t n);
+
+    /**
+     * @brief Append element to the outcoming message. The bytes are buffered and sent only when
+     * the send buffer gets full or when the message is flushed.
+     *
+     * @tparam T Type of the element.
+     * @throws TCPError.
+     */
     template<typename T>
     void send_element(T element);
 
+    /**
+     * @brief Append bytes to the outcoming message without endianness conversion, copying them
+     * into the send buffer at once.
+     *
+     * @throws TCPError.
+     */
+    void send_bytes(std::span<const uint8_t> element_bytes);
+
+    /**
+     * @brief Sends all buffered bytes of the outcoming message with a single send() call.
+     * Should be called exactly once, after the last element of the message was appended.
+     *
+     * @throws TCPError.
+     */
+    void flush_outcoming_message();
+
+    /**
+     * @brief Sends a message previously encoded with MessageEncoder. The bytes are sent straight
+     * from the provided buffer, without copying them into the send buffer.
+     *
+     * @param message Wire representation of the message.
+     * @throws TCPError.
+     */
+    void send_encoded_message(std::span<const uint8_t> message);
+
+    /**
+     * @brief Sends a message previously encoded with MessageEncoder. If zero-copy is enabled and
+     * the message is large enough, it is sent with MSG_ZEROCOPY and kept alive until the kernel
+     * reports the completion.
+     *
+     * @param message Wire representation of the message.
+     * @throws TCPError.
+     */
+    void send_encoded_message(const MessageEncoder::message_t &message);
+
+    /**
+     * @brief Enables zero-copy sending of encoded messages (SO_ZEROCOPY).
+     *
+     * @param threshold Minimum size of a message sent with MSG_ZEROCOPY. Pinning pages and
+     * handling the completion costs more than copying small messages.
+     * @return bool False if the socket does not support zero-copy.
+     */
+    bool enable_zerocopy(size_t threshold);
+
+    /* Below there are methods used for non-blocking communication driven by an event loop. */
+
+    /**
+     * @brief Receives bytes available on the socket into recv_buff without blocking. Bytes
+     * received before an error occurred are kept in the buffer.
+     *
+     * @return bool True if all available bytes were received, false if the buffer got full.
+     * @throws TCPError - Also when the peer disconnected.
+     */
+    bool receive_available();
+
+    /**
+     * @brief Receives available bytes like receive_available, without exceptions.
+     *
+     * @return StreamResult<bool> Whether all available bytes were received, or Disconnected or Failed.
+     */
+    StreamResult<bool> try_receive_available();
+
+    /**
+     * @brief Blocks until at least n received bytes are buffered, without exceptions. Fails with
+     * Incomplete instead of blocking while a message is decoded by try_decode_buffered.
+     *
+     * @return StreamStatus Ok, Incomplete, Disconnected, Failed with errno set, or Invalid if the
+     * receive buffer cannot hold n bytes.
+     */
+    StreamStatus try_wait_for_bytes(size_t n);
+
+    /**
+     * @brief Returns a view of the received bytes which have not been read yet, e.g. to decode
+     * a message from them. The view is valid until the next read on the handler.
+     */
+    [[nodiscard]] std::span<const uint8_t> get_buffered_bytes() const;
+
+    /**
+     * @brief Marks the first n buffered bytes as read, e.g. once a message was decoded from them.
+     */
+    void consume_buffered_bytes(size_t n);
+
+    /**
+     * @brief Invokes decoder, which reads one message from the handler, on the bytes already
+     * present in recv_buff, without performing reads on the socket. If the bytes do not hold
+     * the whole message, they are left unconsumed.
+     *
+     * @tparam Decoder Callable reading one message.
+     * @return bool True if the message was decoded.
+     */
+    template<typename Decoder>
+    bool try_decode_buffered(Decoder decoder);
+
+    /**
+     * @brief Queues an encoded message to be sent by send_queued_messages.
+     */
+    void queue_encoded_message(const MessageEncoder::message_t &message);
+
+    /**
+     * @brief Sends queued messages without blocking, gathering many of them in one syscall.
+     *
+     * @return bool True if the queue was emptied, false if the socket cannot accept more bytes.
+     * @throws TCPError.
+     */
+    bool send_queued_messages();
+
+    /**
+     * @brief Sends queued messages like send_queued_messages, without exceptions.
+     *
+     * @return StreamResult<bool> Whether the queue was emptied, or Failed.
+     */
+    StreamResult<bool> try_send_queued_messages();
+
+    [[nodiscard]] size_t get_queued_bytes_count() const;
+
+    /**
+     * @return size_t Number of received bytes which have not been read yet.
+     */
+    [[nodiscard]] size_t get_buffered_bytes_count() const;
+
+    /**
+     * @brief Returns the received bytes which have not been read yet, e.g. to hand the connection
+     * over to another process.
+     */
+    [[nodiscard]] std::vector<uint8_t> get_unread_bytes() const;
+
+    /**
+     * @brief Returns the bytes of the messages queued with queue_encoded_message which have not
+     * been sent yet.
+     */
+    [[nodiscard]] std::vector<uint8_t> get_unsent_bytes() const;
+
+    /**
+     * @brief Puts back bytes received from the socket by another process, as if they were just
+     * received. Must be called before anything is received.
+     */
+    void restore_unread_bytes(std::span<const uint8_t> bytes);
+
+    /**
+     * @brief Gives the buffers without unconsumed bytes back to the pool, so that idle connections
+     * do not hold memory. They are taken again on the next receive or send.
+     */
+    void release_idle_buffers();
+
     // Delete copy constructor and copy assignment.
     TCPHandler(TCPHandler const &) = delete;
 
     void operator=(TCPHandler const &) = delete;
 
 private:
+    // -1 if the stream is a memory pipe.
     int socket_fd;
-    std::deque<char> recv_deque;
+    // Pipes of the stream, nullptr if it is a socket.
+    MemoryPipe::endpoint_t pipe;
+    // Received but not yet consumed bytes are stored in recv_buff[recv_head, recv_tail).
+    size_t recv_head;
+    size_t recv_tail;
+    // Bytes of the outcoming message are stored in send_buff[0, send_len).
+    size_t send_len;
+    // If set, reads fail instead of waiting for bytes from the socket.
+    bool buffered_reads_only;
+    // Encoded messages waiting to be sent, the first one is already sent up to send_queue_offset.
+    std::deque<MessageEncoder::message_t> send_queue;
+    size_t send_queue_offset;
+    size_t send_queue_bytes;
+
+    // Messages of at least this size are sent with MSG_ZEROCOPY, 0 if zero-copy is disabled.
+    size_t zerocopy_threshold;
+
+    // Zero-copy sends waiting for their completions.
+    ZerocopySends zerocopy_sends;
 
     /**
      * @brief Sets up a TCP connection. Sets TCP_NODELAY option for instant message outbound.
@@ -120,14 +685,64 @@ private:
     static int set_up_tcp_connection(std::string &address, types::port_t port);
 
     /**
-     * @brief Reads from the TCP stream as long as there are not enough bytes in recv_deque.
+     * @brief Connects to a Unix domain stream socket.
+     *
+     * @param socket_path Path of the socket file.
+     * @return int File descriptor of the connected socket.
+     */
+    static int set_up_unix_connection(const std::string &socket_path);
+
+    /**
+     * @brief Reads from the TCP stream as long as there are not enough bytes in recv_buff.
+     * The bytes are received directly into the free space at the end of recv_buff, which is
+     * reclaimed by moving the unconsumed bytes to its beginning when needed.
      *
-     * @param n Minimum number of bytes in recv_deque when returning.
+     * @param n Minimum number of unconsumed bytes in recv_buff when returning. It must not be
+     * greater than recv_buff_max_size, recv_buff is grown if it is smaller.
      * @throws TCPError.
      */
-    void return_when_n_bytes_in_deque(size_t n);
+    void return_when_n_bytes_in_buffer(size_t n);
+
+    void send_n_bytes(size_t n, const uint8_t *buff, int flags);
 
-    void send_n_bytes(size_t n, uint8_t *buff) const;
+    /**
+     * @brief Receives bytes from the socket or the memory pipe.
+     *
+     * @param wait Whether to wait for bytes if there are none.
+     * @return ssize_t Number of received bytes, 0 if the peer disconnected, or -1 with errno set.
+     */
+    ssize_t receive_stream(uint8_t *buff, size_t n, bool wait);
+
+    /**
+     * @brief Sends all the chunks to the socket or the memory pipe, blocking until they are sent.
+     *
+     * @return ssize_t Number of sent bytes or -1 with errno set.
+     */
+    ssize_t transmit_stream(std::span<const std::span<const uint8_t>> chunks, int flags);
+
+    // Replaces recv_buff with one of at least n bytes, keeping the unconsumed bytes.
+    void grow_recv_buff(size_t n);
+
+    // Makes room for n more bytes in send_buff, growing it up to send_buff_max_size.
+    // Returns false if it is already at the maximum size.
+    bool grow_send_buff(size_t n);
+
+    /**
+     * @brief Sends the message with MSG_ZEROCOPY. If the kernel runs out of memory for the
+     * completion notification, the bytes are sent with an ordinary copying send instead.
+     *
+     * @param message Owner of the sent memory.
+     * @return ssize_t Number of sent bytes or -1 with errno set.
+     */
+    ssize_t send_zerocopy(struct msghdr *msg, int flags, const MessageEncoder::message_t &message);
+
+    /**
+     * @brief Reads zero-copy completions from the error queue of the socket without blocking and
+     * releases the messages whose sends have completed.
+     *
+     * @throws TCPError.
+     */
+    void reap_zerocopy_completions();
 };
 
 class UDPHandler : public NetworkHandler {
@@ -143,15 +758,34 @@ public:
     UDPHandler(types::port_t recv_port, const std::string &send_address, types::port_t send_port,
                size_t buff_size_);
 
+    /**
+     * @brief Construct a new UDPHandler object sending every packet to many hosts.
+     *
+     * @param recv_port Port on which the handler listens to incoming UDP packets.
+     * @param send_endpoints Hosts to which UDP packets are sent.
+     * @param buff_size_ Size of the receive/send buffers.
+     */
+    UDPHandler(types::port_t recv_port, const std::vector<types::endpoint_t> &send_endpoints, size_t buff_size_);
+
     ~UDPHandler();
 
     /**
-     * @brief Reads incoming UDP packet and puts it into recv_buff.
+     * @brief Makes the next received UDP packet the one read by read_next_packet_element.
+     * If there are no received packets left, receives all the queued ones (at most UDP_BATCH_SIZE)
+     * with a single syscall, waiting for at least one.
+     *
+     * Every packet is received into its own slot of recv_buff. Packets not fitting into the slot
+     * are truncated, but their original size is returned.
      *
      * @return size_t Size of the incoming UDP packet.
      */
     size_t read_incoming_packet();
 
+    /**
+     * @return bool True if there are received packets which have not been read yet.
+     */
+    [[nodiscard]] bool has_received_packets() const;
+
     /**
      * @brief Reads another element of the UDP packet. Advances pointer to the buffer by
      * the size of the element.
@@ -165,6 +799,23 @@ public:
     template<typename T>
     void append_to_outcoming_packet(T element);
 
+    /**
+     * @brief Appends bytes to the outcoming packet without endianness conversion.
+     *
+     * @throws UDPError - Thrown when the packet does not fit into the send buffer.
+     */
+    void append_bytes_to_outcoming_packet(std::span<const uint8_t> element_bytes);
+
+    /**
+     * @brief Finishes the packet being built and keeps it in the send buffer, so that it is sent
+     * together with the following ones. Queued packets are sent when the batch is full, the send
+     * buffer is half full or flush_outcoming_packet is called.
+     */
+    void queue_outcoming_packet();
+
+    /**
+     * @brief Sends the queued packets and the one being built to every host with a single syscall.
+     */
     void flush_outcoming_packet();
 
     // Delete copy constructor and copy assignment.
@@ -174,14 +825,39 @@ public:
 
 private:
     int recv_socket_fd;
-    int send_socket_fd;
+    // Sockets sending to the IPv4 and to the IPv6 hosts, -1 if there are no hosts of the family.
+    int send_socket_fd_v4;
+    int send_socket_fd_v6;
+
+    // A host to which packets are sent, over the socket of its address family.
+    struct destination_t {
+        struct sockaddr_storage address;
+        socklen_t address_len;
+        int socket_fd;
+    };
+
+    // Hosts to which packets are sent, the ones of each address family next to each other.
+    std::vector<destination_t> destinations;
     // Size of the last received UDP packet.
     size_t packet_size;
+    // Beginning of the last received UDP packet.
+    uint8_t *recv_packet;
     // Keeps track of the next element of the packet to be read.
     uint8_t *recv_pointer;
     // Keeps track of free space in the send buffer.
     uint8_t *send_pointer;
 
+    // Packets received with the last syscall, the ones before next_packet were already read.
+    struct mmsghdr recv_msgs[UDP_BATCH_SIZE];
+    struct iovec recv_iovs[UDP_BATCH_SIZE];
+    size_t received_packets;
+    size_t next_packet;
+
+    // Ends of the queued packets, which lie one after another in the send buffer.
+    std::vector<size_t> queued_packets;
+    std::vector<struct mmsghdr> send_msgs;
+    std::vector<struct iovec> send_iovs;
+
     /**
      * @brief Open a socket for reading UDP packets.
      *
@@ -191,52 +867,127 @@ private:
     static int set_up_udp_listening(types::port_t port);
 
     /**
-     * @brief Open a socket for sending UDP packets and bind it to the provided address.
+     * @brief Resolves the address of a host to which UDP packets will be sent.
      *
      * @param address Address of the host to which UPD packets will be sent.
      * @param port Port of the host to which UDP packets will be sent.
+     * @return destination_t Address of the host, its socket is not set.
+     */
+    static destination_t resolve_udp_destination(const std::string &address, types::port_t port);
+
+    /**
+     * @brief Opens a socket sending UDP packets to the hosts of the address family.
+     *
      * @return int File descriptor of the UDP socket.
      */
-    static int set_up_udp_sending(const std::string &address, types::port_t port);
+    static int set_up_udp_sending(int family);
+
+    // Makes room for n more bytes of the packet being built, sending the queued packets if needed.
+    void reserve_outcoming_bytes(size_t n);
+
+    // Receives a batch of packets, waiting for at least one.
+    void receive_packets();
+
+    // Sends all the queued packets to every destination. The packet being built is moved to the
+    // beginning of the send buffer.
+    void send_queued_packets();
 };
 
 template<typename T>
 T TCPHandler::read_element() {
     size_t n = sizeof(T);
-    return_when_n_bytes_in_deque(n);
-    // At this point there are at least n bytes in the deque.
-    uint8_t temp_buff[n];
-    for (size_t i = 0; i < n; i++) {
-        // Copy n bytes from the deque to the buffer.
-        temp_buff[i] = recv_deque.front();
-        recv_deque.pop_front();
-    }
+    return_when_n_bytes_in_buffer(n);
+    // At this point there are at least n bytes in the buffer.
+    uint8_t temp_buff[sizeof(T)];
+    std::memcpy(temp_buff, recv_buff + recv_head, n);
+    recv_head += n;
+
     // Convert the endianness if needed.
-    convert_network_to_host_byte_order(temp_buff, n);
-    // Cast the received bytes.
-    return *(T *) temp_buff;
+    convert_network_to_host_byte_order<T>(temp_buff);
+    T element;
+    std::memcpy(&element, temp_buff, n);
+    return element;
+}
+
+template<typename Decoder>
+bool TCPHandler::try_decode_buffered(Decoder decoder) {
+    size_t mark = recv_head;
+    buffered_reads_only = true;
+    try {
+        decoder();
+    }
+    catch (const TCPIncompleteError &e) {
+        // Give back the bytes of the incomplete message.
+        recv_head = mark;
+        buffered_reads_only = false;
+        return false;
+    }
+    catch (...) {
+        buffered_reads_only = false;
+        throw;
+    }
+    buffered_reads_only = false;
+    return true;
 }
 
 template<typename T>
 void TCPHandler::send_element(T element) {
+    if (send_buff_size - send_len < sizeof(T) && !grow_send_buff(sizeof(T))) {
+        // The message does not fit into the send buffer. Send what is buffered and let the
+        // kernel know that the rest of the message follows, so that it does not push out
+        // a partial segment.
+        send_n_bytes(send_len, send_buff, MSG_MORE);
+        send_len = 0;
+    }
+
     // Put the bytes into the send buffer.
-    std::memcpy(send_buff, &element, sizeof(T));
+    std::memcpy(send_buff + send_len, &element, sizeof(T));
 
     // Convert the endianness if needed.
-    convert_host_to_network_byte_order(send_buff, sizeof(T));
+    convert_host_to_network_byte_order<T>(send_buff + send_len);
+
+    send_len += sizeof(T);
+}
+
+template<typename T>
+void MessageEncoder::send_element(T element) {
+    size_t offset = bytes.size();
+    bytes.resize(offset + sizeof(T));
+    std::memcpy(bytes.data() + offset, &element, sizeof(T));
 
-    send_n_bytes(sizeof(T), send_buff);
+    // Convert the endianness if needed.
+    convert_host_to_network_byte_order<T>(bytes.data() + offset);
+}
+
+template<typename T>
+T MessageDecoder::read_element() {
+    T element;
+    if (!try_read_element(element)) {
+        throw DecodeError("Attempt to read data out of the message's bound!");
+    }
+    return element;
+}
+
+template<typename T>
+bool MessageDecoder::try_read_element(T &element) {
+    uint8_t temp_buff[sizeof(T)];
+    if (!try_read_bytes(temp_buff)) {
+        return false;
+    }
+    convert_network_to_host_byte_order<T>(temp_buff);
+    std::memcpy(&element, temp_buff, sizeof(T));
+    return true;
 }
 
 template<typename T>
 T UDPHandler::read_next_packet_element() {
     // Check if there is enough data left in the buffer.
-    if (recv_buff + packet_size < recv_pointer + sizeof(T)) {
+    if (recv_packet + packet_size < recv_pointer + sizeof(T)) {
         throw UDPError("Attempt to read data out of UDP packet's bound!");
     }
 
     // Convert the endianness if needed.
-    convert_network_to_host_byte_order(recv_pointer, sizeof(T));
+    convert_network_to_host_byte_order<T>(recv_pointer);
     T element = *(T *) recv_pointer;
 
     // Advance the pointer.
@@ -249,11 +1000,11 @@ template<typename T>
 void UDPHandler::append_to_outcoming_packet(T element) {
     // Check if the element will fit into the send buffer.
     if (send_buff + send_buff_size < send_pointer + sizeof(T)) {
-        throw UDPError("Data does not fit into the send buffer!");
+        reserve_outcoming_bytes(sizeof(T));
     }
 
     std::memcpy(send_pointer, &element, sizeof(T));
-    convert_host_to_network_byte_order(send_pointer, sizeof(T));
+    convert_host_to_network_byte_order<T>(send_pointer);
 
     // Advance the pointer.
     send_pointer += sizeof(T);
@@ -0,0 +1,159 @@
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include "reactor.h"
+
+Reactor::Reactor(connection_factory_t connection_factory_) : connection_factory(std::move(connection_factory_)) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        throw ReactorError(std::strerror(errno));
+    }
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd == -1) {
+        throw ReactorError(std::strerror(errno));
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = event_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &event) == -1) {
+        throw ReactorError(std::strerror(errno));
+    }
+}
+
+Reactor::~Reactor() {
+    connections.clear();
+    if (close(event_fd) == -1 || close(epoll_fd) == -1) {
+        std::cerr << std::strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void Reactor::add_connection(int socket_fd) {
+    add_connection(socket_fd, nullptr);
+}
+
+void Reactor::add_connection(int socket_fd, std::unique_ptr<Connection> connection) {
+    {
+        std::unique_lock<std::mutex> lock_guard(mutex);
+        pending_connections.emplace_back(socket_fd, std::move(connection));
+    }
+    wake_up();
+}
+
+std::vector<std::pair<int, std::unique_ptr<Reactor::Connection>>> Reactor::take_connections() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+    take_requested = true;
+    wake_up();
+    taken_condition.wait(lock_guard, [&] { return !take_requested; });
+    return std::move(taken_connections);
+}
+
+void Reactor::wake_up() {
+    uint64_t value = 1;
+    if (write(event_fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+        throw ReactorError(std::strerror(errno));
+    }
+}
+
+void Reactor::register_pending_connections() {
+    std::vector<std::pair<int, std::unique_ptr<Connection>>> pending;
+    {
+        std::unique_lock<std::mutex> lock_guard(mutex);
+        pending.swap(pending_connections);
+    }
+
+    for (auto &[socket_fd, connection]: pending) {
+        try {
+            connections.insert({socket_fd, connection ? std::move(connection) : connection_factory(socket_fd)});
+        }
+        catch (const std::exception &e) {
+            std::cerr << e.what() << '\n';
+            close(socket_fd);
+            continue;
+        }
+
+        // Edge-triggered, the connection reads and writes until the socket would block.
+        struct epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = socket_fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket_fd, &event) == -1) {
+            std::cerr << std::strerror(errno) << '\n';
+            connections.erase(socket_fd);
+        }
+    }
+}
+
+void Reactor::wake_up_connections() {
+    for (auto it = connections.begin(); it != connections.end();) {
+        if (it->second->handle_wake_up()) {
+            ++it;
+        } else {
+            // Closing the socket removes it from the epoll set.
+            it = connections.erase(it);
+        }
+    }
+}
+
+void Reactor::hand_over_connections() {
+    std::unique_lock<std::mutex> lock_guard(mutex);
+    if (!take_requested) {
+        return;
+    }
+
+    for (auto &[socket_fd, connection]: connections) {
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, socket_fd, nullptr) == -1) {
+            throw ReactorError(std::strerror(errno));
+        }
+        taken_connections.emplace_back(socket_fd, std::move(connection));
+    }
+    connections.clear();
+
+    take_requested = false;
+    taken_condition.notify_all();
+}
+
+void Reactor::handle_socket_events(int socket_fd, uint32_t events) {
+    auto it = connections.find(socket_fd);
+    if (it != connections.end() && !it->second->handle_socket_events(events)) {
+        connections.erase(it);
+    }
+}
+
+void Reactor::run() {
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+
+    while (true) {
+        int n = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw ReactorError(std::strerror(errno));
+        }
+
+        bool woken_up = false;
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == event_fd) {
+                // Reset the counter of the event file descriptor.
+                uint64_t value;
+                if (read(event_fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+                    throw ReactorError(std::strerror(errno));
+                }
+                woken_up = true;
+            } else {
+                handle_socket_events(events[i].data.fd, events[i].events);
+            }
+        }
+
+        if (woken_up) {
+            register_pending_connections();
+            hand_over_connections();
+            wake_up_connections();
+        }
+    }
+}
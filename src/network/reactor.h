@@ -0,0 +1,129 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides an event loop serving many non-blocking TCP connections in one thread.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <stdexcept>
+#include <cinttypes>
+#include "../config/config.h"
+
+class ReactorError : public std::runtime_error {
+public:
+    explicit ReactorError(const char *w) : std::runtime_error(w) {}
+};
+
+/**
+ * @brief Event loop built on epoll. Connections are registered in edge-triggered mode for both
+ * reading and writing. Other threads can wake the loop up, which lets every connection check whether
+ * there is new data for it to send.
+ */
+class Reactor {
+public:
+    using ptr = std::shared_ptr<Reactor>;
+
+    /**
+     * @brief State of a single connection served by the reactor. All methods are invoked only by
+     * the thread running the reactor.
+     */
+    class Connection {
+    public:
+        virtual ~Connection() = default;
+
+        /**
+         * @brief Handles readiness of the socket.
+         *
+         * @param events Epoll events reported for the socket.
+         * @return bool False if the connection should be closed.
+         */
+        virtual bool handle_socket_events(uint32_t events) = 0;
+
+        /**
+         * @brief Handles a wake up of the reactor, e.g. caused by a change of the game state.
+         *
+         * @return bool False if the connection should be closed.
+         */
+        virtual bool handle_wake_up() = 0;
+    };
+
+    // Creates the state of a connection using the provided socket.
+    using connection_factory_t = std::function<std::unique_ptr<Connection>(int)>;
+
+    explicit Reactor(connection_factory_t);
+
+    ~Reactor();
+
+    /**
+     * @brief Hands a connected socket over to the reactor. Thread-safe.
+     *
+     * @param socket_fd File descriptor of the connected socket.
+     */
+    void add_connection(int socket_fd);
+
+    /**
+     * @brief Hands a connected socket over to the reactor together with the state of its
+     * connection, e.g. one restored after a handoff. Thread-safe.
+     */
+    void add_connection(int socket_fd, std::unique_ptr<Connection> connection);
+
+    /**
+     * @brief Stops serving all the connections and returns them with their sockets, which are
+     * left open. Connections added later are served as usual. Thread-safe, must not be called by
+     * the thread running the reactor.
+     */
+    std::vector<std::pair<int, std::unique_ptr<Connection>>> take_connections();
+
+    /**
+     * @brief Wakes the reactor up, so that all its connections handle the wake up. Thread-safe.
+     */
+    void wake_up();
+
+    /**
+     * @brief Runs the event loop. Never returns.
+     *
+     * @throws ReactorError - Thrown when epoll fails.
+     */
+    [[noreturn]] void run();
+
+    /* Delete copy constructor and copy assignment. */
+    Reactor(Reactor const &) = delete;
+
+    void operator=(Reactor const &) = delete;
+
+private:
+    int epoll_fd;
+    int event_fd;
+    connection_factory_t connection_factory;
+
+    // Sockets handed over by other threads, waiting to be registered. The state of a connection
+    // is created by connection_factory if it is nullptr.
+    std::mutex mutex;
+    std::vector<std::pair<int, std::unique_ptr<Connection>>> pending_connections;
+
+    // Set by take_connections until the loop moves its connections to taken_connections.
+    std::condition_variable taken_condition;
+    bool take_requested = false;
+    std::vector<std::pair<int, std::unique_ptr<Connection>>> taken_connections;
+
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
+    void register_pending_connections();
+
+    void wake_up_connections();
+
+    void hand_over_connections();
+
+    void handle_socket_events(int socket_fd, uint32_t events);
+};
+
+#endif // REACTOR_H
@@ -0,0 +1,149 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include "shared_memory_handler.h"
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared counters must be lock-free.");
+
+// Futexes are shared between processes, so the private variants cannot be used.
+static void futex_wait(std::atomic<uint32_t> &word, uint32_t expected) {
+    syscall(SYS_futex, (uint32_t *) &word, FUTEX_WAIT, expected, nullptr, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t> &word) {
+    syscall(SYS_futex, (uint32_t *) &word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static shared_gui_channel_t *map_channel(int fd) {
+    void *address = mmap(nullptr, sizeof(shared_gui_channel_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw SharedMemoryError(std::strerror(errno));
+    }
+    return (shared_gui_channel_t *) address;
+}
+
+SharedMemoryGuiHandler::SharedMemoryGuiHandler(const std::string &name_) :
+        name(name_), back_frame(0), send_len(0), input_size(0), input_offset(0) {
+    // A channel left by a previous client is replaced.
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        throw SharedMemoryError(std::strerror(errno));
+    }
+    if (ftruncate(fd, sizeof(shared_gui_channel_t)) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw SharedMemoryError(std::strerror(errno));
+    }
+    channel = map_channel(fd);
+
+    // The object is zero-filled, so the counters start at 0. The client owns frame 0, the middle
+    // frame is 1 and the gui owns frame 2.
+    channel->frame_middle.store(1);
+    __atomic_store_n(&channel->magic, SHM_CHANNEL_MAGIC, __ATOMIC_RELEASE);
+}
+
+SharedMemoryGuiHandler::~SharedMemoryGuiHandler() {
+    munmap(channel, sizeof(shared_gui_channel_t));
+    shm_unlink(name.c_str());
+}
+
+size_t SharedMemoryGuiHandler::read_incoming_packet() {
+    uint32_t head = channel->input_head.load(std::memory_order_relaxed);
+    uint32_t tail;
+    while ((tail = channel->input_tail.load(std::memory_order_acquire)) == head) {
+        futex_wait(channel->input_tail, tail);
+    }
+
+    // Copy the input, so that its slot can be given back to the gui at once.
+    shared_gui_channel_t::input_t &slot = channel->inputs[head % SHM_INPUT_RING_SIZE];
+    input_size = std::min<size_t>(slot.size, SHM_INPUT_SIZE);
+    std::memcpy(input, slot.bytes, input_size);
+    input_offset = 0;
+    channel->input_head.store(head + 1, std::memory_order_release);
+    return input_size;
+}
+
+bool SharedMemoryGuiHandler::has_received_packets() const {
+    return channel->input_tail.load(std::memory_order_acquire) != channel->input_head.load(std::memory_order_relaxed);
+}
+
+void SharedMemoryGuiHandler::publish_frame() {
+    channel->frames[back_frame].size = (uint32_t) send_len;
+    send_len = 0;
+
+    // Swap the back frame with the middle one, the gui takes the latest frame from the middle.
+    uint32_t previous = channel->frame_middle.exchange(back_frame | SHM_FRAME_FRESH, std::memory_order_acq_rel);
+    back_frame = previous & ~SHM_FRAME_FRESH;
+    channel->frame_sequence.fetch_add(1, std::memory_order_release);
+}
+
+void SharedMemoryGuiHandler::append_bytes_to_outcoming_packet(std::span<const uint8_t> element_bytes) {
+    if (send_len + element_bytes.size() > SHM_FRAME_SIZE) {
+        throw SharedMemoryError("Data does not fit into the shared frame!");
+    }
+
+    std::memcpy(channel->frames[back_frame].bytes + send_len, element_bytes.data(), element_bytes.size());
+    send_len += element_bytes.size();
+}
+
+void SharedMemoryGuiHandler::queue_outcoming_packet() {
+    publish_frame();
+}
+
+void SharedMemoryGuiHandler::flush_outcoming_packet() {
+    publish_frame();
+    futex_wake(channel->frame_sequence);
+}
+
+SharedMemoryGuiPeer::SharedMemoryGuiPeer(const std::string &name) : front_frame(2), last_sequence(0) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd == -1) {
+        throw SharedMemoryError(std::strerror(errno));
+    }
+    channel = map_channel(fd);
+    if (__atomic_load_n(&channel->magic, __ATOMIC_ACQUIRE) != SHM_CHANNEL_MAGIC) {
+        munmap(channel, sizeof(shared_gui_channel_t));
+        throw SharedMemoryError("Shared memory object is not a gui channel!");
+    }
+}
+
+SharedMemoryGuiPeer::~SharedMemoryGuiPeer() {
+    munmap(channel, sizeof(shared_gui_channel_t));
+}
+
+std::span<const uint8_t> SharedMemoryGuiPeer::read_frame() {
+    uint32_t sequence;
+    while ((sequence = channel->frame_sequence.load(std::memory_order_acquire)) == last_sequence) {
+        futex_wait(channel->frame_sequence, sequence);
+    }
+    last_sequence = sequence;
+
+    if (channel->frame_middle.load(std::memory_order_relaxed) & SHM_FRAME_FRESH) {
+        uint32_t previous = channel->frame_middle.exchange(front_frame, std::memory_order_acq_rel);
+        front_frame = previous & ~SHM_FRAME_FRESH;
+    }
+    shared_gui_channel_t::frame_t &frame = channel->frames[front_frame];
+    return {frame.bytes, std::min<size_t>(frame.size, SHM_FRAME_SIZE)};
+}
+
+bool SharedMemoryGuiPeer::send_input(std::span<const uint8_t> bytes) {
+    uint32_t tail = channel->input_tail.load(std::memory_order_relaxed);
+    if (bytes.size() > SHM_INPUT_SIZE ||
+        tail - channel->input_head.load(std::memory_order_acquire) == SHM_INPUT_RING_SIZE) {
+        return false;
+    }
+
+    shared_gui_channel_t::input_t &slot = channel->inputs[tail % SHM_INPUT_RING_SIZE];
+    slot.size = (uint8_t) bytes.size();
+    std::memcpy(slot.bytes, bytes.data(), bytes.size());
+    channel->input_tail.store(tail + 1, std::memory_order_release);
+    futex_wake(channel->input_tail);
+    return true;
+}
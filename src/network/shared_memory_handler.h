@@ -0,0 +1,212 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides a shared memory channel between the client and a gui running on
+ * the same host, used instead of UDP.
+ *
+ * Messages have the same encoding as the UDP datagrams. The client publishes every LobbyMessage or
+ * GameMessage as a frame of a triple buffer, so the gui always reads the latest complete state
+ * without blocking the client, and frames are not limited by the size of a datagram. Inputs of the
+ * gui go through a single-producer single-consumer ring. Both directions wake up the waiting side
+ * with a futex on the shared counters.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SHARED_MEMORY_HANDLER_H
+#define SHARED_MEMORY_HANDLER_H
+
+#include <atomic>
+#include <span>
+#include <string>
+#include <stdexcept>
+#include <cstring>
+#include <cinttypes>
+#include "../config/config.h"
+#include "network_handler.h"
+
+class SharedMemoryError : public std::runtime_error {
+public:
+    explicit SharedMemoryError(const char *w) : std::runtime_error(w) {}
+};
+
+/**
+ * @brief Layout of the shared memory object. Guis written in other languages map the object and
+ * follow the same protocol:
+ *
+ * - Frames: the middle frame is published by exchanging its index (with SHM_FRAME_FRESH set) into
+ *   frame_middle. The gui takes it by exchanging the index of the frame it owns into frame_middle,
+ *   if SHM_FRAME_FRESH is set. frame_sequence is incremented after every publication and woken with
+ *   FUTEX_WAKE, the gui waits on it with FUTEX_WAIT.
+ * - Inputs: the gui writes the slot at input_tail % SHM_INPUT_RING_SIZE, increments input_tail
+ *   (release) and wakes it with FUTEX_WAKE. The client consumes slots up to input_tail and
+ *   increments input_head. The ring is full when input_tail - input_head == SHM_INPUT_RING_SIZE.
+ */
+struct shared_gui_channel_t {
+    struct frame_t {
+        uint32_t size;
+        uint8_t bytes[SHM_FRAME_SIZE];
+    };
+
+    struct input_t {
+        uint8_t size;
+        uint8_t bytes[SHM_INPUT_SIZE];
+    };
+
+    // SHM_CHANNEL_MAGIC once the client initialized the channel.
+    uint32_t magic;
+    // Counters written by different processes are kept in different cache lines.
+    alignas(64) std::atomic<uint32_t> frame_middle;
+    std::atomic<uint32_t> frame_sequence;
+    alignas(64) std::atomic<uint32_t> input_head;
+    alignas(64) std::atomic<uint32_t> input_tail;
+    alignas(64) input_t inputs[SHM_INPUT_RING_SIZE];
+    alignas(64) frame_t frames[3];
+};
+
+/**
+ * @brief Client side of the channel. It provides the same interface for reading and sending
+ * packets as UDPHandler, so that gui messages are serialized straight into the shared frames.
+ */
+class SharedMemoryGuiHandler {
+public:
+    /**
+     * @brief Creates the shared memory object (shm_open) and maps it. The object is removed when
+     * the handler is destroyed.
+     *
+     * @param name Name of the shared memory object, e.g. "/robots-gui".
+     * @throws SharedMemoryError.
+     */
+    explicit SharedMemoryGuiHandler(const std::string &name);
+
+    ~SharedMemoryGuiHandler();
+
+    /**
+     * @brief Makes the next input of the gui the one read by read_next_packet_element, waiting
+     * for one if there are none.
+     *
+     * @return size_t Size of the input.
+     */
+    size_t read_incoming_packet();
+
+    /**
+     * @return bool True if there are inputs of the gui which have not been read yet.
+     */
+    [[nodiscard]] bool has_received_packets() const;
+
+    template<typename T>
+    T read_next_packet_element();
+
+    /**
+     * @brief Appends element to the frame being built.
+     *
+     * @throws SharedMemoryError - Thrown when the frame does not fit into SHM_FRAME_SIZE bytes.
+     */
+    template<typename T>
+    void append_to_outcoming_packet(T element);
+
+    /**
+     * @brief Appends bytes to the frame being built without endianness conversion.
+     *
+     * @throws SharedMemoryError - Thrown when the frame does not fit into SHM_FRAME_SIZE bytes.
+     */
+    void append_bytes_to_outcoming_packet(std::span<const uint8_t> element_bytes);
+
+    /**
+     * @brief Publishes the frame without waking up the gui, as more frames follow.
+     */
+    void queue_outcoming_packet();
+
+    /**
+     * @brief Publishes the frame and wakes up the gui.
+     */
+    void flush_outcoming_packet();
+
+    // Delete copy constructor and copy assignment.
+    SharedMemoryGuiHandler(SharedMemoryGuiHandler const &) = delete;
+
+    void operator=(SharedMemoryGuiHandler const &) = delete;
+
+private:
+    std::string name;
+    shared_gui_channel_t *channel;
+    // Frame being built by the client.
+    uint32_t back_frame;
+    size_t send_len;
+    // Copy of the input being read.
+    uint8_t input[SHM_INPUT_SIZE];
+    size_t input_size;
+    size_t input_offset;
+
+    void publish_frame();
+};
+
+/**
+ * @brief Gui side of the channel.
+ */
+class SharedMemoryGuiPeer {
+public:
+    /**
+     * @brief Maps the shared memory object created by the client.
+     *
+     * @throws SharedMemoryError.
+     */
+    explicit SharedMemoryGuiPeer(const std::string &name);
+
+    ~SharedMemoryGuiPeer();
+
+    /**
+     * @brief Returns the latest frame published by the client, waiting until the client publishes
+     * one after the previous call. The frame is valid until the next call.
+     *
+     * @return std::span<const uint8_t> Encoded LobbyMessage or GameMessage, as in a UDP datagram.
+     */
+    std::span<const uint8_t> read_frame();
+
+    /**
+     * @brief Passes an encoded input (as in a UDP datagram) to the client.
+     *
+     * @return bool False if the input is longer than SHM_INPUT_SIZE or the ring is full.
+     */
+    bool send_input(std::span<const uint8_t> bytes);
+
+    // Delete copy constructor and copy assignment.
+    SharedMemoryGuiPeer(SharedMemoryGuiPeer const &) = delete;
+
+    void operator=(SharedMemoryGuiPeer const &) = delete;
+
+private:
+    shared_gui_channel_t *channel;
+    // Frame owned by the gui.
+    uint32_t front_frame;
+    uint32_t last_sequence;
+};
+
+template<typename T>
+T SharedMemoryGuiHandler::read_next_packet_element() {
+    if (input_offset + sizeof(T) > input_size) {
+        throw SharedMemoryError("Attempt to read data out of input's bound!");
+    }
+
+    uint8_t temp_buff[sizeof(T)];
+    std::memcpy(temp_buff, input + input_offset, sizeof(T));
+    convert_network_to_host_byte_order<T>(temp_buff);
+    input_offset += sizeof(T);
+
+    T element;
+    std::memcpy(&element, temp_buff, sizeof(T));
+    return element;
+}
+
+template<typename T>
+void SharedMemoryGuiHandler::append_to_outcoming_packet(T element) {
+    if (send_len + sizeof(T) > SHM_FRAME_SIZE) {
+        throw SharedMemoryError("Data does not fit into the shared frame!");
+    }
+
+    uint8_t *frame = channel->frames[back_frame].bytes;
+    std::memcpy(frame + send_len, &element, sizeof(T));
+    convert_host_to_network_byte_order<T>(frame + send_len);
+    send_len += sizeof(T);
+}
+
+#endif // SHARED_MEMORY_HANDLER_H
@@ -0,0 +1,175 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <array>
+#include <sstream>
+#include <iostream>
+#include "socket_tuning.h"
+
+namespace {
+    enum Option {
+        NO_DELAY, QUICK_ACK, NOTSENT_LOWAT, BUSY_POLL, SNDBUF, RCVBUF, TOS, PRIORITY, OPTIONS_COUNT
+    };
+
+    // Value of an option which is not set, so that the kernel default is used.
+    const int KERNEL_DEFAULT = -1;
+
+    using profile_t = std::array<int, OPTIONS_COUNT>;
+
+    bool set_option(int socket_fd, int level, int name, int value) {
+        return setsockopt(socket_fd, level, name, &value, sizeof(value)) == 0;
+    }
+
+    bool set_no_delay(int socket_fd, int value) {
+        return set_option(socket_fd, IPPROTO_TCP, TCP_NODELAY, value);
+    }
+
+    bool set_quick_ack(int socket_fd, int value) {
+        return set_option(socket_fd, IPPROTO_TCP, TCP_QUICKACK, value);
+    }
+
+    bool set_notsent_lowat(int socket_fd, int value) {
+        return set_option(socket_fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, value);
+    }
+
+    bool set_busy_poll(int socket_fd, int value) {
+        return set_option(socket_fd, SOL_SOCKET, SO_BUSY_POLL, value);
+    }
+
+    bool set_sndbuf(int socket_fd, int value) {
+        return set_option(socket_fd, SOL_SOCKET, SO_SNDBUF, value);
+    }
+
+    bool set_rcvbuf(int socket_fd, int value) {
+        return set_option(socket_fd, SOL_SOCKET, SO_RCVBUF, value);
+    }
+
+    bool set_tos(int socket_fd, int value) {
+        int domain;
+        socklen_t domain_len = sizeof(domain);
+        if (getsockopt(socket_fd, SOL_SOCKET, SO_DOMAIN, &domain, &domain_len) != 0) {
+            return false;
+        }
+        if (domain == AF_INET6) {
+            // Dual-stack sockets take the IPv4 traffic class from IP_TOS.
+            set_option(socket_fd, IPPROTO_IP, IP_TOS, value);
+            return set_option(socket_fd, IPPROTO_IPV6, IPV6_TCLASS, value);
+        }
+        return set_option(socket_fd, IPPROTO_IP, IP_TOS, value);
+    }
+
+    bool set_priority(int socket_fd, int value) {
+        return set_option(socket_fd, SOL_SOCKET, SO_PRIORITY, value);
+    }
+
+    struct option_t {
+        const char *name;
+        // Whether the option applies to TCP sockets only.
+        bool tcp_only;
+        bool (*set)(int socket_fd, int value);
+    };
+
+    // Descriptions of the options in the order of Option.
+    const option_t OPTIONS[OPTIONS_COUNT] = {
+            {"TCP_NODELAY",       true,  set_no_delay},
+            {"TCP_QUICKACK",      true,  set_quick_ack},
+            {"TCP_NOTSENT_LOWAT", true,  set_notsent_lowat},
+            {"SO_BUSY_POLL",      false, set_busy_poll},
+            {"SO_SNDBUF",         false, set_sndbuf},
+            {"SO_RCVBUF",         false, set_rcvbuf},
+            {"IP_TOS",            false, set_tos},
+            {"SO_PRIORITY",       false, set_priority},
+    };
+
+    const std::string PROFILE_NAMES[] = {
+            options::SOCKET_PROFILE_DEFAULT, options::SOCKET_PROFILE_LATENCY,
+            options::SOCKET_PROFILE_THROUGHPUT, options::SOCKET_PROFILE_DENSE
+    };
+
+    // Values of the options in the order of Option, for every SocketProfile.
+    const profile_t PROFILES[] = {
+            // Default: Nagle's algorithm disabled only, as messages are flushed whole.
+            {1, KERNEL_DEFAULT, KERNEL_DEFAULT, KERNEL_DEFAULT, KERNEL_DEFAULT, KERNEL_DEFAULT,
+             KERNEL_DEFAULT, KERNEL_DEFAULT},
+            // Latency: acknowledge at once, poll the device queue before sleeping (microseconds),
+            // keep little unsent data queued, mark the packets Expedited Forwarding (DSCP 46).
+            {1, 1, 16384, 50, KERNEL_DEFAULT, KERNEL_DEFAULT, 46 << 2, 6},
+            // Throughput: large buffers for long turns on many players, DSCP AF11 (bulk data).
+            {1, KERNEL_DEFAULT, KERNEL_DEFAULT, KERNEL_DEFAULT, 4 << 20, 4 << 20, 10 << 2, KERNEL_DEFAULT},
+            // Dense: many mostly idle connections, small kernel buffers bound the memory of each one.
+            {1, KERNEL_DEFAULT, 4096, KERNEL_DEFAULT, 16384, 16384, KERNEL_DEFAULT, KERNEL_DEFAULT},
+    };
+
+    SocketProfile selected_profile = SocketProfile::Default;
+    profile_t selected = PROFILES[(size_t) SocketProfile::Default];
+
+    // Sets the options of the selected profile, skipping the ones for which skip returns true.
+    template<typename Skip>
+    bool tune_socket(int socket_fd, Skip skip) {
+        for (size_t i = 0; i < OPTIONS_COUNT; i++) {
+            if (selected[i] != KERNEL_DEFAULT && !skip((Option) i) && !OPTIONS[i].set(socket_fd, selected[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void SocketTuning::select_profile(SocketProfile profile) {
+    selected_profile = profile;
+    selected = PROFILES[(size_t) profile];
+
+    // Try every option on sockets of both kinds.
+    int tcp_fd = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+    int udp_fd = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    for (size_t i = 0; i < OPTIONS_COUNT; i++) {
+        if (selected[i] == KERNEL_DEFAULT) {
+            continue;
+        }
+        if (!OPTIONS[i].set(tcp_fd, selected[i]) ||
+            (!OPTIONS[i].tcp_only && !OPTIONS[i].set(udp_fd, selected[i]))) {
+            std::cerr << OPTIONS[i].name << " cannot be set (" << std::strerror(errno)
+                      << "), the kernel default is used instead.\n";
+            selected[i] = KERNEL_DEFAULT;
+        }
+    }
+    close(tcp_fd);
+    close(udp_fd);
+}
+
+std::string SocketTuning::describe_profile() {
+    std::stringstream description;
+    description << "Socket profile " << PROFILE_NAMES[(size_t) selected_profile] << ":";
+    for (size_t i = 0; i < OPTIONS_COUNT; i++) {
+        description << (i == 0 ? " " : ", ") << OPTIONS[i].name << " ";
+        if (selected[i] == KERNEL_DEFAULT) {
+            description << "default";
+        } else {
+            description << selected[i];
+        }
+    }
+    return description.str();
+}
+
+bool SocketTuning::tune_tcp_socket(int socket_fd) {
+    return tune_socket(socket_fd, [](Option) { return false; });
+}
+
+bool SocketTuning::tune_listening_socket(int socket_fd) {
+    return tune_socket(socket_fd, [](Option option) { return option != SNDBUF && option != RCVBUF; });
+}
+
+bool SocketTuning::tune_udp_socket(int socket_fd) {
+    return tune_socket(socket_fd, [](Option option) { return OPTIONS[option].tcp_only; });
+}
+
+void SocketTuning::rearm_quick_ack(int socket_fd) {
+    if (selected[QUICK_ACK] != KERNEL_DEFAULT) {
+        // Errors are not fatal, acknowledgements are only delayed.
+        set_quick_ack(socket_fd, selected[QUICK_ACK]);
+    }
+}
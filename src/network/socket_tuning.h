@@ -0,0 +1,62 @@
+/**
+ * @author Olaf Placha
+ * @brief This module applies the options of the selected socket tuning profile to the sockets
+ * created by the server and the client.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef SOCKET_TUNING_H
+#define SOCKET_TUNING_H
+
+#include <string>
+#include "../config/config.h"
+
+/**
+ * @brief Named sets of socket options (see SocketProfile), applied uniformly to every TCP and UDP
+ * socket. The profile is selected once at startup, before any socket is created.
+ */
+class SocketTuning {
+public:
+    /**
+     * @brief Selects the profile applied to sockets created afterwards. Options which cannot be set
+     * on this system (e.g. SO_BUSY_POLL without CAP_NET_ADMIN) are reported and left at the kernel
+     * defaults, so that they do not make every connection fail.
+     */
+    static void select_profile(SocketProfile profile);
+
+    /**
+     * @return std::string Name of the selected profile and the values of its options.
+     */
+    static std::string describe_profile();
+
+    /**
+     * @brief Applies the profile to a TCP socket, either connected or not yet connected.
+     *
+     * @return bool False with errno set if an option could not be set.
+     */
+    static bool tune_tcp_socket(int socket_fd);
+
+    /**
+     * @brief Applies the buffer sizes of the profile to a listening socket. Accepted sockets inherit
+     * them, and the receive buffer must be set before the handshake to get a matching window scale.
+     *
+     * @return bool False with errno set if an option could not be set.
+     */
+    static bool tune_listening_socket(int socket_fd);
+
+    /**
+     * @brief Applies the options of the profile not specific to TCP to a UDP socket.
+     *
+     * @return bool False with errno set if an option could not be set.
+     */
+    static bool tune_udp_socket(int socket_fd);
+
+    /**
+     * @brief The kernel leaves quick ack mode on its own, so the profiles using TCP_QUICKACK set it
+     * again after every receive. Does nothing for the other profiles.
+     */
+    static void rearm_quick_ack(int socket_fd);
+};
+
+#endif // SOCKET_TUNING_H
@@ -0,0 +1,27 @@
+#include <algorithm>
+#include "token_bucket.h"
+
+TokenBucket::TokenBucket(double rate_, double burst_) : rate(rate_), burst(std::max(burst_, 1.0)),
+                                                        tokens(burst), last_refill(clock_type::now()) {}
+
+bool TokenBucket::try_consume(clock_type::time_point now) {
+    if (!is_limited()) {
+        return true;
+    }
+
+    if (now > last_refill) {
+        double elapsed = std::chrono::duration<double>(now - last_refill).count();
+        last_refill = now;
+        tokens = std::min(burst, tokens + elapsed * rate);
+    }
+
+    if (tokens < 1) {
+        return false;
+    }
+    tokens--;
+    return true;
+}
+
+bool TokenBucket::is_limited() const {
+    return rate > 0;
+}
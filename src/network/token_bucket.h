@@ -0,0 +1,47 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides the token bucket limiting the rate of the messages a server accepts
+ * from a single connection.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <chrono>
+
+/**
+ * @brief Token bucket refilled with rate tokens per second up to burst tokens, every accepted
+ * message takes a token. Not thread-safe, each connection owns its bucket.
+ */
+class TokenBucket {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /**
+     * @brief Creates a full bucket.
+     *
+     * @param rate_ Tokens added per second, 0 disables the limit.
+     * @param burst_ Maximum number of tokens, at least 1 is held.
+     */
+    TokenBucket(double rate_, double burst_);
+
+    /**
+     * @brief Takes a token if there is one.
+     *
+     * @param now Current time, earlier times than the last one refill nothing.
+     * @return bool False if the message exceeds the limit.
+     */
+    bool try_consume(clock_type::time_point now);
+
+    bool is_limited() const;
+
+private:
+    double rate;
+    double burst;
+    double tokens;
+    clock_type::time_point last_refill;
+};
+
+#endif // TOKEN_BUCKET_H
@@ -0,0 +1,61 @@
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "tool_connections.h"
+
+void ToolConnection::open(int epoll_fd, size_t id, std::string &address, types::port_t port) {
+    handler = std::make_unique<TCPHandler>(address, port, TCP_BUFF_SIZE);
+    polls_output = false;
+
+    struct epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.u64 = id;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, handler->get_socket_fd(), &event) == -1) {
+        int error = errno;
+        handler.reset();
+        throw std::runtime_error(std::strerror(error));
+    }
+}
+
+void ToolConnection::close(int epoll_fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, handler->get_socket_fd(), nullptr);
+    handler.reset();
+}
+
+void ToolConnection::send_queued_messages(int epoll_fd, size_t id) {
+    // Poll for writability only while bytes are left in the queue.
+    bool polls_output_now = !handler->send_queued_messages();
+    if (polls_output_now != polls_output) {
+        struct epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP | (polls_output_now ? (uint32_t) EPOLLOUT : 0);
+        event.data.u64 = id;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, handler->get_socket_fd(), &event) == -1) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        polls_output = polls_output_now;
+    }
+}
+
+void raise_open_files_limit() {
+    struct rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+double percentile(std::vector<double> values, size_t p) {
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+void report_percentiles(const std::string &name, const std::vector<double> &values) {
+    if (values.empty()) {
+        std::cout << name << ": no samples." << std::endl;
+        return;
+    }
+    std::cout << name << ": p50 " << percentile(values, 50) << " ms, p99 " << percentile(values, 99)
+              << " ms, max " << percentile(values, 100) << " ms." << std::endl;
+}
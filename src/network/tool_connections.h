@@ -0,0 +1,97 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides what the tools driving a server share: the connections of the
+ * tools opening many of them (robots-replay, robots-load), the limit of open files and the
+ * reports of the measured latencies.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef TOOL_CONNECTIONS_H
+#define TOOL_CONNECTIONS_H
+
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "message_manager.h"
+
+/**
+ * @brief Connection to the server, one of many polled by a single epoll instance with the id of
+ * the connection as the event data. Messages queued on the handler are sent by send_queued_messages,
+ * which polls the socket for writability only while bytes are left in the queue.
+ */
+class ToolConnection {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    // nullptr until the connection is opened and after it is closed.
+    std::unique_ptr<TCPHandler> handler;
+
+    /**
+     * @brief Connects to the server and registers the socket for reading.
+     *
+     * @throws TCPError or std::runtime_error if it fails, the connection stays closed then.
+     */
+    void open(int epoll_fd, size_t id, std::string &address, types::port_t port);
+
+    void close(int epoll_fd);
+
+    /**
+     * @brief Sends as many of the queued messages as the socket takes.
+     *
+     * @throws TCPError or std::runtime_error if the connection fails.
+     */
+    void send_queued_messages(int epoll_fd, size_t id);
+
+    /**
+     * @brief Receives everything available and views the messages in the receive buffer.
+     *
+     * @param on_message Called with every complete message, its bytes and the time of receiving.
+     * @throws TCPError if the connection fails, DecodeError if the server sends an invalid message.
+     */
+    template<typename F>
+    void receive_server_messages(F on_message);
+
+private:
+    // Whether the socket is polled for writability, as queued bytes are waiting.
+    bool polls_output = false;
+};
+
+template<typename F>
+void ToolConnection::receive_server_messages(F on_message) {
+    bool drained = false;
+    while (!drained) {
+        drained = handler->receive_available();
+        auto now = clock_type::now();
+
+        while (true) {
+            std::span<const uint8_t> bytes = handler->get_buffered_bytes();
+            MessageDecoder decoder(bytes);
+            StreamResult<ServerMessageView> message = ClientMessageManager::try_view_server_message(decoder);
+            if (message.status() == StreamStatus::Incomplete) {
+                break;
+            }
+            if (!message) {
+                // The rest of the stream cannot be decoded.
+                throw DecodeError(message.what());
+            }
+
+            size_t size = bytes.size() - decoder.get_remaining_bytes_count();
+            on_message(*message, bytes.first(size), now);
+            handler->consume_buffered_bytes(size);
+        }
+    }
+}
+
+/* Raises the limit of open files to the hard limit, so that the process can hold many connections. */
+void raise_open_files_limit();
+
+/* Returns the p-th percentile of the values, which must not be empty. */
+double percentile(std::vector<double> values, size_t p);
+
+/* Prints the median, the 99th percentile and the maximum of the milliseconds. */
+void report_percentiles(const std::string &name, const std::vector<double> &values);
+
+#endif // TOOL_CONNECTIONS_H
@@ -0,0 +1,127 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include "traffic_capture.h"
+
+static void write_all(int fd, std::span<const uint8_t> bytes) {
+    while (!bytes.empty()) {
+        ssize_t written = write(fd, bytes.data(), bytes.size());
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw TrafficCaptureError(std::strerror(errno));
+        }
+        bytes = bytes.subspan((size_t) written);
+    }
+}
+
+TrafficCapture::TrafficCapture(const std::string &path) : buffered_bytes(0), stopped(false) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        throw TrafficCaptureError(std::strerror(errno));
+    }
+    last_record = last_flush = clock_type::now();
+
+    buffer.send_element<uint32_t>(TRAFFIC_CAPTURE_MAGIC);
+    buffered_bytes = sizeof(uint32_t);
+}
+
+TrafficCapture::~TrafficCapture() {
+    flush();
+    close(fd);
+}
+
+void TrafficCapture::write_buffer() {
+    MessageEncoder::message_t bytes = buffer.get_encoded_message();
+    buffered_bytes = 0;
+    last_flush = clock_type::now();
+    try {
+        write_all(fd, *bytes);
+    }
+    catch (const TrafficCaptureError &e) {
+        // The clients are still served, only the capture stops.
+        std::cerr << "Traffic capture stopped: " << e.what() << '\n';
+        stopped = true;
+    }
+}
+
+void TrafficCapture::record(uint32_t connection_id, std::span<const uint8_t> message) {
+    std::lock_guard<std::mutex> lock_guard(mutex);
+    if (stopped) {
+        return;
+    }
+
+    auto now = clock_type::now();
+    auto delta = std::chrono::duration_cast<std::chrono::microseconds>(now - last_record).count();
+    last_record = now;
+
+    buffer.send_element<uint32_t>(connection_id);
+    buffer.send_element<uint32_t>((uint32_t) std::min<int64_t>(delta, UINT32_MAX));
+    buffer.send_element<uint16_t>((uint16_t) message.size());
+    buffer.send_bytes(message);
+    buffered_bytes += 2 * sizeof(uint32_t) + sizeof(uint16_t) + message.size();
+
+    if (buffered_bytes >= CAPTURE_BUFFER_SIZE ||
+        now - last_flush >= std::chrono::milliseconds(CAPTURE_FLUSH_INTERVAL)) {
+        write_buffer();
+    }
+}
+
+void TrafficCapture::flush() {
+    std::lock_guard<std::mutex> lock_guard(mutex);
+
+    if (!stopped && buffered_bytes > 0) {
+        write_buffer();
+    }
+}
+
+std::vector<TrafficCapture::record_t> TrafficCapture::read(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw TrafficCaptureError(std::strerror(errno));
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[CAPTURE_BUFFER_SIZE];
+    ssize_t received;
+    while ((received = ::read(fd, chunk, sizeof(chunk))) != 0) {
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            throw TrafficCaptureError(std::strerror(errno));
+        }
+        bytes.insert(bytes.end(), chunk, chunk + received);
+    }
+    close(fd);
+
+    std::vector<record_t> records;
+    try {
+        MessageDecoder decoder(bytes);
+        if (decoder.read_element<uint32_t>() != TRAFFIC_CAPTURE_MAGIC) {
+            throw TrafficCaptureError("Not a traffic capture!");
+        }
+
+        uint64_t time = 0;
+        while (decoder.get_remaining_bytes_count() > 0) {
+            record_t record;
+            record.connection_id = decoder.read_element<uint32_t>();
+            time += decoder.read_element<uint32_t>();
+            record.time = time;
+            record.message.resize(decoder.read_element<uint16_t>());
+            decoder.read_bytes(record.message);
+            records.push_back(std::move(record));
+        }
+    }
+    catch (const DecodeError &e) {
+        // A capture of a server which was killed may end with a partial record.
+        if (records.empty()) {
+            throw TrafficCaptureError("Not a traffic capture!");
+        }
+    }
+    return records;
+}
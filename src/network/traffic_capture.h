@@ -0,0 +1,99 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides the capture of the messages received by the server from its clients,
+ * which the replay tool sends again to reproduce the load of real players.
+ *
+ * The file starts with TRAFFIC_CAPTURE_MAGIC (u32) and is followed by records, all in network
+ * byte order:
+ *
+ * - u32 id of the connection, assigned in the order in which the connections were opened,
+ * - u32 microseconds since the previous record (since the start of the capture for the first one),
+ * - u16 length of the message,
+ * - the message encoded as sent by the client, starting with its code.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef TRAFFIC_CAPTURE_H
+#define TRAFFIC_CAPTURE_H
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cinttypes>
+#include "../config/config.h"
+#include "network_handler.h"
+
+class TrafficCaptureError : public std::runtime_error {
+public:
+    explicit TrafficCaptureError(const char *w) : std::runtime_error(w) {}
+};
+
+class TrafficCapture {
+public:
+    using ptr = std::shared_ptr<TrafficCapture>;
+
+    struct record_t {
+        uint32_t connection_id;
+        // Microseconds since the start of the capture.
+        uint64_t time;
+        std::vector<uint8_t> message;
+    };
+
+    /**
+     * @brief Creates the capture file, replacing an existing one.
+     *
+     * @throws TrafficCaptureError.
+     */
+    explicit TrafficCapture(const std::string &path);
+
+    /**
+     * @brief Writes the buffered records and closes the file.
+     */
+    ~TrafficCapture();
+
+    /**
+     * @brief Appends a record. Records are buffered and written when CAPTURE_BUFFER_SIZE bytes
+     * are buffered or CAPTURE_FLUSH_INTERVAL milliseconds passed since the last write. Thread-safe.
+     * If a write fails, the error is logged once and the capture stops, later records are dropped.
+     */
+    void record(uint32_t connection_id, std::span<const uint8_t> message);
+
+    /**
+     * @brief Writes the buffered records, stopping the capture as record does if it fails.
+     * Thread-safe.
+     */
+    void flush();
+
+    /**
+     * @brief Reads all the records of a capture file.
+     *
+     * @throws TrafficCaptureError - Also thrown when the file is not a capture.
+     */
+    static std::vector<record_t> read(const std::string &path);
+
+    // Delete copy constructor and copy assignment.
+    TrafficCapture(TrafficCapture const &) = delete;
+
+    void operator=(TrafficCapture const &) = delete;
+
+private:
+    using clock_type = std::chrono::steady_clock;
+
+    std::mutex mutex;
+    int fd;
+    MessageEncoder buffer;
+    size_t buffered_bytes;
+    clock_type::time_point last_record;
+    clock_type::time_point last_flush;
+    // Set after a write fails, nothing is recorded then.
+    bool stopped;
+
+    void write_buffer();
+};
+
+#endif // TRAFFIC_CAPTURE_H
@@ -0,0 +1,314 @@
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "turn_channel.h"
+#include "socket_tuning.h"
+
+namespace {
+    // Game identifier and number of turns.
+    const size_t DATAGRAM_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint8_t);
+    const size_t ACK_SIZE = sizeof(uint32_t) + sizeof(types::turn_t);
+
+    int open_udp_socket(types::port_t port) {
+        int fd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+        if (fd == -1) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        if (!SocketTuning::tune_udp_socket(fd)) {
+            close(fd);
+            throw std::runtime_error(std::strerror(errno));
+        }
+
+        struct sockaddr_in6 address{};
+        address.sin6_family = AF_INET6;
+        address.sin6_addr = in6addr_any;
+        address.sin6_port = htons(port);
+        if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+            close(fd);
+            throw std::runtime_error(std::strerror(errno));
+        }
+        return fd;
+    }
+
+    types::port_t get_socket_port(int fd) {
+        struct sockaddr_in6 address{};
+        socklen_t address_len = sizeof(address);
+        if (getsockname(fd, (struct sockaddr *) &address, &address_len) != 0) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+        return ntohs(address.sin6_port);
+    }
+
+    bool same_address(const struct sockaddr_in6 &a, const struct sockaddr_in6 &b) {
+        return a.sin6_port == b.sin6_port && std::memcmp(&a.sin6_addr, &b.sin6_addr, sizeof(a.sin6_addr)) == 0;
+    }
+
+    template<typename T>
+    void append_element(std::vector<uint8_t> &bytes, T element) {
+        size_t offset = bytes.size();
+        bytes.resize(offset + sizeof(T));
+        std::memcpy(bytes.data() + offset, &element, sizeof(T));
+        convert_host_to_network_byte_order<T>(bytes.data() + offset);
+    }
+}
+
+TurnChannelServer::TurnChannelServer(types::port_t port) : socket_fd(open_udp_socket(port)), game_id(0) {}
+
+TurnChannelServer::TurnChannelServer(int socket_fd_, uint32_t game_id_, std::vector<MessageEncoder::message_t> turns_) :
+        socket_fd(socket_fd_), game_id(game_id_) {
+    for (auto &turn: turns_) {
+        turns.push_back(fits_datagram(turn) ? std::move(turn) : nullptr);
+    }
+}
+
+TurnChannelServer::~TurnChannelServer() {
+    close(socket_fd);
+}
+
+types::port_t TurnChannelServer::get_port() const {
+    return get_socket_port(socket_fd);
+}
+
+int TurnChannelServer::get_socket_fd() const {
+    return socket_fd;
+}
+
+bool TurnChannelServer::fits_datagram(const MessageEncoder::message_t &turn) {
+    return turn->size() <= TURN_DATAGRAM_SIZE - DATAGRAM_HEADER_SIZE;
+}
+
+void TurnChannelServer::subscribe(const struct sockaddr_in6 &address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &subscriber: subscribers) {
+        if (same_address(subscriber.address, address)) {
+            return;
+        }
+    }
+    // Nothing is acknowledged yet, so the turns already published are sent on the next resend.
+    subscribers.push_back({address, 0, clock_type::time_point()});
+}
+
+void TurnChannelServer::unsubscribe(const struct sockaddr_in6 &address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::erase_if(subscribers, [&address](const subscriber_t &subscriber) {
+        return same_address(subscriber.address, address);
+    });
+}
+
+void TurnChannelServer::start_game(uint32_t game_id_) {
+    std::lock_guard<std::mutex> lock(mutex);
+    game_id = game_id_;
+    turns.clear();
+    for (auto &subscriber: subscribers) {
+        subscriber.acked = 0;
+    }
+}
+
+void TurnChannelServer::publish_turn(const MessageEncoder::message_t &turn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    turns.push_back(fits_datagram(turn) ? turn : nullptr);
+
+    size_t last = turns.size();
+    size_t window = std::min<size_t>(last, TURN_REDUNDANCY + 1);
+    for (auto &subscriber: subscribers) {
+        send_turns(subscriber, std::max(subscriber.acked, last - window), last);
+    }
+}
+
+void TurnChannelServer::send_turns(subscriber_t &subscriber, size_t first, size_t last) {
+    // Take the newest turns which fit.
+    size_t size = DATAGRAM_HEADER_SIZE;
+    size_t count = 0;
+    size_t begin = last;
+    while (begin > first && count < UINT8_MAX) {
+        const MessageEncoder::message_t &turn = turns[begin - 1];
+        if (turn) {
+            if (size + turn->size() > TURN_DATAGRAM_SIZE) {
+                break;
+            }
+            size += turn->size();
+            count++;
+        }
+        begin--;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<uint8_t> datagram;
+    datagram.reserve(size);
+    append_element<uint32_t>(datagram, game_id);
+    append_element<uint8_t>(datagram, (uint8_t) count);
+    for (size_t i = begin; i < last; i++) {
+        if (turns[i]) {
+            datagram.insert(datagram.end(), turns[i]->begin(), turns[i]->end());
+        }
+    }
+
+    // Errors are not fatal, lost turns are sent again.
+    sendto(socket_fd, datagram.data(), datagram.size(), MSG_DONTWAIT, (struct sockaddr *) &subscriber.address,
+           sizeof(subscriber.address));
+    subscriber.last_sent = clock_type::now();
+}
+
+void TurnChannelServer::run() {
+    uint8_t buffer[ACK_SIZE + 1];
+    while (true) {
+        struct pollfd fd{socket_fd, POLLIN, 0};
+        if (poll(&fd, 1, TURN_RESEND_TIMEOUT) == -1 && errno != EINTR) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+
+        // Handle all the queued acknowledgements.
+        while (true) {
+            struct sockaddr_in6 address{};
+            socklen_t address_len = sizeof(address);
+            ssize_t received = recvfrom(socket_fd, buffer, sizeof(buffer), MSG_DONTWAIT,
+                                        (struct sockaddr *) &address, &address_len);
+            if (received == -1) {
+                break;
+            }
+            handle_ack(address, {buffer, (size_t) received});
+        }
+
+        resend_unacked_turns();
+    }
+}
+
+void TurnChannelServer::handle_ack(const struct sockaddr_in6 &address, std::span<const uint8_t> datagram) {
+    if (datagram.size() != ACK_SIZE) {
+        // Ignore.
+        return;
+    }
+    MessageDecoder decoder(datagram);
+    auto ack_game_id = decoder.read_element<uint32_t>();
+    auto received = decoder.read_element<types::turn_t>();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ack_game_id != game_id) {
+        return;
+    }
+    for (auto &subscriber: subscribers) {
+        if (same_address(subscriber.address, address)) {
+            subscriber.acked = std::max(subscriber.acked, std::min<size_t>(received, turns.size()));
+        }
+    }
+}
+
+void TurnChannelServer::resend_unacked_turns() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = clock_type::now();
+    for (auto &subscriber: subscribers) {
+        if (subscriber.acked < turns.size() &&
+            now - subscriber.last_sent >= std::chrono::milliseconds(TURN_RESEND_TIMEOUT)) {
+            // Fill the gap from its beginning.
+            send_turns(subscriber, subscriber.acked,
+                       std::min<size_t>(subscriber.acked + TURN_REDUNDANCY + 1, turns.size()));
+        }
+    }
+}
+
+TurnChannelClient::TurnChannelClient(types::port_t port) :
+        socket_fd(open_udp_socket(port)), next_turn(0), datagram(TURN_DATAGRAM_SIZE) {}
+
+TurnChannelClient::~TurnChannelClient() {
+    close(socket_fd);
+}
+
+int TurnChannelClient::get_socket_fd() const {
+    return socket_fd;
+}
+
+types::port_t TurnChannelClient::get_port() const {
+    return get_socket_port(socket_fd);
+}
+
+void TurnChannelClient::receive_datagrams() {
+    while (true) {
+        struct sockaddr_in6 address{};
+        socklen_t address_len = sizeof(address);
+        ssize_t received = recvfrom(socket_fd, datagram.data(), datagram.size(), MSG_DONTWAIT,
+                                    (struct sockaddr *) &address, &address_len);
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        try {
+            if (handle_datagram({datagram.data(), (size_t) received})) {
+                send_ack(address);
+            }
+        }
+        catch (const DecodeError &e) {
+            // Ignore malformed datagrams.
+        }
+    }
+}
+
+bool TurnChannelClient::handle_datagram(std::span<const uint8_t> bytes) {
+    MessageDecoder decoder(bytes);
+    auto datagram_game_id = decoder.read_element<uint32_t>();
+    auto count = decoder.read_element<uint8_t>();
+
+    if (game_id ? *game_id != datagram_game_id : finished_game_id && datagram_game_id <= *finished_game_id) {
+        // Turns of the previous game, or of the next one, which are sent again after it starts here.
+        return false;
+    }
+    game_id = datagram_game_id;
+
+    for (size_t i = 0; i < count; i++) {
+        if (decoder.read_element<types::message_id_t>() != clientServerCodes::turn) {
+            throw DecodeError("Turn expected in the datagram!");
+        }
+        accept_turn(Turn(decoder));
+    }
+    return true;
+}
+
+void TurnChannelClient::send_ack(const struct sockaddr_in6 &address) {
+    size_t received = next_turn;
+    while (turns.contains(received)) {
+        received++;
+    }
+
+    std::vector<uint8_t> ack;
+    append_element<uint32_t>(ack, *game_id);
+    append_element<types::turn_t>(ack, (types::turn_t) received);
+    // Errors are not fatal, the turns are sent again.
+    sendto(socket_fd, ack.data(), ack.size(), MSG_DONTWAIT, (const struct sockaddr *) &address, sizeof(address));
+}
+
+void TurnChannelClient::accept_turn(Turn &&turn) {
+    if (turn.turn >= next_turn) {
+        turns.try_emplace(turn.turn, std::move(turn));
+    }
+}
+
+bool TurnChannelClient::has_next_turn() const {
+    return turns.contains(next_turn);
+}
+
+size_t TurnChannelClient::get_next_turn() const {
+    return next_turn;
+}
+
+Turn TurnChannelClient::take_next_turn() {
+    auto node = turns.extract(next_turn);
+    next_turn++;
+    return std::move(node.mapped());
+}
+
+void TurnChannelClient::end_game() {
+    if (game_id) {
+        finished_game_id = game_id;
+    }
+    game_id.reset();
+    turns.clear();
+    next_turn = 0;
+}
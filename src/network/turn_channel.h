@@ -0,0 +1,190 @@
+/**
+ * @author Olaf Placha
+ * @brief This module provides delivery of turns over UDP, so that a lost segment does not stall
+ * the following turns as it does over TCP.
+ *
+ * A client subscribes with SubscribeTurns sent over TCP, all the other messages are still sent
+ * over TCP. Every datagram holds the newest turn together with up to TURN_REDUNDANCY earlier ones
+ * the client has not acknowledged, so a single lost datagram is made up for by the next one.
+ * Turns still unacknowledged after TURN_RESEND_TIMEOUT milliseconds are sent again.
+ *
+ * Datagram with turns: game identifier (uint32), number of turns (uint8) and the turns encoded as
+ * over TCP, oldest first. Acknowledgement: game identifier (uint32) and the number of turns of the
+ * game the client has received without gaps (turn_t).
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef TURN_CHANNEL_H
+#define TURN_CHANNEL_H
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <netinet/in.h>
+#include "../config/config.h"
+#include "network_handler.h"
+#include "messages.h"
+
+/**
+ * @brief Server side of the channel. Turns are published by the thread running the game, while
+ * run() receives acknowledgements and sends the lost turns again.
+ */
+class TurnChannelServer {
+public:
+    using ptr = std::shared_ptr<TurnChannelServer>;
+
+    /**
+     * @brief Opens the UDP socket of the channel.
+     *
+     * @param port Port of the socket, 0 for any.
+     */
+    explicit TurnChannelServer(types::port_t port);
+
+    /**
+     * @brief Takes over the socket of a channel handed over by another server, together with the
+     * turns of the current game. Subscribers have to subscribe again.
+     */
+    TurnChannelServer(int socket_fd, uint32_t game_id, std::vector<MessageEncoder::message_t> turns);
+
+    ~TurnChannelServer();
+
+    [[nodiscard]] types::port_t get_port() const;
+
+    [[nodiscard]] int get_socket_fd() const;
+
+    /**
+     * @return bool True if the encoded turn is sent over UDP. Turns which do not fit into a datagram
+     * must be sent over TCP to subscribed clients too.
+     */
+    static bool fits_datagram(const MessageEncoder::message_t &turn);
+
+    /**
+     * @brief Starts sending turns to the address. Turns of the current game are sent from the
+     * beginning, as they are not sent over TCP to the client anymore.
+     */
+    void subscribe(const struct sockaddr_in6 &address);
+
+    void unsubscribe(const struct sockaddr_in6 &address);
+
+    /**
+     * @brief Forgets the turns of the previous game.
+     */
+    void start_game(uint32_t game_id);
+
+    /**
+     * @brief Sends the next turn of the current game to every subscriber.
+     */
+    void publish_turn(const MessageEncoder::message_t &turn);
+
+    /**
+     * @brief Receives acknowledgements and sends again the turns which were not acknowledged in
+     * time. Never returns.
+     */
+    [[noreturn]] void run();
+
+    // Delete copy constructor and copy assignment.
+    TurnChannelServer(TurnChannelServer const &) = delete;
+
+    void operator=(TurnChannelServer const &) = delete;
+
+private:
+    using clock_type = std::chrono::steady_clock;
+
+    struct subscriber_t {
+        struct sockaddr_in6 address;
+        // Number of turns of the current game acknowledged by the client.
+        size_t acked;
+        clock_type::time_point last_sent;
+    };
+
+    int socket_fd;
+    std::mutex mutex;
+    uint32_t game_id;
+    // Encoded turns of the current game, nullptr for the ones which do not fit into a datagram.
+    std::vector<MessageEncoder::message_t> turns;
+    std::vector<subscriber_t> subscribers;
+
+    // Sends the turns [first, last) in one datagram, leaving out the oldest ones if they do not fit.
+    void send_turns(subscriber_t &subscriber, size_t first, size_t last);
+
+    void handle_ack(const struct sockaddr_in6 &address, std::span<const uint8_t> datagram);
+
+    void resend_unacked_turns();
+};
+
+/**
+ * @brief Client side of the channel. Turns received over UDP and over TCP are put together, so
+ * that they are handed over once each and in order.
+ */
+class TurnChannelClient {
+public:
+    /**
+     * @brief Opens the UDP socket on which turns are received.
+     *
+     * @param port Port of the socket, sent to the server with SubscribeTurns.
+     */
+    explicit TurnChannelClient(types::port_t port);
+
+    ~TurnChannelClient();
+
+    [[nodiscard]] int get_socket_fd() const;
+
+    [[nodiscard]] types::port_t get_port() const;
+
+    /**
+     * @brief Receives all the queued datagrams without blocking, keeps their turns and
+     * acknowledges them.
+     */
+    void receive_datagrams();
+
+    /**
+     * @brief Keeps a turn received over TCP.
+     */
+    void accept_turn(Turn &&turn);
+
+    /**
+     * @return bool True if the next turn of the game has been received.
+     */
+    [[nodiscard]] bool has_next_turn() const;
+
+    /**
+     * @return size_t Number of turns of the game handed over.
+     */
+    [[nodiscard]] size_t get_next_turn() const;
+
+    /**
+     * @brief Hands over the next turn of the game. Must be called only if has_next_turn().
+     */
+    Turn take_next_turn();
+
+    /**
+     * @brief Forgets the turns of the game which ended, later datagrams with them are ignored.
+     */
+    void end_game();
+
+    // Delete copy constructor and copy assignment.
+    TurnChannelClient(TurnChannelClient const &) = delete;
+
+    void operator=(TurnChannelClient const &) = delete;
+
+private:
+    int socket_fd;
+    // Game of the kept turns, unknown until the first datagram of the game arrives.
+    std::optional<uint32_t> game_id;
+    std::optional<uint32_t> finished_game_id;
+    size_t next_turn;
+    // Received turns which have not been handed over yet.
+    std::map<size_t, Turn> turns;
+    std::vector<uint8_t> datagram;
+
+    // Returns false if the datagram is of another game.
+    bool handle_datagram(std::span<const uint8_t> bytes);
+
+    void send_ack(const struct sockaddr_in6 &address);
+};
+
+#endif // TURN_CHANNEL_H
@@ -0,0 +1,355 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string_view>
+
+#include "config/config.h"
+#include "config/parser.h"
+#include "network/message_manager.h"
+#include "network/tool_connections.h"
+#include "network/traffic_capture.h"
+#include "network/turn_channel.h"
+
+using clock_type = std::chrono::steady_clock;
+
+// Set in the event data of the turn channel sockets, next to the id of the connection.
+const uint64_t TURN_CHANNEL_EVENT = 1ULL << 63;
+
+// Message of a captured connection, sent by one of the replaying connections.
+struct scheduled_message {
+    // Microseconds since the start of the replay.
+    uint64_t time;
+    size_t connection;
+    MessageEncoder::message_t message;
+};
+
+// Opened when it sends its first message.
+struct replay_connection : ToolConnection {
+    clock_type::time_point opened_at;
+    bool closed = false;
+    // nullptr until the connection subscribes to the turns sent over UDP.
+    std::unique_ptr<TurnChannelClient> turn_channel;
+};
+
+// Times at which the same turn arrived at the first and the last connection.
+struct turn_arrival {
+    clock_type::time_point first;
+    clock_type::time_point last;
+};
+
+struct replay_stats {
+    uint64_t sent_messages = 0;
+    uint64_t received_turns = 0;
+    uint64_t failed_connections = 0;
+    // Turns are identified by their number and the hash of their bytes, as games repeat the numbers.
+    std::map<std::pair<types::turn_t, size_t>, turn_arrival> turns;
+    // Milliseconds by which every delivery of a turn lagged behind its first delivery. Turns sent
+    // to a connection opened after their first delivery, as a part of the history, are skipped.
+    std::vector<double> lags;
+};
+
+// Returns the CPU time (user and system) used by the process in seconds or -1 if it is not known.
+static double read_cpu_time(pid_t pid) {
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat;
+    if (!std::getline(file, stat)) {
+        return -1;
+    }
+
+    // The name of the process is in parentheses and may contain spaces. It is followed by the
+    // state, which is the 3rd field, while utime and stime are the 14th and 15th.
+    std::istringstream fields(stat.substr(stat.rfind(')') + 1));
+    std::string skipped;
+    for (int field = 3; field < 14; field++) {
+        fields >> skipped;
+    }
+    uint64_t utime, stime;
+    if (!(fields >> utime >> stime)) {
+        return -1;
+    }
+    return (double) (utime + stime) / (double) sysconf(_SC_CLK_TCK);
+}
+
+static std::vector<scheduled_message> schedule_messages(const std::vector<TrafficCapture::record_t> &records,
+                                                        const options_replay &options, size_t &connections_count) {
+    // Captured connections in the order of their first messages.
+    std::map<uint32_t, size_t> captured_ids;
+    std::vector<std::vector<const TrafficCapture::record_t *>> captured;
+    for (auto &record: records) {
+        auto [it, inserted] = captured_ids.insert({record.connection_id, captured.size()});
+        if (inserted) {
+            captured.emplace_back();
+        }
+        captured[it->second].push_back(&record);
+    }
+
+    connections_count = options.connections > 0 ? options.connections : captured.size();
+    std::vector<MessageEncoder::message_t> messages;
+    messages.reserve(records.size());
+    for (auto &record: records) {
+        messages.push_back(std::make_shared<const std::vector<uint8_t>>(record.message));
+    }
+
+    std::vector<scheduled_message> schedule;
+    for (size_t connection = 0; connection < connections_count; connection++) {
+        for (const TrafficCapture::record_t *record: captured[connection % captured.size()]) {
+            uint64_t time = options.speed > 0 ? record->time / options.speed : 0;
+            schedule.push_back({time, connection, messages[(size_t) (record - records.data())]});
+        }
+    }
+    // Messages of every connection stay in the captured order.
+    std::stable_sort(schedule.begin(), schedule.end(), [](auto &a, auto &b) { return a.time < b.time; });
+    return schedule;
+}
+
+// Records the arrival of a turn, told apart from the others by the hash of its bytes.
+static void record_turn(replay_connection &connection, types::turn_t turn, std::span<const uint8_t> bytes,
+                        clock_type::time_point now, replay_stats &stats) {
+    stats.received_turns++;
+    size_t hash = std::hash<std::string_view>()({(const char *) bytes.data(), bytes.size()});
+
+    auto [it, inserted] = stats.turns.insert({{turn, hash}, {now, now}});
+    if (connection.opened_at > it->second.first) {
+        return;
+    }
+    it->second.last = now;
+    stats.lags.push_back(std::chrono::duration<double, std::milli>(now - it->second.first).count());
+}
+
+// Records the arrival of the turns the channel of the connection hands over, in order as the
+// client would. Their bytes are encoded again, as sent over TCP.
+static void take_channel_turns(replay_connection &connection, clock_type::time_point now, replay_stats &stats) {
+    while (connection.turn_channel->has_next_turn()) {
+        Turn turn = connection.turn_channel->take_next_turn();
+        MessageEncoder::message_t bytes = encode_client_message(turn);
+        record_turn(connection, turn.turn, *bytes, now, stats);
+    }
+}
+
+static void close_connection(int epoll_fd, replay_connection &connection, replay_stats &stats) {
+    if (connection.turn_channel) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection.turn_channel->get_socket_fd(), nullptr);
+        connection.turn_channel.reset();
+    }
+    connection.close(epoll_fd);
+    connection.closed = true;
+    stats.failed_connections++;
+}
+
+static void send_messages(int epoll_fd, size_t id, replay_connection &connection, replay_stats &stats) {
+    try {
+        connection.send_queued_messages(epoll_fd, id);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Connection " << id << ": " << e.what() << '\n';
+        close_connection(epoll_fd, connection, stats);
+    }
+}
+
+// Records the arrival of the turns received. The messages are viewed in the receive buffer, as
+// only turns are inspected.
+static void receive_messages(int epoll_fd, size_t id, replay_connection &connection, replay_stats &stats) {
+    try {
+        connection.receive_server_messages(
+                [&](const ServerMessageView &message, std::span<const uint8_t> bytes, clock_type::time_point now) {
+                    if (const auto *turn = std::get_if<TurnView>(&message)) {
+                        if (!connection.turn_channel) {
+                            record_turn(connection, turn->turn, bytes, now, stats);
+                            return;
+                        }
+                        // Turns which do not fit into a datagram, or sent before the subscription.
+                        connection.turn_channel->accept_turn(Turn(*turn));
+                        take_channel_turns(connection, now, stats);
+                    } else if (connection.turn_channel && std::holds_alternative<GameEndedView>(message)) {
+                        // Turns of the game still on their way over UDP are not counted.
+                        connection.turn_channel->receive_datagrams();
+                        take_channel_turns(connection, now, stats);
+                        connection.turn_channel->end_game();
+                    }
+                });
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Connection " << id << ": " << e.what() << '\n';
+        close_connection(epoll_fd, connection, stats);
+    }
+}
+
+static void receive_datagrams(replay_connection &connection, replay_stats &stats) {
+    connection.turn_channel->receive_datagrams();
+    take_channel_turns(connection, clock_type::now(), stats);
+}
+
+// Returns SubscribeTurns with the port of the UDP socket of the connection, opened on the first
+// subscription, instead of the captured one, which belonged to the captured client.
+static MessageEncoder::message_t subscribe_to_turns(int epoll_fd, size_t id, replay_connection &connection) {
+    if (!connection.turn_channel) {
+        connection.turn_channel = std::make_unique<TurnChannelClient>(0);
+
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id | TURN_CHANNEL_EVENT;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection.turn_channel->get_socket_fd(), &event) == -1) {
+            int error = errno;
+            connection.turn_channel.reset();
+            throw std::runtime_error(std::strerror(error));
+        }
+    }
+    return ClientMessageManager::encode_server_message(SubscribeTurns(connection.turn_channel->get_port()));
+}
+
+static void open_connection(int epoll_fd, size_t id, replay_connection &connection, options_replay &options,
+                            replay_stats &stats) {
+    try {
+        connection.open(epoll_fd, id, options.server_address, options.server_port);
+        connection.opened_at = clock_type::now();
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Connection " << id << ": " << e.what() << '\n';
+        connection.closed = true;
+        stats.failed_connections++;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    options_replay options = parse_replay(argc, argv);
+
+    std::vector<TrafficCapture::record_t> records;
+    try {
+        records = TrafficCapture::read(options.capture_path);
+    }
+    catch (const TrafficCaptureError &e) {
+        std::cerr << e.what() << '\n';
+        exit(EXIT_FAILURE);
+    }
+    if (records.empty()) {
+        std::cerr << "The capture holds no messages!\n";
+        exit(EXIT_FAILURE);
+    }
+
+    size_t connections_count;
+    std::vector<scheduled_message> schedule = schedule_messages(records, options, connections_count);
+    std::vector<replay_connection> connections(connections_count);
+    replay_stats stats;
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        std::cerr << std::strerror(errno) << '\n';
+        exit(EXIT_FAILURE);
+    }
+
+    double cpu_before = options.server_pid > 0 ? read_cpu_time(options.server_pid) : -1;
+    auto start = clock_type::now();
+    // Time of the last message sent or received, the replay ends REPLAY_DRAIN_TIMEOUT after it.
+    auto last_activity = start;
+    size_t next_message = 0;
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+
+    while (true) {
+        auto now = clock_type::now();
+
+        // Send the messages that are due. Connections are opened just before their first message.
+        while (next_message < schedule.size() &&
+               start + std::chrono::microseconds(schedule[next_message].time) <= now) {
+            scheduled_message &scheduled = schedule[next_message++];
+            replay_connection &connection = connections[scheduled.connection];
+            if (!connection.handler && !connection.closed) {
+                open_connection(epoll_fd, scheduled.connection, connection, options, stats);
+            }
+            if (connection.closed) {
+                continue;
+            }
+            MessageEncoder::message_t message = scheduled.message;
+            if (message->front() == serverClientCodes::subscribeTurns) {
+                try {
+                    message = subscribe_to_turns(epoll_fd, scheduled.connection, connection);
+                }
+                catch (const std::exception &e) {
+                    std::cerr << "Connection " << scheduled.connection << ": " << e.what() << '\n';
+                    close_connection(epoll_fd, connection, stats);
+                    continue;
+                }
+            }
+            connection.handler->queue_encoded_message(message);
+            stats.sent_messages++;
+            last_activity = now;
+            send_messages(epoll_fd, scheduled.connection, connection, stats);
+        }
+
+        int timeout;
+        if (next_message < schedule.size()) {
+            auto due = start + std::chrono::microseconds(schedule[next_message].time);
+            timeout = (int) std::chrono::ceil<std::chrono::milliseconds>(due - now).count();
+        } else {
+            auto deadline = last_activity + std::chrono::milliseconds(REPLAY_DRAIN_TIMEOUT);
+            if (now >= deadline) {
+                break;
+            }
+            timeout = (int) std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+        }
+
+        int n = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, std::max(timeout, 0));
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << std::strerror(errno) << '\n';
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < n; i++) {
+            auto id = (size_t) (events[i].data.u64 & ~TURN_CHANNEL_EVENT);
+            replay_connection &connection = connections[id];
+            if (connection.closed) {
+                continue;
+            }
+            if (events[i].data.u64 & TURN_CHANNEL_EVENT) {
+                receive_datagrams(connection, stats);
+                last_activity = clock_type::now();
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                send_messages(epoll_fd, id, connection, stats);
+            }
+            if (!connection.closed && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                receive_messages(epoll_fd, id, connection, stats);
+                last_activity = clock_type::now();
+            }
+        }
+    }
+
+    double cpu_after = options.server_pid > 0 ? read_cpu_time(options.server_pid) : -1;
+    double elapsed = std::chrono::duration<double>(last_activity - start).count();
+    close(epoll_fd);
+
+    std::cout << "Sent " << stats.sent_messages << " messages over " << connections_count << " connections in "
+              << elapsed << " s, received " << stats.received_turns << " turns." << std::endl;
+    if (stats.failed_connections > 0) {
+        std::cout << stats.failed_connections << " connections failed." << std::endl;
+    }
+
+    // Fan-out latency is how much later than at the first connection a turn arrives at the others.
+    std::vector<double> spreads;
+    for (auto &[key, arrival]: stats.turns) {
+        spreads.push_back(std::chrono::duration<double, std::milli>(arrival.last - arrival.first).count());
+    }
+    report_percentiles("Turn fan-out latency", stats.lags);
+    report_percentiles("Turn fan-out spread", spreads);
+
+    if (options.server_pid > 0) {
+        if (cpu_before < 0 || cpu_after < 0) {
+            std::cout << "CPU time of the server is not known." << std::endl;
+        } else {
+            double cpu = cpu_after - cpu_before;
+            std::cout << "Server CPU time: " << cpu << " s, " << (elapsed > 0 ? 100 * cpu / elapsed : 0)
+                      << "% of one core." << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -2,11 +2,23 @@
 #include <memory>
 #include <set>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <csignal>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 #include <shared_mutex>
 #include "network/connection_acceptor.h"
 #include "network/network_handler.h"
+#include "network/buffer_pool.h"
+#include "network/socket_tuning.h"
 #include "network/message_manager.h"
+#include "network/reactor.h"
+#include "network/turn_channel.h"
+#include "network/handoff.h"
+#include "network/token_bucket.h"
 #include "config/config.h"
 #include "config/parser.h"
 #include "concurrency/accepted_player_container.h"
@@ -17,47 +29,93 @@
 typedef std::unique_lock<std::shared_mutex> WriteLock;
 typedef std::shared_lock<std::shared_mutex> ReadLock;
 
+using clock_type = std::chrono::steady_clock;
+
 options_server settings;
 
+// Event loops serving the clients, empty if every client is served by dedicated threads.
+std::vector<Reactor::ptr> reactors;
+
+// Hello message is the same for every client.
+MessageEncoder::message_t encoded_hello;
+
+// nullptr if turns are sent only over TCP.
+TurnChannelServer::ptr turn_channel;
+
+// nullptr if the messages from the clients are not captured.
+TrafficCapture::ptr traffic_capture;
+
+// Listening sockets, the Unix domain one last, and the threads accepting connections on them.
+std::vector<std::shared_ptr<ConnectionAcceptor>> acceptors;
+std::vector<std::thread> acceptor_threads;
+
+/* Game carried out by the main thread. It is changed only while holding the mutex, so that a
+ * handoff takes its state between turns. */
+struct game_progress {
+    std::mutex mutex;
+    // nullptr between games.
+    std::unique_ptr<GameServer> server;
+    clock_type::time_point next_turn_at;
+} progress;
+
 struct shared_state {
     std::shared_mutex mutex;
-    bool game_started;
-    size_t game_version;
+    // Written while holding the mutex, read without it on the paths taken for every message.
+    std::atomic<bool> game_started;
+    // Increased after the structures of a new game are in place, the clients copy the pointers
+    // below only when it changes.
+    std::atomic<size_t> game_version;
     AcceptedPlayerContainer::ptr accepted_players;
     MoveContainer::ptr move_container;
     TurnContainer::ptr turn_container;
 } shared;
 
+/* Increased before the moves are taken for a turn and when a game ends, so that a move repeating
+ * the last one stored by a client since then is dropped without taking the locks. */
+std::atomic<size_t> move_epoch{1};
+
 void reset_shared() {
     WriteLock lock_guard(shared.mutex);
+    move_epoch++;
     shared.game_started = false;
-    shared.game_version++;
     shared.accepted_players = std::make_shared<AcceptedPlayerContainer>(settings.players_count);
     shared.move_container = std::make_shared<MoveContainer>(settings.players_count);
     shared.turn_container = std::make_shared<TurnContainer>();
+    shared.game_version++;
 }
 
 bool is_game_started() {
-    // Here the lock is used only to introduce the happens-before relationship.
-    ReadLock lock_guard(shared.mutex);
     return shared.game_started;
 }
 
 bool is_game_valid(size_t version) {
-    ReadLock lock_guard(shared.mutex);
     return shared.game_version == version;
 }
 
-void handle_tcp_stream_in(ServerMessageManager::ptr manager) {
-    ClientMessage msg;
-
-    // Pointers to shared data structures.
+/* Structures of the game a client sent its last message in, copied from shared when a new game is
+ * published. A client keeps the structures of a finished game until its next message. */
+struct game_structures {
+    // 0 until the structures are first copied.
+    size_t game_version = 0;
     AcceptedPlayerContainer::ptr accepted_players;
     MoveContainer::ptr move_container;
+};
 
+// Copies the structures of the current game, only if they changed since the last copy.
+void refresh_game_structures(game_structures &game) {
+    if (game.game_version == shared.game_version) {
+        return;
+    }
+    ReadLock lock_guard(shared.mutex);
+    game.accepted_players = shared.accepted_players;
+    game.move_container = shared.move_container;
+    game.game_version = shared.game_version;
+}
+
+/* Client's participation in the game, updated with each message received from the client. */
+struct client_input_state {
     // Determines whether client's participation in the game should be updated.
     size_t last_game_version = 0;
-    size_t current_game_version;
 
     // True if and only if the client successfully joined the most recent version of the game.
     bool joined_the_game = false;
@@ -65,56 +123,408 @@ void handle_tcp_stream_in(ServerMessageManager::ptr manager) {
     // Valid only if the client joined the most recent version of the game.
     types::player_id_t player_id{};
 
-    try {
-        while (true) {
-            msg = manager->read_client_message();
+    game_structures game;
 
-            // Get most recent data structures.
-            {
-                ReadLock lock_guard(shared.mutex);
-                accepted_players = shared.accepted_players;
-                move_container = shared.move_container;
-                current_game_version = shared.game_version;
-            }
+    // Limits the rate of the moves accepted from the client.
+    TokenBucket input_limit{(double) settings.input_rate, (double) settings.input_burst};
+
+    // Last move stored for the client and move_epoch at the time, 0 if none was stored.
+    ClientMessage last_move;
+    size_t last_move_epoch = 0;
+
+    // Moves dropped by input_limit since flood_window_start.
+    size_t flood_window_dropped = 0;
+    clock_type::time_point flood_window_start;
+};
+
+/* Totals of the messages dropped from the clients, reported on SIGUSR1. */
+struct input_stats {
+    // Moves above settings.input_rate.
+    std::atomic<size_t> rate_limited{0};
+    // Moves repeating the last one of the turn.
+    std::atomic<size_t> repeated_moves{0};
+    std::atomic<size_t> disconnected_clients{0};
+} dropped_inputs;
+
+/* How far behind the turns of the game a client is, reported on SIGUSR1. */
+struct client_backlog {
+    std::string name;
+    // Turns of the game which were not queued for the client yet.
+    std::atomic<size_t> lag_turns{0};
+    // Bytes of those turns together with the bytes queued but not sent yet.
+    std::atomic<size_t> backlog_bytes{0};
+    // Number of times settings.slow_client_policy was applied to the client.
+    std::atomic<size_t> policy_applied{0};
+};
+
+/* Clients registered for the reports, the disconnected ones are forgotten lazily. */
+struct backlog_registry {
+    std::mutex mutex;
+    std::vector<std::weak_ptr<client_backlog>> clients;
+    // Number of registered clients after the disconnected ones were last forgotten.
+    size_t compacted_size = 0;
+} backlogs;
+
+/* Totals of the actions taken on slow clients. */
+struct slow_client_stats {
+    std::atomic<size_t> coalesced_turns{0};
+    std::atomic<size_t> skipped_turns{0};
+    std::atomic<size_t> disconnected_clients{0};
+} slow_clients;
+
+std::shared_ptr<client_backlog> register_backlog(const std::string &name) {
+    auto backlog = std::make_shared<client_backlog>();
+    backlog->name = name;
+
+    std::lock_guard<std::mutex> lock_guard(backlogs.mutex);
+    // Forgetting the disconnected clients only when the registry doubles keeps registration cheap.
+    if (backlogs.clients.size() >= 2 * backlogs.compacted_size) {
+        std::erase_if(backlogs.clients, [](const std::weak_ptr<client_backlog> &client) { return client.expired(); });
+        backlogs.compacted_size = std::max<size_t>(backlogs.clients.size(), 1);
+    }
+    backlogs.clients.push_back(backlog);
+    return backlog;
+}
+
+/* How turns are sent to the client, shared by the threads receiving from and sending to the client. */
+struct turn_delivery_state {
+    // True if the client subscribed to the turn channel.
+    std::atomic<bool> over_udp{false};
+    struct sockaddr_in6 address{};
+    // Version of the game the client joined as a player, 0 if it has not joined any.
+    std::atomic<size_t> joined_game_version{0};
+    // Set when receiving from the client failed, so that sending stops without failing too.
+    std::atomic<bool> disconnected{false};
+    std::shared_ptr<client_backlog> backlog;
+};
+
+// Records how far behind a client which is to be sent turn next_turn next is, returning the lag and the bytes.
+std::pair<size_t, size_t> measure_backlog(turn_delivery_state &delivery, TurnContainer &turn_container,
+                                          size_t next_turn, size_t queued_bytes) {
+    size_t turns_count = turn_container.get_turns_count();
+    size_t lag = turns_count > next_turn ? turns_count - next_turn : 0;
+    size_t bytes = turn_container.get_bytes_since(next_turn) + queued_bytes;
+    delivery.backlog->lag_turns = lag;
+    delivery.backlog->backlog_bytes = bytes;
+    return {lag, bytes};
+}
+
+// What is done with a client which fell too far behind the game.
+enum class BacklogAction {
+    NONE, SNAPSHOT, SKIP_TO_LATEST, DISCONNECT
+};
+
+/**
+ * @brief Measures the backlog of a client which is to be sent turn next_turn of the game of the
+ * specified version next and has queued_bytes bytes queued but not sent yet. When it exceeds
+ * the limits, picks the action according to settings.slow_client_policy. Spectators lose the
+ * turns they missed with the Drop policy, players get a snapshot, as their moves depend on the
+ * positions. A client whose queued bytes alone exceed the limit is disconnected, as the snapshot
+ * cannot shrink them.
+ */
+BacklogAction check_backlog(turn_delivery_state &delivery, TurnContainer &turn_container, size_t game_version,
+                            size_t next_turn, size_t queued_bytes) {
+    // Turns sent over UDP are not queued.
+    if (delivery.over_udp) {
+        return BacklogAction::NONE;
+    }
+
+    auto [lag, bytes] = measure_backlog(delivery, turn_container, next_turn, queued_bytes);
+
+    bool bytes_exceeded = settings.max_backlog_bytes > 0 && bytes > settings.max_backlog_bytes;
+    if (!bytes_exceeded && (settings.max_lag_turns == 0 || lag <= settings.max_lag_turns)) {
+        return BacklogAction::NONE;
+    }
+    if (settings.max_backlog_bytes > 0 && queued_bytes > settings.max_backlog_bytes) {
+        return BacklogAction::DISCONNECT;
+    }
 
-            if (last_game_version != current_game_version) {
-                // A new game was started.
-                last_game_version = current_game_version;
-                joined_the_game = false;
+    switch (settings.slow_client_policy) {
+        case SlowClientPolicy::Coalesce:
+            return lag > 1 ? BacklogAction::SNAPSHOT : BacklogAction::NONE;
+        case SlowClientPolicy::Drop:
+            if (delivery.joined_game_version != game_version) {
+                return lag > 1 ? BacklogAction::SKIP_TO_LATEST : BacklogAction::NONE;
             }
+            return lag > 1 ? BacklogAction::SNAPSHOT : BacklogAction::NONE;
+        case SlowClientPolicy::Disconnect:
+            return BacklogAction::DISCONNECT;
+    }
+    return BacklogAction::NONE;
+}
 
-            if (std::holds_alternative<Join>(msg)) {
-                if (!joined_the_game) {
-                    Player player;
-                    player.name = std::get<Join>(msg).name;
-                    player.address = manager->get_client_name();
+// Replaces the turns the client missed, starting with turn next_turn, with the snapshot of the board.
+MessageEncoder::message_t send_snapshot(turn_delivery_state &delivery, TurnContainer &turn_container,
+                                        size_t &next_turn) {
+    auto [message, replaced] = turn_container.encode_snapshot(next_turn);
+    next_turn += replaced;
+    slow_clients.coalesced_turns += replaced;
+    delivery.backlog->policy_applied++;
+    measure_backlog(delivery, turn_container, next_turn, message->size());
+    return message;
+}
 
-                    try {
-                        player_id = accepted_players->add_new_player(player);
-                        joined_the_game = true;
-                    }
-                    catch (const RejectedPlayerException &e) {
-                        // The client was rejected from joining the game.
-                    }
-                } else {
-                    // The client already joined the game!
-                }
-            } else {
-                if (joined_the_game && is_game_started()) {
-                    // Proceed only if the client joined the most recent version of the game and the game is underway.
-                    move_container->update_slot(player_id, msg);
-                }
+// Skips the turns the client missed, returning the index of the latest turn, which is sent.
+size_t skip_backlog(turn_delivery_state &delivery, TurnContainer &turn_container, size_t next_turn) {
+    size_t latest = turn_container.get_turns_count() - 1;
+    slow_clients.skipped_turns += latest - next_turn;
+    delivery.backlog->policy_applied++;
+    measure_backlog(delivery, turn_container, latest, 0);
+    return latest;
+}
+
+void count_disconnected(turn_delivery_state &delivery) {
+    std::cerr << "Client " << delivery.backlog->name << " disconnected, as it fell too far behind.\n";
+    slow_clients.disconnected_clients++;
+    delivery.backlog->policy_applied++;
+}
+
+// Turns sent over UDP are not sent over TCP.
+bool is_sent_over_udp(const turn_delivery_state &delivery, const MessageEncoder::message_t &turn) {
+    return delivery.over_udp && TurnChannelServer::fits_datagram(turn);
+}
+
+void subscribe_to_turns(ServerMessageManager &manager, turn_delivery_state &delivery, const SubscribeTurns &msg) {
+    // Clients on the Unix domain socket have no address to send the datagrams to.
+    if (!turn_channel || delivery.over_udp || !manager.get_client_address(delivery.address)) {
+        return;
+    }
+    delivery.address.sin6_port = htons(msg.port);
+    turn_channel->subscribe(delivery.address);
+    delivery.over_udp = true;
+}
+
+void unsubscribe_from_turns(turn_delivery_state &delivery) {
+    if (delivery.over_udp) {
+        turn_channel->unsubscribe(delivery.address);
+    }
+}
+
+void notify_reactors() {
+    for (auto &reactor: reactors) {
+        reactor->wake_up();
+    }
+}
+
+void set_up_zerocopy(TCPHandler &handler) {
+    if (settings.zerocopy_threshold > 0 && !handler.enable_zerocopy(settings.zerocopy_threshold)) {
+        std::cerr << "Zero-copy sending is not supported, bytes are copied instead.\n";
+    }
+}
+
+void report_send_stats() {
+    std::cout << "Bytes sent with zero-copy: " << TCPHandler::send_stats.zerocopy_bytes
+              << ", with zero-copy but copied by the kernel: " << TCPHandler::send_stats.zerocopy_copied_bytes
+              << ", copied: " << TCPHandler::send_stats.copied_bytes << std::endl;
+}
+
+void report_memory_stats() {
+    BufferPool::stats_t stats = BufferPool::get_stats();
+    size_t connections = TCPHandler::instances_count;
+    std::cout << "Connections: " << connections << ", buffer memory in use: " << stats.used_bytes
+              << " bytes, pooled: " << stats.pooled_bytes << " bytes, per connection: "
+              << (connections > 0 ? stats.used_bytes / connections : 0) << " bytes" << std::endl;
+    report_send_stats();
+}
+
+void report_backlog_stats() {
+    std::cout << "Slow clients: turns coalesced " << slow_clients.coalesced_turns << ", turns skipped "
+              << slow_clients.skipped_turns << ", clients disconnected " << slow_clients.disconnected_clients
+              << std::endl;
+
+    // Only the clients which are behind, most are up to date.
+    std::lock_guard<std::mutex> lock_guard(backlogs.mutex);
+    for (const auto &client: backlogs.clients) {
+        std::shared_ptr<client_backlog> backlog = client.lock();
+        if (backlog && (backlog->lag_turns > 0 || backlog->backlog_bytes > 0)) {
+            std::cout << "Client " << backlog->name << ": lag " << backlog->lag_turns << " turns, backlog "
+                      << backlog->backlog_bytes << " bytes, policy applied " << backlog->policy_applied
+                      << " times" << std::endl;
+        }
+    }
+}
+
+void report_input_stats() {
+    std::cout << "Dropped client messages: above the rate " << dropped_inputs.rate_limited << ", repeated moves "
+              << dropped_inputs.repeated_moves << ", flooding clients disconnected "
+              << dropped_inputs.disconnected_clients << std::endl;
+}
+
+// Reports the statistics whenever SIGUSR1 is delivered. The signal must be blocked in all the threads.
+void handle_stats_requests() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    while (true) {
+        int signal;
+        if (sigwait(&signals, &signal) == 0) {
+            report_memory_stats();
+            report_backlog_stats();
+            report_input_stats();
+        }
+    }
+}
+
+// Below there are helpers encoding the state handed over to the next server.
+
+void encode_bytes(MessageEncoder &encoder, std::span<const uint8_t> bytes) {
+    encoder.send_element<uint32_t>((uint32_t) bytes.size());
+    encoder.send_bytes(bytes);
+}
+
+std::vector<uint8_t> decode_bytes(MessageDecoder &decoder) {
+    auto size = decoder.read_element<uint32_t>();
+    if (size > decoder.get_remaining_bytes_count()) {
+        throw DecodeError("Attempt to read data out of message's bound!");
+    }
+    std::vector<uint8_t> bytes(size);
+    decoder.read_bytes(bytes);
+    return bytes;
+}
+
+// What is done with a message received from a client.
+enum class InputAction {
+    ACCEPT, DROP, DISCONNECT
+};
+
+/**
+ * @brief Drops the moves of a client sending more than settings.input_rate per second. A client
+ * which keeps flooding, more than settings.flood_limit of its moves dropped within FLOOD_WINDOW,
+ * is disconnected.
+ */
+InputAction check_input_rate(ServerMessageManager &manager, client_input_state &state) {
+    if (!state.input_limit.is_limited()) {
+        return InputAction::ACCEPT;
+    }
+
+    auto now = clock_type::now();
+    if (state.input_limit.try_consume(now)) {
+        return InputAction::ACCEPT;
+    }
+    dropped_inputs.rate_limited++;
+
+    if (now - state.flood_window_start >= std::chrono::milliseconds(FLOOD_WINDOW)) {
+        state.flood_window_start = now;
+        state.flood_window_dropped = 0;
+    }
+    state.flood_window_dropped++;
+    if (settings.flood_limit > 0 && state.flood_window_dropped > settings.flood_limit) {
+        std::cerr << "Client " << manager.get_client_name() << " disconnected, as it flooded the server.\n";
+        dropped_inputs.disconnected_clients++;
+        return InputAction::DISCONNECT;
+    }
+    return InputAction::DROP;
+}
+
+// True if the move would not change the one stored for the client before the next turn.
+bool is_repeated_move(const client_input_state &state, const ClientMessage &msg) {
+    if (state.last_move_epoch != move_epoch || state.last_move.index() != msg.index()) {
+        return false;
+    }
+    if (auto *move = std::get_if<Move>(&msg)) {
+        return move->direction == std::get<Move>(state.last_move).direction;
+    }
+    return true;
+}
+
+/**
+ * @brief Acts on a message received from a client.
+ *
+ * @return bool False if the client is to be disconnected.
+ */
+bool handle_client_message(ServerMessageManager &manager, client_input_state &state, turn_delivery_state &delivery,
+                           const ClientMessage &msg) {
+    if (std::holds_alternative<SubscribeTurns>(msg)) {
+        subscribe_to_turns(manager, delivery, std::get<SubscribeTurns>(msg));
+        return true;
+    }
+
+    if (!std::holds_alternative<Join>(msg)) {
+        // Only the moves are limited, a client joining or subscribing is never throttled.
+        switch (check_input_rate(manager, state)) {
+            case InputAction::ACCEPT:
+                break;
+            case InputAction::DROP:
+                return true;
+            case InputAction::DISCONNECT:
+                return false;
+        }
+
+        // Only the last move of a turn counts, repeating it needs neither of the locks.
+        if (is_repeated_move(state, msg)) {
+            dropped_inputs.repeated_moves++;
+            return true;
+        }
+    }
+
+    // Get most recent data structures, the shared lock is taken only when a new game was published.
+    refresh_game_structures(state.game);
+    size_t current_game_version = state.game.game_version;
+
+    if (state.last_game_version != current_game_version) {
+        // A new game was started.
+        state.last_game_version = current_game_version;
+        state.joined_the_game = false;
+    }
+
+    if (std::holds_alternative<Join>(msg)) {
+        if (!state.joined_the_game) {
+            Player player;
+            player.name = std::get<Join>(msg).name;
+            player.address = manager.get_client_name();
+
+            try {
+                state.player_id = state.game.accepted_players->add_new_player(player);
+                state.joined_the_game = true;
+                delivery.joined_game_version = current_game_version;
+
+                // Let the event loops send the message about the new player.
+                notify_reactors();
             }
+            catch (const RejectedPlayerException &e) {
+                // The client was rejected from joining the game.
+            }
+        } else {
+            // The client already joined the game!
+        }
+    } else {
+        if (state.joined_the_game && is_game_started()) {
+            // Proceed only if the client joined the most recent version of the game and the game is underway.
+            // The epoch is read first, a turn taking the moves in between makes the move stored again.
+            size_t epoch = move_epoch;
+            state.game.move_container->update_slot(state.player_id, msg);
+            state.last_move = msg;
+            state.last_move_epoch = epoch;
+        }
+    }
+    return true;
+}
+
+void handle_tcp_stream_in(ServerMessageManager::ptr manager, std::shared_ptr<turn_delivery_state> delivery) {
+    client_input_state state;
+
+    try {
+        // Disconnections are reported without exceptions, as many clients may leave at once.
+        StreamResult<ClientMessage> msg = manager->try_read_client_message();
+        while (msg && handle_client_message(*manager, state, *delivery, *msg)) {
+            msg = manager->try_read_client_message();
+        }
+        if (msg) {
+            // The client flooded the server.
+            manager->disconnect_client();
+        } else {
+            std::cerr << msg.what() << '\n';
         }
     }
     catch (const std::exception &e) {
         // Communication with the client failed.
         std::cerr << e.what() << '\n';
-        return;
     }
+    unsubscribe_from_turns(*delivery);
+    delivery->disconnected = true;
 }
 
-void handle_tcp_stream_out(ServerMessageManager::ptr manager) {
+void handle_tcp_stream_out(ServerMessageManager::ptr manager, std::shared_ptr<turn_delivery_state> delivery) {
     try {
         Hello hello_message(settings);
         manager->send_client_message(hello_message);
@@ -122,37 +532,69 @@ void handle_tcp_stream_out(ServerMessageManager::ptr manager) {
         while (true) {
             AcceptedPlayerContainer::ptr accepted_players;
             TurnContainer::ptr turn_container;
+            size_t game_version;
 
             // Get most recent structures with players and moves.
             {
                 ReadLock lock_guard(shared.mutex);
                 accepted_players = shared.accepted_players;
                 turn_container = shared.turn_container;
+                game_version = shared.game_version;
             }
 
             if (!is_game_started()) {
                 // Show accepted players.
                 for (types::player_id_t i = 0; i < settings.players_count; i++) {
                     AcceptedPlayer message = accepted_players->get_accepted_player(i);
+                    if (delivery->disconnected) {
+                        return;
+                    }
                     manager->send_client_message(message);
                 }
             }
 
             // Send message about the start of the game.
-            GameStarted message = accepted_players->return_when_target_players_joined();
+            MessageEncoder::message_t message = accepted_players->return_encoded_when_target_players_joined();
+            if (delivery->disconnected) {
+                return;
+            }
             manager->send_client_message(message);
 
-            for (types::turn_t i = 0; i < settings.game_length + 1; i++) {
-                // Wait for each turn to complete and send it.
-                Turn message = turn_container->get_turn(i);
-                manager->send_client_message(message);
+            size_t next_turn = 0;
+            while (next_turn < (size_t) settings.game_length + 1) {
+                // Sends are blocking, so the backlog is only the turns appended in the meantime.
+                switch (check_backlog(*delivery, *turn_container, game_version, next_turn, 0)) {
+                    case BacklogAction::SNAPSHOT:
+                        manager->send_client_message(send_snapshot(*delivery, *turn_container, next_turn));
+                        continue;
+                    case BacklogAction::SKIP_TO_LATEST:
+                        next_turn = skip_backlog(*delivery, *turn_container, next_turn);
+                        break;
+                    case BacklogAction::DISCONNECT:
+                        count_disconnected(*delivery);
+                        manager->disconnect_client();
+                        return;
+                    case BacklogAction::NONE:
+                        break;
+                }
+
+                // Wait for each turn to complete and send its encoded bytes.
+                message = turn_container->get_turn((types::turn_t) next_turn++);
+                if (delivery->disconnected) {
+                    return;
+                }
+                if (!is_sent_over_udp(*delivery, message)) {
+                    manager->send_client_message(message);
+                }
             }
+            measure_backlog(*delivery, *turn_container, next_turn, 0);
 
             // Send message about the end of the game.
-            GameEnded message_end;
-            Game::score_map_t score_map = turn_container->return_when_game_finished();
-            message_end.scores = score_map;
-            manager->send_client_message(message_end);
+            message = turn_container->return_when_game_finished();
+            if (delivery->disconnected) {
+                return;
+            }
+            manager->send_client_message(message);
         }
     }
     catch (const std::exception &e) {
@@ -162,24 +604,330 @@ void handle_tcp_stream_out(ServerMessageManager::ptr manager) {
     }
 }
 
-void accept_new_connections(types::port_t port) {
-    ConnectionAcceptor acceptor(port, TCP_BACKLOG_SIZE);
+/**
+ * @brief Client served by an event loop. Messages from the client are handled as in
+ * handle_tcp_stream_in. Messages to the client are the same as the ones sent by handle_tcp_stream_out,
+ * whose progress is kept in an explicit state machine instead of on a thread's stack.
+ */
+class ClientSession : public Reactor::Connection {
+public:
+    explicit ClientSession(int socket_fd) {
+        handler = std::make_shared<TCPHandler>(socket_fd, TCP_BUFF_SIZE);
+        set_up_zerocopy(*handler);
+        manager = std::make_shared<ServerMessageManager>(handler);
+        delivery.backlog = register_backlog(manager->get_client_name());
+        handler->queue_encoded_message(encoded_hello);
+    }
+
+    /**
+     * @brief Restores the session serialized by the previous server. Must be called after the
+     * shared state of the game and the turn channel are restored.
+     *
+     * @throws DecodeError.
+     */
+    ClientSession(int socket_fd, MessageDecoder &decoder) {
+        // Completions of the zero-copy sends of the previous server would arrive on the socket, so
+        // bytes are copied.
+        handler = std::make_shared<TCPHandler>(socket_fd, TCP_BUFF_SIZE);
+        manager = std::make_shared<ServerMessageManager>(handler);
+        delivery.backlog = register_backlog(manager->get_client_name());
+
+        input_state.last_game_version = decoder.read_element<uint64_t>();
+        input_state.joined_the_game = decoder.read_element<uint8_t>() != 0;
+        input_state.player_id = decoder.read_element<types::player_id_t>();
+        if (input_state.joined_the_game) {
+            delivery.joined_game_version = input_state.last_game_version;
+        }
+
+        bool over_udp = decoder.read_element<uint8_t>() != 0;
+        std::vector<uint8_t> address = decode_bytes(decoder);
+        if (address.size() != sizeof(delivery.address)) {
+            throw DecodeError("Invalid address of the turn channel!");
+        }
+        std::memcpy(&delivery.address, address.data(), address.size());
+        if (over_udp && turn_channel) {
+            turn_channel->subscribe(delivery.address);
+            delivery.over_udp = true;
+        }
+
+        input_open = decoder.read_element<uint8_t>() != 0;
+        output_open = decoder.read_element<uint8_t>() != 0;
+        auto phase_id = decoder.read_element<uint8_t>();
+        if (phase_id > (uint8_t) Phase::GAME_ENDED) {
+            throw DecodeError("Invalid phase of the session!");
+        }
+        phase = (Phase) phase_id;
+        game_version = decoder.read_element<uint64_t>();
+        next_player = decoder.read_element<uint64_t>();
+        next_turn = decoder.read_element<uint64_t>();
+
+        {
+            ReadLock lock_guard(shared.mutex);
+            if (game_version == shared.game_version) {
+                accepted_players = shared.accepted_players;
+                turn_container = shared.turn_container;
+            } else {
+                // The previous game is gone, its remaining messages cannot be sent.
+                phase = Phase::NEW_GAME;
+            }
+        }
+
+        handler->restore_unread_bytes(decode_bytes(decoder));
+        std::vector<uint8_t> unsent = decode_bytes(decoder);
+        if (!unsent.empty()) {
+            handler->queue_encoded_message(std::make_shared<const std::vector<uint8_t>>(std::move(unsent)));
+        }
+    }
+
+    // Serializes the progress of the session, read back by the restoring constructor.
+    void serialize(MessageEncoder &encoder) const {
+        encoder.send_element<uint64_t>(input_state.last_game_version);
+        encoder.send_element<uint8_t>(input_state.joined_the_game);
+        encoder.send_element<types::player_id_t>(input_state.player_id);
+        encoder.send_element<uint8_t>(delivery.over_udp);
+        encode_bytes(encoder, {(const uint8_t *) &delivery.address, sizeof(delivery.address)});
+        encoder.send_element<uint8_t>(input_open);
+        encoder.send_element<uint8_t>(output_open);
+        encoder.send_element<uint8_t>((uint8_t) phase);
+        encoder.send_element<uint64_t>(game_version);
+        encoder.send_element<uint64_t>(next_player);
+        encoder.send_element<uint64_t>(next_turn);
+        encode_bytes(encoder, handler->get_unread_bytes());
+        encode_bytes(encoder, handler->get_unsent_bytes());
+    }
+
+    bool handle_socket_events(uint32_t) override {
+        if (input_open) {
+            receive_messages();
+        }
+        if (output_open) {
+            send_messages();
+        }
+        // Most clients are idle between turns, their buffers are better shared.
+        handler->release_idle_buffers();
+        return input_open || output_open;
+    }
+
+    bool handle_wake_up() override {
+        if (output_open) {
+            send_messages();
+        }
+        handler->release_idle_buffers();
+        return input_open || output_open;
+    }
+
+private:
+    enum class Phase {
+        NEW_GAME, LOBBY, GAME_STARTED, GAME, GAME_ENDED
+    };
+
+    TCPHandler::ptr handler;
+    ServerMessageManager::ptr manager;
+    bool input_open = true;
+    bool output_open = true;
+    client_input_state input_state;
+    turn_delivery_state delivery;
+
+    // Progress of sending the current game to the client.
+    Phase phase = Phase::NEW_GAME;
+    size_t game_version = 0;
+    AcceptedPlayerContainer::ptr accepted_players;
+    TurnContainer::ptr turn_container;
+    size_t next_player = 0;
+    size_t next_turn = 0;
+
+    void receive_messages() {
+        try {
+            bool drained = false;
+            while (!drained) {
+                // Disconnections are reported without exceptions, as many clients may leave at once.
+                StreamResult<bool> received = handler->try_receive_available();
+                drained = !received || *received;
+
+                // Bytes received before a disconnection are still handled.
+                StreamResult<ClientMessage> msg = manager->try_decode_buffered_client_message();
+                for (; msg; msg = manager->try_decode_buffered_client_message()) {
+                    if (!handle_client_message(*manager, input_state, delivery, *msg)) {
+                        // The client flooded the server.
+                        manager->disconnect_client();
+                        unsubscribe_from_turns(delivery);
+                        input_open = false;
+                        return;
+                    }
+                }
+
+                const char *error = !received ? received.what() :
+                                    msg.status() != StreamStatus::Incomplete ? msg.what() : nullptr;
+                if (error) {
+                    // Communication with the client failed.
+                    std::cerr << error << '\n';
+                    unsubscribe_from_turns(delivery);
+                    input_open = false;
+                    return;
+                }
+            }
+        }
+        catch (const std::exception &e) {
+            // Communication with the client failed.
+            std::cerr << e.what() << '\n';
+            unsubscribe_from_turns(delivery);
+            input_open = false;
+        }
+    }
+
+    void send_messages() {
+        // A client which does not read at all is caught here, as no messages are produced for it.
+        if (phase == Phase::GAME && check_backlog(delivery, *turn_container, game_version, next_turn,
+                                                  handler->get_queued_bytes_count()) == BacklogAction::DISCONNECT) {
+            count_disconnected(delivery);
+            manager->disconnect_client();
+            unsubscribe_from_turns(delivery);
+            input_open = false;
+            output_open = false;
+            return;
+        }
+
+        try {
+            StreamResult<bool> emptied = handler->try_send_queued_messages();
+            for (; emptied && *emptied; emptied = handler->try_send_queued_messages()) {
+                // Produce messages until enough bytes are queued or there is nothing more to send yet.
+                MessageEncoder::message_t message;
+                while (handler->get_queued_bytes_count() < SEND_QUEUE_LOW_WATERMARK && (message = next_message())) {
+                    handler->queue_encoded_message(message);
+                }
+                if (handler->get_queued_bytes_count() == 0) {
+                    return;
+                }
+            }
+            if (!emptied) {
+                // Communication with the client failed.
+                std::cerr << emptied.what() << '\n';
+                output_open = false;
+            }
+        }
+        catch (const std::exception &e) {
+            // Communication with the client failed.
+            std::cerr << e.what() << '\n';
+            output_open = false;
+        }
+    }
+
+    // Returns the next message to be sent to the client or nullptr if it is not available yet.
+    MessageEncoder::message_t next_message() {
+        MessageEncoder::message_t message;
+        while (true) {
+            switch (phase) {
+                case Phase::NEW_GAME:
+                    // Get most recent structures with players and moves.
+                    {
+                        ReadLock lock_guard(shared.mutex);
+                        accepted_players = shared.accepted_players;
+                        turn_container = shared.turn_container;
+                        game_version = shared.game_version;
+                    }
+                    next_player = 0;
+                    next_turn = 0;
+                    // Show accepted players only if the game is not underway.
+                    phase = is_game_started() ? Phase::GAME_STARTED : Phase::LOBBY;
+                    break;
+
+                case Phase::LOBBY:
+                    if (next_player == settings.players_count) {
+                        phase = Phase::GAME_STARTED;
+                        break;
+                    }
+                    message = accepted_players->try_get_encoded_accepted_player((types::player_id_t) next_player);
+                    if (message) {
+                        next_player++;
+                    }
+                    return message;
+
+                case Phase::GAME_STARTED:
+                    message = accepted_players->try_get_encoded_game_started();
+                    if (message) {
+                        phase = Phase::GAME;
+                    }
+                    return message;
+
+                case Phase::GAME:
+                    if (next_turn == (size_t) settings.game_length + 1) {
+                        measure_backlog(delivery, *turn_container, next_turn, 0);
+                        phase = Phase::GAME_ENDED;
+                        break;
+                    }
+                    switch (check_backlog(delivery, *turn_container, game_version, next_turn,
+                                          handler->get_queued_bytes_count())) {
+                        case BacklogAction::SNAPSHOT:
+                            return send_snapshot(delivery, *turn_container, next_turn);
+                        case BacklogAction::SKIP_TO_LATEST:
+                            next_turn = skip_backlog(delivery, *turn_container, next_turn);
+                            break;
+                        default:
+                            // Clients are disconnected by send_messages, before the messages are produced.
+                            break;
+                    }
+                    message = turn_container->try_get_turn(next_turn);
+                    if (!message) {
+                        return message;
+                    }
+                    next_turn++;
+                    if (!is_sent_over_udp(delivery, message)) {
+                        return message;
+                    }
+                    break;
+
+                case Phase::GAME_ENDED:
+                    message = turn_container->try_get_game_ended();
+                    if (message) {
+                        phase = Phase::NEW_GAME;
+                    }
+                    return message;
+            }
+        }
+    }
+};
+
+// Sends the turn, already encoded by the container, over UDP too.
+void publish_turn(TurnContainer &turn_container, size_t turn_id) {
+    if (turn_channel) {
+        turn_channel->publish_turn(turn_container.try_get_turn(turn_id));
+    }
+}
+
+void accept_new_connections(const std::shared_ptr<ConnectionAcceptor> &acceptor, size_t next_reactor) {
+    // Event loops need non-blocking sockets, dedicated threads use blocking ones.
+    int flags = reactors.empty() ? 0 : SOCK_NONBLOCK;
 
     while (true) {
-        // Accept another connection.
+        // Accept pending connections.
         try {
-            // Wait for another connection request.
-            int new_connection_fd = acceptor.accept_another_connection();
+            // Wait for connection requests.
+            std::vector<int> new_connection_fds = acceptor->accept_pending_connections(flags);
+            if (new_connection_fds.empty()) {
+                // The acceptor was stopped for a handoff.
+                return;
+            }
 
-            // Create message manager for the newly connected client.
-            TCPHandler::ptr handler = std::make_shared<TCPHandler>(new_connection_fd, TCP_BUFF_SIZE);
-            ServerMessageManager::ptr manager = std::make_shared<ServerMessageManager>(handler);
+            for (int new_connection_fd: new_connection_fds) {
+                if (!reactors.empty()) {
+                    // Hand the connection over to the event loops in a round-robin fashion.
+                    reactors.at(next_reactor++ % reactors.size())->add_connection(new_connection_fd);
+                    continue;
+                }
+
+                // Create message manager for the newly connected client.
+                TCPHandler::ptr handler = std::make_shared<TCPHandler>(new_connection_fd, TCP_BUFF_SIZE);
+                set_up_zerocopy(*handler);
+                ServerMessageManager::ptr manager = std::make_shared<ServerMessageManager>(handler);
 
-            // Create two threads for data streaming in and out of the server.
-            std::thread thread_in{[=] { handle_tcp_stream_in(manager); }};
-            std::thread thread_out{[=] { handle_tcp_stream_out(manager); }};
-            thread_in.detach();
-            thread_out.detach();
+                // Create two threads for data streaming in and out of the server.
+                auto delivery = std::make_shared<turn_delivery_state>();
+                delivery->backlog = register_backlog(manager->get_client_name());
+                std::thread thread_in{[=] { handle_tcp_stream_in(manager, delivery); }};
+                std::thread thread_out{[=] { handle_tcp_stream_out(manager, delivery); }};
+                thread_in.detach();
+                thread_out.detach();
+            }
         }
         catch (const TCPAcceptError &e) {
             // Continue execution.
@@ -188,56 +936,410 @@ void accept_new_connections(types::port_t port) {
     }
 }
 
+// Starts a thread accepting connections on each listening socket.
+void start_accepting() {
+    for (size_t i = 0; i < acceptors.size(); i++) {
+        acceptor_threads.emplace_back([acceptor = acceptors[i], i] { accept_new_connections(acceptor, i); });
+    }
+}
+
+/**
+ * @brief Serializes everything the next server needs to carry on, collecting the sockets passed
+ * with it: the listening ones, the one of the turn channel and the ones of the sessions, in this
+ * order. Must be called while holding the mutex of the game.
+ */
+MessageEncoder::message_t encode_server_state(const std::vector<std::pair<int, std::unique_ptr<Reactor::Connection>>> &sessions,
+                                              std::vector<int> &fds) {
+    MessageEncoder encoder;
+    encode_bytes(encoder, *encoded_hello);
+
+    encoder.send_element<types::threads_count_t>(settings.acceptor_threads);
+    encode_bytes(encoder, {(const uint8_t *) settings.socket_path.data(), settings.socket_path.size()});
+    encoder.send_element<uint8_t>(turn_channel != nullptr);
+    for (const auto &acceptor: acceptors) {
+        fds.push_back(acceptor->get_socket_fd());
+    }
+    if (turn_channel) {
+        fds.push_back(turn_channel->get_socket_fd());
+    }
+
+    {
+        ReadLock lock_guard(shared.mutex);
+        encoder.send_element<uint64_t>(shared.game_version);
+        encoder.send_element<uint8_t>(shared.game_started);
+        shared.accepted_players->get_accepted_players().serialize(encoder);
+
+        std::vector<MessageEncoder::message_t> turns = shared.turn_container->get_turns();
+        encoder.send_element<uint32_t>((uint32_t) turns.size());
+        for (const auto &turn: turns) {
+            encode_bytes(encoder, *turn);
+        }
+
+        // Moves requested since the last turn.
+        MoveContainer::container_t moves = shared.move_container->atomic_snapshot();
+        encoder.send_element<uint32_t>((uint32_t) std::count_if(moves.begin(), moves.end(), [](const auto &slot) {
+            return slot.first;
+        }));
+        for (size_t id = 0; id < moves.size(); id++) {
+            if (moves[id].first) {
+                encoder.send_element<types::player_id_t>((types::player_id_t) id);
+                encoder.send_bytes(*ClientMessageManager::encode_server_message(moves[id].second));
+            }
+        }
+    }
+
+    encoder.send_element<uint8_t>(progress.server != nullptr);
+    if (progress.server) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(progress.next_turn_at - clock_type::now());
+        encoder.send_element<uint32_t>((uint32_t) std::max<int64_t>(left.count(), 0));
+        progress.server->serialize(encoder);
+    }
+
+    encoder.send_element<uint32_t>((uint32_t) sessions.size());
+    for (const auto &[socket_fd, connection]: sessions) {
+        // Every connection served by the event loops is a client session.
+        static_cast<const ClientSession &>(*connection).serialize(encoder);
+        fds.push_back(socket_fd);
+    }
+
+    return encoder.get_encoded_message();
+}
+
+/**
+ * @brief Hands the server over to the new one connected to the channel. The clients are not served
+ * while the state is taken, so it does not change until the new server confirms and this process
+ * exits. Returns only if the handoff failed, once the server is resumed.
+ */
+void hand_over_server(HandoffChannel &channel) {
+    // Connection requests wait in the queues of the listening sockets, which are handed over.
+    for (auto &acceptor: acceptors) {
+        acceptor->stop();
+    }
+    for (auto &thread: acceptor_threads) {
+        thread.join();
+    }
+    acceptor_threads.clear();
+
+    std::vector<std::pair<int, std::unique_ptr<Reactor::Connection>>> sessions;
+    for (auto &reactor: reactors) {
+        for (auto &session: reactor->take_connections()) {
+            sessions.push_back(std::move(session));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock_guard(progress.mutex);
+        std::vector<int> fds;
+        MessageEncoder::message_t state = encode_server_state(sessions, fds);
+        try {
+            channel.send_state(*state, fds);
+            if (channel.wait_for_confirmation()) {
+                if (traffic_capture) {
+                    traffic_capture->flush();
+                }
+                std::cout << "Handed " << sessions.size() << " clients over to the new server." << std::endl;
+                // The sockets and the socket files belong to the new server now, so nothing is cleaned up.
+                _exit(EXIT_SUCCESS);
+            }
+        }
+        catch (const HandoffError &e) {
+            std::cerr << e.what() << '\n';
+        }
+    }
+
+    std::cerr << "Handoff failed, resuming.\n";
+    for (size_t i = 0; i < sessions.size(); i++) {
+        reactors.at(i % reactors.size())->add_connection(sessions[i].first, std::move(sessions[i].second));
+    }
+    for (auto &acceptor: acceptors) {
+        acceptor->resume();
+    }
+    start_accepting();
+}
+
+void serve_handoff_requests(const std::shared_ptr<ConnectionAcceptor> &acceptor) {
+    while (true) {
+        try {
+            HandoffChannel channel(acceptor->accept_another_connection());
+            hand_over_server(channel);
+        }
+        catch (const TCPAcceptError &e) {
+            // Continue execution.
+            std::cerr << e.what() << '\n';
+        }
+    }
+}
+
+/**
+ * @brief Restores the state encoded by encode_server_state. The listening sockets and the turn
+ * channel are taken over, the sessions are returned to be handed to the event loops.
+ *
+ * @throws HandoffError - Thrown when the previous server runs with different options.
+ */
+std::vector<std::pair<int, std::unique_ptr<ClientSession>>> take_over_server(HandoffChannel &channel) {
+    auto [state, fds] = channel.receive_state();
+    MessageDecoder decoder(state);
+    size_t next_fd = 0;
+    auto take_fd = [&fds, &next_fd] {
+        if (next_fd == fds.size()) {
+            throw HandoffError("Missing sockets of the previous server!");
+        }
+        return fds[next_fd++];
+    };
+
+    if (decode_bytes(decoder) != *encoded_hello) {
+        throw HandoffError("The previous server runs a different game!");
+    }
+    auto acceptors_count = decoder.read_element<types::threads_count_t>();
+    std::vector<uint8_t> socket_path = decode_bytes(decoder);
+    bool has_turn_channel = decoder.read_element<uint8_t>() != 0;
+    if (acceptors_count != settings.acceptor_threads ||
+        std::string(socket_path.begin(), socket_path.end()) != settings.socket_path ||
+        has_turn_channel != (settings.turn_port != 0)) {
+        throw HandoffError("The previous server listens on different sockets!");
+    }
+    for (types::threads_count_t i = 0; i < acceptors_count; i++) {
+        acceptors.push_back(std::make_shared<ConnectionAcceptor>(take_fd(), ""));
+    }
+    if (!settings.socket_path.empty()) {
+        acceptors.push_back(std::make_shared<ConnectionAcceptor>(take_fd(), settings.socket_path));
+    }
+    int turn_channel_fd = has_turn_channel ? take_fd() : -1;
+
+    std::vector<MessageEncoder::message_t> turns;
+    {
+        WriteLock lock_guard(shared.mutex);
+        shared.game_version = decoder.read_element<uint64_t>();
+        shared.game_started = decoder.read_element<uint8_t>() != 0;
+        for (const auto &[id, player]: GameStarted(decoder).players) {
+            shared.accepted_players->add_new_player(player);
+        }
+
+        for (auto count = decoder.read_element<uint32_t>(); count > 0; count--) {
+            turns.push_back(std::make_shared<const std::vector<uint8_t>>(decode_bytes(decoder)));
+            shared.turn_container->append_encoded_turn(turns.back());
+        }
+
+        for (auto count = decoder.read_element<uint32_t>(); count > 0; count--) {
+            auto id = decoder.read_element<types::player_id_t>();
+            shared.move_container->update_slot(id, ServerMessageManager::decode_client_message(decoder));
+        }
+    }
+    if (has_turn_channel) {
+        turn_channel = std::make_shared<TurnChannelServer>(turn_channel_fd, (uint32_t) shared.game_version,
+                                                           std::move(turns));
+    }
+
+    if (decoder.read_element<uint8_t>() != 0) {
+        auto left = decoder.read_element<uint32_t>();
+        progress.server = std::make_unique<GameServer>(settings, decoder);
+        progress.next_turn_at = clock_type::now() + std::chrono::milliseconds(left);
+    }
+
+    std::vector<std::pair<int, std::unique_ptr<ClientSession>>> sessions;
+    for (auto count = decoder.read_element<uint32_t>(); count > 0; count--) {
+        int socket_fd = take_fd();
+        sessions.emplace_back(socket_fd, std::make_unique<ClientSession>(socket_fd, decoder));
+    }
+
+    if (next_fd != fds.size() || decoder.get_remaining_bytes_count() != 0) {
+        throw HandoffError("Unexpected state of the previous server!");
+    }
+    return sessions;
+}
+
 int main(int argc, char *argv[]) {
     settings = parse_server(argc, argv);
+    NetworkHandler::select_io_backend(settings.io_backend);
+    SocketTuning::select_profile(settings.socket_profile);
+    std::cerr << SocketTuning::describe_profile() << '\n';
     reset_shared();
+    encoded_hello = encode_client_message(Hello(settings));
+
+    if (!settings.capture_path.empty()) {
+        try {
+            traffic_capture = std::make_shared<TrafficCapture>(settings.capture_path);
+        }
+        catch (const TrafficCaptureError &e) {
+            std::cerr << e.what() << '\n';
+            exit(EXIT_FAILURE);
+        }
+        ServerMessageManager::set_traffic_capture(traffic_capture);
+    }
+
+    // Block SIGUSR1 before any thread is created, so that it is delivered to the reporting thread only.
+    sigset_t stats_signals;
+    sigemptyset(&stats_signals);
+    sigaddset(&stats_signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &stats_signals, nullptr);
+    std::thread{handle_stats_requests}.detach();
+
+    // Take over from the server listening on the handoff path, if there is one.
+    std::vector<std::pair<int, std::unique_ptr<ClientSession>>> sessions;
+    if (!settings.handoff_path.empty()) {
+        std::unique_ptr<HandoffChannel> channel;
+        try {
+            channel = std::make_unique<HandoffChannel>(settings.handoff_path);
+        }
+        catch (const HandoffError &e) {
+            // There is no server to take over from.
+        }
+
+        if (channel) {
+            try {
+                sessions = take_over_server(*channel);
+                channel->confirm();
+            }
+            catch (const std::exception &e) {
+                // The previous server resumes once the channel is closed.
+                std::cerr << e.what() << '\n';
+                exit(EXIT_FAILURE);
+            }
+            std::cout << "Took " << sessions.size() << " clients over from the previous server." << std::endl;
+        }
+    }
+
+    // Send turns over UDP to the clients which subscribe.
+    if (settings.turn_port != 0) {
+        if (!turn_channel) {
+            try {
+                turn_channel = std::make_shared<TurnChannelServer>(settings.turn_port);
+            }
+            catch (const std::runtime_error &e) {
+                std::cerr << e.what() << '\n';
+                exit(EXIT_FAILURE);
+            }
+        }
+        std::thread{[] { turn_channel->run(); }}.detach();
+    }
+
+    // Create event loops serving the clients.
+    for (types::threads_count_t i = 0; i < settings.reactor_threads; i++) {
+        auto reactor = std::make_shared<Reactor>([](int socket_fd) {
+            return std::make_unique<ClientSession>(socket_fd);
+        });
+        reactors.push_back(reactor);
+        std::thread{[reactor] { reactor->run(); }}.detach();
+    }
+    for (size_t i = 0; i < sessions.size(); i++) {
+        reactors.at(i % reactors.size())->add_connection(sessions[i].first, std::move(sessions[i].second));
+    }
 
-    // Create thread for accepting new connection.
-    std::thread thread_acceptor{[=] { accept_new_connections(settings.port); }};
+    // Create listening sockets, unless they were taken over.
+    if (acceptors.empty()) {
+        try {
+            // Each thread accepting connections has its own listening socket.
+            for (types::threads_count_t i = 0; i < settings.acceptor_threads; i++) {
+                acceptors.push_back(std::make_shared<ConnectionAcceptor>(settings.port, settings.backlog_size,
+                                                                         settings.acceptor_threads > 1,
+                                                                         settings.defer_accept));
+            }
+
+            // Accept clients running on the same host on the Unix domain socket too.
+            if (!settings.socket_path.empty()) {
+                acceptors.push_back(std::make_shared<ConnectionAcceptor>(settings.socket_path, settings.backlog_size));
+            }
+        }
+        catch (const TCPAcceptError &e) {
+            std::cerr << e.what() << '\n';
+            exit(EXIT_FAILURE);
+        }
+    }
+    start_accepting();
+
+    // Wait for the next server to take over.
+    if (!settings.handoff_path.empty()) {
+        std::shared_ptr<ConnectionAcceptor> handoff_acceptor;
+        try {
+            handoff_acceptor = std::make_shared<ConnectionAcceptor>(settings.handoff_path, 1);
+        }
+        catch (const TCPAcceptError &e) {
+            std::cerr << e.what() << '\n';
+            exit(EXIT_FAILURE);
+        }
+        std::thread{[handoff_acceptor] { serve_handoff_requests(handoff_acceptor); }}.detach();
+    }
 
     while (true) {
         AcceptedPlayerContainer::ptr accepted_players;
         MoveContainer::ptr move_container;
         TurnContainer::ptr turn_container;
+        size_t game_version;
 
         {
             ReadLock lock_guard(shared.mutex);
             accepted_players = shared.accepted_players;
             move_container = shared.move_container;
             turn_container = shared.turn_container;
+            game_version = shared.game_version;
         }
 
-        // Wait until enough players join.
-        accepted_players->return_when_target_players_joined();
+        // A game taken over from the previous server is already underway.
+        if (!progress.server) {
+            // Wait until enough players join.
+            accepted_players->return_when_target_players_joined();
 
-        {
-            WriteLock lock_guard(shared.mutex);
-            shared.game_started = true;
+            std::lock_guard<std::mutex> lock_guard(progress.mutex);
+            {
+                WriteLock shared_lock_guard(shared.mutex);
+                shared.game_started = true;
+            }
+
+            if (turn_channel) {
+                turn_channel->start_game((uint32_t) game_version);
+            }
+
+            // Initialize the game.
+            progress.server = std::make_unique<GameServer>(settings);
+            Turn turn = progress.server->game_init();
+            turn_container->append_new_turn(turn);
+            publish_turn(*turn_container, 0);
+            notify_reactors();
+            progress.next_turn_at = clock_type::now() + std::chrono::milliseconds(settings.turn_duration);
         }
 
-        // Initialize the game.
-        GameServer game(settings);
-        Turn turn = game.game_init();
-        turn_container->append_new_turn(turn);
+        // Carry out all the turns, the lock is not held while waiting for the next one.
+        while (progress.server->get_turn() < settings.game_length) {
+            std::this_thread::sleep_until(progress.next_turn_at);
 
-        // Carry out all the turns.
-        for (types::turn_t i = 0; i < settings.game_length; i++) {
-            turn = game.apply_moves(*move_container);
+            std::lock_guard<std::mutex> lock_guard(progress.mutex);
+            move_epoch++;
+            Turn turn = progress.server->apply_moves(*move_container);
             turn_container->append_new_turn(turn);
+            publish_turn(*turn_container, turn.turn);
+            notify_reactors();
+            progress.next_turn_at += std::chrono::milliseconds(settings.turn_duration);
         }
 
-        // Get the score map after the game;
-        Game::score_map_t score_map = game.get_score_map();
+        {
+            std::lock_guard<std::mutex> lock_guard(progress.mutex);
+
+            // Get the score map after the game;
+            Game::score_map_t score_map = progress.server->get_score_map();
+            progress.server.reset();
+
+            // Prepare data structures for the next round.
+            reset_shared();
+
+            // Mark the last game as finished.
+            turn_container->mark_the_game_as_finished(score_map);
+            notify_reactors();
+        }
 
-        // Prepare data structures for the next round.
-        reset_shared();
+        if (settings.zerocopy_threshold > 0) {
+            report_send_stats();
+        }
 
-        // Mark the last game as finished.
-        turn_container->mark_the_game_as_finished(score_map);
+        // The server is usually killed, so the capture is written after every game.
+        if (traffic_capture) {
+            traffic_capture->flush();
+        }
     }
 
     // Unreachable.
-    thread_acceptor.join();
+    for (auto &thread_acceptor: acceptor_threads) {
+        thread_acceptor.join();
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include "../network/byte_order.h"
+
+#define MAX_COUNT 100
+// Offsets of the arrays from an aligned address.
+#define MAX_OFFSET 8
+
+static_assert(swap_byte_order<uint16_t>(0x1234) == 0x3412);
+static_assert(swap_byte_order<uint32_t>(0x12345678) == 0x78563412);
+static_assert(swap_byte_order<uint64_t>(0x0102030405060708) == 0x0807060504030201);
+static_assert(network_to_host(host_to_network<uint32_t>(0xdeadbeef)) == 0xdeadbeef);
+
+// Every kernel converts arrays of every length at every offset like the scalar one.
+template<typename T, typename Swap>
+void check_kernels(const Swap &swap) {
+    for (ByteSwapKernel kernel: {ByteSwapKernel::Best, ByteSwapKernel::Scalar, ByteSwapKernel::SSE,
+                                 ByteSwapKernel::AVX2}) {
+        for (size_t offset = 0; offset < MAX_OFFSET; offset++) {
+            for (size_t count = 0; count <= MAX_COUNT; count++) {
+                std::vector<uint8_t> bytes(offset + count * sizeof(T) + 1);
+                for (size_t i = 0; i < bytes.size(); i++) {
+                    bytes[i] = (uint8_t) (i * 7 + count);
+                }
+                std::vector<uint8_t> expected = bytes;
+                for (size_t i = 0; i < count; i++) {
+                    convert_host_to_network_byte_order<T>(expected.data() + offset + i * sizeof(T));
+                }
+
+                swap(bytes.data() + offset, count, kernel);
+                if constexpr (std::endian::native == std::endian::little) {
+                    // The bytes around the array are left as they were.
+                    assert(bytes == expected);
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    uint8_t element[] = {0x12, 0x34, 0x56, 0x78};
+    convert_network_to_host_byte_order<uint32_t>(element);
+    uint32_t value;
+    std::memcpy(&value, element, sizeof(value));
+    assert(value == 0x12345678);
+
+    check_kernels<uint16_t>([](uint8_t *buffer, size_t count, ByteSwapKernel kernel) {
+        swap_byte_order_16(buffer, count, kernel);
+    });
+    check_kernels<uint32_t>([](uint8_t *buffer, size_t count, ByteSwapKernel kernel) {
+        swap_byte_order_32(buffer, count, kernel);
+    });
+
+    std::cout << "Byte order kernels agree with the scalar conversion." << std::endl;
+    return 0;
+}
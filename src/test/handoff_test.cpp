@@ -0,0 +1,198 @@
+#include <iostream>
+#include <thread>
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../network/message_manager.h"
+
+#define NUM_PLAYERS 2
+#define GAME_LENGTH 60
+// Milliseconds per turn.
+#define TURN_DURATION 50
+// Turn after which the new server is started. No moves are sent in the turns around it, so that
+// they are applied in the same turns as without the upgrade.
+#define UPGRADE_TURN 22
+#define SEED "7"
+
+using clock_type = std::chrono::steady_clock;
+
+struct game_record {
+    std::vector<MessageEncoder::message_t> turns;
+    // Longest time between consecutive turns in milliseconds.
+    double max_gap = 0;
+};
+
+static pid_t start_server(types::port_t port, const std::string &handoff_path) {
+    // Nothing is allocated after fork, as other threads may hold the allocator's locks.
+    std::vector<std::string> args = {"robots-server", "-b", "3", "-c", std::to_string(NUM_PLAYERS),
+                                     "-d", std::to_string(TURN_DURATION), "-e", "2", "-k", "10",
+                                     "-l", std::to_string(GAME_LENGTH), "-n", "Handoff test",
+                                     "-p", std::to_string(port), "-s", SEED, "-x", "10", "-y", "10",
+                                     "-r", "1", "-o", handoff_path};
+    std::vector<char *> argv;
+    for (auto &arg: args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv("./robots-server", argv.data());
+        _exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+static std::unique_ptr<TCPHandler> connect_to_server(types::port_t port) {
+    std::string address = "localhost";
+    for (int attempt = 0; attempt < 100; attempt++) {
+        try {
+            return std::make_unique<TCPHandler>(address, port, TCP_BUFF_SIZE);
+        }
+        catch (const std::exception &e) {
+            // The server is not listening yet.
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    std::cerr << "Could not connect to the server!\n";
+    exit(EXIT_FAILURE);
+}
+
+// Reads the next message, returning its code. Turns are encoded again, so that they can be compared.
+static types::message_id_t read_message(TCPHandler &handler, MessageEncoder::message_t &turn) {
+    auto message_id = handler.read_element<types::message_id_t>();
+    switch (message_id) {
+        case clientServerCodes::hello:
+            Hello{handler};
+            break;
+        case clientServerCodes::acceptedPlayer:
+            AcceptedPlayer{handler};
+            break;
+        case clientServerCodes::gameStarted:
+            GameStarted{handler};
+            break;
+        case clientServerCodes::turn:
+            turn = encode_client_message(Turn(handler));
+            break;
+        case clientServerCodes::gameEnded:
+            GameEnded{handler};
+            break;
+        default:
+            assert(false);
+    }
+    return message_id;
+}
+
+static void join(TCPHandler &handler, std::string name) {
+    handler.send_element<types::message_id_t>(serverClientCodes::join);
+    Join(name).serialize(handler);
+    handler.flush_outcoming_message();
+
+    // Wait until the player is accepted, so that the ids of the players are always the same.
+    MessageEncoder::message_t turn;
+    types::message_id_t message_id = read_message(handler, turn);
+    assert(message_id == clientServerCodes::hello);
+    while (read_message(handler, turn) != clientServerCodes::acceptedPlayer) {}
+}
+
+// Plays the game, placing bombs regularly. upgrade is invoked after UPGRADE_TURN is received.
+template<typename Upgrade>
+static game_record play(TCPHandler &handler, const Upgrade &upgrade) {
+    game_record record;
+    clock_type::time_point last_turn;
+    types::message_id_t message_id;
+    MessageEncoder::message_t turn;
+
+    while ((message_id = read_message(handler, turn)) != clientServerCodes::gameEnded) {
+        if (message_id != clientServerCodes::turn) {
+            continue;
+        }
+        auto now = clock_type::now();
+        if (!record.turns.empty()) {
+            record.max_gap = std::max(record.max_gap, std::chrono::duration<double, std::milli>(now - last_turn).count());
+        }
+        last_turn = now;
+        record.turns.push_back(turn);
+
+        size_t turn_id = record.turns.size() - 1;
+        if (turn_id % 4 == 1) {
+            handler.send_element<types::message_id_t>(serverClientCodes::placeBomb);
+            handler.flush_outcoming_message();
+        }
+        if (turn_id == UPGRADE_TURN) {
+            upgrade();
+        }
+    }
+    return record;
+}
+
+// Plays a game on a server started with handoff_path, upgrading it to a new server if upgrade.
+static std::vector<game_record> run_game(types::port_t port, const std::string &handoff_path, bool upgrade) {
+    pid_t old_server = start_server(port, handoff_path);
+    pid_t new_server = -1;
+
+    std::vector<std::unique_ptr<TCPHandler>> clients;
+    for (size_t i = 0; i < NUM_PLAYERS; i++) {
+        clients.push_back(connect_to_server(port));
+        join(*clients.back(), "Player " + std::to_string(i));
+    }
+
+    std::vector<game_record> records(NUM_PLAYERS);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < NUM_PLAYERS; i++) {
+        threads.emplace_back([&, i] {
+            records[i] = play(*clients[i], [&, i] {
+                if (upgrade && i == 0) {
+                    new_server = start_server(port, handoff_path);
+                }
+            });
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    if (upgrade) {
+        // The old server exits once the new one takes over.
+        int status;
+        pid_t exited = waitpid(old_server, &status, 0);
+        assert(exited == old_server && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+        // New clients are accepted by the new server.
+        std::unique_ptr<TCPHandler> client = connect_to_server(port);
+        MessageEncoder::message_t turn;
+        types::message_id_t message_id = read_message(*client, turn);
+        assert(message_id == clientServerCodes::hello);
+        std::swap(old_server, new_server);
+    }
+
+    kill(old_server, SIGKILL);
+    waitpid(old_server, nullptr, 0);
+    unlink(handoff_path.c_str());
+    return records;
+}
+
+int main() {
+    std::string handoff_path = "/tmp/robots-handoff-" + std::to_string(getpid()) + ".sock";
+    auto port = (types::port_t) (20000 + getpid() % 20000);
+
+    std::vector<game_record> baseline = run_game(port, handoff_path, false);
+    std::vector<game_record> upgraded = run_game((types::port_t) (port + 1), handoff_path, true);
+
+    for (size_t i = 0; i < NUM_PLAYERS; i++) {
+        std::cout << "Player " << i << ": longest time between turns " << baseline[i].max_gap << " ms, with an upgrade "
+                  << upgraded[i].max_gap << " ms." << std::endl;
+
+        // The game goes on as if there was no upgrade.
+        assert(upgraded[i].turns.size() == GAME_LENGTH + 1);
+        assert(baseline[i].turns.size() == upgraded[i].turns.size());
+        for (size_t t = 0; t < baseline[i].turns.size(); t++) {
+            assert(*baseline[i].turns[t] == *upgraded[i].turns[t]);
+        }
+        assert(upgraded[i].max_gap < 3 * TURN_DURATION);
+    }
+
+    return 0;
+}
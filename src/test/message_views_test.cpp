@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cassert>
+#include <string>
+#include "../network/message_manager.h"
+
+#define PLAYERS 4
+
+// The owning message constructed from the view is encoded to the same bytes.
+template<typename Message, typename View>
+void check_owning(const MessageEncoder::message_t &encoded, const View &view) {
+    MessageEncoder::message_t copy = encode_client_message(Message(view));
+    assert(*copy == *encoded);
+}
+
+// Every message cut short is incomplete, the whole one is viewed up to its end.
+StreamResult<ServerMessageView> view_whole(const MessageEncoder::message_t &encoded) {
+    for (size_t size = 0; size < encoded->size(); size++) {
+        MessageDecoder decoder(std::span<const uint8_t>(*encoded).first(size));
+        assert(ClientMessageManager::try_view_server_message(decoder).status() == StreamStatus::Incomplete);
+    }
+    MessageDecoder decoder(*encoded);
+    StreamResult<ServerMessageView> message = ClientMessageManager::try_view_server_message(decoder);
+    assert(message && decoder.get_remaining_bytes_count() == 0);
+    return message;
+}
+
+int main() {
+    GameStarted game_started;
+    GameEnded game_ended;
+    for (types::player_id_t id = 0; id < PLAYERS; id++) {
+        Player player;
+        player.name = "Player " + std::to_string(id);
+        player.address = "127.0.0.1:" + std::to_string(10000 + id);
+        game_started.players[id] = player;
+        game_ended.scores[id] = 10u * id;
+    }
+
+    MessageEncoder::message_t encoded = encode_client_message(game_started);
+    StreamResult<ServerMessageView> message = view_whole(encoded);
+    const auto &game_started_view = std::get<GameStartedView>(*message);
+    assert(game_started_view.players.size() == PLAYERS);
+    auto player = game_started.players.begin();
+    for (const auto &[id, view]: game_started_view.players) {
+        assert(id == player->first && view.name == player->second.name && view.address == player->second.address);
+        player++;
+    }
+    check_owning<GameStarted>(encoded, game_started_view);
+
+    Turn turn;
+    turn.turn = 7;
+    BombExploded exploded;
+    exploded.id = 3;
+    exploded.robots_destroyed = {1, 2};
+    exploded.blocks_destroyed = {Position(), Position()};
+    exploded.blocks_destroyed[1].x = 5;
+    PlayerMoved moved;
+    moved.id = 1;
+    moved.position.x = 2;
+    moved.position.y = 9;
+    turn.events = {exploded, moved};
+
+    encoded = encode_client_message(turn);
+    message = view_whole(encoded);
+    const auto &turn_view = std::get<TurnView>(*message);
+    assert(turn_view.turn == turn.turn && turn_view.events.size() == 2);
+    auto event = turn_view.events.begin();
+    const auto &exploded_view = std::get<BombExplodedView>(*event);
+    assert(exploded_view.id == exploded.id && exploded_view.robots_destroyed.size() == 2);
+    size_t i = 0;
+    for (const Position &position: exploded_view.blocks_destroyed) {
+        assert(position == exploded.blocks_destroyed[i++]);
+    }
+    ++event;
+    assert(std::get<PlayerMoved>(*event).position == moved.position);
+    ++event;
+    assert(event == turn_view.events.end());
+    check_owning<Turn>(encoded, turn_view);
+
+    encoded = encode_client_message(game_ended);
+    message = view_whole(encoded);
+    for (const auto &[id, score]: std::get<GameEndedView>(*message).scores) {
+        assert(game_ended.scores.at(id) == score);
+    }
+    check_owning<GameEnded>(encoded, std::get<GameEndedView>(*message));
+
+    // An event of an unknown code makes the turn invalid.
+    std::vector<uint8_t> invalid = *encode_client_message(turn);
+    invalid[1 + sizeof(types::turn_t) + sizeof(types::vec_len_t)] = 42;
+    MessageDecoder invalid_decoder(invalid);
+    assert(ClientMessageManager::try_view_server_message(invalid_decoder).status() == StreamStatus::Invalid);
+
+    // The name of Join is viewed in the bytes.
+    std::string name = "Viewed player";
+    encoded = ClientMessageManager::encode_server_message(Join(name));
+    MessageDecoder decoder(*encoded);
+    StreamResult<ClientMessageView> join = ServerMessageManager::try_view_client_message(decoder);
+    const auto &join_view = std::get<JoinView>(*join);
+    assert(join_view.name == name && (const uint8_t *) join_view.name.data() > encoded->data());
+    assert(Join(join_view).name == name);
+
+    std::cout << "Views of the messages match the messages they were encoded from." << std::endl;
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <thread>
+#include <cassert>
+#include <atomic>
+#include <vector>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "../network/shared_memory_handler.h"
+
+// Inputs sent through the ring, enough for its counters to wrap around it several times.
+#define NUM_INPUTS (5 * SHM_INPUT_RING_SIZE + 3)
+// Milliseconds for which a waiting thread is left blocked before it is woken up.
+#define WAIT_TIME 50
+
+static uint32_t read_frame_value(std::span<const uint8_t> frame) {
+    assert(frame.size() == sizeof(uint32_t));
+    uint32_t value;
+    std::memcpy(&value, frame.data(), sizeof(value));
+    return ntohl(value);
+}
+
+static void publish_value(SharedMemoryGuiHandler &handler, uint32_t value, bool flush) {
+    handler.append_to_outcoming_packet<uint32_t>(value);
+    if (flush) {
+        handler.flush_outcoming_packet();
+    } else {
+        handler.queue_outcoming_packet();
+    }
+}
+
+static void send_input_value(SharedMemoryGuiPeer &peer, uint16_t value) {
+    uint16_t bytes = htons(value);
+    assert(peer.send_input({(const uint8_t *) &bytes, sizeof(bytes)}));
+}
+
+static uint16_t read_input_value(SharedMemoryGuiHandler &handler) {
+    assert(handler.read_incoming_packet() == sizeof(uint16_t));
+    return handler.read_next_packet_element<uint16_t>();
+}
+
+// The gui always reads the latest frame, and the frame it holds is not overwritten by the client.
+static void test_frames(SharedMemoryGuiHandler &handler, SharedMemoryGuiPeer &peer) {
+    publish_value(handler, 1, true);
+    assert(read_frame_value(peer.read_frame()) == 1);
+
+    // Frames published while the gui is not reading are skipped, only the latest one is read.
+    for (uint32_t value = 2; value <= 10; value++) {
+        publish_value(handler, value, value == 10);
+    }
+    std::span<const uint8_t> frame = peer.read_frame();
+    assert(read_frame_value(frame) == 10);
+
+    // The client keeps swapping its frame with the middle one, never with the one the gui holds.
+    for (uint32_t value = 11; value <= 20; value++) {
+        publish_value(handler, value, true);
+        assert(read_frame_value(frame) == 10);
+    }
+    assert(read_frame_value(peer.read_frame()) == 20);
+
+    // A frame larger than SHM_FRAME_SIZE is rejected, the frame being built is kept.
+    std::vector<uint8_t> too_large(SHM_FRAME_SIZE);
+    handler.append_to_outcoming_packet<uint32_t>(21);
+    bool thrown = false;
+    try {
+        handler.append_bytes_to_outcoming_packet(too_large);
+    }
+    catch (const SharedMemoryError &) {
+        thrown = true;
+    }
+    assert(thrown);
+    handler.flush_outcoming_packet();
+    assert(read_frame_value(peer.read_frame()) == 21);
+}
+
+// Inputs keep their order while the counters go around the ring, which takes at most
+// SHM_INPUT_RING_SIZE of them.
+static void test_inputs(SharedMemoryGuiHandler &handler, SharedMemoryGuiPeer &peer) {
+    uint8_t too_long[SHM_INPUT_SIZE + 1] = {};
+    assert(!peer.send_input(too_long));
+
+    uint16_t sent = 0, received = 0;
+    while (sent < SHM_INPUT_RING_SIZE) {
+        send_input_value(peer, sent++);
+    }
+    uint16_t full = htons(sent);
+    assert(!peer.send_input({(const uint8_t *) &full, sizeof(full)}));
+
+    // Read and send in uneven steps, so that the head and the tail meet in different slots.
+    size_t step = 1;
+    while (received < NUM_INPUTS) {
+        for (size_t i = 0; i < step && received < sent; i++) {
+            assert(read_input_value(handler) == received);
+            received++;
+        }
+        for (size_t i = 0; i < step + 1 && sent < NUM_INPUTS && sent - received < SHM_INPUT_RING_SIZE; i++) {
+            send_input_value(peer, sent++);
+        }
+        step = step % 7 + 1;
+    }
+    assert(!handler.has_received_packets());
+
+    // A read past the end of the input throws.
+    send_input_value(peer, 0);
+    read_input_value(handler);
+    bool thrown = false;
+    try {
+        handler.read_next_packet_element<uint8_t>();
+    }
+    catch (const SharedMemoryError &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// Both sides sleep on the futexes while there is nothing to read and are woken by the other one.
+static void test_wake_up(SharedMemoryGuiHandler &handler, SharedMemoryGuiPeer &peer) {
+    std::atomic<bool> woken = false;
+    std::thread gui([&] {
+        assert(read_frame_value(peer.read_frame()) == 100);
+        woken = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_TIME));
+    assert(!woken);
+    publish_value(handler, 100, true);
+    gui.join();
+    assert(woken);
+
+    woken = false;
+    std::thread client([&] {
+        assert(read_input_value(handler) == 200);
+        woken = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_TIME));
+    assert(!woken);
+    send_input_value(peer, 200);
+    client.join();
+    assert(woken);
+}
+
+int main() {
+    std::string name = "/robots-test-" + std::to_string(getpid());
+    SharedMemoryGuiHandler handler(name);
+    SharedMemoryGuiPeer peer(name);
+
+    test_frames(handler, peer);
+    test_inputs(handler, peer);
+    test_wake_up(handler, peer);
+
+    std::cout << "Shared memory channel passes the latest frames and all the inputs in order." << std::endl;
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <iostream>
+#include <cassert>
+#include "../network/token_bucket.h"
+
+// Messages per second.
+#define RATE 100
+#define BURST 10
+#define SECONDS 5
+
+using clock_type = TokenBucket::clock_type;
+
+int main() {
+    auto now = clock_type::now();
+    TokenBucket bucket(RATE, BURST);
+
+    // A flood takes the burst at once and then only the refilled tokens.
+    size_t accepted = 0;
+    for (int i = 0; i < 1000; i++) {
+        accepted += bucket.try_consume(now);
+    }
+    assert(accepted == BURST);
+
+    // Ten messages per millisecond for some seconds get through at the rate.
+    accepted = 0;
+    for (int ms = 1; ms <= SECONDS * 1000; ms++) {
+        for (int i = 0; i < 10; i++) {
+            accepted += bucket.try_consume(now + std::chrono::milliseconds(ms));
+        }
+    }
+    assert(accepted >= RATE * SECONDS - 1 && accepted <= RATE * SECONDS + 1);
+
+    // A client sending below the rate is never limited, after an idle period it may burst again.
+    now += std::chrono::seconds(SECONDS + 1);
+    for (int i = 0; i < BURST; i++) {
+        assert(bucket.try_consume(now));
+    }
+    for (int ms = 20; ms <= SECONDS * 1000; ms += 20) {
+        assert(bucket.try_consume(now + std::chrono::milliseconds(ms)));
+    }
+
+    // Rate 0 disables the limit.
+    TokenBucket unlimited(0, BURST);
+    assert(!unlimited.is_limited());
+    for (int i = 0; i < 1000; i++) {
+        assert(unlimited.try_consume(now));
+    }
+
+    std::cout << "Token bucket limits the messages to the rate and the burst." << std::endl;
+    return 0;
+}
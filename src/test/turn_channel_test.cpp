@@ -0,0 +1,306 @@
+#include <iostream>
+#include <thread>
+#include <cassert>
+#include <atomic>
+#include <deque>
+#include <random>
+#include <algorithm>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include "../network/message_manager.h"
+#include "../network/turn_channel.h"
+
+#define NUM_TURNS 400
+#define NUM_PLAYERS 16
+// Milliseconds between turns.
+#define TURN_INTERVAL 5
+// One-way delay of the emulated link in milliseconds.
+#define LINK_DELAY 2
+#define LOSS_RATE 0.02
+// Minimal TCP retransmission timeout of Linux in milliseconds.
+#define TCP_RTO 200
+#define SEED 42
+
+using clock_type = std::chrono::steady_clock;
+
+// Packets held back by the emulated link until their time comes, each with its destination.
+class DelayLine {
+public:
+    void push(std::vector<uint8_t> &&bytes, clock_type::time_point due, int destination) {
+        packets.push_back({std::move(bytes), due, destination});
+    }
+
+    // Milliseconds until the next packet is due, -1 if there are none.
+    int get_timeout() const {
+        if (packets.empty()) {
+            return -1;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(packets.front().due - clock_type::now());
+        return (int) std::max<long>(left.count(), 0);
+    }
+
+    template<typename Send>
+    void send_due(const Send &send) {
+        while (!packets.empty() && packets.front().due <= clock_type::now()) {
+            send(packets.front().destination, packets.front().bytes);
+            packets.pop_front();
+        }
+    }
+
+    [[nodiscard]] bool empty() const {
+        return packets.empty();
+    }
+
+    [[nodiscard]] clock_type::time_point last_due() const {
+        return packets.empty() ? clock_type::time_point() : packets.back().due;
+    }
+
+private:
+    struct packet_t {
+        std::vector<uint8_t> bytes;
+        clock_type::time_point due;
+        int destination;
+    };
+
+    // Due times do not decrease.
+    std::deque<packet_t> packets;
+};
+
+static Turn make_turn(types::turn_t turn_id) {
+    Turn turn;
+    turn.turn = turn_id;
+    for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+        PlayerMoved moved{};
+        moved.id = id;
+        moved.position.x = (types::size_xy_t) (turn_id + id);
+        moved.position.y = (types::size_xy_t) (turn_id * id);
+        turn.events.emplace_back(moved);
+    }
+    return turn;
+}
+
+static Hello make_hello() {
+    options_server op;
+    op.bomb_timer = 5;
+    op.players_count = NUM_PLAYERS;
+    op.explosion_radius = 4;
+    op.game_length = NUM_TURNS - 1;
+    op.server_name = "Test server";
+    op.size_x = 64;
+    op.size_y = 64;
+    return Hello(op);
+}
+
+static struct sockaddr_in6 loopback_address(types::port_t port) {
+    struct sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_loopback;
+    address.sin6_port = htons(port);
+    return address;
+}
+
+static std::pair<int, int> create_socket_pair() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        std::cerr << std::strerror(errno) << '\n';
+        exit(EXIT_FAILURE);
+    }
+    return {fds[0], fds[1]};
+}
+
+/**
+ * @brief Emulates a lossy link under TCP. A lost segment is delivered after the retransmission
+ * timeout and holds back all the following ones, which wait for it in the receiver's buffer.
+ */
+static void relay_tcp(int from_fd, int to_fd) {
+    std::mt19937 generator(SEED);
+    std::bernoulli_distribution lost(LOSS_RATE);
+    DelayLine line;
+    std::vector<uint8_t> buffer(TCP_BUFF_SIZE);
+    bool open = true;
+
+    while (open || !line.empty()) {
+        struct pollfd fd{open ? from_fd : -1, POLLIN, 0};
+        poll(&fd, 1, line.get_timeout());
+        if (fd.revents != 0) {
+            ssize_t received = read(from_fd, buffer.data(), buffer.size());
+            if (received <= 0) {
+                open = false;
+            } else {
+                auto due = clock_type::now() + std::chrono::milliseconds(lost(generator) ? TCP_RTO : LINK_DELAY);
+                line.push({buffer.begin(), buffer.begin() + received}, std::max(due, line.last_due()), to_fd);
+            }
+        }
+        line.send_due([](int fd, const std::vector<uint8_t> &bytes) {
+            if (write(fd, bytes.data(), bytes.size()) != (ssize_t) bytes.size()) {
+                std::cerr << "Relay failed!\n";
+                exit(EXIT_FAILURE);
+            }
+        });
+    }
+    shutdown(to_fd, SHUT_WR);
+}
+
+/**
+ * @brief Emulates a lossy link under UDP in both directions. Datagrams from the server go to the
+ * client, all the other ones (acknowledgements) go to the server.
+ */
+static void relay_udp(int relay_fd, types::port_t server_port, types::port_t client_port,
+                      const std::atomic<bool> &stop) {
+    std::mt19937 generator(SEED);
+    std::bernoulli_distribution lost(LOSS_RATE);
+    DelayLine line;
+    std::vector<uint8_t> buffer(TURN_DATAGRAM_SIZE);
+    struct sockaddr_in6 server_address = loopback_address(server_port);
+    struct sockaddr_in6 client_address = loopback_address(client_port);
+
+    while (!stop) {
+        struct pollfd fd{relay_fd, POLLIN, 0};
+        int timeout = line.get_timeout();
+        poll(&fd, 1, timeout == -1 ? TURN_INTERVAL : timeout);
+        if (fd.revents != 0) {
+            struct sockaddr_in6 source{};
+            socklen_t source_len = sizeof(source);
+            ssize_t received = recvfrom(relay_fd, buffer.data(), buffer.size(), 0, (struct sockaddr *) &source,
+                                        &source_len);
+            if (received > 0 && !lost(generator)) {
+                int to_client = ntohs(source.sin6_port) == server_port;
+                line.push({buffer.begin(), buffer.begin() + received},
+                          clock_type::now() + std::chrono::milliseconds(LINK_DELAY), to_client);
+            }
+        }
+        line.send_due([&](int to_client, const std::vector<uint8_t> &bytes) {
+            const struct sockaddr_in6 &address = to_client ? client_address : server_address;
+            sendto(relay_fd, bytes.data(), bytes.size(), 0, (const struct sockaddr *) &address, sizeof(address));
+        });
+    }
+}
+
+// Reads all the turns, returning the latency of each one in milliseconds.
+static std::vector<double> read_turns(ClientMessageManager &manager,
+                                      const std::vector<std::atomic<clock_type::rep>> &published) {
+    ServerMessage hello = manager.read_server_message();
+    assert(std::holds_alternative<Hello>(hello));
+    ServerMessage game_started = manager.read_server_message();
+    assert(std::holds_alternative<GameStarted>(game_started));
+
+    std::vector<double> latencies;
+    for (types::turn_t t = 0; t < NUM_TURNS; t++) {
+        ServerMessage message = manager.read_server_message();
+        assert(std::holds_alternative<Turn>(message));
+        assert(std::get<Turn>(message).turn == t);
+        clock_type::duration latency = clock_type::now().time_since_epoch() - clock_type::duration(published[t]);
+        latencies.push_back(std::chrono::duration<double, std::milli>(latency).count());
+    }
+    return latencies;
+}
+
+static double percentile(std::vector<double> latencies, size_t p) {
+    std::sort(latencies.begin(), latencies.end());
+    return latencies[latencies.size() * p / 100];
+}
+
+static void report(const std::string &name, const std::vector<double> &latencies) {
+    std::cout << name << ": p50 " << percentile(latencies, 50) << " ms, p99 " << percentile(latencies, 99)
+              << " ms." << std::endl;
+}
+
+static std::vector<double> run_tcp(const std::vector<MessageEncoder::message_t> &turns) {
+    auto [server_fd, server_relay_fd] = create_socket_pair();
+    auto [client_relay_fd, client_fd] = create_socket_pair();
+    std::thread relay{[=] { relay_tcp(server_relay_fd, client_relay_fd); }};
+
+    TCPHandler::ptr server_handler = std::make_shared<TCPHandler>(server_fd, TCP_BUFF_SIZE);
+    ServerMessageManager server(server_handler);
+    TCPHandler client_handler(client_fd, TCP_BUFF_SIZE);
+    UDPHandler gui_handler(0, {}, UDP_BUFF_SIZE);
+    ClientMessageManager client(client_handler, gui_handler);
+
+    std::vector<std::atomic<clock_type::rep>> published(NUM_TURNS);
+    std::thread publisher{[&] {
+        server.send_client_message(make_hello());
+        server.send_client_message(GameStarted());
+        auto start = clock_type::now();
+        for (size_t t = 0; t < NUM_TURNS; t++) {
+            std::this_thread::sleep_until(start + std::chrono::milliseconds(t * TURN_INTERVAL));
+            published[t] = clock_type::now().time_since_epoch().count();
+            server.send_client_message(turns[t]);
+        }
+    }};
+
+    std::vector<double> latencies = read_turns(client, published);
+    publisher.join();
+    shutdown(server_fd, SHUT_WR);
+    relay.join();
+    close(server_relay_fd);
+    close(client_relay_fd);
+    return latencies;
+}
+
+static std::vector<double> run_udp(const std::vector<MessageEncoder::message_t> &turns) {
+    auto [server_fd, client_fd] = create_socket_pair();
+    TCPHandler::ptr server_handler = std::make_shared<TCPHandler>(server_fd, TCP_BUFF_SIZE);
+    ServerMessageManager server(server_handler);
+    TCPHandler client_handler(client_fd, TCP_BUFF_SIZE);
+    UDPHandler gui_handler(0, {}, UDP_BUFF_SIZE);
+    ClientMessageManager client(client_handler, gui_handler);
+
+    // The channel keeps running until the end of the process.
+    auto channel = std::make_shared<TurnChannelServer>(0);
+    std::thread{[channel] { channel->run(); }}.detach();
+    TurnChannelClient client_channel(0);
+    client.set_turn_channel(client_channel);
+
+    int relay_fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    struct sockaddr_in6 relay_address = loopback_address(0);
+    socklen_t relay_address_len = sizeof(relay_address);
+    if (relay_fd == -1 || bind(relay_fd, (struct sockaddr *) &relay_address, sizeof(relay_address)) != 0 ||
+        getsockname(relay_fd, (struct sockaddr *) &relay_address, &relay_address_len) != 0) {
+        std::cerr << std::strerror(errno) << '\n';
+        exit(EXIT_FAILURE);
+    }
+    std::atomic<bool> stop = false;
+    std::thread relay{[&, server_port = channel->get_port(), client_port = client_channel.get_port()] {
+        relay_udp(relay_fd, server_port, client_port, stop);
+    }};
+    channel->subscribe(relay_address);
+
+    std::vector<std::atomic<clock_type::rep>> published(NUM_TURNS);
+    std::thread publisher{[&] {
+        server.send_client_message(make_hello());
+        server.send_client_message(GameStarted());
+        channel->start_game(1);
+        auto start = clock_type::now();
+        for (size_t t = 0; t < NUM_TURNS; t++) {
+            std::this_thread::sleep_until(start + std::chrono::milliseconds(t * TURN_INTERVAL));
+            published[t] = clock_type::now().time_since_epoch().count();
+            channel->publish_turn(turns[t]);
+        }
+    }};
+
+    std::vector<double> latencies = read_turns(client, published);
+    publisher.join();
+    stop = true;
+    relay.join();
+    close(relay_fd);
+    return latencies;
+}
+
+int main() {
+    std::vector<MessageEncoder::message_t> turns;
+    for (types::turn_t t = 0; t < NUM_TURNS; t++) {
+        turns.push_back(encode_client_message(make_turn(t)));
+    }
+
+    std::vector<double> tcp = run_tcp(turns);
+    report("TCP", tcp);
+    std::vector<double> udp = run_udp(turns);
+    report("UDP turn channel", udp);
+
+    // A lost datagram is made up for by the next one, while a lost segment stalls the stream.
+    assert(percentile(udp, 99) < percentile(tcp, 99));
+
+    return 0;
+}
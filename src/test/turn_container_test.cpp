@@ -0,0 +1,233 @@
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <set>
+#include <tuple>
+#include <random>
+#include "../concurrency/turn_container.h"
+#include "../game_logic/game.h"
+
+#define NUM_TURNS 200
+#define NUM_PLAYERS 4
+#define BOARD_SIZE 6
+#define SEED 42
+
+#define BOMB_TIMER 5
+// Turns behind the last one appended from which snapshots are taken while the turns are appended.
+#define SNAPSHOT_LAG 10
+
+/* Client applying the turns it receives, with the board compared as sets, as the order of the
+ * blocks and bombs in its state depends on the order the events were applied in. */
+struct client_view {
+    GameClient game;
+
+    client_view() : game(hello(), game_started()) {}
+
+    static Hello hello() {
+        Hello message;
+        message.server_name = "test";
+        message.players_count = NUM_PLAYERS;
+        message.size_x = BOARD_SIZE;
+        message.size_y = BOARD_SIZE;
+        message.game_length = NUM_TURNS;
+        message.explosion_radius = 2;
+        message.bomb_timer = BOMB_TIMER;
+        return message;
+    }
+
+    static GameStarted game_started() {
+        GameStarted message;
+        for (types::player_id_t id = 0; id < NUM_PLAYERS; id++) {
+            message.players[id] = Player();
+        }
+        return message;
+    }
+
+    // Applies every turn of the message, which may hold many of them.
+    void apply(const MessageEncoder::message_t &message) {
+        MessageDecoder decoder(*message);
+        while (decoder.get_remaining_bytes_count() > 0) {
+            auto message_id = decoder.read_element<types::message_id_t>();
+            assert(message_id == clientServerCodes::turn);
+            game.apply_turn(Turn(decoder));
+        }
+    }
+
+    bool operator==(const client_view &other) const {
+        GameMessage state = game.get_game_state();
+        GameMessage other_state = other.game.get_game_state();
+        auto cells = [](const std::vector<Position> &positions) {
+            std::multiset<std::pair<int, int>> set;
+            for (const Position &p: positions) {
+                set.emplace(p.x, p.y);
+            }
+            return set;
+        };
+        auto bombs = [](const std::vector<Bomb> &bombs) {
+            std::multiset<std::tuple<int, int, int>> set;
+            for (const Bomb &bomb: bombs) {
+                set.emplace(bomb.position.x, bomb.position.y, bomb.timer);
+            }
+            return set;
+        };
+        return state.turn == other_state.turn && state.player_positions == other_state.player_positions &&
+               cells(state.blocks) == cells(other_state.blocks) && bombs(state.bombs) == bombs(other_state.bombs) &&
+               cells(state.explosions) == cells(other_state.explosions) && state.scores == other_state.scores;
+    }
+};
+
+static Position random_position(std::mt19937 &generator) {
+    std::uniform_int_distribution<types::size_xy_t> coordinate(0, BOARD_SIZE - 1);
+    Position position;
+    position.x = coordinate(generator);
+    position.y = coordinate(generator);
+    return position;
+}
+
+// Turn with random moves, blocks and explosions, placing and destroying blocks in the same cells often.
+static Turn random_turn(types::turn_t turn_id, std::mt19937 &generator) {
+    std::uniform_int_distribution<int> kind(0, 3);
+    Turn turn;
+    turn.turn = turn_id;
+    for (int i = 0; i < 8; i++) {
+        switch (kind(generator)) {
+            case 0: {
+                PlayerMoved event;
+                event.id = (types::player_id_t) (generator() % NUM_PLAYERS);
+                event.position = random_position(generator);
+                turn.events.emplace_back(event);
+                break;
+            }
+            case 1: {
+                BlockPlaced event;
+                event.position = random_position(generator);
+                turn.events.emplace_back(event);
+                break;
+            }
+            case 2: {
+                BombExploded event;
+                event.id = (types::bomb_id_t) i;
+                event.robots_destroyed = {(types::player_id_t) (generator() % NUM_PLAYERS)};
+                event.blocks_destroyed = {random_position(generator), random_position(generator)};
+                turn.events.emplace_back(event);
+                break;
+            }
+            default: {
+                BombPlaced event;
+                event.id = (types::bomb_id_t) i;
+                event.position = random_position(generator);
+                turn.events.emplace_back(event);
+                break;
+            }
+        }
+    }
+    return turn;
+}
+
+// Turn with few events and rare explosions, so that the bombs ticking decide the catch-up turns.
+static Turn quiet_turn(types::turn_t turn_id, std::mt19937 &generator) {
+    std::uniform_int_distribution<int> kind(0, 15);
+    Turn turn;
+    turn.turn = turn_id;
+    for (int i = 0; i < 2; i++) {
+        types::bomb_id_t id = (types::bomb_id_t) (2 * turn_id + i);
+        switch (kind(generator)) {
+            case 0: {
+                BombExploded event;
+                event.id = (types::bomb_id_t) (generator() % (id + 1));
+                event.blocks_destroyed = {random_position(generator)};
+                if (generator() % 4 == 0) {
+                    event.robots_destroyed = {(types::player_id_t) (generator() % NUM_PLAYERS)};
+                }
+                turn.events.emplace_back(event);
+                break;
+            }
+            case 1:
+            case 2: {
+                BombPlaced event;
+                event.id = id;
+                event.position = random_position(generator);
+                turn.events.emplace_back(event);
+                break;
+            }
+            case 3: {
+                BlockPlaced event;
+                event.position = random_position(generator);
+                turn.events.emplace_back(event);
+                break;
+            }
+            case 4:
+            case 5: {
+                PlayerMoved event;
+                event.id = (types::player_id_t) (generator() % NUM_PLAYERS);
+                event.position = random_position(generator);
+                turn.events.emplace_back(event);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return turn;
+}
+
+static void test_snapshots(Turn (*next_turn)(types::turn_t, std::mt19937 &)) {
+    std::mt19937 generator(SEED);
+    TurnContainer container;
+    std::vector<size_t> sizes;
+    client_view lagging;
+    for (types::turn_t i = 0; i < NUM_TURNS; i++) {
+        container.append_new_turn(next_turn(i, generator));
+        sizes.push_back(container.try_get_turn(i)->size());
+
+        // The board the snapshots are made from follows the turns appended so far.
+        if (i >= SNAPSHOT_LAG) {
+            size_t first = i - SNAPSHOT_LAG;
+            client_view snapshot = lagging;
+            snapshot.apply(container.encode_snapshot(first).first);
+            client_view received = lagging;
+            for (size_t j = first; j <= i; j++) {
+                received.apply(container.try_get_turn(j));
+            }
+            assert(snapshot == received);
+            lagging.apply(container.try_get_turn(first));
+        }
+    }
+    assert(container.get_turns_count() == NUM_TURNS);
+    assert(container.get_bytes_since(NUM_TURNS) == 0);
+
+    // A client which received every turn sees the same board as one which received the turns
+    // up to some point and then the snapshot.
+    client_view expected;
+    for (size_t first = 0; first < NUM_TURNS; first++) {
+        size_t backlog = 0;
+        for (size_t i = first; i < NUM_TURNS; i++) {
+            backlog += sizes[i];
+        }
+        assert(container.get_bytes_since(first) == backlog);
+
+        client_view snapshot = expected;
+        auto [message, replaced] = container.encode_snapshot(first);
+        assert(replaced == NUM_TURNS - first);
+        snapshot.apply(message);
+
+        client_view received = expected;
+        for (size_t i = first; i < NUM_TURNS; i++) {
+            received.apply(container.try_get_turn(i));
+        }
+        assert(snapshot == received);
+
+        expected.apply(container.try_get_turn(first));
+    }
+
+    auto [message, replaced] = container.encode_snapshot(NUM_TURNS);
+    assert(message == nullptr && replaced == 0);
+}
+
+int main() {
+    test_snapshots(random_turn);
+    test_snapshots(quiet_turn);
+
+    std::cout << "Snapshots match the turns received one by one." << std::endl;
+    return 0;
+}